@@ -138,6 +138,34 @@ dict session_stats_values(session_stats_alert const& alert)
     return d;
 }
 
+list disk_latency_jobs(disk_latency_alert const& alert)
+{
+    list result;
+    for (disk_job_latency const& j : alert.jobs)
+    {
+        list queue_time;
+        for (std::int64_t const v : j.queue_time) queue_time.append(v);
+        list exec_time;
+        for (std::int64_t const v : j.exec_time) exec_time.append(v);
+
+        dict d;
+        d["job"] = j.job;
+        d["queue_time"] = queue_time;
+        d["exec_time"] = exec_time;
+        result.append(d);
+    }
+    return result;
+}
+
+std::int64_t disk_latency_percentile(list const& histogram, double const p)
+{
+    std::vector<std::int64_t> h;
+    int const size = int(len(histogram));
+    for (int i = 0; i < size; ++i)
+        h.push_back(extract<std::int64_t>(histogram[i]));
+    return disk_latency_alert::percentile(h, p);
+}
+
 list dht_live_nodes_nodes(dht_live_nodes_alert const& alert)
 {
     list result;
@@ -274,6 +302,7 @@ namespace boost
 	POLY(file_prio_alert)
 	POLY(oversized_file_alert)
 	POLY(torrent_conflict_alert)
+	POLY(disk_latency_alert)
 
 #if TORRENT_ABI_VERSION == 1
 	POLY(anonymous_mode_alert)
@@ -1088,6 +1117,15 @@ void bind_alert()
         "session_stats_header_alert", no_init)
         ;
 
+    class_<disk_latency_alert, bases<alert>, noncopyable>(
+        "disk_latency_alert", no_init)
+        .add_property("jobs", &disk_latency_jobs)
+        .def("bucket_floor", &disk_latency_alert::bucket_floor)
+        .staticmethod("bucket_floor")
+        .def("percentile", &disk_latency_percentile)
+        .staticmethod("percentile")
+        ;
+
     std::vector<tcp::endpoint> (dht_get_peers_reply_alert::*peers)() const = &dht_get_peers_reply_alert::peers;
 
     class_<dht_get_peers_reply_alert, bases<alert>, noncopyable>(
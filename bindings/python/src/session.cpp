@@ -1155,6 +1155,7 @@ void bind_session()
         .def("post_torrent_updates", allow_threads(&lt::session::post_torrent_updates), arg("flags") = 0xffffffff)
         .def("post_dht_stats", allow_threads(&lt::session::post_dht_stats))
         .def("post_session_stats", allow_threads(&lt::session::post_session_stats))
+        .def("post_disk_latency", allow_threads(&lt::session::post_disk_latency))
         .def("is_listening", allow_threads(&lt::session::is_listening))
         .def("listen_port", allow_threads(&lt::session::listen_port))
         .def("ssl_listen_port", allow_threads(&lt::session::ssl_listen_port))
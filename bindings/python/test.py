@@ -976,6 +976,24 @@ class test_session(unittest.TestCase):
         self.assertTrue(isinstance(a.values, dict))
         self.assertTrue(len(a.values) > 0)
 
+    def test_post_disk_latency(self):
+        s = lt.session({'alert_mask': 0, 'enable_dht': False})
+        s.post_disk_latency()
+        a = None
+        for i in range(60):
+            s.wait_for_alert(1000)
+            alerts = [x for x in s.pop_alerts() if isinstance(x, lt.disk_latency_alert)]
+            if len(alerts) > 0:
+                a = alerts[0]
+                break
+        self.assertTrue(isinstance(a, lt.disk_latency_alert))
+        self.assertTrue(isinstance(a.jobs, list))
+        for j in a.jobs:
+            self.assertTrue(isinstance(j['job'], str))
+            self.assertEqual(len(j['queue_time']), len(j['exec_time']))
+        self.assertEqual(lt.disk_latency_alert.bucket_floor(0), 0)
+        self.assertEqual(lt.disk_latency_alert.percentile([0, 0, 0], 0.99), 0)
+
     def test_post_dht_stats(self):
         s = lt.session({'alert_mask': 0, 'enable_dht': False})
         s.post_dht_stats()
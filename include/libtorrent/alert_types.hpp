@@ -70,6 +70,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/socket_type.hpp"
 #include "libtorrent/client_data.hpp"
 #include "libtorrent/peer_info.hpp" // for peer_info
+#include "libtorrent/disk_interface.hpp" // for disk_job_latency
 #include "libtorrent/aux_/deprecated.hpp"
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
@@ -99,7 +100,7 @@ namespace libtorrent {
 	constexpr int user_alert_id = 10000;
 
 	// this constant represents "max_alert_index" + 1
-	constexpr int num_alert_types = 105;
+	constexpr int num_alert_types = 106;
 
 	// internal
 	constexpr int abi_alert_count = 128;
@@ -3112,6 +3113,39 @@ TORRENT_VERSION_NAMESPACE_3_END
 		std::vector<announce_entry> trackers;
 	};
 
+	// posted when session_handle::post_disk_latency() is called. It holds
+	// histograms of how long disk jobs have spent waiting in the queue and
+	// executing, for each type of job, since the session started. This alert
+	// does not have a category, since it's only posted in response to an API
+	// call. It is not subject to the alert_mask filter.
+	//
+	// The histograms are log-linear. Each bucket covers a range of latencies
+	// that is at most 12.5% of its lower bound wide, which is the precision of
+	// percentiles computed from them.
+	struct TORRENT_EXPORT disk_latency_alert final : alert
+	{
+		// internal
+		TORRENT_UNEXPORT disk_latency_alert(aux::stack_allocator& alloc
+			, std::vector<disk_job_latency> j);
+		TORRENT_DEFINE_ALERT_PRIO(disk_latency_alert, 105, alert_priority::critical)
+
+		static constexpr alert_category_t static_category = {};
+		std::string message() const override;
+
+		// one entry per type of disk job. If the disk I/O subsystem does not
+		// record job latencies, this is empty.
+		std::vector<disk_job_latency> jobs;
+
+		// returns the smallest latency, in microseconds, counted in
+		// ``bucket``.
+		static std::int64_t bucket_floor(int bucket);
+
+		// returns the latency, in microseconds, that the fraction ``p`` (e.g.
+		// 0.99) of the samples in ``histogram`` fall below. This is the upper
+		// bound of the histogram bucket the percentile falls in.
+		static std::int64_t percentile(span<std::int64_t const> histogram, double p);
+	};
+
 	// internal
 	TORRENT_EXTRA_EXPORT char const* performance_warning_str(performance_alert::performance_warning_t i);
 
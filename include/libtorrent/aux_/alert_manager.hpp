@@ -41,6 +41,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/stack_allocator.hpp"
 #include "libtorrent/alert_types.hpp" // for abi_alert_count
 #include "libtorrent/aux_/array.hpp"
+#include "libtorrent/aux_/scope_end.hpp"
 
 #include <functional>
 #include <utility> // for std::forward
@@ -48,6 +49,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <condition_variable>
 #include <atomic>
 #include <bitset>
+#include <vector>
+#include <cstdint>
 
 #ifndef TORRENT_DISABLE_EXTENSIONS
 #include "libtorrent/extensions.hpp"
@@ -71,35 +74,48 @@ namespace aux {
 		template <class T, typename... Args>
 		void emplace_alert(Args&&... args) try
 		{
-			std::unique_lock<std::recursive_mutex> lock(m_mutex);
-
-			heterogeneous_queue<alert>& queue = m_alerts[m_generation];
+			thread_queue& q = m_queues[queue_index()];
+			std::unique_lock<std::recursive_mutex> lock(q.mutex);
 
 			// don't add more than this number of alerts, unless it's a
 			// high priority alert, in which case we try harder to deliver it
 			// for high priority alerts, double the upper limit
-			if (queue.size() / (1 + static_cast<int>(T::priority)) >= m_queue_size_limit)
+			if (m_num_queued.load(std::memory_order_relaxed) / (1 + static_cast<int>(T::priority))
+				>= m_queue_size_limit.load(std::memory_order_relaxed))
 			{
 				// record that we dropped an alert of this type
-				m_dropped.set(T::alert_type);
+				q.dropped.set(T::alert_type);
 				return;
 			}
 
-			T& alert = queue.emplace_back<T>(
-				m_allocations[m_generation], std::forward<Args>(args)...);
+			auto& seq = q.sequence[q.generation];
+			seq.push_back(m_sequence.fetch_add(1, std::memory_order_relaxed));
+			auto undo = aux::scope_end([&seq] { seq.pop_back(); });
+
+			T& alert = q.alerts[q.generation].emplace_back<T>(
+				q.allocations[q.generation], std::forward<Args>(args)...);
+			undo.disarm();
 
-			maybe_notify(&alert);
+			bool const first = m_num_queued.fetch_add(1, std::memory_order_acq_rel) == 0;
+			maybe_notify(&alert, first);
 		}
 		catch (std::bad_alloc const&)
 		{
 			// record that we dropped an alert of this type
-			std::unique_lock<std::recursive_mutex> lock(m_mutex);
-			m_dropped.set(T::alert_type);
+			thread_queue& q = m_queues[queue_index()];
+			std::unique_lock<std::recursive_mutex> lock(q.mutex);
+			q.dropped.set(T::alert_type);
 		}
 
 		bool pending() const;
 		void get_all(std::vector<alert*>& alerts);
 
+		// calls ``handler`` with every queued alert, in the order they were
+		// posted, without copying the pointers into a vector. Just like with
+		// the overload above, the alerts stay valid until the next call to
+		// get_all().
+		void get_all(std::function<void(alert*)> const& handler);
+
 		template <class T>
 		bool should_post() const
 		{
@@ -129,21 +145,76 @@ namespace aux {
 
 	private:
 
-		void maybe_notify(alert* a);
+		void maybe_notify(alert* a, bool first);
+
+		// moves all queued alerts to the client, calling f with each one
+		template <typename Fun>
+		void drain(Fun f);
+
+		// returns the oldest queued alert, or nullptr
+		alert* front();
+
+		// the index of the thread_queue the calling thread posts alerts to
+		static int queue_index();
+
+		// the number of independent alert queues. Threads posting alerts are
+		// spread across them, to not contend on a single mutex
+		static constexpr int num_queues = 8;
+
+		// alerts are posted to one of these queues, depending on the posting
+		// thread. Each queue is double buffered. The mutex gives exclusive
+		// access to alerts[generation], allocations[generation] and
+		// sequence[generation] whereas the other copy is exclusively used by
+		// the client thread. Since the mutex is held while executing extension
+		// on_alert() callbacks it must be recursive, to support posting new
+		// alerts from within them.
+		struct thread_queue
+		{
+			std::recursive_mutex mutex;
+
+			// this is either 0 or 1, it indicates which buffers the
+			// alert_manager is allowed to post alerts to right now. This is
+			// swapped when the client calls get_all(), at which point all of
+			// the alert objects passed to the client will be owned by
+			// libtorrent again, and reset.
+			int generation = 0;
 
-		// this mutex protects everything. Since it's held while executing user
-		// callbacks (the notify function and extension on_alert()) it must be
-		// recursive to support recursively post new alerts.
+			aux::array<heterogeneous_queue<alert>, 2> alerts;
+
+			// this is a stack where alerts can allocate variable length
+			// content, such as strings, to go with the alerts.
+			aux::array<stack_allocator, 2> allocations;
+
+			// the sequence number of each alert, used to deliver alerts in
+			// the order they were posted, across queues
+			aux::array<std::vector<std::uint64_t>, 2> sequence;
+
+			// a bitfield where each bit represents an alert type. Every time
+			// we drop an alert (because the queue is full or of some other
+			// error) we set the corresponding bit in this mask, to communicate
+			// to the client that it may have missed an update.
+			std::bitset<abi_alert_count> dropped;
+		};
+
+		aux::array<thread_queue, num_queues> m_queues;
+
+		// the total number of alerts queued, across all thread queues
+		std::atomic<int> m_num_queued{0};
+
+		// the sequence number to assign to the next alert
+		std::atomic<std::uint64_t> m_sequence{0};
+
+		// serializes clients calling get_all()
+		std::mutex m_client_mutex;
+
+		// this mutex protects the notify function and is used to wait for
+		// alerts. It's held while executing the notify function, so it must
+		// be recursive to support posting new alerts from it. It may be locked
+		// while holding a thread_queue mutex, but not the other way around.
 		mutable std::recursive_mutex m_mutex;
 		std::condition_variable_any m_condition;
 		std::atomic<alert_category_t> m_alert_mask;
-		int m_queue_size_limit;
-
-		// a bitfield where each bit represents an alert type. Every time we drop
-		// an alert (because the queue is full or of some other error) we set the
-		// corresponding bit in this mask, to communicate to the client that it
-		// may have missed an update.
-		std::bitset<abi_alert_count> m_dropped;
+		std::atomic<int> m_queue_size_limit;
 
 		// this function (if set) is called whenever the number of alerts in
 		// the alert queue goes from 0 to 1. The client is expected to wake up
@@ -153,23 +224,6 @@ namespace aux {
 		// posted to the queue
 		std::function<void()> m_notify;
 
-		// this is either 0 or 1, it indicates which m_alerts and m_allocations
-		// the alert_manager is allowed to use right now. This is swapped when
-		// the client calls get_all(), at which point all of the alert objects
-		// passed to the client will be owned by libtorrent again, and reset.
-		int m_generation = 0;
-
-		// this is where all alerts are queued up. There are two heterogeneous
-		// queues to double buffer the thread access. The std::mutex in the alert
-		// manager gives exclusive access to m_alerts[m_generation] and
-		// m_allocations[m_generation] whereas the other copy is exclusively
-		// used by the client thread.
-		aux::array<heterogeneous_queue<alert>, 2> m_alerts;
-
-		// this is a stack where alerts can allocate variable length content,
-		// such as strings, to go with the alerts.
-		aux::array<stack_allocator, 2> m_allocations;
-
 #ifndef TORRENT_DISABLE_EXTENSIONS
 		std::list<std::shared_ptr<plugin>> m_ses_extensions;
 #endif
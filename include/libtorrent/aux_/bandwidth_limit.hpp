@@ -81,10 +81,6 @@ struct TORRENT_EXTRA_EXPORT bandwidth_channel
 		return false;
 	}
 
-	// used as temporary storage while distributing
-	// bandwidth
-	int tmp;
-
 	// this is the number of bytes to distribute this round
 	int distribute_quota;
 
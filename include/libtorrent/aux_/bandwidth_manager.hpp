@@ -34,7 +34,10 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef TORRENT_BANDWIDTH_MANAGER_HPP_INCLUDED
 #define TORRENT_BANDWIDTH_MANAGER_HPP_INCLUDED
 
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include "libtorrent/aux_/invariant_check.hpp"
@@ -42,6 +45,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/bandwidth_limit.hpp"
 #include "libtorrent/aux_/bandwidth_queue_entry.hpp"
 #include "libtorrent/aux_/bandwidth_socket.hpp"
+#include "libtorrent/aux_/array.hpp"
 #include "libtorrent/time.hpp"
 
 namespace libtorrent {
@@ -68,6 +72,11 @@ struct TORRENT_EXTRA_EXPORT bandwidth_manager
 	int request_bandwidth(std::shared_ptr<bandwidth_socket> peer
 		, int blk, int priority, bandwidth_channel** chan, int num_channels);
 
+	// called when a peer disconnects while it has a request queued. The
+	// request is dropped without calling assign_bandwidth(), and the quota
+	// its channels had handed it so far is returned to them
+	void cancel_request(bandwidth_socket const* peer);
+
 #if TORRENT_USE_INVARIANT_CHECKS
 	void check_invariant() const;
 #endif
@@ -76,11 +85,110 @@ struct TORRENT_EXTRA_EXPORT bandwidth_manager
 
 private:
 
-	// these are the consumers that want bandwidth
-	std::vector<bw_request> m_queue;
+	// the scheduling state of a bandwidth channel that has requests queued
+	// on it. Every round, the channel hands out all of its quota, split by
+	// priority. Instead of crediting each request individually, the channel
+	// advances its virtual time by the number of bytes handed out per unit of
+	// priority. A request has then been given
+	// ``priority * (virtual_time - start)`` bytes by this channel.
+	struct channel_state
+	{
+		// the sum of the priorities of all requests queued on this channel
+		int weight = 0;
+
+		// bytes handed out per unit of priority, since the channel last had
+		// requests queued on it
+		double virtual_time = 0.;
+
+		// min-heap of the requests parked on this channel, ordered by the
+		// virtual time at which the channel will have handed them out all
+		// the bytes they need
+		struct waiter
+		{
+			double tag;
+			int slot;
+			std::uint32_t ticket;
+			bool operator<(waiter const& rhs) const { return tag > rhs.tag; }
+		};
+		std::vector<waiter> waiting;
+
+		// the number of entries in waiting that no longer refer to a
+		// parked request. They're pruned lazily
+		int stale = 0;
+	};
+
+	struct queued_request
+	{
+		explicit queued_request(bw_request r) : req(std::move(r)) {}
+
+		bw_request req;
+
+		// the state of each channel in req.channel, and its virtual time when
+		// the request was queued
+		aux::array<channel_state*, bw_request::max_bandwidth_channels> state{};
+		aux::array<double, bw_request::max_bandwidth_channels> start{};
+
+		// the number of bytes each channel needs to hand out before this
+		// request is dispatched. Normally the full request size, but if the
+		// request's ttl expires without it having been given anything, it's
+		// dispatched as soon as it gets anything
+		int need = 0;
+
+		// the index (into req.channel) of the channel this request is
+		// parked on, or -1 if it's waiting to be dispatched
+		int parked = -1;
+
+		// identifies this request's entry in the channel's waiting heap
+		std::uint32_t ticket = 0;
+
+		// identifies this request, as opposed to others queued in the same
+		// slot before or after it
+		std::uint32_t id = 0;
+	};
+
+	struct expiry
+	{
+		std::int64_t round;
+		int slot;
+		std::uint32_t id;
+	};
+
+	// parks the request in the waiting heap of the first of its channels
+	// that still owes it bytes. Returns false if there is no such channel,
+	// i.e. the request is ready to be dispatched
+	bool park(int slot);
+	void unpark(queued_request& r);
+
+	// returns the number of bytes to assign to the request, and gives any
+	// surplus back to its channels
+	int settle(queued_request& r);
+
+	void prune(channel_state& s);
+
+	// these are the consumers that want bandwidth. Slots in m_free_slots are
+	// unused (their peer is null)
+	std::vector<queued_request> m_queue;
+	std::vector<int> m_free_slots;
+	int m_queue_size = 0;
+
+	// the channels that have requests queued on them
+	std::unordered_map<bandwidth_channel*, channel_state> m_channels;
+
+	// the round at which each request's ttl runs out. Since every request
+	// gets the same ttl, this is in the order they were queued
+	std::deque<expiry> m_expiry;
+
+	// requests that will be dispatched at the next round
+	std::vector<int> m_ready;
+
 	// the number of bytes all the requests in queue are for
 	std::int64_t m_queued_bytes;
 
+	// the number of times update_quotas() has run
+	std::int64_t m_round = 0;
+
+	std::uint32_t m_serial = 0;
+
 	// this is the channel within the consumers
 	// that bandwidth is assigned to (upload or download)
 	int m_channel;
@@ -0,0 +1,106 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TORRENT_BDP_ESTIMATOR_HPP_INCLUDED
+#define TORRENT_BDP_ESTIMATOR_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/time.hpp"
+
+#include <array>
+#include <cstdint>
+
+namespace libtorrent {
+namespace aux {
+
+	// estimates the bandwidth-delay product of a peer connection, from the
+	// round trip times and delivery rates of its block requests. It follows
+	// the model of BBR: the bottleneck bandwidth is the highest delivery rate
+	// seen over the last 10 round trips, and the round trip time is the lowest
+	// seen over the last 10 seconds.
+	//
+	// Once the request queue is deeper than the pipe, every request waits
+	// behind our own earlier requests at the peer, which inflates the round
+	// trip samples. So, when the minimum has not been refreshed for 10 seconds,
+	// the estimator enters a "probe RTT" phase. During that phase, the
+	// suggested queue is just the pipe, to let the peer's queue drain, and the
+	// minimum is measured again.
+	struct TORRENT_EXTRA_EXPORT bdp_estimator
+	{
+		// records a block arriving at ``now``. ``rtt`` is the time since it was
+		// requested, and ``delivered`` is the number of payload bytes received
+		// on the connection over that time, including the block itself.
+		void on_block(time_point now, time_duration rtt, std::int64_t delivered);
+
+		bool has_estimate() const { return m_bw[0].value > 0; }
+
+		// the estimated bottleneck bandwidth, in bytes per second
+		std::int64_t bandwidth() const { return m_bw[0].value; }
+
+		time_duration min_rtt() const { return m_min_rtt; }
+
+		bool probing_rtt() const { return m_probe_rtt; }
+
+		// the number of bytes to keep requested from the peer. This is twice
+		// the bandwidth-delay product, which leaves room for the delivery rate
+		// to grow, and to keep the pipe full while the requests are in
+		// flight. Returns 0 if there is no estimate yet.
+		std::int64_t target_outstanding() const;
+
+	private:
+
+		struct sample
+		{
+			time_point time;
+			std::int64_t value;
+		};
+
+		void update_bandwidth(time_point now, std::int64_t bw);
+
+		// the best, second best and third best delivery rates within the
+		// window, each one more recent than the one before it
+		std::array<sample, 3> m_bw{};
+
+		time_duration m_min_rtt = time_duration::max();
+		time_point m_min_rtt_stamp{};
+
+		// when probing the round trip time, this is the lowest sample so far,
+		// and when the probe ends
+		time_duration m_probe_min = time_duration::max();
+		time_point m_probe_end{};
+		bool m_probe_rtt = false;
+	};
+}
+}
+
+#endif
@@ -45,6 +45,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/assert.hpp"
 #include "libtorrent/span.hpp"
 #include "libtorrent/aux_/throw.hpp"
+#include "libtorrent/aux_/buffer_arena.hpp"
 
 #if defined __GLIBC__
 #include <malloc.h>
@@ -113,30 +114,54 @@ public:
 		}
 	}
 
+	// allocate the buffer from an arena, if the arena serves allocations of
+	// this size. Otherwise fall back to the heap. The arena must outlive the
+	// buffer
+	buffer(difference_type size, span<char const> initialize
+		, buffer_arena* arena)
+	{
+		if (arena == nullptr || !buffer_arena::serves(size))
+		{
+			buffer(size, initialize).swap(*this);
+			return;
+		}
+
+		m_begin = arena->allocate(size);
+		if (m_begin == nullptr) aux::throw_ex<std::bad_alloc>();
+		m_size = size;
+		m_arena = arena;
+		TORRENT_ASSERT(initialize.size() <= size);
+		std::copy(initialize.begin(), initialize.end(), m_begin);
+	}
+
 	buffer(buffer const& b) = delete;
 
 	buffer(buffer&& b)
 		: m_begin(b.m_begin)
 		, m_size(b.m_size)
+		, m_arena(b.m_arena)
 	{
 		b.m_begin = nullptr;
 		b.m_size = 0;
+		b.m_arena = nullptr;
 	}
 
 	buffer& operator=(buffer&& b)
 	{
 		if (&b == this) return *this;
-		std::free(m_begin);
+		release();
 		m_begin = b.m_begin;
 		m_size = b.m_size;
+		m_arena = b.m_arena;
 		b.m_begin = nullptr;
 		b.m_size = 0;
+		b.m_arena = nullptr;
 		return *this;
 	}
 
 	buffer& operator=(buffer const& b) = delete;
 
-	~buffer() { std::free(m_begin); }
+	~buffer() { release(); }
 
 	char* data() { return m_begin; }
 	char const* data() const { return m_begin; }
@@ -156,12 +181,22 @@ public:
 		using std::swap;
 		swap(m_begin, b.m_begin);
 		swap(m_size, b.m_size);
+		swap(m_arena, b.m_arena);
 	}
 
 private:
+
+	void release()
+	{
+		if (m_arena) m_arena->free(m_begin, m_size);
+		else std::free(m_begin);
+	}
+
 	char* m_begin = nullptr;
 	// m_begin points to an allocation of this size.
 	difference_type m_size = 0;
+	// if set, m_begin was allocated from this arena rather than malloc()
+	buffer_arena* m_arena = nullptr;
 };
 
 }
@@ -0,0 +1,92 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TORRENT_BUFFER_ARENA_HPP_INCLUDED
+#define TORRENT_BUFFER_ARENA_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/aux_/slab_allocator.hpp"
+#include "libtorrent/aux_/array.hpp"
+
+#include <cstddef>
+#include <memory>
+
+namespace libtorrent {
+namespace aux {
+
+	// variable size buffers (like peer receive buffers), allocated from
+	// slab_allocators of a few power-of-two size classes. This puts them in
+	// 2 MiB slabs, which can be backed by huge pages and bound to the NUMA
+	// node of the thread using them, the same way disk buffers are. Sizes
+	// are rounded up to the next size class. Small buffers, and sizes larger
+	// than the largest class, are not served by the arena (see serves()).
+	struct TORRENT_EXTRA_EXPORT buffer_arena
+	{
+		// the size classes are min_size, 2 * min_size, ... max_size
+		static constexpr int min_size = slab_allocator::min_block_size;
+		static constexpr int num_classes = 4;
+		static constexpr int max_size = min_size << (num_classes - 1);
+
+		buffer_arena();
+
+		// returns true if allocations of this size should be made from the
+		// arena. Buffers smaller than min_size would waste part of their
+		// block, and are better off on the heap
+		static bool serves(std::ptrdiff_t const size)
+		{ return size >= min_size && size <= max_size; }
+
+		// ``size`` must be within the range the arena serves. Returns nullptr
+		// if the system is out of memory. On success, ``size`` is set to the
+		// actual size of the allocation
+		char* allocate(std::ptrdiff_t& size);
+
+		// ``size`` must be the size returned by allocate()
+		void free(char* buf, std::ptrdiff_t size);
+
+		// see slab_allocator
+		void set_hugepages(bool h);
+		void set_numa_local(bool n);
+
+		// the sum over all size classes
+		slab_allocator::stats_t stats() const;
+
+	private:
+
+		static int size_class(std::ptrdiff_t size);
+
+		aux::array<std::unique_ptr<slab_allocator>, num_classes> m_classes;
+	};
+}
+}
+
+#endif
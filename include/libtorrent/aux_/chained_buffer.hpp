@@ -41,6 +41,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <deque>
 #include <vector>
+#include <cstdint>
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <boost/asio/buffer.hpp>
@@ -110,9 +111,7 @@ namespace aux {
 #endif
 
 			destruct_holder_fun destruct_holder;
-#if TORRENT_CPP98_DEQUE
 			move_construct_holder_fun move_holder;
-#endif
 			aux::aligned_storage<32>::type holder;
 			char* buf = nullptr; // the first byte of the buffer
 			int size = 0; // the total size of the buffer
@@ -127,6 +126,22 @@ namespace aux {
 
 		void pop_front(int bytes_to_pop);
 
+		// like pop_front(), but the buffers that are completely consumed are
+		// not freed. They are kept until release_retained() is called with a
+		// tag past ``tag``. This is used when the kernel may still refer to
+		// the memory after the send completes (MSG_ZEROCOPY).
+		void retain_front(int bytes_to_pop, std::uint32_t tag);
+
+		// frees the retained buffers whose tag is before ``tag``. Tags wrap
+		// around, they are compared as sequence numbers.
+		void release_retained(std::uint32_t tag);
+
+		bool has_retained() const { return !m_retained.empty(); }
+
+		// moves the retained buffers of ``other`` to the end of this buffer's
+		// retained list, keeping their tags
+		void take_retained(chained_buffer& other);
+
 		template <typename Holder>
 		void append_buffer(Holder buffer, int used_size)
 		{
@@ -188,10 +203,8 @@ namespace aux {
 			b.destruct_holder = [](void* holder)
 			{ reinterpret_cast<Holder*>(holder)->~Holder(); };
 
-#if TORRENT_CPP98_DEQUE
 			b.move_holder = [](void* dst, void* src)
 			{ new (dst) Holder(std::move(*reinterpret_cast<Holder*>(src))); };
-#endif
 
 #ifdef _MSC_VER
 #pragma warning(pop)
@@ -208,10 +221,23 @@ namespace aux {
 		template <typename Buffer>
 		void build_vec(int bytes, std::vector<Buffer>& vec);
 
+		template <typename Fun>
+		void pop_front_impl(int bytes_to_pop, Fun release);
+
+		struct retained_t
+		{
+			buffer_t buffer;
+			std::uint32_t tag;
+		};
+
 		// this is the list of all the buffers we want to
 		// send
 		std::deque<buffer_t> m_vec;
 
+		// buffers that have been sent, but are still owned by the kernel. Only
+		// the holder of these are valid. Tags are in ascending order
+		std::deque<retained_t> m_retained;
+
 		// this is the number of bytes in the send buf.
 		// this will always be equal to the sum of the
 		// size of all buffers in vec
@@ -44,15 +44,18 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <mutex>
 #include <functional>
 #include <memory>
+#include <atomic>
 
 #include "libtorrent/io_context.hpp"
 #include "libtorrent/span.hpp"
 #include "libtorrent/disk_buffer_holder.hpp" // for buffer_allocator_interface
+#include "libtorrent/aux_/slab_allocator.hpp"
 
 namespace libtorrent {
 
 	struct settings_interface;
 	struct disk_observer;
+	struct counters;
 
 namespace aux {
 
@@ -71,29 +74,32 @@ namespace aux {
 		void free_buffer(char* buf);
 		void free_multiple_buffers(span<char*> bufvec);
 
-		int in_use() const
-		{
-			std::unique_lock<std::mutex> l(m_pool_mutex);
-			return m_in_use;
-		}
+		int in_use() const { return m_in_use; }
 
 		void set_settings(settings_interface const& sett);
 
+		// sets the gauges and counters of the buffer pool and its allocator
+		void update_stats_counters(counters& c) const;
+
 	private:
 
-		void free_buffer_impl(char* buf, std::unique_lock<std::mutex>& l);
-		char* allocate_buffer_impl(std::unique_lock<std::mutex>& l, char const* category);
+		void free_buffer_impl(char* buf);
+		char* allocate_buffer_impl(char const* category);
+
+		// the buffers are allocated from per-thread caches, to not have
+		// allocations and frees from different threads contend on a mutex
+		slab_allocator m_allocator;
 
 		// number of disk buffers currently allocated
-		int m_in_use;
+		std::atomic<int> m_in_use;
 
 		// cache size limit
-		int m_max_use;
+		std::atomic<int> m_max_use;
 
 		// if we have exceeded the limit, we won't start
 		// allowing allocations again until we drop below
 		// this low watermark
-		int m_low_watermark;
+		std::atomic<int> m_low_watermark;
 
 		// if we exceed the max number of buffers, we start
 		// adding up callbacks to this queue. Once the number
@@ -101,17 +107,21 @@ namespace aux {
 		// we start calling these functions back
 		std::vector<std::weak_ptr<disk_observer>> m_observers;
 
-		// set to true to throttle more allocations
-		bool m_exceeded_max_size;
+		// set to true to throttle more allocations. It may be set without
+		// holding m_pool_mutex, but it's only cleared (and the observers
+		// notified) while holding it
+		std::atomic<bool> m_exceeded_max_size;
 
 		// this is the main thread io_context. Callbacks are
 		// posted on this in order to have them execute in
 		// the main thread.
 		io_context& m_ios;
 
+		void check_buffer_level();
 		void check_buffer_level(std::unique_lock<std::mutex>& l);
 		void remove_buffer_in_use(char* buf);
 
+		// protects m_observers (and m_buffers_in_use)
 		mutable std::mutex m_pool_mutex;
 
 		// this is specifically exempt from release_asserts
@@ -0,0 +1,96 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_HASH_MANY_HPP_INCLUDED
+#define TORRENT_HASH_MANY_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/sha1_hash.hpp"
+#include "libtorrent/span.hpp"
+
+#include <cstdint>
+#include <cstddef>
+
+namespace libtorrent {
+namespace aux {
+
+	// the implementations of SHA-256 hash_many() can use
+	enum class hash_impl : std::uint8_t
+	{
+		// one buffer at a time, using hasher256
+		generic,
+
+		// one buffer at a time, using the SHA extensions
+		sha_ni,
+
+		// up to 8 buffers of the same size in parallel, one per 32 bit lane of
+		// the AVX2 registers
+		avx2
+	};
+
+	// returns true if ``impl`` can be used on this CPU
+	TORRENT_EXTRA_EXPORT bool hash_impl_supported(hash_impl impl);
+
+	// computes the SHA-256 hash of each buffer in ``in`` and stores it in the
+	// corresponding element of ``out``. This is meant for hashing many
+	// independent buffers, like the v2 blocks of a piece or the nodes of one
+	// level of a merkle tree. Consecutive buffers of the same size are hashed
+	// in parallel, when the CPU supports it.
+	TORRENT_EXTRA_EXPORT void hash_many(span<span<char const> const> in
+		, span<sha256_hash> out);
+
+	// the same as above, but with an explicit implementation. ``impl`` must
+	// be supported by the CPU. This is mostly useful for testing.
+	TORRENT_EXTRA_EXPORT void hash_many(hash_impl impl
+		, span<span<char const> const> in, span<sha256_hash> out);
+
+	// computes ``out[i] = SHA-256(in[i * 2], in[i * 2 + 1])`` for every
+	// element in ``out``, i.e. one level of a merkle tree from the level
+	// below it. ``in`` must have at least twice as many elements as ``out``.
+	// ``out`` may alias the beginning of ``in``.
+	TORRENT_EXTRA_EXPORT void hash_pairs(span<sha256_hash const> in
+		, span<sha256_hash> out);
+
+#if TORRENT_HAS_SIMD_HASH
+	// these run the SHA-1 and SHA-256 compression functions over ``num``
+	// consecutive 64 byte blocks, using the SHA extensions. ``state`` is the
+	// hash state in host byte order. These may only be called if
+	// aux::sha_ni_support is true.
+	TORRENT_EXTRA_EXPORT void sha1_compress_ni(std::uint32_t* state
+		, std::uint8_t const* blocks, std::size_t num);
+	TORRENT_EXTRA_EXPORT void sha256_compress_ni(std::uint32_t* state
+		, std::uint8_t const* blocks, std::size_t num);
+#endif
+}
+}
+
+#endif
@@ -154,6 +154,34 @@ namespace aux {
 			}
 		}
 
+		// iterates over the elements in the queue, in the order they were
+		// added. Dereferencing an iterator yields a pointer to the element
+		struct iterator
+		{
+			T* operator*() const
+			{
+				header_t const* hdr = reinterpret_cast<header_t const*>(m_ptr);
+				return reinterpret_cast<T*>(m_ptr + sizeof(header_t) + hdr->pad_bytes);
+			}
+
+			iterator& operator++()
+			{
+				header_t const* hdr = reinterpret_cast<header_t const*>(m_ptr);
+				m_ptr += sizeof(header_t) + hdr->pad_bytes + hdr->len;
+				return *this;
+			}
+
+			friend bool operator==(iterator const lhs, iterator const rhs)
+			{ return lhs.m_ptr == rhs.m_ptr; }
+			friend bool operator!=(iterator const lhs, iterator const rhs)
+			{ return lhs.m_ptr != rhs.m_ptr; }
+
+			char* m_ptr = nullptr;
+		};
+
+		iterator begin() { return iterator{m_storage.get()}; }
+		iterator end() { return iterator{m_storage.get() + m_size}; }
+
 		void swap(heterogeneous_queue& rhs)
 		{
 			std::swap(m_storage, rhs.m_storage);
@@ -0,0 +1,136 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_IO_URING_HPP_INCLUDED
+#define TORRENT_IO_URING_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+
+#if TORRENT_HAVE_IO_URING
+
+#include "libtorrent/error_code.hpp"
+
+#include <linux/io_uring.h>
+#include <cstdint>
+
+namespace libtorrent {
+namespace aux {
+
+	// a thin wrapper around a Linux io_uring instance. It talks to the kernel
+	// via the raw system calls, to avoid a dependency on liburing. An io_uring
+	// object is not thread safe, it's meant to be owned by a single thread.
+	struct TORRENT_EXTRA_EXPORT io_uring
+	{
+		// sets up a ring with (at least) ``entries`` submission queue entries.
+		// If the kernel does not support io_uring, ``ec`` is set and the
+		// object is left in an invalid state (see is_open()).
+		io_uring(unsigned entries, error_code& ec);
+		~io_uring();
+
+		io_uring(io_uring const&) = delete;
+		io_uring& operator=(io_uring const&) = delete;
+
+		bool is_open() const { return m_fd >= 0; }
+
+		// returns the next free, zero-initialized, submission queue entry, or
+		// nullptr if the submission queue is full. The entry is not passed on
+		// to the kernel until the next call to submit().
+		io_uring_sqe* get_sqe();
+
+		// passes all prepared submission queue entries on to the kernel and
+		// blocks until at least ``wait_nr`` completions are available. Returns
+		// the number of entries submitted.
+		int submit(unsigned wait_nr, error_code& ec);
+
+		// the number of prepared submission queue entries not yet passed on to
+		// the kernel
+		unsigned pending() const { return m_sqe_tail - m_sqe_submitted; }
+
+		// calls ``f`` with each available completion queue entry, and retires
+		// them. Returns the number of completions handled.
+		template <typename Fun>
+		int for_each_completion(Fun f)
+		{
+			std::uint32_t head = *m_cq_head;
+			std::uint32_t const tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+			int ret = 0;
+			for (; head != tail; ++head, ++ret)
+				f(m_cqes[head & m_cq_mask]);
+			__atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+			return ret;
+		}
+
+		// registers a sparse table of ``num_slots`` file descriptors with the
+		// ring. Slots are populated with update_file(). Returns false if the
+		// kernel doesn't support it, in which case plain file descriptors
+		// have to be used.
+		bool register_files(int num_slots, error_code& ec);
+		void update_file(int slot, int fd, error_code& ec);
+
+		unsigned sq_entries() const { return m_sq_entries; }
+		unsigned cq_entries() const { return m_cq_entries; }
+
+	private:
+
+		int m_fd = -1;
+
+		// the memory mapped rings shared with the kernel
+		void* m_sq_ring = nullptr;
+		std::size_t m_sq_ring_size = 0;
+		void* m_cq_ring = nullptr;
+		std::size_t m_cq_ring_size = 0;
+		io_uring_sqe* m_sqes = nullptr;
+
+		std::uint32_t* m_sq_head = nullptr;
+		std::uint32_t* m_sq_tail = nullptr;
+		std::uint32_t* m_sq_array = nullptr;
+		std::uint32_t m_sq_mask = 0;
+		unsigned m_sq_entries = 0;
+
+		std::uint32_t* m_cq_head = nullptr;
+		std::uint32_t* m_cq_tail = nullptr;
+		io_uring_cqe* m_cqes = nullptr;
+		std::uint32_t m_cq_mask = 0;
+		unsigned m_cq_entries = 0;
+
+		// the local submission queue tail. Entries up to here have been
+		// handed out by get_sqe(), entries up to m_sqe_submitted have been
+		// passed on to the kernel
+		std::uint32_t m_sqe_tail = 0;
+		std::uint32_t m_sqe_submitted = 0;
+	};
+}
+}
+
+#endif // TORRENT_HAVE_IO_URING
+
+#endif
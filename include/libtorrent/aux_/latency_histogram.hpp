@@ -0,0 +1,131 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_LATENCY_HISTOGRAM_HPP_INCLUDED
+#define TORRENT_LATENCY_HISTOGRAM_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/span.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+
+namespace libtorrent {
+namespace aux {
+
+	// the number of linear sub-buckets each power of two is split into, as a
+	// power of two. This bounds the relative error of a recorded value to
+	// 1 / (1 << latency_sub_bucket_bits)
+	constexpr int latency_sub_bucket_bits = 3;
+	constexpr int latency_sub_buckets = 1 << latency_sub_bucket_bits;
+
+	// values are clamped to this many bits (about 12 days, in microseconds)
+	constexpr int latency_value_bits = 40;
+
+	constexpr int latency_buckets
+		= (latency_value_bits - latency_sub_bucket_bits + 1) * latency_sub_buckets;
+
+	// returns the histogram bucket the value ``v`` is counted in. Values
+	// smaller than latency_sub_buckets each get their own bucket, larger
+	// values are bucketed log-linearly.
+	inline int latency_bucket(std::int64_t v)
+	{
+		if (v < latency_sub_buckets) return v < 0 ? 0 : int(v);
+		if (v >= (std::int64_t(1) << latency_value_bits))
+			return latency_buckets - 1;
+		int exp = latency_sub_bucket_bits;
+		while ((v >> (exp + 1)) != 0) ++exp;
+		int const sub = int(v >> (exp - latency_sub_bucket_bits)) & (latency_sub_buckets - 1);
+		return (exp - latency_sub_bucket_bits + 1) * latency_sub_buckets + sub;
+	}
+
+	// the smallest value counted in ``bucket``
+	inline std::int64_t latency_bucket_floor(int const bucket)
+	{
+		if (bucket < latency_sub_buckets) return bucket;
+		int const exp = bucket / latency_sub_buckets + latency_sub_bucket_bits - 1;
+		std::int64_t const sub = bucket % latency_sub_buckets;
+		return (latency_sub_buckets + sub) << (exp - latency_sub_bucket_bits);
+	}
+
+	// returns the value below which the fraction ``p`` of the samples in
+	// ``histogram`` fall. The result is the upper bound of the bucket the
+	// percentile falls in, or 0 if the histogram is empty.
+	inline std::int64_t latency_percentile(span<std::int64_t const> const histogram
+		, double const p)
+	{
+		std::int64_t total = 0;
+		for (auto const c : histogram) total += c;
+		if (total == 0) return 0;
+
+		std::int64_t const target = std::max(std::int64_t(1)
+			, std::int64_t(std::ceil(p * double(total))));
+		std::int64_t sum = 0;
+		int const num_buckets = int(std::min(histogram.size(), std::ptrdiff_t(latency_buckets)));
+		for (int i = 0; i < num_buckets; ++i)
+		{
+			sum += histogram[i];
+			if (sum < target) continue;
+			return i + 1 < latency_buckets ? latency_bucket_floor(i + 1) - 1
+				: latency_bucket_floor(i);
+		}
+		return latency_bucket_floor(num_buckets - 1);
+	}
+
+	// a histogram of latencies, in microseconds. Samples can be recorded from
+	// multiple threads concurrently, without locking.
+	struct latency_histogram
+	{
+		void record(std::int64_t const v)
+		{
+			m_buckets[std::size_t(latency_bucket(v))].fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// copies the current counts into ``out``, which must have room for
+		// latency_buckets counts
+		void snapshot(span<std::int64_t> out) const
+		{
+			TORRENT_ASSERT(out.size() >= latency_buckets);
+			for (int i = 0; i < latency_buckets; ++i)
+				out[i] = std::int64_t(m_buckets[std::size_t(i)].load(std::memory_order_relaxed));
+		}
+
+	private:
+		std::array<std::atomic<std::uint64_t>, latency_buckets> m_buckets{};
+	};
+}
+}
+
+#endif
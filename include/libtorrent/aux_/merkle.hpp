@@ -78,6 +78,14 @@ namespace libtorrent {
 	TORRENT_EXTRA_EXPORT void merkle_fill_tree(span<sha256_hash> tree, int num_leafs, int level_start);
 	TORRENT_EXTRA_EXPORT void merkle_fill_tree(span<sha256_hash> tree, int num_leafs);
 
+	// given a range of ``num_nodes`` nodes within a single layer of the tree,
+	// starting at ``level_start``, compute the ``num_layers`` layers of nodes
+	// above them. Unlike merkle_fill_tree(), this may stop below the root of
+	// the sub-tree, and so can compute many sub-trees at once. ``num_nodes``
+	// must be a multiple of ``1 << num_layers``.
+	TORRENT_EXTRA_EXPORT void merkle_fill_layers(span<sha256_hash> tree
+		, int num_nodes, int level_start, int num_layers);
+
 	// fills in nodes that can be computed from a tree with arbitrary nodes set
 	// all "orphan" hashes, i.e ones that do not contribute towards computing
 	// the root, will be cleared.
@@ -135,6 +135,14 @@ struct TORRENT_EXTRA_EXPORT merkle_tree
 
 	aux::vector<sha256_hash> get_piece_layer() const;
 
+	// if all piece hashes are known, drop everything but the piece layer
+	// from the tree. This is meant for files we have all pieces of, where
+	// the block hashes are only needed to serve hash requests from peers.
+	// The block hashes are lost and have to be recomputed from the file (and
+	// added with set_block()) to be available again. Returns true if the
+	// tree was collapsed.
+	bool collapse_to_piece_layer();
+
 	enum class set_block_result
 	{
 		ok, unknown, hash_failed, block_hash_failed
@@ -44,6 +44,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/units.hpp"
 #include "libtorrent/session_types.hpp"
 #include "libtorrent/flags.hpp"
+#include "libtorrent/time.hpp"
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <boost/variant/variant.hpp>
@@ -211,6 +212,10 @@ namespace aux {
 
 		move_flags_t move_flags = move_flags_t::always_replace_files;
 
+		// the time this job was allocated, i.e. issued. Used to measure the
+		// time it spends waiting to be executed
+		time_point queued;
+
 #if TORRENT_USE_ASSERTS
 		bool in_use = false;
 
@@ -0,0 +1,171 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TORRENT_MSG_ZEROCOPY_HPP_INCLUDED
+#define TORRENT_MSG_ZEROCOPY_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+
+#if TORRENT_USE_MSG_ZEROCOPY
+
+#include "libtorrent/error_code.hpp"
+#include "libtorrent/time.hpp"
+#include "libtorrent/aux_/chained_buffer.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <memory>
+
+namespace libtorrent {
+namespace aux {
+
+	// keeps track of the sends issued with MSG_ZEROCOPY on a TCP socket. The
+	// kernel numbers every such send, and once it no longer refers to the
+	// memory passed to it, it posts a notification with a range of send
+	// numbers to the socket's error queue. Until then, the send buffers must
+	// be kept alive, and left unmodified.
+	struct TORRENT_EXTRA_EXPORT zerocopy_tracker
+	{
+		// the flag to pass to send() to request a zero-copy send
+		static int const send_flag;
+
+		// sets SO_ZEROCOPY on the socket. This is only attempted once, if the
+		// kernel doesn't support it, it returns false, now and in subsequent
+		// calls.
+		bool enable(int fd, error_code& ec);
+		bool enabled() const { return m_state == state_t::enabled; }
+
+		// to be called when a send issued with send_flag completes.
+		// ``success`` is true if any bytes were sent. Only successful sends
+		// are numbered by the kernel.
+		void on_send(bool success)
+		{
+			if (success) ++m_issued;
+		}
+
+		// the number of the most recent zero-copy send
+		std::uint32_t last_sent() const { return m_issued - 1; }
+
+		// the number of the first send the kernel may still refer to. All
+		// sends before it have completed
+		std::uint32_t completed() const { return m_completed; }
+
+		// returns true if there are sends the kernel may still refer to
+		bool outstanding() const { return m_issued != m_completed; }
+
+		// reads all notifications from the socket's error queue. Returns true
+		// if any sends completed
+		bool reap(int fd);
+
+		// records that sends [first, last] have completed
+		void on_completion(std::uint32_t first, std::uint32_t last);
+
+	private:
+
+		enum class state_t : std::uint8_t { unknown, enabled, unsupported };
+		state_t m_state = state_t::unknown;
+
+		std::uint32_t m_issued = 0;
+		std::uint32_t m_completed = 0;
+
+		// ranges of completed sends that are not (yet) contiguous with
+		// m_completed. Notifications are only reordered in rare cases, this
+		// is almost always empty
+		std::vector<std::pair<std::uint32_t, std::uint32_t>> m_early;
+	};
+
+	// when a connection with outstanding zero-copy sends is closed, the
+	// kernel may still be sending the data queued on the socket, from the
+	// buffers passed to it. The reaper keeps those buffers alive until the
+	// completion notifications arrive. Since the notifications are read
+	// from the socket's error queue, it also keeps the socket open, through
+	// a duplicate of its file descriptor. There's one reaper per session.
+	struct TORRENT_EXTRA_EXPORT zerocopy_reaper
+	{
+		zerocopy_reaper() = default;
+		zerocopy_reaper(zerocopy_reaper const&) = delete;
+		zerocopy_reaper& operator=(zerocopy_reaper const&) = delete;
+		~zerocopy_reaper();
+
+		// takes over the retained buffers of ``buffers`` and ``fd``, which
+		// must be a duplicate of the connection's socket descriptor. The
+		// socket is shut down, and closed once the kernel is done with the
+		// buffers. If there are no outstanding sends, the descriptor is
+		// closed right away.
+		void add(int fd, zerocopy_tracker const& t, chained_buffer& buffers);
+
+		// reads completion notifications and releases the buffers and sockets
+		// that are done. Connections that haven't drained their send queue
+		// within linger_time are reset, which makes the kernel drop the
+		// queued data and complete the sends. To be called once a second
+		void tick(time_point now);
+
+		// resets all connections and frees all buffers. This is called when
+		// the session shuts down, before the disk buffer pool goes away
+		void abort();
+
+		int num_sockets() const { return int(m_entries.size()); }
+
+		// returns a duplicate of the socket descriptor ``fd``, to be passed
+		// to add() once the connection's send buffer is released, or -1 on
+		// failure. This keeps the socket open after the connection closes
+		// its own descriptor
+		static int keep_open(int fd);
+
+		static constexpr seconds linger_time{30};
+
+	private:
+
+		struct entry
+		{
+			int fd;
+			zerocopy_tracker tracker;
+			std::unique_ptr<chained_buffer> buffers;
+			time_point deadline;
+			bool reset = false;
+		};
+
+		// returns true if all the sends of ``e`` have completed
+		static bool reap(entry& e);
+		static void reset(entry& e);
+		static void close(entry& e);
+
+		std::vector<entry> m_entries;
+	};
+}
+}
+
+#endif // TORRENT_USE_MSG_ZEROCOPY
+
+#endif
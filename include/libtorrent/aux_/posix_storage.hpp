@@ -67,6 +67,28 @@ namespace aux {
 			, piece_index_t const piece, int const offset
 			, storage_error& error);
 
+		// these overloads only handle pad files and the part file themselves.
+		// Portions of the buffer backed by regular files are passed on to
+		// ``op``, to let a disk I/O back-end issue the file operations itself.
+		int read(settings_interface const& sett
+			, span<char> bufs
+			, piece_index_t const piece, int const offset
+			, fileop const& op
+			, storage_error& error);
+
+		int write(settings_interface const& sett
+			, span<char> bufs
+			, piece_index_t const piece, int const offset
+			, fileop const& op
+			, storage_error& error);
+
+		// returns true if reads and writes to the specified file are
+		// redirected to the part file
+		bool in_part_file(file_index_t file_index) const;
+
+		// the absolute path of the specified file, given the current save path
+		std::string file_path(file_index_t file_index) const;
+
 		bool has_any_file(storage_error& error);
 		void set_file_priority(aux::vector<download_priority_t, file_index_t>& prio
 			, storage_error& ec);
@@ -41,6 +41,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/numeric_cast.hpp"
 
 #include <climits>
+#include <memory>
 
 namespace libtorrent {
 namespace aux {
@@ -102,6 +103,10 @@ struct TORRENT_EXTRA_EXPORT receive_buffer
 
 	// returns the last 'bytes' from the receive buffer
 	span<char> mutable_buffer(int bytes);
+
+	// returns the last 'bytes' before the read cursor, followed by all bytes
+	// received beyond it
+	span<char> mutable_buffer_ahead(int bytes);
 #endif
 
 	// the purpose of this function is to free up and cut off all messages
@@ -111,6 +116,10 @@ struct TORRENT_EXTRA_EXPORT receive_buffer
 
 	void reset(int packet_size);
 
+	// allocate the buffer from this arena from now on. This must be set
+	// before anything is received
+	void set_arena(std::shared_ptr<buffer_arena> a);
+
 #if TORRENT_USE_INVARIANT_CHECKS
 	void check_invariant() const
 	{
@@ -161,6 +170,9 @@ private:
 	// enough of it we shrink it
 	sliding_average<std::ptrdiff_t, 20> m_watermark;
 
+	// keeps the arena m_recv_buffer may be allocated from alive
+	std::shared_ptr<buffer_arena> m_arena;
+
 	buffer m_recv_buffer;
 };
 
@@ -216,6 +228,11 @@ struct crypto_receive_buffer
 
 	span<char> mutable_buffer(int bytes);
 
+	// only valid when the crypto layer doesn't frame its packets (i.e.
+	// crypto_packet_finished() is always true). See
+	// receive_buffer::mutable_buffer_ahead()
+	span<char> mutable_buffer_ahead(int bytes);
+
 private:
 
 	int m_recv_pos = (std::numeric_limits<int>::max)();
@@ -49,6 +49,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/performance_counters.hpp" // for counters
 #include "libtorrent/aux_/allocating_handler.hpp"
 #include "libtorrent/aux_/time.hpp"
+#include "libtorrent/aux_/msg_zerocopy.hpp"
 #include "libtorrent/aux_/torrent_list.hpp"
 #include "libtorrent/session_params.hpp" // for disk_io_constructor_type
 
@@ -85,6 +86,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/kademlia/announce_flags.hpp"
 #include "libtorrent/aux_/resolver.hpp"
 #include "libtorrent/aux_/invariant_check.hpp"
+#include "libtorrent/aux_/timer_wheel.hpp"
 #include "libtorrent/extensions.hpp"
 #include "libtorrent/aux_/portmap.hpp"
 #include "libtorrent/aux_/lsd.hpp"
@@ -134,6 +136,7 @@ namespace aux {
 
 	struct session_impl;
 	struct session_settings;
+	struct stats_export;
 
 #ifndef TORRENT_DISABLE_LOGGING
 	struct tracker_logger;
@@ -434,6 +437,12 @@ namespace aux {
 			// need the initial push to connect peers
 			void prioritize_connections(std::weak_ptr<torrent> t) override;
 
+			// none of this torrent's connect candidates may be tried again
+			// until ``delay`` from now. It's kept out of the connect
+			// round-robin (see torrent::want_peers()) until then
+			void defer_connect_attempts(std::weak_ptr<torrent> t
+				, seconds32 delay) override;
+
 			void async_accept(std::shared_ptr<tcp::acceptor> const&, transport);
 			void on_accept_connection(true_tcp_socket s, error_code const&
 				, std::weak_ptr<tcp::acceptor>, transport);
@@ -624,10 +633,16 @@ namespace aux {
 			void post_torrent_updates(status_flags_t flags);
 			void post_session_stats();
 			void post_dht_stats();
+			void post_disk_latency();
+
+			// refreshes the gauges in m_stats_counters that are sampled, rather
+			// than updated as they change
+			void update_stats_gauges();
 
 			std::vector<torrent_handle> get_torrents() const;
 
 			void pop_alerts(std::vector<alert*>* alerts);
+			void pop_alerts(std::function<void(alert*)> const& handler);
 			alert* wait_for_alert(time_duration max_wait);
 
 #if TORRENT_ABI_VERSION == 1
@@ -709,6 +724,9 @@ namespace aux {
 
 			alert_manager& alerts() override { return m_alerts; }
 			disk_interface& disk_thread() override { return *m_disk_thread; }
+#if TORRENT_USE_MSG_ZEROCOPY
+			zerocopy_reaper& get_zerocopy_reaper() override { return m_zerocopy_reaper; }
+#endif
 
 			void abort() noexcept;
 			void abort_stage2() noexcept;
@@ -840,12 +858,14 @@ namespace aux {
 			void update_connection_speed();
 			void update_alert_queue_size();
 			void update_disk_threads();
+			void update_buffer_arenas();
 			void update_report_web_seed_downloads();
 			void update_outgoing_interfaces();
 			void update_listen_interfaces();
 			void update_privileged_ports();
 			void update_auto_sequential();
 			void update_max_failcount();
+			void update_min_reconnect_time();
 			void update_resolver_cache_timeout();
 
 			void update_ip_notifier();
@@ -857,6 +877,8 @@ namespace aux {
 			void update_dht_bootstrap_nodes();
 
 			void update_socket_buffer_size();
+			void update_udp_gro();
+			void update_stats_export();
 			void update_dht_announce_interval();
 			void update_download_rate();
 			void update_upload_rate();
@@ -893,6 +915,11 @@ namespace aux {
 
 			counters m_stats_counters;
 
+			// peer receive buffers are allocated from this, when either
+			// hugepage_buffers or numa_local_buffers is enabled. Connections
+			// hold on to it for the lifetime of their buffers
+			std::shared_ptr<buffer_arena> m_receive_arena;
+
 			// this is a pool allocator for torrent_peer objects
 			// torrents and the disk cache (implicitly by holding references to the
 			// torrents) depend on this outliving them.
@@ -942,6 +969,13 @@ namespace aux {
 			// constructed after it.
 			std::unique_ptr<disk_interface> m_disk_thread;
 
+#if TORRENT_USE_MSG_ZEROCOPY
+			// holds on to the send buffers of closed connections until the
+			// kernel is done sending from them. These may be disk buffers, so
+			// this must be destructed before m_disk_thread
+			zerocopy_reaper m_zerocopy_reaper;
+#endif
+
 			// the bandwidth manager is responsible for
 			// handing out bandwidth to connections that
 			// asks for it, it can also throttle the
@@ -1106,6 +1140,7 @@ namespace aux {
 #endif
 
 			void on_tick(error_code const& e);
+			void on_stats_export(error_code const& e);
 
 			void try_connect_more_peers();
 			void auto_manage_checking_torrents(std::vector<torrent*>& list
@@ -1138,6 +1173,29 @@ namespace aux {
 			time_point m_last_tick;
 			time_point m_last_second_tick;
 
+			// torrents that want to be ticked (i.e. are in the
+			// torrent_want_tick list) are scheduled here, to be ticked once a
+			// second each. This spreads them out over the second, instead of
+			// ticking all of them at once
+			struct torrent_tick
+			{
+				std::weak_ptr<torrent> tor;
+				// when the torrent was last ticked
+				time_point last;
+				// when the torrent is due to be ticked
+				time_point due;
+			};
+			aux::timer_wheel<torrent_tick> m_torrent_ticks;
+
+			// incoming connections that haven't been attached to a torrent
+			// yet. They're disconnected unless they complete the handshake
+			// within handshake_timeout
+			aux::timer_wheel<std::weak_ptr<peer_connection>> m_handshake_timeouts;
+
+			void tick_torrents(time_point now);
+			void check_handshake_timeouts(time_point now);
+			time_duration handshake_timeout(peer_connection const& p) const;
+
 			// the last time we went through the peers
 			// to decide which ones to choke/unchoke
 			time_point m_last_choke;
@@ -1227,6 +1285,24 @@ namespace aux {
 
 			void on_udp_writeable(std::weak_ptr<session_udp_socket> s, error_code const& ec);
 
+			// if ec indicates the UDP socket's send buffer is full, wait for it
+			// to become writable again (unless we're already waiting)
+			void udp_send_blocked(std::shared_ptr<session_udp_socket> const& s
+				, error_code const& ec);
+
+			// passes on the datagrams queued up while the socket was corked
+			void uncork_udp_socket(std::shared_ptr<session_udp_socket> const& s);
+
+			// used by the uTP socket managers to batch up the packets sent by
+			// a uTP socket
+			void cork_udp_socket(std::weak_ptr<utp_socket_interface> sock, bool cork);
+
+			// called when a datagram queued up while the UDP socket was corked
+			// could not be sent
+			void on_udp_send_error(std::weak_ptr<listen_socket_t> const& ls
+				, transport ssl, udp::endpoint const& ep, int size
+				, error_code const& ec);
+
 			void on_udp_packet(std::weak_ptr<session_udp_socket> s
 				, std::weak_ptr<listen_socket_t> ls
 				, transport ssl, error_code const& ec);
@@ -1287,6 +1363,14 @@ namespace aux {
 			// torrents prioritized to get connection attempts
 			std::deque<std::pair<std::weak_ptr<torrent>, int>> m_prio_torrents;
 
+			// torrents whose connect candidates are all waiting out their
+			// reconnect timeout. This is a min-heap ordered by the time the
+			// first one may be tried again. Expired entries are popped at the
+			// start of try_connect_more_peers(), which lets the torrent back
+			// into m_torrent_lists. This way the round-robin only visits
+			// torrents that have a peer to connect to right now
+			std::vector<std::pair<time_point, std::weak_ptr<torrent>>> m_deferred_connects;
+
 			// this announce timer is used
 			// by Local service discovery
 			deadline_timer m_lsd_announce_timer;
@@ -1296,6 +1380,12 @@ namespace aux {
 			// time it's called, to force the windows disk cache to be flushed
 			deadline_timer m_close_file_timer;
 
+			// when the stats_export_path setting is set, this publishes the
+			// stats counters to a shared memory mapped file, every time
+			// m_stats_export_timer fires
+			std::unique_ptr<stats_export> m_stats_export;
+			deadline_timer m_stats_export_timer;
+
 			// the index of the torrent that will be offered to
 			// connect to a peer next time on_tick is called.
 			// This implements a round robin peer connections among
@@ -1322,6 +1412,11 @@ namespace aux {
 
 			counters& stats_counters() override { return m_stats_counters; }
 
+			void schedule_tick(std::weak_ptr<torrent> t) override;
+
+			std::shared_ptr<buffer_arena> receive_buffer_arena() const override
+			{ return m_receive_arena; }
+
 			void received_buffer(int size) override;
 			void sent_buffer(int size) override;
 
@@ -99,6 +99,10 @@ namespace aux {
 
 	struct proxy_settings;
 	struct session_settings;
+	struct buffer_arena;
+#if TORRENT_USE_MSG_ZEROCOPY
+	struct zerocopy_reaper;
+#endif
 
 	using ip_source_t = flags::bitfield_flag<std::uint8_t, struct ip_source_tag>;
 
@@ -150,6 +154,9 @@ namespace aux {
 		virtual external_ip external_address() const = 0;
 
 		virtual disk_interface& disk_thread() = 0;
+#if TORRENT_USE_MSG_ZEROCOPY
+		virtual zerocopy_reaper& get_zerocopy_reaper() = 0;
+#endif
 
 		virtual alert_manager& alerts() = 0;
 
@@ -218,6 +225,8 @@ namespace aux {
 #endif
 
 		virtual void prioritize_connections(std::weak_ptr<torrent> t) = 0;
+		virtual void defer_connect_attempts(std::weak_ptr<torrent> t
+			, seconds32 delay) = 0;
 
 		virtual void trigger_auto_manage() = 0;
 
@@ -302,6 +311,14 @@ namespace aux {
 #endif
 
 		virtual counters& stats_counters() = 0;
+
+		// schedule the torrent's second_tick(), which will keep being called
+		// once a second for as long as the torrent wants to be ticked
+		virtual void schedule_tick(std::weak_ptr<torrent> t) = 0;
+
+		// the arena peer receive buffers should be allocated from, or nullptr
+		// to use the heap
+		virtual std::shared_ptr<buffer_arena> receive_buffer_arena() const = 0;
 		virtual void received_buffer(int size) = 0;
 		virtual void sent_buffer(int size) = 0;
 
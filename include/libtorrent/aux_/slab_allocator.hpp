@@ -0,0 +1,219 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TORRENT_SLAB_ALLOCATOR_HPP_INCLUDED
+#define TORRENT_SLAB_ALLOCATOR_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/aux_/array.hpp"
+
+#include <array>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+namespace libtorrent {
+namespace aux {
+
+	// an allocator of fixed size blocks (16 kiB by default), carved out of
+	// large (2 MiB) slabs. Each thread allocates from and frees into its own
+	// cache of blocks (two "magazines"), which don't need to synchronize with
+	// other threads. Only when a thread runs out of (or has too many) blocks,
+	// whole magazines are exchanged with a shared depot. Slabs are backed by
+	// transparent huge pages where supported, or explicit huge pages when
+	// asked to, and may be locked in RAM. Slabs whose blocks are all free are
+	// returned to the system.
+	struct TORRENT_EXTRA_EXPORT slab_allocator
+	{
+		static constexpr int slab_size = 2 * 1024 * 1024;
+		static constexpr int min_block_size = 0x4000;
+		static constexpr int max_blocks_per_slab = slab_size / min_block_size;
+
+		// ``block_size`` must be a power of two, at least min_block_size and
+		// at most slab_size
+		explicit slab_allocator(int block_size = min_block_size);
+		~slab_allocator();
+		slab_allocator(slab_allocator const&) = delete;
+		slab_allocator& operator=(slab_allocator const&) = delete;
+
+		// returns nullptr if the system is out of memory
+		char* allocate();
+		void free(char* buf);
+
+		// when enabled, slabs are locked in physical RAM (mlock()), never to
+		// be paged out. This applies to the current slabs as well
+		void set_lock_memory(bool l);
+
+		// when enabled, new slabs are mapped from explicit 2 MiB huge pages
+		// (``MAP_HUGETLB`` on Linux, large pages on Windows). This requires
+		// the system to have huge pages reserved. If it doesn't, slabs fall
+		// back to regular pages (and transparent huge pages).
+		void set_hugepages(bool h);
+
+		// when enabled, slabs belong to the NUMA node of the thread that
+		// caused them to be allocated, and their memory is bound to that
+		// node. Threads refill their caches from slabs of their own node,
+		// unless a consumer node is set.
+		void set_numa_local(bool n);
+
+		// buffers allocated by one thread but filled and drained by another
+		// (like disk read buffers, allocated by a disk thread and sent by the
+		// network thread) belong on the node of the thread using them. Once
+		// set, all threads take blocks from slabs of ``node``. -1 (the
+		// default) means the node of the allocating thread. This only has an
+		// effect with numa_local enabled. Blocks already in the threads'
+		// caches are still handed out.
+		void set_consumer_node(int node);
+
+		// the NUMA node the calling thread is currently running on, as
+		// reported by the node function
+		int calling_thread_node() const { return m_current_node(); }
+
+		// the function used to determine which NUMA node the calling thread
+		// is running on. This is only meant for tests, to simulate threads
+		// running on different nodes. It must be set before the allocator is
+		// used
+		using node_function = int (*)();
+		void set_node_function(node_function f);
+
+		int block_size() const { return m_block_size; }
+		int blocks_per_slab() const { return slab_size / m_block_size; }
+
+		struct stats_t
+		{
+			// the number of allocations and frees served by the calling
+			// thread's own magazines
+			std::int64_t magazine_hits = 0;
+
+			// the number of allocations and frees that had to go to the depot
+			std::int64_t magazine_misses = 0;
+
+			// the number of slabs currently allocated
+			int slabs = 0;
+
+			// the number of those slabs backed by a single explicit huge page
+			// each (the rest may or may not be backed by transparent huge
+			// pages)
+			int hugepage_slabs = 0;
+
+			// the number of times a huge page slab was asked for, but regular
+			// pages had to be used
+			std::int64_t hugepage_fallbacks = 0;
+		};
+		stats_t stats() const;
+
+	private:
+
+		static constexpr int magazine_size = 16;
+
+		struct magazine
+		{
+			std::array<char*, magazine_size> blocks;
+			int size = 0;
+			// the NUMA node of the slabs the blocks of this magazine belong
+			// to. This is only maintained for magazines in the depot
+			int node = 0;
+			bool empty() const { return size == 0; }
+			bool full() const { return size == magazine_size; }
+		};
+
+		// the magazines of the threads mapped to this cache
+		struct thread_cache
+		{
+			mutable std::mutex mutex;
+			magazine loaded;
+			magazine previous;
+			std::int64_t hits = 0;
+			std::int64_t misses = 0;
+
+			// keeps caches used by different threads out of each other's
+			// cache lines
+			char padding[64];
+		};
+
+		struct slab
+		{
+			char* base;
+			// one bit per block, set for free blocks
+			std::array<std::uint64_t, max_blocks_per_slab / 64> free_mask;
+			int num_free;
+			int node;
+			bool hugepage;
+		};
+
+		thread_cache& local_cache();
+
+		// these must be called with m_depot_mutex held
+		void refill(magazine& m, int node);
+		void return_block(char* b);
+		void return_blocks(magazine& m);
+		// returns the blocks that don't belong to slabs of ``node`` to their
+		// slabs, and keeps the rest
+		void return_foreign_blocks(magazine& m, int node);
+		std::vector<slab>::iterator find_slab(char const* b);
+		bool add_slab(int node);
+		void release_slab(slab const& s);
+
+		// the node new slabs and magazines are associated with, for the
+		// calling thread. This is the consumer node, if one is set
+		int local_node() const;
+
+		int const m_block_size;
+
+		node_function m_current_node;
+
+		// set by the network thread, read by any thread going to the depot
+		std::atomic<int> m_consumer_node{-1};
+
+		static constexpr int num_caches = 16;
+		aux::array<thread_cache, num_caches> m_caches;
+
+		mutable std::mutex m_depot_mutex;
+
+		// full magazines, not owned by any thread
+		std::vector<magazine> m_depot;
+
+		// sorted by base address
+		std::vector<slab> m_slabs;
+
+		std::int64_t m_hugepage_fallbacks = 0;
+
+		bool m_lock_memory = false;
+		bool m_hugepages = false;
+		bool m_numa_local = false;
+	};
+}
+}
+
+#endif
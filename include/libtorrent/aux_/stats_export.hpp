@@ -0,0 +1,129 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_STATS_EXPORT_HPP_INCLUDED
+#define TORRENT_STATS_EXPORT_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+
+#if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
+
+#include "libtorrent/aux_/mmap.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/span.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace libtorrent {
+namespace aux {
+
+	// The session stats export file starts with this header. It's followed by
+	// ``num_metrics`` stats_export_metric entries at ``metrics_offset`` and
+	// ``num_values`` 64 bit values at ``values_offset``. The metric entries
+	// map the name of each metric to its index in the values array, the same
+	// way session_stats_metrics() does. All fields are in host byte order.
+	//
+	// The values are updated under a sequence lock. A reader must load
+	// ``sequence``, retry if it's odd, copy the values and then load
+	// ``sequence`` again. If it changed, the copy is torn and must be
+	// retried. read_stats_export() implements this protocol.
+	struct stats_export_header
+	{
+		// "LTSTATS" followed by a null terminator
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t num_metrics;
+		std::uint32_t num_values;
+
+		// byte offsets from the start of the file
+		std::uint32_t metrics_offset;
+		std::uint32_t values_offset;
+		std::uint32_t reserved;
+
+		std::atomic<std::uint64_t> sequence;
+
+		// the time of the last update, in microseconds, of the monotonic
+		// clock (clock_type)
+		std::atomic<std::int64_t> timestamp;
+	};
+
+	struct stats_export_metric
+	{
+		std::uint32_t value_index;
+
+		// 0 for counters and 1 for gauges, see metric_type_t
+		std::uint32_t type;
+
+		// the null terminated name of the metric
+		char name[56];
+	};
+
+	// publishes the session stats counters in a memory mapped file, for an
+	// external process to sample at a high frequency. Updating the file does
+	// not allocate memory or post any alerts.
+	struct TORRENT_EXTRA_EXPORT stats_export
+	{
+		// creates (or truncates) the file at ``path`` and writes the header
+		// and metric descriptors to it. Throws on failure.
+		explicit stats_export(std::string path);
+
+		stats_export(stats_export const&) = delete;
+		stats_export& operator=(stats_export const&) = delete;
+
+		// copies the current value of all counters into the file
+		void update(counters const& c);
+
+		std::string const& path() const { return m_path; }
+
+		static constexpr std::uint32_t version = 1;
+
+	private:
+
+		std::string m_path;
+		file_mapping m_file;
+		stats_export_header* m_header;
+		std::atomic<std::int64_t>* m_values;
+	};
+
+	// copies a consistent snapshot of the values from a stats export file
+	// mapped into memory into ``out``. Returns the number of values copied
+	// or -1 if ``file`` does not hold a valid stats export.
+	TORRENT_EXTRA_EXPORT int read_stats_export(span<char const> file
+		, span<std::int64_t> out);
+}
+}
+
+#endif // TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
+
+#endif
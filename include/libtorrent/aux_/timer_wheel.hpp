@@ -0,0 +1,187 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TORRENT_TIMER_WHEEL_HPP_INCLUDED
+#define TORRENT_TIMER_WHEEL_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/time.hpp"
+#include "libtorrent/assert.hpp"
+#include "libtorrent/aux_/array.hpp"
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+namespace libtorrent {
+namespace aux {
+
+	// a hierarchical timer wheel. Timers are bucketed by their expiry time,
+	// rounded up to the wheel's resolution. Timers expiring within the next
+	// 64 ticks are held in the first wheel, one slot per tick. Timers further
+	// out are held in coarser wheels, 64 times coarser for each level, and
+	// are moved down a level as their time approaches. Scheduling a timer is
+	// O(1), and advancing the wheel only touches the slots that have passed,
+	// regardless of how many timers are pending.
+	//
+	// Timers can't be cancelled. Whoever handles the expired values is
+	// expected to check whether they're still relevant.
+	template <typename T>
+	struct timer_wheel
+	{
+		timer_wheel(time_duration const resolution, time_point const now)
+			: m_resolution(resolution)
+			, m_epoch(now)
+		{
+			TORRENT_ASSERT(resolution > time_duration(0));
+		}
+
+		// schedule ``value`` to be passed to the handler of the first call to
+		// advance() at or after ``expiry``
+		void schedule(time_point const expiry, T value)
+		{
+			// round up, to never expire a timer early. Timers that are
+			// already due expire on the next tick
+			std::int64_t due = (expiry - m_epoch + m_resolution - time_duration(1))
+				/ m_resolution;
+			if (due <= m_current) due = m_current + 1;
+			insert(entry{due, std::move(value)});
+			++m_size;
+		}
+
+		// move the wheel forward to ``now``, calling ``f`` with every value
+		// whose timer has expired. ``f`` may schedule new timers
+		template <typename Fun>
+		void advance(time_point const now, Fun&& f)
+		{
+			std::int64_t const target = (now - m_epoch) / m_resolution;
+
+			// if there are no timers, there's nothing to visit on the way
+			if (m_size == 0 && target > m_current) m_current = target;
+
+			while (m_current < target)
+			{
+				++m_current;
+
+				// when a wheel wraps around, the next slot of the level above
+				// is due, and its timers are distributed over the lower levels.
+				// The higher levels first, since they may cascade into the
+				// slots about to be cascaded from the lower ones
+				int level = 1;
+				while (level < num_levels
+					&& (m_current & ((std::int64_t(1) << (slot_bits * level)) - 1)) == 0)
+					++level;
+				for (--level; level > 0; --level)
+					cascade(level);
+
+				auto& slot = m_wheels[0][std::size_t(m_current & slot_mask)];
+				if (slot.empty()) continue;
+
+				std::vector<entry> due;
+				due.swap(slot);
+				for (auto& e : due)
+				{
+					if (e.due > m_current)
+					{
+						// this timer wrapped around the top level wheel
+						insert(std::move(e));
+						continue;
+					}
+					--m_size;
+					f(e.value);
+				}
+			}
+		}
+
+		// the number of pending timers
+		int size() const { return m_size; }
+		bool empty() const { return m_size == 0; }
+
+	private:
+
+		static constexpr int slot_bits = 6;
+		static constexpr int num_slots = 1 << slot_bits;
+		static constexpr std::int64_t slot_mask = num_slots - 1;
+		static constexpr int num_levels = 4;
+
+		struct entry
+		{
+			// the tick this timer expires at
+			std::int64_t due;
+			T value;
+		};
+
+		void insert(entry e)
+		{
+			std::int64_t const delta = e.due - m_current;
+			TORRENT_ASSERT(delta >= 0);
+			int level = 0;
+			while (level < num_levels - 1
+				&& delta >= (std::int64_t(1) << (slot_bits * (level + 1))))
+				++level;
+
+			// timers too far out for the top level wheel are parked in its
+			// furthest slot, and re-inserted from there
+			std::int64_t const tick = std::min(e.due
+				, m_current + (std::int64_t(num_slots - 1) << (slot_bits * level)));
+			std::size_t const idx = std::size_t((tick >> (slot_bits * level)) & slot_mask);
+			m_wheels[level][idx].push_back(std::move(e));
+		}
+
+		void cascade(int const level)
+		{
+			auto& slot = m_wheels[level][std::size_t(
+				(m_current >> (slot_bits * level)) & slot_mask)];
+			if (slot.empty()) return;
+			std::vector<entry> entries;
+			entries.swap(slot);
+			for (auto& e : entries)
+				insert(std::move(e));
+		}
+
+		time_duration const m_resolution;
+		time_point const m_epoch;
+
+		// the number of ticks (of m_resolution) since m_epoch the wheel has
+		// advanced to. All timers due at or before this have expired
+		std::int64_t m_current = 0;
+
+		int m_size = 0;
+
+		aux::array<aux::array<std::vector<entry>, num_slots>, num_levels> m_wheels;
+	};
+}
+}
+
+#endif
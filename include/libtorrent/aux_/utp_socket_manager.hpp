@@ -70,9 +70,14 @@ namespace aux {
 			, span<char const>
 			, error_code&, udp_send_flags_t)>;
 
+		// corks (true) or uncorks (false) the underlying UDP socket. While
+		// corked, packets are queued up to be sent in a batch
+		using cork_fun_t = std::function<void(std::weak_ptr<utp_socket_interface>, bool)>;
+
 		using incoming_utp_callback_t =  std::function<void(aux::socket_type)>;
 
 		utp_socket_manager(send_fun_t send_fun
+			, cork_fun_t cork_fun
 			, incoming_utp_callback_t cb
 			, io_context& ios
 			, aux::session_settings const& sett
@@ -99,6 +104,18 @@ namespace aux {
 			, error_code& ec, udp_send_flags_t flags = {});
 		void subscribe_writable(utp_socket_impl* s);
 
+		// a packet sent to ``ep`` over ``sock`` failed after send_packet()
+		// had returned, because it was queued up while the UDP socket was
+		// corked. The uTP sockets connected to ``ep`` handle the error the
+		// same way they would have, had send_packet() failed
+		void send_failed(std::weak_ptr<utp_socket_interface> const& sock
+			, udp::endpoint const& ep, int size, error_code const& ec);
+
+		// used by uTP sockets to batch up a burst of packets into as few
+		// system calls as possible. Calls must be balanced
+		void cork(std::weak_ptr<utp_socket_interface> const& sock) { m_cork_fun(sock, true); }
+		void uncork(std::weak_ptr<utp_socket_interface> const& sock) { m_cork_fun(sock, false); }
+
 		void remove_udp_socket(std::weak_ptr<utp_socket_interface> sock);
 
 		// internal, used by utp_stream
@@ -147,6 +164,7 @@ namespace aux {
 	private:
 
 		send_fun_t m_send_fun;
+		cork_fun_t m_cork_fun;
 		incoming_utp_callback_t m_cb;
 
 		// replace with a hash-map
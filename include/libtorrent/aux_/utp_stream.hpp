@@ -634,6 +634,10 @@ struct utp_socket_impl
 		, udp::endpoint const& ep, time_point receive_time);
 	void writable();
 
+	// a packet of ``size`` bytes, queued up while the UDP socket was corked,
+	// could not be sent
+	void send_failed(int size, error_code const& ec);
+
 	bool should_delete() const;
 	tcp::endpoint remote_endpoint(error_code& ec) const;
 	std::size_t available() const;
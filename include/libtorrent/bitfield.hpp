@@ -172,6 +172,43 @@ namespace libtorrent {
 		// count the number of bits in the bitfield that are set to 1.
 		int count() const noexcept;
 
+		// count the number of bits that are set in both this bitfield and
+		// ``rhs`` (count_and), or set in this bitfield but not in ``rhs``
+		// (count_and_not). Both bitfields must have the same size.
+		int count_and(bitfield const& rhs) const noexcept;
+		int count_and_not(bitfield const& rhs) const noexcept;
+
+		// returns true if there is at least one bit set in both this bitfield
+		// and ``rhs``. Bits past the end of the shorter bitfield are ignored.
+		bool intersects(bitfield const& rhs) const noexcept;
+
+		// calls ``f`` with the index of every bit that is set, in ascending
+		// order. Words with no bits set are skipped in bulk, which makes this
+		// a lot cheaper than testing every bit of a sparse bitfield.
+		template <typename Fun>
+		void for_each_set_bit(Fun f) const
+		{
+			int const words = num_words();
+			if (words == 0) return;
+			std::uint32_t const* b = buf();
+			for (int i = next_set_word(0); i < words;)
+			{
+				std::uint32_t w = aux::network_to_host(b[i]);
+				do
+				{
+#if TORRENT_HAS_BUILTIN_CLZ
+					int const bit = __builtin_clz(w);
+#else
+					int const bit = 31 - aux::log2p1(w);
+#endif
+					f(i * 32 + bit);
+					w ^= 0x80000000U >> bit;
+				} while (w != 0);
+				++i;
+				if (i < words && b[i] == 0) i = next_set_word(i);
+			}
+		}
+
 		// returns the index of the first set bit in the bitfield, i.e. 1 bit.
 		int find_first_set() const noexcept;
 
@@ -274,6 +311,10 @@ namespace libtorrent {
 
 		std::uint32_t const* buf() const noexcept { TORRENT_ASSERT(m_buf); return &m_buf[1]; }
 		std::uint32_t* buf() noexcept { TORRENT_ASSERT(m_buf); return &m_buf[1]; }
+
+		// returns the index of the first word at or after ``start`` that has
+		// any bit set, or num_words() if there is none
+		int next_set_word(int start) const noexcept;
 		void clear_trailing_bits() noexcept
 		{
 			// clear the tail bits in the last byte
@@ -329,6 +370,12 @@ namespace libtorrent {
 		{ this->bitfield::set_bit(static_cast<int>(index)); }
 
 		IndexType end_index() const noexcept { return IndexType(this->size()); }
+
+		template <typename Fun>
+		void for_each_set_bit(Fun f) const
+		{
+			this->bitfield::for_each_set_bit([&f](int const i) { f(IndexType(i)); });
+		}
 	};
 }
 
@@ -254,6 +254,7 @@ namespace libtorrent {
 		void write_have(piece_index_t index) override;
 		void write_dont_have(piece_index_t index) override;
 		void write_piece(peer_request const& r, disk_buffer_holder buffer) override;
+		bool allow_zero_copy_send() const override;
 		void write_keepalive() override;
 		void write_handshake();
 		void write_upload_only(bool enabled) override;
@@ -194,6 +194,14 @@ POSSIBILITY OF SUCH DAMAGE.
 #define TORRENT_HAS_COPY_FILE_RANGE 1
 #endif
 
+#ifndef TORRENT_HAVE_IO_URING
+#if defined __has_include && !defined __ANDROID__
+#if __has_include(<linux/io_uring.h>)
+#define TORRENT_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
 #define TORRENT_HAS_PTHREAD_SET_NAME 1
 #define TORRENT_HAS_SYMLINK 1
 #define TORRENT_USE_MADVISE 1
@@ -202,6 +210,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #define TORRENT_USE_IFCONF 1
 #define TORRENT_HAS_SALEN 0
 #define TORRENT_USE_FDATASYNC 1
+#define TORRENT_HAS_MMSG 1
+#define TORRENT_USE_MSG_ZEROCOPY 1
+#define TORRENT_HAS_PWRITEV 1
 
 #if defined __GLIBC__ && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ > 24))
 #define TORRENT_USE_GETRANDOM 1
@@ -504,6 +515,10 @@ POSSIBILITY OF SUCH DAMAGE.
 #define TORRENT_HAVE_MAP_VIEW_OF_FILE 0
 #endif
 
+#ifndef TORRENT_HAVE_IO_URING
+#define TORRENT_HAVE_IO_URING 0
+#endif
+
 #ifndef TORRENT_USE_MADVISE
 #define TORRENT_USE_MADVISE 0
 #endif
@@ -521,6 +536,22 @@ POSSIBILITY OF SUCH DAMAGE.
 #define TORRENT_USE_FDATASYNC 0
 #endif
 
+// recvmmsg() and sendmmsg()
+#ifndef TORRENT_HAS_MMSG
+#define TORRENT_HAS_MMSG 0
+#endif
+
+// send() with MSG_ZEROCOPY, and completion notifications on the socket's
+// error queue
+#ifndef TORRENT_USE_MSG_ZEROCOPY
+#define TORRENT_USE_MSG_ZEROCOPY 0
+#endif
+
+// pwritev()
+#ifndef TORRENT_HAS_PWRITEV
+#define TORRENT_HAS_PWRITEV 0
+#endif
+
 #ifndef TORRENT_USE_UNC_PATHS
 #define TORRENT_USE_UNC_PATHS 0
 #endif
@@ -652,6 +683,17 @@ POSSIBILITY OF SUCH DAMAGE.
 #	define TORRENT_HAS_ARM_NEON 0
 #endif // TORRENT_HAS_ARM_NEON
 
+// the AVX2 bitfield kernels (popcount and scanning for set bits) are compiled
+// with function target attributes and selected at runtime, see
+// aux_/cpuid.hpp. This is independent of the SIMD hash functions
+#ifndef TORRENT_HAS_SIMD_BITFIELD
+#if TORRENT_HAS_SSE && (defined __GNUC__ || defined __clang__)
+#	define TORRENT_HAS_SIMD_BITFIELD 1
+#else
+#	define TORRENT_HAS_SIMD_BITFIELD 0
+#endif
+#endif // TORRENT_HAS_SIMD_BITFIELD
+
 #if TORRENT_HAS_ARM && defined __ARM_FEATURE_CRC32
 #	define TORRENT_HAS_ARM_CRC32 1
 #else
@@ -662,6 +704,15 @@ POSSIBILITY OF SUCH DAMAGE.
 #endif
 #endif // TORRENT_HAS_ARM_CRC32
 
+// the SHA extensions (SHA-NI) and AVX2 code paths are compiled with function
+// target attributes, to not require any special flags on the command line.
+// Whether they are used is determined at runtime, see aux_/cpuid.hpp
+#if TORRENT_HAS_SSE && defined __GNUC__
+#	define TORRENT_HAS_SIMD_HASH 1
+#else
+#	define TORRENT_HAS_SIMD_HASH 0
+#endif
+
 #if defined TORRENT_USE_OPENSSL || defined TORRENT_USE_GNUTLS
 #define TORRENT_USE_SSL 1
 #else
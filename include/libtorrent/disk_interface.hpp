@@ -140,7 +140,21 @@ namespace file_open_mode {
 		time_point last_use;
 	};
 
-	using disk_job_flags_t = flags::bitfield_flag<std::uint8_t, struct disk_job_flags_tag>;
+	// latency histograms for one type of disk job, see disk_latency_alert.
+	struct TORRENT_EXPORT disk_job_latency
+	{
+		// the name of the type of job, e.g. "read", "write" or "hash"
+		char const* job;
+
+		// the number of jobs, bucketed by the time (in microseconds) they spent
+		// queued, waiting for a disk thread, and the time they took to execute.
+		// The bucket boundaries are given by
+		// disk_latency_alert::bucket_floor().
+		std::vector<std::int64_t> queue_time;
+		std::vector<std::int64_t> exec_time;
+	};
+
+	using disk_job_flags_t = flags::bitfield_flag<std::uint16_t, struct disk_job_flags_tag>;
 
 	// The disk_interface is the customization point for disk I/O in libtorrent.
 	// implement this interface and provide a factory function to the session constructor
@@ -180,6 +194,14 @@ namespace file_open_mode {
 		// it should be flushed to disk
 		static constexpr disk_job_flags_t flush_piece = 7_bit;
 
+		// for async_read(), this is a hint that the returned buffer may refer
+		// directly to the memory the file is mapped into, rather than to a
+		// copy in the disk buffer pool. The caller must not touch the buffer
+		// contents in the network thread (in case a page needs to be brought
+		// in, or the file was truncated), only hand it to the kernel, e.g. by
+		// writing it to a plain TCP socket.
+		static constexpr disk_job_flags_t zero_copy = 8_bit;
+
 		// this is called when a new torrent is added. The shared_ptr can be
 		// used to hold the internal torrent object alive as long as there are
 		// outstanding disk operations on the storage.
@@ -339,6 +361,12 @@ namespace file_open_mode {
 		// in.
 		virtual std::vector<open_file_state> get_status(storage_index_t) const = 0;
 
+		// Return latency histograms for the disk jobs performed so far, one
+		// entry per type of job. This is used by
+		// session_handle::post_disk_latency(). Supporting this is optional,
+		// the default implementation returns an empty list.
+		virtual std::vector<disk_job_latency> job_latency() const { return {}; }
+
 		// this is called when the session is starting to shut down. The disk
 		// I/O object is expected to flush any outstanding write jobs, cancel
 		// hash jobs and initiate tearing down of any internal threads. If
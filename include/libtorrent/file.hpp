@@ -99,6 +99,13 @@ namespace aux {
 		, std::int64_t file_offset
 		, error_code& ec);
 
+	// writes all of ``bufs``, back to back, starting at ``file_offset``. Uses
+	// a single pwritev() call where available
+	int pwritev_all(handle_type handle
+		, span<span<char const> const> bufs
+		, std::int64_t file_offset
+		, error_code& ec);
+
 	struct TORRENT_EXTRA_EXPORT file_handle
 	{
 		file_handle(): m_fd(invalid_handle) {}
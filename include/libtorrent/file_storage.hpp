@@ -36,6 +36,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #define TORRENT_FILE_STORAGE_HPP_INCLUDED
 
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <unordered_set>
@@ -407,6 +408,48 @@ namespace aux {
 		std::vector<file_slice> map_block(piece_index_t piece, std::int64_t offset
 			, std::int64_t size) const;
 
+		// calls ``f`` with each file_slice the specified range overlaps, in
+		// order. This is the same mapping as the overload above, but without
+		// allocating a vector to hold the result. If ``f`` returns false, no
+		// more slices are produced.
+		template <typename Fun>
+		void map_block(piece_index_t const piece, std::int64_t const offset
+			, std::int64_t size, Fun f) const
+		{
+			TORRENT_ASSERT_PRECOND(piece >= piece_index_t{0});
+			TORRENT_ASSERT_PRECOND(piece < end_piece());
+			TORRENT_ASSERT_PRECOND(size >= 0);
+
+			if (m_files.empty()) return;
+
+			std::int64_t const torrent_offset
+				= static_cast<int>(piece) * std::int64_t(m_piece_length) + offset;
+			TORRENT_ASSERT_PRECOND(torrent_offset <= m_total_size - size);
+
+			// in case the size is past the end, fix it up
+			if (torrent_offset > m_total_size - size)
+				size = m_total_size - torrent_offset;
+			if (size <= 0) return;
+
+			file_index_t file = file_index_at_offset(torrent_offset);
+			std::int64_t file_offset = torrent_offset
+				- static_cast<std::int64_t>(m_files[file].offset);
+			for (; size > 0; file_offset -= static_cast<std::int64_t>(m_files[file].size), ++file)
+			{
+				TORRENT_ASSERT(file < end_file());
+				std::int64_t const file_size = static_cast<std::int64_t>(m_files[file].size);
+				if (file_offset >= file_size) continue;
+
+				file_slice slice{};
+				slice.file_index = file;
+				slice.offset = file_offset;
+				slice.size = std::min(file_size - file_offset, size);
+				size -= slice.size;
+				file_offset += slice.size;
+				if (!f(slice)) return;
+			}
+		}
+
 		// returns a peer_request representing the piece index, byte offset
 		// and size the specified file range overlaps. This is the inverse
 		// mapping over map_block(). Note that the ``peer_request`` return type
@@ -430,7 +473,7 @@ namespace aux {
 		std::int64_t total_size() const { return m_total_size; }
 
 		// set and get the number of pieces in the torrent
-		void set_num_pieces(int n) { m_num_pieces = n; }
+		void set_num_pieces(int n);
 		int num_pieces() const { TORRENT_ASSERT(m_piece_length > 0); return m_num_pieces; }
 
 		// returns the index of the one-past-end piece in the file storage
@@ -450,7 +493,7 @@ namespace aux {
 
 		// set and get the size of each piece in this torrent. It must be a power of two
 		// and at least 16 kiB.
-		void set_piece_length(int l)  { m_piece_length = l; }
+		void set_piece_length(int l);
 		int piece_length() const { TORRENT_ASSERT(m_piece_length > 0); return m_piece_length; }
 
 		// returns the piece size of ``index``. This will be the same as piece_length(), except
@@ -657,6 +700,10 @@ namespace aux {
 
 		aux::path_index_t get_or_add_path(string_view path);
 
+		// rebuilds m_piece_file, once the piece size and number of pieces
+		// agree with the files
+		void update_piece_index();
+
 		// the number of bytes in a regular piece
 		// (i.e. not the potentially truncated last piece)
 		int m_piece_length = 0;
@@ -674,6 +721,12 @@ namespace aux {
 		// the list of files that this torrent consists of
 		aux::vector<aux::file_entry, file_index_t> m_files;
 
+		// the file each piece starts in. This narrows down the search for the
+		// file at a given offset to the files overlapping a single piece. It's
+		// empty for torrents with only a few files, or while the files are
+		// still being added
+		aux::vector<file_index_t, piece_index_t> m_piece_file;
+
 		// if there are sha1 hashes for each individual file there are as many
 		// entries in this array as the m_files array. Each entry in m_files has
 		// a corresponding hash pointer in this array. The reason to split it up
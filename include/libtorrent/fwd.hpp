@@ -171,6 +171,7 @@ struct disk_buffer_holder;
 
 // include/libtorrent/disk_interface.hpp
 struct open_file_state;
+struct disk_job_latency;
 struct disk_interface;
 struct storage_holder;
 
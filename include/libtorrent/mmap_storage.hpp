@@ -115,6 +115,24 @@ namespace aux {
 			, piece_index_t piece, int offset, aux::open_mode_t mode
 			, disk_job_flags_t flags
 			, storage_error&);
+
+		// writes ``bufs`` back to back, as if they were a single buffer. This
+		// is used to write a run of adjacent blocks with a single operation
+		// per file
+		int write(settings_interface const&, span<span<char> const> bufs
+			, piece_index_t piece, int offset, aux::open_mode_t mode
+			, disk_job_flags_t flags
+			, storage_error&);
+
+		// if the ``length`` bytes at ``offset`` into ``piece`` all live in a
+		// single memory mapped file, this faults the pages in and returns the
+		// file mapping, with ``buf`` pointing at the data. The mapping must be
+		// held for as long as ``buf`` is in use. Returns nullptr if the range
+		// can't be served straight out of a mapping (it spans files, is a pad
+		// file or in the part file), in which case read() must be used.
+		std::shared_ptr<aux::file_mapping> mapped_read(settings_interface const&
+			, piece_index_t piece, int offset, int length, aux::open_mode_t mode
+			, char const*& buf, storage_error&);
 		int hash(settings_interface const&, hasher& ph, std::ptrdiff_t len
 			, piece_index_t piece, int offset, aux::open_mode_t mode
 			, disk_job_flags_t flags, storage_error&);
@@ -122,6 +140,14 @@ namespace aux {
 			, piece_index_t piece, int offset, aux::open_mode_t mode
 			, disk_job_flags_t flags, storage_error&);
 
+		// computes the v2 hashes of consecutive blocks, starting at ``offset``
+		// in ``piece``, one per element in ``hashes``. When the file is memory
+		// mapped, the blocks are hashed in parallel (see aux::hash_many()).
+		// Returns the number of bytes hashed, or -1 on error.
+		int hash2(settings_interface const&, span<sha256_hash> hashes
+			, piece_index_t piece, int offset, aux::open_mode_t mode
+			, disk_job_flags_t flags, storage_error&);
+
 		// if the files in this storage are mapped, returns the mapped
 		// file_storage, otherwise returns the original file_storage object.
 		file_storage const& files() const { return m_mapped_files ? *m_mapped_files : m_files; }
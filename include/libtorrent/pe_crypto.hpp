@@ -62,13 +62,21 @@ namespace libtorrent {
 
 	TORRENT_EXTRA_EXPORT std::array<char, 96> export_key(key_t const& k);
 
-	// RC4 state from libtomcrypt
+	// RC4 state, originally from libtomcrypt. The permutation only holds byte
+	// values, but is stored as 32 bit words. With byte sized entries every
+	// swap is a partial register write, which makes the keystream generation
+	// about 40% slower on x86.
 	struct rc4 {
 		int x;
 		int y;
-		aux::array<std::uint8_t, 256> buf;
+		aux::array<std::uint32_t, 256> buf;
 	};
 
+	TORRENT_EXTRA_EXPORT void rc4_init(const unsigned char* in, std::size_t len, rc4 *state);
+
+	// XORs the RC4 keystream into the buffers, as one continuous stream
+	TORRENT_EXTRA_EXPORT void rc4_crypt(span<span<char>> bufs, rc4& state);
+
 	// TODO: 3 dh_key_exchange should probably move into its own file
 	class TORRENT_EXTRA_EXPORT dh_key_exchange
 	{
@@ -106,8 +114,11 @@ namespace libtorrent {
 		bool switch_send_crypto(std::shared_ptr<crypto_plugin> crypto
 			, int pending_encryption);
 
+		// ``stream_cipher`` is set for the built-in RC4 handler. It doesn't
+		// frame its input, which means all received bytes can be decrypted
+		// as soon as they arrive, rather than one message at a time.
 		void switch_recv_crypto(std::shared_ptr<crypto_plugin> crypto
-			, aux::crypto_receive_buffer& recv_buffer);
+			, aux::crypto_receive_buffer& recv_buffer, bool stream_cipher = false);
 
 		bool is_send_plaintext() const
 		{
@@ -130,6 +141,11 @@ namespace libtorrent {
 		};
 		std::list<barrier> m_send_barriers;
 		std::shared_ptr<crypto_plugin> m_dec_handler;
+
+		// the number of bytes past the receive position that have already
+		// been decrypted. Only used with stream ciphers
+		int m_decrypted_ahead = 0;
+		bool m_dec_stream = false;
 	};
 
 	struct TORRENT_EXTRA_EXPORT rc4_handler : crypto_plugin
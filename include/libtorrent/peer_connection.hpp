@@ -45,8 +45,10 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/peer_request.hpp"
 #include "libtorrent/piece_block_progress.hpp"
 #include "libtorrent/aux_/bandwidth_limit.hpp"
+#include "libtorrent/aux_/bdp_estimator.hpp"
 #include "libtorrent/assert.hpp"
 #include "libtorrent/aux_/chained_buffer.hpp"
+#include "libtorrent/aux_/msg_zerocopy.hpp"
 #include "libtorrent/disk_buffer_holder.hpp"
 #include "libtorrent/bitfield.hpp"
 #include "libtorrent/aux_/bandwidth_socket.hpp"
@@ -129,7 +131,7 @@ namespace aux {
 	{
 		pending_block(piece_block const& b) // NOLINT
 			: block(b), send_buffer_offset(not_in_buffer), not_wanted(false)
-			, timed_out(false), busy(false)
+			, timed_out(false), busy(false), sent(false)
 		{}
 
 		piece_block block;
@@ -139,7 +141,7 @@ namespace aux {
 		// the number of bytes into the send buffer this request is. Every time
 		// some portion of the send buffer is transmitted, this offset is
 		// decremented by the number of bytes sent. once this drops below 0, the
-		// request_time field is set to the current time.
+		// send_time field is set to the current time.
 		// if the request has not been written to the send buffer, this field
 		// remains not_in_buffer.
 		std::uint32_t send_buffer_offset:29;
@@ -159,6 +161,20 @@ namespace aux {
 		// busy request at a time in each peer's queue
 		std::uint32_t busy:1;
 
+		// set once the request has been handed to the socket. send_time and
+		// delivered_at_send are only valid once this is set
+		bool sent;
+
+		// when the request was handed to the socket, relative to when the
+		// peer connected
+		aux::relative_time send_time;
+
+		// the total number of payload bytes received from the peer at the time
+		// the request was sent (truncated to 32 bits). The number of bytes
+		// received while the request was outstanding is used to estimate the
+		// delivery rate
+		std::uint32_t delivered_at_send = 0;
+
 		bool operator==(pending_block const& b) const
 		{
 			return b.block == block
@@ -386,6 +402,9 @@ namespace aux {
 		bool no_download() const { return m_no_download; }
 		void no_download(bool b) { m_no_download = b; }
 
+		int deferred_request() const { return m_deferred_request; }
+		void deferred_request(int counter) { m_deferred_request = counter; }
+
 		bool ignore_stats() const { return m_ignore_stats; }
 		void ignore_stats(bool b) { m_ignore_stats = b; }
 
@@ -736,6 +755,12 @@ namespace aux {
 		virtual void write_keepalive() = 0;
 		virtual void write_piece(peer_request const& r, disk_buffer_holder buffer) = 0;
 		virtual void write_suggest(piece_index_t piece) = 0;
+
+		// returns true if blocks sent to this peer may refer directly to file
+		// mappings (see disk_interface::zero_copy). That's only the case if
+		// nothing in this thread reads the payload before it's handed to the
+		// kernel.
+		virtual bool allow_zero_copy_send() const { return false; }
 		virtual void write_bitfield() = 0;
 
 		virtual void write_reject_request(peer_request const& r) = 0;
@@ -789,6 +814,22 @@ namespace aux {
 
 		void account_received_bytes(int bytes_transferred);
 
+#if TORRENT_USE_MSG_ZEROCOPY
+		// returns true if a write of this many bytes should be sent with
+		// MSG_ZEROCOPY
+		bool use_msg_zerocopy(int bytes);
+
+		// frees the send buffers the kernel is done with
+		void reap_zerocopy_sends();
+
+		// when the connection is closed with zero-copy sends outstanding,
+		// the kernel may still send from our buffers. These keep the socket
+		// open, and hand it over to the session's zerocopy_reaper along with
+		// the buffers, once the send buffer is released
+		void keep_zerocopy_socket();
+		void hand_off_zerocopy_sends();
+#endif
+
 		void do_update_interest();
 		void fill_send_buffer();
 		void on_disk_read_complete(disk_buffer_holder buffer
@@ -867,6 +908,20 @@ namespace aux {
 		aux::chained_buffer m_send_buffer;
 	private:
 
+#if TORRENT_USE_MSG_ZEROCOPY
+		// the sends issued with MSG_ZEROCOPY. As long as any of them are
+		// outstanding, buffers popped from m_send_buffer are retained, since
+		// the kernel may still be reading from them
+		aux::zerocopy_tracker m_zerocopy;
+
+		// true if the outstanding write was issued with MSG_ZEROCOPY
+		bool m_zerocopy_write = false;
+
+		// a duplicate of the socket's descriptor, taken on disconnect if
+		// there are zero-copy sends outstanding. See keep_zerocopy_socket()
+		int m_zerocopy_fd = -1;
+#endif
+
 		// the disk thread to use to issue disk jobs to
 		disk_interface& m_disk_thread;
 
@@ -885,6 +940,11 @@ namespace aux {
 		// receive a payload message after it has been requested.
 		sliding_average<int, 20> m_request_time;
 
+		// the bandwidth and round trip time to this peer, estimated from the
+		// blocks we receive. Used to size the request queue when
+		// bdp_request_queue is enabled
+		aux::bdp_estimator m_bdp;
+
 		// keep the io_context running as long as we
 		// have peer connections
 		executor_work_guard<io_context::executor_type> m_work;
@@ -1081,6 +1141,11 @@ namespace aux {
 		// stop sending data after this many bytes, INT_MAX = inf
 		int m_send_barrier = INT_MAX;
 
+		// the stats counter to increment once the torrent has refilled this
+		// peer's request queue, or -1 if it isn't queued for a refill. See
+		// torrent::refill_requests()
+		int m_deferred_request = -1;
+
 		// the number of request we should queue up
 		// at the remote end.
 		// TODO: 2 rename this target queue size
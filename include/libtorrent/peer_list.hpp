@@ -39,12 +39,16 @@ POSSIBILITY OF SUCH DAMAGE.
 #define TORRENT_POLICY_HPP_INCLUDED
 
 #include <algorithm>
+#include <array>
+#include <iterator>
+#include <cstddef>
 
 #include "libtorrent/fwd.hpp"
 #include "libtorrent/string_util.hpp" // for allocate_string_copy
 #include "libtorrent/request_blocks.hpp" // for source_rank
 
 #include "libtorrent/torrent_peer.hpp"
+#include "libtorrent/torrent_peer_allocator.hpp"
 #include "libtorrent/piece_picker.hpp"
 #include "libtorrent/socket.hpp"
 #include "libtorrent/address.hpp"
@@ -53,15 +57,13 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/config.hpp"
 #include "libtorrent/debug.hpp"
 #include "libtorrent/peer_connection_interface.hpp"
-#include "libtorrent/aux_/deque.hpp"
+#include "libtorrent/aux_/vector.hpp"
 #include "libtorrent/peer_info.hpp" // for peer_source_flags_t
 #include "libtorrent/string_view.hpp"
 #include "libtorrent/pex_flags.hpp"
 
 namespace libtorrent {
 
-	struct torrent_peer_allocator_interface;
-
 	// this object is used to communicate torrent state and
 	// some configuration to the peer_list object. This make
 	// the peer_list type not depend on the torrent type directly.
@@ -81,6 +83,13 @@ namespace libtorrent {
 		// the number of iterations over the peer list for this operation
 		int loop_counter = 0;
 
+		// set by connect_one_peer() when it can't find a peer to connect to
+		// because every connect candidate is still waiting out its reconnect
+		// timeout. This is the session time when the first of them may be
+		// tried again. It's left at 0 if the peer list is too large to be
+		// scanned in a single call, since we can't be sure then.
+		int next_connect_time = 0;
+
 		// these are used only by find_connect_candidates in order
 		// to implement peer ranking. See:
 		// http://blog.libtorrent.org/2012/12/swarm-connectivity/
@@ -158,32 +167,46 @@ namespace libtorrent {
 		void check_invariant() const;
 #endif
 
+		// the random key of the hash function the address index uses
+		using hash_key = std::array<std::uint64_t, 2>;
+
 		int num_peers() const { return int(m_peers.size()); }
 		int num_candidate_cache() const { return int(m_candidate_cache.size()); }
 
-		using peers_t = aux::deque<torrent_peer*>;
-		using iterator = peers_t::iterator;
-		using const_iterator = peers_t::const_iterator;
-		iterator begin() { return m_peers.begin(); }
-		iterator end() { return m_peers.end(); }
-		const_iterator begin() const { return m_peers.begin(); }
-		const_iterator end() const { return m_peers.end(); }
-
-		std::pair<iterator, iterator> find_peers(address const& a)
-		{
-#if TORRENT_USE_I2P
-			if (a == address())
-				return std::pair<iterator, iterator>(m_peers.end(), m_peers.end());
-#endif
-			return std::equal_range(
-				m_peers.begin(), m_peers.end(), a, peer_address_compare());
-		}
+		// m_peers is not kept in any particular order. Peers are appended as
+		// they are added and erasing a peer moves the last one into its slot.
+		// Lookups by address go through m_index instead.
+		using peers_t = aux::vector<peer_handle>;
 
-		std::pair<const_iterator, const_iterator> find_peers(address const& a) const
+		// iterates over all peers, in no particular order
+		struct const_iterator
 		{
-			return std::equal_range(
-				m_peers.begin(), m_peers.end(), a, peer_address_compare());
-		}
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = torrent_peer*;
+			using difference_type = std::ptrdiff_t;
+			using pointer = torrent_peer* const*;
+			using reference = torrent_peer*;
+
+			torrent_peer* operator*() const { return m_alloc->peer_at(*m_i); }
+			const_iterator& operator++() { ++m_i; return *this; }
+			const_iterator operator++(int) { const_iterator ret = *this; ++m_i; return ret; }
+			bool operator==(const_iterator const& rhs) const { return m_i == rhs.m_i; }
+			bool operator!=(const_iterator const& rhs) const { return m_i != rhs.m_i; }
+
+		private:
+			friend struct peer_list;
+			const_iterator(peers_t::const_iterator i
+				, torrent_peer_allocator_interface const* a)
+				: m_i(i), m_alloc(a) {}
+			peers_t::const_iterator m_i;
+			torrent_peer_allocator_interface const* m_alloc;
+		};
+		const_iterator begin() const { return {m_peers.begin(), &m_peer_allocator}; }
+		const_iterator end() const { return {m_peers.end(), &m_peer_allocator}; }
+
+		// returns all peers with the address ``a``. There may be more than one
+		// if multiple connections per IP are allowed
+		std::vector<torrent_peer*> find_peers(address const& a) const;
 
 		torrent_peer* connect_one_peer(int session_time, torrent_state* state);
 
@@ -193,20 +216,45 @@ namespace libtorrent {
 		int num_connect_candidates() const { return m_num_connect_candidates; }
 
 		void erase_peer(torrent_peer* p, torrent_state* state);
-		void erase_peer(iterator i, torrent_state* state);
 
 		void set_max_failcount(torrent_state* st);
 
 	private:
 
+		torrent_peer* peer_at(int const pos) const
+		{ return m_peer_allocator.peer_at(m_peers[pos]); }
+
+		void erase_peer_at(int pos, torrent_state* state);
+
 		void recalculate_connect_candidates(torrent_state* state);
 
 		void update_connect_candidates(int delta);
 
 		void update_peer(torrent_peer* p, peer_source_flags_t src
 			, pex_flags_t flags, tcp::endpoint const& remote);
-		bool insert_peer(torrent_peer* p, iterator iter
-			, pex_flags_t flags, torrent_state* state);
+		bool insert_peer(peer_handle h, pex_flags_t flags, torrent_state* state);
+
+		// appends the peer to m_peers and adds it to the address index
+		void append_peer(peer_handle h);
+
+		// returns the position in m_peers of the first peer for which ``pred``
+		// returns true, among the ones whose address (or i2p destination)
+		// hashes to ``hash``. Returns -1 if there is no such peer.
+		template <typename Pred>
+		int find_in_index(std::uint32_t hash, Pred pred) const;
+		int find_peer(address const& a) const;
+		int find_peer(address const& a, std::uint16_t port) const;
+#if TORRENT_USE_I2P
+		int find_peer(string_view dest) const;
+#endif
+		int position_of(torrent_peer const* p) const;
+
+		// the slot in m_index of the peer at position ``pos`` in m_peers
+		int index_slot(int pos) const;
+		void index_insert(int pos);
+		void index_erase(int pos);
+		void index_move(int from, int to);
+		void rehash(int capacity);
 
 		void find_connect_candidates(std::vector<torrent_peer*>& peers
 			, int session_time, torrent_state* state);
@@ -219,8 +267,22 @@ namespace libtorrent {
 		static constexpr erase_peer_flags_t force_erase = 1_bit;
 		void erase_peers(torrent_state* state, erase_peer_flags_t flags = {});
 
+		// the handles of our peers, allocated from m_peer_allocator. A handle
+		// is half the size of a pointer
 		peers_t m_peers;
 
+		// an open addressing hash table (with linear probing) of positions in
+		// m_peers, keyed by the peer's address (or i2p destination). Each slot
+		// holds the position + 1, 0 denotes an empty slot. The capacity is
+		// always a power of two. This is what lets us find peers by address
+		// without keeping m_peers sorted, which would make every insert and
+		// erase move half the list.
+		aux::vector<std::uint32_t> m_index;
+
+		// randomly generated for every peer_list, to make the positions of
+		// peers in m_index unpredictable
+		hash_key m_hash_key;
+
 		// this should be nullptr for the most part. It's set
 		// to point to a valid torrent_peer object if that
 		// object needs to be kept alive. If we ever feel
@@ -203,6 +203,10 @@ namespace libtorrent {
 			num_read_ops,
 			num_read_back,
 
+			disk_buffer_magazine_hits,
+			disk_buffer_magazine_misses,
+			disk_buffer_hugepage_fallbacks,
+
 			disk_read_time,
 			disk_write_time,
 			disk_hash_time,
@@ -401,6 +405,9 @@ namespace libtorrent {
 			request_latency,
 
 			disk_blocks_in_use,
+			disk_buffer_slabs,
+			disk_buffer_free_blocks,
+			disk_buffer_hugepage_slabs,
 			queued_disk_jobs,
 			num_running_disk_jobs,
 			num_read_jobs,
@@ -445,6 +452,9 @@ namespace libtorrent {
 			limiter_up_bytes,
 			limiter_down_bytes,
 
+			recv_buffer_arena_slabs,
+			recv_buffer_arena_hugepage_slabs,
+
 			// the number of uTP connections in each respective state
 			// these must be defined in the same order as the state_t enum
 			// in utp_stream
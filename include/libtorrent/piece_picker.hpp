@@ -316,6 +316,35 @@ namespace libtorrent {
 			, counters& pc
 			) const;
 
+		// one entry per peer passed to pick_pieces_batch()
+		struct batch_pick
+		{
+			// the pieces the peer has, that can be requested from it
+			typed_bitfield<piece_index_t> const* pieces;
+			torrent_peer* peer;
+
+			// the number of blocks to pick for this peer. This is decremented
+			// as blocks are picked
+			int num_blocks;
+
+			// the blocks picked for this peer, in priority order
+			std::vector<piece_block> picked;
+		};
+
+		// picks blocks for a number of peers in a single pass over the
+		// priority buckets, in rarest-first order. This is equivalent to
+		// calling pick_pieces() with the rarest_first option for each peer in
+		// turn, and marking the picked blocks as downloading in between, except
+		// that it doesn't consider busy blocks. Each free block is handed to at
+		// most one peer. Peers whose num_blocks is still positive afterwards
+		// could not be satisfied with free blocks, and should fall back to
+		// pick_pieces() to enter end-game mode.
+		//
+		// Peers that don't have any piece we want are identified up-front
+		// with a word-wise intersection of their bitfield and the pieces we
+		// want, and never visit the priority buckets.
+		void pick_pieces_batch(span<batch_pick> peers, counters& pc) const;
+
 		// picks blocks from each of the pieces in the piece_list
 		// vector that is also in the piece bitmask. The blocks
 		// are added to interesting_blocks, and busy blocks are
@@ -778,6 +807,14 @@ namespace libtorrent {
 		std::vector<downloading_piece>::const_iterator find_dl_piece(download_queue_t, piece_index_t) const;
 		std::vector<downloading_piece>::iterator find_dl_piece(download_queue_t, piece_index_t);
 
+		// appends dp to the download queue ``queue`` and records its slot in
+		// m_dl_slot. Removing a piece swaps the last entry of the queue into
+		// its slot, so neither operation moves any other downloading_piece
+		std::vector<downloading_piece>::iterator insert_dl_piece(download_queue_t queue
+			, downloading_piece const& dp);
+		void remove_dl_piece(download_queue_t queue
+			, std::vector<downloading_piece>::iterator i);
+
 		// returns an iterator to the downloading piece, whichever
 		// download list it may live in now
 		std::vector<downloading_piece>::iterator update_piece_state(
@@ -845,16 +882,22 @@ namespace libtorrent {
 
 		// each piece that's currently being downloaded has an entry in this list
 		// with block allocations. i.e. it says which parts of the piece that is
-		// being downloaded. This list is ordered by piece index to make lookups
-		// efficient there are as many buckets as there are piece states. See
-		// piece_pos::state_t. The only download state that does not have a
-		// corresponding downloading_piece vector is piece_open and
-		// piece_downloading_reverse (the latter uses the same as
+		// being downloaded. The lists are not ordered, a piece's position is
+		// tracked by m_dl_slot instead. There are as many buckets as there are
+		// piece states. See piece_pos::state_t. The only download state that
+		// does not have a corresponding downloading_piece vector is piece_open
+		// and piece_downloading_reverse (the latter uses the same as
 		// piece_downloading).
 		aux::array<aux::vector<downloading_piece>
 			, static_cast<std::uint8_t>(piece_pos::num_download_categories)
 			, download_queue_t> m_downloads;
 
+		// for every piece in one of the download queues, this is the index of
+		// its downloading_piece in m_downloads[queue]. Entries for pieces that
+		// aren't being downloaded are stale. Since the number of downloading
+		// pieces is bounded by downloading_piece::info_idx, 16 bits is enough
+		aux::vector<std::uint16_t, piece_index_t> m_dl_slot;
+
 		// this holds the information of the blocks in partially downloaded
 		// pieces. the downloading_piece::info index point into this vector for
 		// its storage
@@ -34,6 +34,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #define TORRENT_REQUEST_BLOCKS_HPP_INCLUDED
 
 #include "libtorrent/peer_info.hpp"
+#include "libtorrent/span.hpp"
+
+#include <vector>
 
 namespace libtorrent {
 
@@ -46,6 +49,16 @@ namespace libtorrent {
 	// amount of CPU
 	bool request_a_block(torrent& t, peer_connection& c);
 
+	// requests blocks from a number of peers of the same torrent. Peers that
+	// use plain rarest-first picking have their blocks picked in a single
+	// pass over the piece picker (piece_picker::pick_pieces_batch()). Other
+	// peers, and the ones that couldn't fill their request queue from the
+	// batch, fall back to request_a_block(). Returns the number of peers the
+	// piece picker was invoked for. If ``picked_peers`` is set, those peers
+	// are appended to it.
+	int request_blocks(torrent& t, span<peer_connection* const> peers
+		, std::vector<peer_connection*>* picked_peers = nullptr);
+
 	// returns the rank of a peer's source. We have an affinity
 	// to connecting to peers with higher rank. This is to avoid
 	// problems when our peer list is diluted by stale peers from
@@ -234,6 +234,10 @@ namespace libtorrent {
 		// This will cause a dht_stats_alert to be posted.
 		void post_dht_stats();
 
+		// This will cause a disk_latency_alert to be posted, with histograms
+		// of the time disk jobs have spent queued and executing.
+		void post_disk_latency();
+
 		// internal
 		io_context& get_context();
 
@@ -1015,7 +1019,15 @@ namespace libtorrent {
 		// The type of an alert is returned by the polymorphic function
 		// ``alert::type()`` but can also be queries from a concrete type via
 		// ``T::alert_type``, as a static constant.
+		//
+		// The overload taking a ``handler`` calls it once for every new alert,
+		// in the order they were posted, instead of filling in a vector. The
+		// handler is called from within ``pop_alerts``, in the calling thread.
+		// The same lifetime rules apply, the alerts stay valid until the next
+		// time ``pop_alerts`` is called. The handler may not call
+		// ``pop_alerts`` itself.
 		void pop_alerts(std::vector<alert*>* alerts);
+		void pop_alerts(std::function<void(alert*)> const& handler);
 		alert* wait_for_alert(time_duration max_wait);
 		void set_alert_notify(std::function<void()> const& fun);
 
@@ -387,6 +387,17 @@ namespace aux {
 			// effect until the DHT is restarted.
 			dht_bootstrap_nodes,
 
+			// if set to a path, the session stats counters are published in a
+			// memory mapped file at this path, every ``stats_export_interval``
+			// milliseconds. This lets an external process sample the counters
+			// at a high frequency, without the overhead of posting and popping
+			// session_stats_alert. The file is created (or truncated) when this
+			// setting is changed. Setting it to an empty string stops
+			// publishing. The file layout is described by
+			// ``aux::stats_export_header``; the values are indexed the same way
+			// as session_stats_alert::counters(), see session_stats_metrics().
+			stats_export_path,
+
 			max_string_setting_internal
 		};
 
@@ -1014,6 +1025,79 @@ namespace aux {
 			// protocol may not be valid from the proxy's point of view.
 			socks5_udp_send_local_ep,
 
+			// when true, UDP generic receive offload (GRO) is enabled on the
+			// UDP sockets, where supported (Linux). This lets the kernel
+			// deliver a train of uTP packets from the same peer as a single
+			// buffer, saving per-packet overhead when receiving at high rates.
+			// It requires larger receive buffers (512 kiB per UDP socket).
+			enable_udp_gro,
+
+			// when true, the v2 merkle trees of files we have all pieces of
+			// are collapsed to just the piece layer, dropping the block
+			// hashes. This saves 32 bytes of memory per 16 kiB block of
+			// seeded data. When a peer requests block hashes from a collapsed
+			// tree, the request is rejected and the block hashes of the
+			// requested pieces are recomputed from disk in the background, to
+			// be able to serve subsequent requests. Trees are collapsed again
+			// once their block hashes haven't been needed for a while.
+			compact_merkle_trees,
+
+			// when true, blocks uploaded to unencrypted, non-SSL TCP peers
+			// are sent straight out of the memory mapped file, rather than
+			// being copied into a disk buffer first. This saves a copy of
+			// every uploaded byte, and disk buffer pool space, when seeding.
+			// The disk thread makes sure the pages are resident before handing
+			// the block over. Only the default (mmap) disk I/O subsystem
+			// supports this, and only for files that are memory mapped.
+			zero_copy_send,
+
+			// when true, large writes to plain (non-SSL, non-uTP) TCP peers are
+			// sent with ``MSG_ZEROCOPY``. The kernel then transmits directly
+			// from the send buffers instead of copying them into socket
+			// buffers, and the send buffers are held on to until the kernel
+			// reports it's done with them. This saves CPU on fast links, but
+			// the bookkeeping makes it a loss for small writes, and on
+			// loopback. Only supported on Linux 4.14 and later.
+			msg_zerocopy_send,
+
+			// when true, the number of outstanding block requests to a peer is
+			// sized from an estimate of the bandwidth-delay product of the
+			// connection, rather than from ``request_queue_time``. The
+			// bandwidth and minimum round trip time are measured from the
+			// blocks received from the peer. This keeps the request queue just
+			// deep enough to keep the connection saturated, and converges
+			// within a few round trips, without the slow-start phase. The
+			// queue is still bounded by ``max_out_request_queue``.
+			bdp_request_queue,
+
+			// when true, the memory disk buffers are allocated from is locked
+			// in physical RAM (with ``mlock()``), never to be swapped out. The
+			// buffers are allocated in 2 MiB slabs, so this only costs a
+			// system call every 128 blocks. If the process is not allowed to
+			// lock that much memory, the buffers are left pageable.
+			lock_disk_buffers,
+
+			// when true, disk buffers and peer receive buffers are allocated
+			// from 2 MiB slabs backed by explicit huge pages (``MAP_HUGETLB``
+			// on Linux, large pages on Windows). A huge page takes a single TLB
+			// entry, which cuts down on TLB misses when copying blocks in and
+			// out of the buffers. The system must have huge pages reserved
+			// (``vm.nr_hugepages`` on Linux), otherwise regular pages are used.
+			// See the ``disk.disk_buffer_hugepage_slabs`` and
+			// ``disk.disk_buffer_hugepage_fallbacks`` counters.
+			hugepage_buffers,
+
+			// when true, the slabs disk buffers and peer receive buffers are
+			// allocated from are bound to the NUMA node of the network thread,
+			// which is the thread filling and draining them. This applies to
+			// disk read buffers too, even though they are allocated by disk
+			// threads. On machines with more than one NUMA node, this keeps
+			// the network thread from copying data into and out of remote
+			// memory. The node is determined when the setting is applied, if
+			// the network thread later migrates to another node, the buffers
+			// stay where they are. Only supported on Linux.
+			numa_local_buffers,
+
 			max_bool_setting_internal
 		};
 
@@ -2068,6 +2152,20 @@ namespace aux {
 			i2p_inbound_length,
 			i2p_outbound_length,
 
+			// the number of milliseconds between updates of the stats export
+			// file, see ``stats_export_path``.
+			stats_export_interval,
+
+			// when using mmap_disk_io, a disk thread picking up a write job
+			// also takes the queued write jobs for adjacent blocks of the same
+			// torrent, and writes them all with a single operation per file
+			// (one memcpy pass into the mapping, or one ``pwritev()``). This
+			// sets the maximum number of 16 kiB blocks written together.
+			// Set it to 1 to write every block on its own. Queued blocks are
+			// not held back waiting for neighbors, the runs form naturally
+			// when the disk can't keep up with the download.
+			write_coalesce_blocks,
+
 			max_int_setting_internal
 		};
 
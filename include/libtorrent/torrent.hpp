@@ -527,6 +527,11 @@ namespace libtorrent {
 
 		void second_tick(int tick_interval_ms);
 
+		// called by the session when the torrent's tick is due. Returns false
+		// if the torrent no longer wants to be ticked, in which case it's not
+		// scheduled again (until update_want_tick() schedules it)
+		bool tick_timer(int tick_interval_ms);
+
 		// see if we need to connect to web seeds, and if so,
 		// connect to them
 		void maybe_connect_web_seeds();
@@ -731,6 +736,16 @@ namespace libtorrent {
 		// decreased in the piece_picker
 		void remove_peer(std::shared_ptr<peer_connection> p) noexcept;
 
+		// refills the peer's request queue and sends the requests. The first
+		// peer to need a refill in a round of the message loop is served
+		// right away. Peers needing one later in the same round are queued,
+		// and handed to request_blocks() together at the end of the round,
+		// so they share a single pass over the piece picker. ``counter`` is
+		// the stats counter to increment if the piece picker was invoked for
+		// the peer. If the peer is already queued, its first counter is kept
+		void refill_requests(peer_connection* p, int counter);
+		void on_refill_requests();
+
 		// cancel requests to this block from any peer we're
 		// connected to on this torrent
 		void cancel_block(piece_block block);
@@ -748,13 +763,19 @@ namespace libtorrent {
 		void update_gauge();
 
 		bool try_connect_peer();
+
+		// called by the session once the reconnect timeout of our connect
+		// candidates has passed, to put the torrent back in line for
+		// connection attempts
+		void resume_connect_attempts();
+
 		torrent_peer* add_peer(tcp::endpoint const& adr
 			, peer_source_flags_t source, pex_flags_t flags = {});
 		bool ban_peer(torrent_peer* tp);
 		void update_peer_port(int port, torrent_peer* p, peer_source_flags_t src);
 		void set_seed(torrent_peer* p, bool s);
 		void clear_failcount(torrent_peer* p);
-		std::pair<peer_list::iterator, peer_list::iterator> find_peers(address const& a);
+		std::vector<torrent_peer*> find_peers(address const& a);
 
 		// the number of peers that belong to this torrent
 		int num_peers() const { return int(m_connections.size() - m_peers_to_disconnect.size()); }
@@ -1107,6 +1128,17 @@ namespace libtorrent {
 
 		hash_request pick_hashes(peer_connection* peer);
 		std::vector<sha256_hash> get_hashes(hash_request const& req) const;
+
+		// called when get_hashes() fails. If the request is for block hashes
+		// dropped by collapse_merkle_trees(), they are recomputed from disk
+		void rehydrate_hashes(hash_request const& req);
+
+		// collapses the merkle trees of files we have all pieces of to the
+		// piece layer, if settings_pack::compact_merkle_trees is enabled
+		void collapse_merkle_trees();
+		void on_hashes_rehydrated(aux::vector<sha256_hash> block_hashes
+			, piece_index_t piece, storage_error const& error);
+
 		bool add_hashes(hash_request const& req, span<sha256_hash> hashes);
 		void hashes_rejected(hash_request const& req);
 		void verify_block_hashes(piece_index_t index);
@@ -1443,6 +1475,16 @@ namespace libtorrent {
 		// v2 merkle tree for each file
 		aux::vector<aux::merkle_tree, file_index_t> m_merkle_trees;
 
+		// pieces whose block hashes are being recomputed from disk, to serve
+		// hash requests against collapsed merkle trees. See
+		// rehydrate_hashes()
+		std::vector<piece_index_t> m_rehydrating_pieces;
+
+		// the last time block hashes were recomputed. The merkle trees are
+		// collapsed again once they haven't been needed for a while
+		time_point32 m_last_rehydrate{seconds32(0)};
+		bool m_merkle_trees_rehydrated = false;
+
 		// the performance counters of this session
 		counters& m_stats_counters;
 
@@ -1550,6 +1592,12 @@ namespace libtorrent {
 		aux::deferred_handler m_deferred_disconnect;
 		aux::handler_storage<aux::deferred_handler_max_size, aux::defer_handler> m_deferred_handler_storage;
 
+		// peers waiting to have their request queues refilled, and whether
+		// on_refill_requests() has been posted for this round of the message
+		// loop. See refill_requests()
+		std::vector<peer_connection*> m_deferred_requests;
+		bool m_refill_posted = false;
+
 		// these are the peer IDs we've used for our outgoing peer connections for
 		// this torrent. If we get an incoming peer claiming to have one of these,
 		// it's a connection to ourself, and we should reject it.
@@ -1690,7 +1738,7 @@ namespace libtorrent {
 		// the number of unchoked peers in this torrent
 		unsigned int m_num_uploads:24;
 
-		// 4 unused bits
+		// 3 unused bits
 
 		// when this is true, this torrent supports peer exchange
 		bool m_enable_pex:1;
@@ -1711,6 +1759,10 @@ namespace libtorrent {
 		// TODO: this member can probably be removed
 		bool m_v2_piece_layers_validated:1;
 
+		// true while the session has a tick scheduled for this torrent. See
+		// tick_timer()
+		bool m_tick_scheduled:1;
+
 // ----
 
 		// this is set to the connect boost quota for this torrent.
@@ -1814,6 +1866,12 @@ namespace libtorrent {
 		// prevent us from sending it again to anyone
 		bool m_complete_sent:1;
 
+		// set when the last connection attempt found that all our connect
+		// candidates are waiting out their reconnect timeout. While set, we
+		// don't want peers, to keep us out of the session's connect
+		// round-robin. The session clears it once the timeout has passed
+		bool m_connects_deferred:1;
+
 #if TORRENT_USE_ASSERTS
 		// set to true when torrent is start()ed. It may only be started once
 		bool m_was_started = false;
@@ -35,10 +35,21 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/config.hpp"
 #include "libtorrent/torrent_peer.hpp"
-#include "libtorrent/aux_/pool.hpp"
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
 
 namespace libtorrent {
 
+	// torrent_peer entries are referred to by 32 bit handles rather than by
+	// pointers where they are stored in bulk, like in the peer_list. The
+	// entries are allocated from slabs of a fixed number of entries of the
+	// same type. The top two bits of a handle are the type, the following
+	// bits are the slab and the lowest bits the entry within the slab.
+	using peer_handle = std::uint32_t;
+
 	struct TORRENT_EXTRA_EXPORT torrent_peer_allocator_interface
 	{
 		enum peer_type_t
@@ -48,23 +59,60 @@ namespace libtorrent {
 			i2p_peer_type
 		};
 
-		virtual torrent_peer* allocate_peer_entry(int type) = 0;
-		virtual void free_peer_entry(torrent_peer* p) = 0;
+		static constexpr peer_handle invalid_handle = 0xffffffff;
+
+		// returns the handle of an entry large enough for a peer of the
+		// specified type, or invalid_handle if we're out of memory. The
+		// caller is expected to construct the peer in place
+		virtual peer_handle allocate_peer_entry(int type) = 0;
+
+		// destructs the peer and frees its entry
+		virtual void free_peer_entry(peer_handle h) = 0;
+
+		// the peer a handle refers to. It stays at the same address for as
+		// long as it's allocated
+		torrent_peer* peer_at(peer_handle const h) const
+		{
+			TORRENT_ASSERT(h != invalid_handle);
+			slab_list const& l = m_types[h >> type_shift];
+			return reinterpret_cast<torrent_peer*>(
+				l.slabs[(h & ~type_mask) >> slab_shift]
+				+ std::size_t(h & entry_mask) * l.entry_size);
+		}
+
 	protected:
+
 		~torrent_peer_allocator_interface() {}
+
+		static constexpr int slab_shift = 10;
+		static constexpr int slab_entries = 1 << slab_shift;
+		static constexpr int type_shift = 30;
+		static constexpr peer_handle entry_mask = slab_entries - 1;
+		static constexpr peer_handle type_mask = 3u << type_shift;
+
+		// the slabs of all peer entries of one type
+		struct slab_list
+		{
+			std::vector<char*> slabs;
+			std::size_t entry_size = 0;
+
+			// free entries are linked through their first bytes
+			peer_handle free_list = invalid_handle;
+		};
+
+		std::array<slab_list, 3> m_types;
 	};
 
 	struct TORRENT_EXTRA_EXPORT torrent_peer_allocator final
 		: torrent_peer_allocator_interface
 	{
-#if TORRENT_USE_ASSERTS
-		~torrent_peer_allocator() {
-			m_in_use = false;
-		}
-#endif
+		torrent_peer_allocator();
+		~torrent_peer_allocator();
+		torrent_peer_allocator(torrent_peer_allocator const&) = delete;
+		torrent_peer_allocator& operator=(torrent_peer_allocator const&) = delete;
 
-		torrent_peer* allocate_peer_entry(int type) override;
-		void free_peer_entry(torrent_peer* p) override;
+		peer_handle allocate_peer_entry(int type) override;
+		void free_peer_entry(peer_handle h) override;
 
 		std::uint64_t total_bytes() const { return m_total_bytes; }
 		std::uint64_t total_allocations() const { return m_total_allocations; }
@@ -73,16 +121,10 @@ namespace libtorrent {
 
 	private:
 
-		// this is a shared pool where torrent_peer objects
-		// are allocated. It's a pool since we're likely
-		// to have tens of thousands of peers, and a pool
-		// saves significant overhead
-
-		aux::pool m_ipv4_peer_pool{sizeof(libtorrent::ipv4_peer), 500};
-		aux::pool m_ipv6_peer_pool{sizeof(libtorrent::ipv6_peer), 500};
-#if TORRENT_USE_I2P
-		aux::pool m_i2p_peer_pool{sizeof(libtorrent::i2p_peer), 500};
-#endif
+		// we're likely to have tens of thousands of peers. Packing them into
+		// slabs saves the per allocation overhead of the heap, and keeps
+		// peers added around the same time next to each other in memory
+		bool add_slab(int type);
 
 		// the total number of bytes allocated (cumulative)
 		std::uint64_t m_total_bytes = 0;
@@ -46,6 +46,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/resolver_interface.hpp"
 
 #include <array>
+#include <functional>
 #include <memory>
 
 namespace libtorrent {
@@ -59,6 +60,7 @@ namespace aux { struct alert_manager; }
 	{
 	public:
 		udp_socket(io_context& ios, aux::listen_socket_handle ls);
+		~udp_socket();
 
 		// non-copyable
 		udp_socket(udp_socket const&) = delete;
@@ -92,6 +94,12 @@ namespace aux { struct alert_manager; }
 			error_code error;
 		};
 
+		// receives up to ``pkts.size()`` datagrams. On systems supporting
+		// recvmmsg(), as many datagrams as are available (up to
+		// max_batch_size) are received in a single system call. With GRO
+		// enabled, coalesced datagrams are split back up into their segments.
+		// The packets refer to internal buffers, which are valid until the
+		// next call to read().
 		int read(span<packet> pkts, error_code& ec);
 
 		// this is only valid when using a socks5 proxy
@@ -100,6 +108,42 @@ namespace aux { struct alert_manager; }
 
 		void send(udp::endpoint const& ep, span<char const> p
 			, error_code& ec, udp_send_flags_t flags = {});
+
+		// while the socket is corked, datagrams passed to send() are queued up
+		// rather than sent immediately. When the socket is uncorked (or the
+		// queue fills up) they are all passed on to the kernel in a single
+		// sendmmsg() call. Runs of equally sized datagrams to the same
+		// endpoint are coalesced into a single UDP_SEGMENT (GSO) send, if
+		// supported. This is used to batch up the packets sent in response to
+		// a burst of incoming packets, by the uTP tick and by a uTP socket
+		// filling its congestion window. Calls may be nested, the queue is
+		// flushed when the outermost uncork() is called. On systems without
+		// sendmmsg(), these are no-ops.
+		void cork();
+		void uncork(error_code& ec);
+
+		// attempts to send datagrams still queued up from a previous uncork()
+		// that failed with EAGAIN. If the send buffer fills up again, ``ec``
+		// is set to would_block. This should be called once the socket is
+		// writable again.
+		void flush(error_code& ec);
+
+		// datagrams queued up while the socket is corked are not sent until
+		// after send() has returned, so errors sending them can't be
+		// reported through its error_code. Instead, this handler is called
+		// with the destination, size and error of each such datagram that
+		// could not be sent (other than for a full send buffer).
+		using send_error_handler = std::function<void(udp::endpoint const&
+			, int, error_code const&)>;
+		void set_send_error_handler(send_error_handler h)
+		{ m_send_error = std::move(h); }
+
+		// enables or disables UDP generic receive offload (UDP_GRO) on the
+		// socket. With GRO enabled the kernel may deliver a train of
+		// datagrams from the same sender as a single buffer, which requires
+		// larger receive buffers. If not supported, ``ec`` is set.
+		void set_gro(bool enable, error_code& ec);
+
 		void open(udp const& protocol, error_code& ec);
 		void bind(udp::endpoint const& ep, error_code& ec);
 		void close();
@@ -147,8 +191,19 @@ namespace aux { struct alert_manager; }
 
 		bool active_socks5() const;
 
+#if TORRENT_HAS_MMSG
+		static constexpr int max_batch_size = 32;
+#else
+		static constexpr int max_batch_size = 1;
+#endif
+
 	private:
 
+		int receive(span<packet> pkts, error_code& ec);
+#if TORRENT_HAS_MMSG
+		bool queue_packet(udp::endpoint const& ep, span<char const> p, error_code& ec);
+#endif
+
 		void wrap(udp::endpoint const& ep, span<char const> p, error_code& ec, udp_send_flags_t flags);
 		void wrap(char const* hostname, int port, span<char const> p, error_code& ec, udp_send_flags_t flags);
 		bool unwrap(udp_socket::packet& pack);
@@ -157,8 +212,21 @@ namespace aux { struct alert_manager; }
 
 		io_context& m_ioc;
 
-		using receive_buffer = std::array<char, 1500>;
+		static constexpr int max_datagram_size = 1500;
+
+		// the buffers datagrams are received into, and the datagrams received
+		// by the last system call not yet returned by read()
+		struct receive_buffer;
 		std::unique_ptr<receive_buffer> m_buf;
+
+#if TORRENT_HAS_MMSG
+		// datagrams queued up while the socket is corked. This is allocated
+		// the first time the socket is corked
+		struct send_queue;
+		std::unique_ptr<send_queue> m_send_queue;
+#endif
+		send_error_handler m_send_error;
+
 		aux::listen_socket_handle m_listen_socket;
 
 		std::uint16_t m_bind_port;
@@ -168,6 +236,16 @@ namespace aux { struct alert_manager; }
 		std::shared_ptr<socks5> m_socks5_connection;
 
 		bool m_abort:1;
+
+		// true if the kernel supports UDP_SEGMENT on this socket
+		bool m_gso:1;
+
+		// true if UDP_GRO is enabled on this socket
+		bool m_gro:1;
+
+		// the number of outstanding calls to cork(). While this is non-zero,
+		// send() is queuing up datagrams
+		std::uint8_t m_cork_depth;
 	};
 }
 
@@ -60,6 +60,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/socket_type.hpp"
 #include "libtorrent/peer_info.hpp"
 #include "libtorrent/aux_/ip_helpers.hpp" // for is_v4
+#include "libtorrent/aux_/latency_histogram.hpp"
 
 #if TORRENT_ABI_VERSION == 1
 #include "libtorrent/write_resume_data.hpp"
@@ -3025,7 +3026,7 @@ namespace {
 		"block_uploaded", "alerts_dropped", "socks5",
 		"file_prio", "oversized_file", "torrent_conflict",
 		"peer_info", "file_progress", "piece_info",
-		"piece_availability", "tracker_list"
+		"piece_availability", "tracker_list", "disk_latency"
 		}};
 
 		TORRENT_ASSERT(alert_type >= 0);
@@ -3189,6 +3190,49 @@ namespace {
 #endif
 	}
 
+	disk_latency_alert::disk_latency_alert(aux::stack_allocator&
+		, std::vector<disk_job_latency> j)
+		: jobs(std::move(j))
+	{}
+
+	std::string disk_latency_alert::message() const
+	{
+#ifdef TORRENT_DISABLE_ALERT_MSG
+		return {};
+#else
+		std::string ret = "disk latency (us, p50/p99/p99.9)";
+		for (auto const& j : jobs)
+		{
+			std::int64_t total = 0;
+			for (auto const c : j.exec_time) total += c;
+			if (total == 0) continue;
+
+			char buf[300];
+			std::snprintf(buf, sizeof(buf), " %s: [ jobs: %" PRId64
+				" queue: %" PRId64 "/%" PRId64 "/%" PRId64
+				" exec: %" PRId64 "/%" PRId64 "/%" PRId64 " ]"
+				, j.job, total
+				, percentile(j.queue_time, 0.5), percentile(j.queue_time, 0.99)
+				, percentile(j.queue_time, 0.999)
+				, percentile(j.exec_time, 0.5), percentile(j.exec_time, 0.99)
+				, percentile(j.exec_time, 0.999));
+			ret += buf;
+		}
+		return ret;
+#endif
+	}
+
+	std::int64_t disk_latency_alert::bucket_floor(int const bucket)
+	{
+		return aux::latency_bucket_floor(bucket);
+	}
+
+	std::int64_t disk_latency_alert::percentile(span<std::int64_t const> const histogram
+		, double const p)
+	{
+		return aux::latency_percentile(histogram, p);
+	}
+
 	// this will no longer be necessary in C++17
 	constexpr alert_category_t torrent_removed_alert::static_category;
 	constexpr alert_category_t read_piece_alert::static_category;
@@ -3288,6 +3332,7 @@ namespace {
 	constexpr alert_category_t piece_info_alert::static_category;
 	constexpr alert_category_t piece_availability_alert::static_category;
 	constexpr alert_category_t tracker_list_alert::static_category;
+	constexpr alert_category_t disk_latency_alert::static_category;
 #if TORRENT_ABI_VERSION == 1
 	constexpr alert_category_t anonymous_mode_alert::static_category;
 	constexpr alert_category_t mmap_cache_alert::static_category;
@@ -37,6 +37,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/alert_manager.hpp"
 #include "libtorrent/alert_types.hpp"
 
+#include <array>
+
 #ifndef TORRENT_DISABLE_EXTENSIONS
 #include "libtorrent/extensions.hpp"
 #include <memory> // for shared_ptr
@@ -52,25 +54,54 @@ namespace aux {
 
 	alert_manager::~alert_manager() = default;
 
+	int alert_manager::queue_index()
+	{
+		// threads are assigned queues round-robin, the first time they post
+		// an alert
+		static std::atomic<int> next_queue{0};
+		thread_local int const idx
+			= next_queue.fetch_add(1, std::memory_order_relaxed) % num_queues;
+		return idx;
+	}
+
 	alert* alert_manager::wait_for_alert(time_duration max_wait)
 	{
-		std::unique_lock<std::recursive_mutex> lock(m_mutex);
+		{
+			std::unique_lock<std::recursive_mutex> lock(m_mutex);
 
-		if (!m_alerts[m_generation].empty())
-			return m_alerts[m_generation].front();
+			if (m_num_queued.load(std::memory_order_acquire) == 0)
+			{
+				// this call can be interrupted prematurely by other signals
+				m_condition.wait_for(lock, max_wait);
+			}
+		}
 
-		// this call can be interrupted prematurely by other signals
-		m_condition.wait_for(lock, max_wait);
-		if (!m_alerts[m_generation].empty())
-			return m_alerts[m_generation].front();
+		// the thread_queue mutexes may not be acquired while holding m_mutex
+		return front();
+	}
 
-		return nullptr;
+	alert* alert_manager::front()
+	{
+		alert* ret = nullptr;
+		std::uint64_t ret_seq = 0;
+		for (auto& q : m_queues)
+		{
+			std::lock_guard<std::recursive_mutex> lock(q.mutex);
+			auto const& seq = q.sequence[q.generation];
+			if (seq.empty()) continue;
+			if (ret != nullptr && seq.front() >= ret_seq) continue;
+			ret = q.alerts[q.generation].front();
+			ret_seq = seq.front();
+		}
+		return ret;
 	}
 
-	void alert_manager::maybe_notify(alert* a)
+	void alert_manager::maybe_notify(alert* a, bool const first)
 	{
-		if (m_alerts[m_generation].size() == 1)
+		if (first)
 		{
+			std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
 			// we just posted to an empty queue. If anyone is waiting for
 			// alerts, we need to notify them. Also (potentially) call the
 			// user supplied m_notify callback to let the client wake up its
@@ -94,7 +125,7 @@ namespace aux {
 	{
 		std::unique_lock<std::recursive_mutex> lock(m_mutex);
 		m_notify = fun;
-		if (!m_alerts[m_generation].empty())
+		if (m_num_queued.load(std::memory_order_acquire) > 0)
 		{
 			if (m_notify) m_notify();
 		}
@@ -107,42 +138,89 @@ namespace aux {
 	}
 #endif
 
-	void alert_manager::get_all(std::vector<alert*>& alerts)
+	template <typename Fun>
+	void alert_manager::drain(Fun f)
 	{
-		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		std::lock_guard<std::mutex> client_lock(m_client_mutex);
 
-		if (m_alerts[m_generation].empty())
+		if (m_num_queued.load(std::memory_order_acquire) == 0) return;
+
+		std::bitset<abi_alert_count> dropped;
+		for (auto& q : m_queues)
+		{
+			std::lock_guard<std::recursive_mutex> lock(q.mutex);
+			dropped |= q.dropped;
+			q.dropped.reset();
+		}
+		if (dropped.any()) emplace_alert<alerts_dropped_alert>(dropped);
+
+		struct cursor
+		{
+			heterogeneous_queue<alert>::iterator it;
+			heterogeneous_queue<alert>::iterator end;
+			std::uint64_t const* seq;
+		};
+		std::array<cursor, num_queues> cursors;
+		int num_cursors = 0;
+
+		for (auto& q : m_queues)
 		{
-			alerts.clear();
-			return;
+			std::lock_guard<std::recursive_mutex> lock(q.mutex);
+
+			// swap buffers. This is done for empty queues too, to release the
+			// alerts handed out by the previous call
+			int const gen = q.generation;
+			q.generation = (gen + 1) & 1;
+			// clear the one we will start writing to now
+			q.alerts[q.generation].clear();
+			q.allocations[q.generation].reset();
+			q.sequence[q.generation].clear();
+
+			auto& queue = q.alerts[gen];
+			if (queue.empty()) continue;
+			m_num_queued.fetch_sub(queue.size(), std::memory_order_acq_rel);
+			cursors[std::size_t(num_cursors++)] = cursor{queue.begin(), queue.end()
+				, q.sequence[gen].data()};
 		}
 
-		if (m_dropped.any()) {
-			emplace_alert<alerts_dropped_alert>(m_dropped);
-			m_dropped.reset();
+		// the alerts in each queue are in order. Merge them to deliver all
+		// alerts in the order they were posted
+		while (num_cursors > 0)
+		{
+			int best = 0;
+			for (int i = 1; i < num_cursors; ++i)
+			{
+				if (*cursors[std::size_t(i)].seq < *cursors[std::size_t(best)].seq)
+					best = i;
+			}
+			cursor& c = cursors[std::size_t(best)];
+			f(*c.it);
+			++c.it;
+			++c.seq;
+			if (c.it == c.end)
+				c = cursors[std::size_t(--num_cursors)];
 		}
+	}
 
-		m_alerts[m_generation].get_pointers(alerts);
+	void alert_manager::get_all(std::vector<alert*>& alerts)
+	{
+		alerts.clear();
+		drain([&alerts](alert* a) { alerts.push_back(a); });
+	}
 
-		// swap buffers
-		m_generation = (m_generation + 1) & 1;
-		// clear the one we will start writing to now
-		m_alerts[m_generation].clear();
-		m_allocations[m_generation].reset();
+	void alert_manager::get_all(std::function<void(alert*)> const& handler)
+	{
+		drain(handler);
 	}
 
 	bool alert_manager::pending() const
 	{
-		std::lock_guard<std::recursive_mutex> lock(m_mutex);
-		return !m_alerts[m_generation].empty();
+		return m_num_queued.load(std::memory_order_acquire) > 0;
 	}
 
-	int alert_manager::set_alert_queue_size_limit(int queue_size_limit_)
+	int alert_manager::set_alert_queue_size_limit(int const queue_size_limit_)
 	{
-		std::lock_guard<std::recursive_mutex> lock(m_mutex);
-
-		std::swap(m_queue_size_limit, queue_size_limit_);
-		return queue_size_limit_;
+		return m_queue_size_limit.exchange(queue_size_limit_);
 	}
 }
 }
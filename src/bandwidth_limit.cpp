@@ -40,8 +40,7 @@ namespace libtorrent {
 namespace aux {
 
 	bandwidth_channel::bandwidth_channel()
-		: tmp(0)
-		, distribute_quota(0)
+		: distribute_quota(0)
 		, m_quota_left(0)
 		, m_limit(0)
 	{}
@@ -34,6 +34,8 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/aux_/bandwidth_manager.hpp"
 
+#include <algorithm>
+
 #if TORRENT_USE_ASSERTS
 #include <climits>
 #endif
@@ -53,7 +55,19 @@ namespace aux {
 		m_abort = true;
 
 		std::vector<bw_request> queue;
-		queue.swap(m_queue);
+		for (auto& r : m_queue)
+		{
+			if (!r.req.peer) continue;
+			unpark(r);
+			r.req.assigned += settle(r);
+			queue.push_back(std::move(r.req));
+		}
+		m_queue.clear();
+		m_free_slots.clear();
+		m_channels.clear();
+		m_expiry.clear();
+		m_ready.clear();
+		m_queue_size = 0;
 		m_queued_bytes = 0;
 
 		while (!queue.empty())
@@ -69,7 +83,7 @@ namespace aux {
 	{
 		for (auto const& r : m_queue)
 		{
-			if (r.peer.get() == peer) return true;
+			if (r.req.peer.get() == peer) return true;
 		}
 		return false;
 	}
@@ -77,7 +91,7 @@ namespace aux {
 
 	int bandwidth_manager::queue_size() const
 	{
-		return int(m_queue.size());
+		return m_queue_size;
 	}
 
 	std::int64_t bandwidth_manager::queued_bytes() const
@@ -120,99 +134,270 @@ namespace aux {
 
 		if (k == 0) return blk;
 
+		int slot;
+		if (m_free_slots.empty())
+		{
+			slot = int(m_queue.size());
+			m_queue.emplace_back(std::move(bwr));
+		}
+		else
+		{
+			slot = m_free_slots.back();
+			m_free_slots.pop_back();
+			m_queue[slot] = queued_request(std::move(bwr));
+		}
+
+		queued_request& r = m_queue[slot];
+		r.need = blk;
+		r.id = ++m_serial;
+		for (int j = 0; j < k; ++j)
+		{
+			channel_state& s = m_channels[r.req.channel[j]];
+			TORRENT_ASSERT(INT_MAX - s.weight > priority);
+			s.weight += priority;
+			r.state[j] = &s;
+			r.start[j] = s.virtual_time;
+		}
+
+		m_expiry.push_back({m_round + r.req.ttl, slot, r.id});
+		if (!park(slot)) m_ready.push_back(slot);
+
+		++m_queue_size;
 		m_queued_bytes += blk;
-		m_queue.push_back(std::move(bwr));
 		return 0;
 	}
 
+	void bandwidth_manager::cancel_request(bandwidth_socket const* peer)
+	{
+		INVARIANT_CHECK;
+
+		auto const i = std::find_if(m_queue.begin(), m_queue.end()
+			, [peer](queued_request const& r) { return r.req.peer.get() == peer; });
+		if (i == m_queue.end()) return;
+		TORRENT_ASSERT(peer->is_disconnecting());
+
+		int const slot = int(i - m_queue.begin());
+		unpark(*i);
+		int const amount = settle(*i);
+		TORRENT_ASSERT(amount == 0);
+		TORRENT_UNUSED(amount);
+
+		auto const ready = std::find(m_ready.begin(), m_ready.end(), slot);
+		if (ready != m_ready.end()) m_ready.erase(ready);
+
+		m_queued_bytes -= i->req.request_size - i->req.assigned;
+		i->req.peer.reset();
+		i->id = 0;
+		m_free_slots.push_back(slot);
+		--m_queue_size;
+	}
+
+	bool bandwidth_manager::park(int const slot)
+	{
+		queued_request& r = m_queue[slot];
+		TORRENT_ASSERT(r.parked == -1);
+		for (int j = 0; j < bw_request::max_bandwidth_channels && r.req.channel[j]; ++j)
+		{
+			if (r.req.channel[j]->throttle() == 0) continue;
+			channel_state& s = *r.state[j];
+			double const tag = r.start[j] + double(r.need) / r.req.priority;
+			if (s.virtual_time >= tag) continue;
+
+			r.parked = j;
+			r.ticket = ++m_serial;
+			s.waiting.push_back({tag, slot, r.ticket});
+			std::push_heap(s.waiting.begin(), s.waiting.end());
+			return true;
+		}
+		return false;
+	}
+
+	void bandwidth_manager::unpark(queued_request& r)
+	{
+		if (r.parked == -1) return;
+		channel_state& s = *r.state[r.parked];
+		r.parked = -1;
+		r.ticket = 0;
+		++s.stale;
+		if (s.stale > 16 && s.stale > int(s.waiting.size()) / 2) prune(s);
+	}
+
+	void bandwidth_manager::prune(channel_state& s)
+	{
+		s.waiting.erase(std::remove_if(s.waiting.begin(), s.waiting.end()
+			, [this](channel_state::waiter const& w)
+			{ return m_queue[w.slot].ticket != w.ticket; })
+			, s.waiting.end());
+		std::make_heap(s.waiting.begin(), s.waiting.end());
+		s.stale = 0;
+	}
+
+	int bandwidth_manager::settle(queued_request& r)
+	{
+		TORRENT_ASSERT(r.parked == -1);
+		int const remaining = r.req.request_size - r.req.assigned;
+		TORRENT_ASSERT(r.need <= remaining);
+		int const priority = r.req.priority;
+		int const num_channels = int(std::find(r.req.channel.begin()
+			, r.req.channel.end(), nullptr) - r.req.channel.begin());
+
+		// the number of bytes each channel has handed out to this request,
+		// or -1 for channels that aren't rate limited
+		std::int64_t earned[bw_request::max_bandwidth_channels];
+		int amount = r.req.peer->is_disconnecting() ? 0 : remaining;
+		for (int j = 0; j < num_channels; ++j)
+		{
+			earned[j] = -1;
+			if (r.req.channel[j]->throttle() == 0) continue;
+			channel_state const& s = *r.state[j];
+			earned[j] = std::int64_t((s.virtual_time - r.start[j]) * priority);
+			// this is the same test park() makes. Rounding errors in the above
+			// must not hold back a request that's been let through
+			if (s.virtual_time >= r.start[j] + double(r.need) / priority)
+				earned[j] = std::max(earned[j], std::int64_t(r.need));
+			amount = int(std::min(std::int64_t(amount), earned[j]));
+		}
+
+		for (int j = 0; j < num_channels; ++j)
+		{
+			bandwidth_channel* ch = r.req.channel[j];
+			if (earned[j] > amount)
+			{
+				ch->return_quota(int(std::min(earned[j] - amount
+					, std::int64_t(bandwidth_channel::inf))));
+			}
+
+			channel_state& s = *r.state[j];
+			s.weight -= priority;
+			TORRENT_ASSERT(s.weight >= 0);
+			if (s.weight == 0)
+			{
+				TORRENT_ASSERT(int(s.waiting.size()) == s.stale);
+				m_channels.erase(ch);
+			}
+		}
+		return amount;
+	}
+
 #if TORRENT_USE_INVARIANT_CHECKS
 	void bandwidth_manager::check_invariant() const
 	{
 		std::int64_t queued = 0;
+		int num_queued = 0;
+		std::unordered_map<bandwidth_channel const*, int> weights;
 		for (auto const& r : m_queue)
 		{
-			queued += r.request_size - r.assigned;
+			if (!r.req.peer) continue;
+			++num_queued;
+			queued += r.req.request_size - r.req.assigned;
+			for (int j = 0; j < bw_request::max_bandwidth_channels && r.req.channel[j]; ++j)
+			{
+				TORRENT_ASSERT(r.state[j] == &m_channels.find(r.req.channel[j])->second);
+				weights[r.req.channel[j]] += r.req.priority;
+			}
 		}
 		TORRENT_ASSERT(queued == m_queued_bytes);
+		TORRENT_ASSERT(num_queued == m_queue_size);
+		TORRENT_ASSERT(weights.size() == m_channels.size());
+		for (auto const& c : m_channels)
+			TORRENT_ASSERT(c.second.weight == weights[c.first]);
 	}
 #endif
 
+	// every round, each channel with requests queued on it is refilled and
+	// hands out its quota. Only the requests whose channels have handed out
+	// all the bytes they asked for, or whose ttl ran out, are visited
 	void bandwidth_manager::update_quotas(time_duration const& dt)
 	{
 		if (m_abort) return;
-		if (m_queue.empty()) return;
+		if (m_queue_size == 0) return;
 
 		INVARIANT_CHECK;
 
 		std::int64_t dt_milliseconds = total_milliseconds(dt);
 		if (dt_milliseconds > 3000) dt_milliseconds = 3000;
 
-		// for each bandwidth channel, call update_quota(dt)
+		++m_round;
 
-		std::vector<bandwidth_channel*> channels;
-
-		std::vector<bw_request> queue;
+		for (auto& c : m_channels)
+		{
+			bandwidth_channel* ch = c.first;
+			if (ch->throttle() == 0) continue;
+			ch->update_quota(int(dt_milliseconds));
+			int const quota = ch->distribute_quota;
+			if (quota == 0) continue;
+			ch->use_quota(quota);
+			c.second.virtual_time += double(quota) / c.second.weight;
+		}
 
-		for (auto i = m_queue.begin(); i != m_queue.end();)
+		// requests parked on a channel that has now handed out what they
+		// need move on to their next channel, or are dispatched
+		for (auto& c : m_channels)
 		{
-			if (i->peer->is_disconnecting())
+			channel_state& s = c.second;
+			bool const unlimited = c.first->throttle() == 0;
+			while (!s.waiting.empty()
+				&& (unlimited || s.waiting.front().tag <= s.virtual_time))
 			{
-				m_queued_bytes -= i->request_size - i->assigned;
-
-				// return all assigned quota to all the
-				// bandwidth channels this peer belongs to
-				for (int j = 0; j < bw_request::max_bandwidth_channels && i->channel[j]; ++j)
+				std::pop_heap(s.waiting.begin(), s.waiting.end());
+				channel_state::waiter const w = s.waiting.back();
+				s.waiting.pop_back();
+				queued_request& r = m_queue[w.slot];
+				if (r.ticket != w.ticket)
 				{
-					bandwidth_channel* bwc = i->channel[j];
-					bwc->return_quota(i->assigned);
+					--s.stale;
+					continue;
 				}
-
-				i->assigned = 0;
-				queue.push_back(std::move(*i));
-				i = m_queue.erase(i);
-				continue;
-			}
-			for (int j = 0; j < bw_request::max_bandwidth_channels && i->channel[j]; ++j)
-			{
-				bandwidth_channel* bwc = i->channel[j];
-				bwc->tmp = 0;
+				r.parked = -1;
+				r.ticket = 0;
+				if (!park(w.slot)) m_ready.push_back(w.slot);
 			}
-			++i;
 		}
 
-		for (auto const& r : m_queue)
+		while (!m_expiry.empty() && m_expiry.front().round <= m_round)
 		{
-			for (int j = 0; j < bw_request::max_bandwidth_channels && r.channel[j]; ++j)
+			expiry const e = m_expiry.front();
+			m_expiry.pop_front();
+			queued_request& r = m_queue[e.slot];
+			if (r.id != e.id || r.parked == -1) continue;
+
+			// the request has run out of time. Dispatch it with whatever
+			// its channels have given it, as long as that's something
+			bool has_quota = true;
+			for (int j = 0; j < bw_request::max_bandwidth_channels && r.req.channel[j]; ++j)
 			{
-				bandwidth_channel* bwc = r.channel[j];
-				if (bwc->tmp == 0) channels.push_back(bwc);
-				TORRENT_ASSERT(INT_MAX - bwc->tmp > r.priority);
-				bwc->tmp += r.priority;
+				if (r.req.channel[j]->throttle() == 0) continue;
+				if ((r.state[j]->virtual_time - r.start[j]) * r.req.priority < 1.)
+				{
+					has_quota = false;
+					break;
+				}
 			}
-		}
 
-		for (auto const& ch : channels)
-		{
-			ch->update_quota(int(dt_milliseconds));
+			unpark(r);
+			if (!has_quota && !r.req.peer->is_disconnecting())
+			{
+				r.need = 1;
+				if (park(e.slot)) continue;
+			}
+			m_ready.push_back(e.slot);
 		}
 
-		for (auto i = m_queue.begin(); i != m_queue.end();)
+		std::vector<bw_request> queue;
+		for (int const slot : m_ready)
 		{
-			int a = i->assign_bandwidth();
-			if (i->assigned == i->request_size
-				|| (i->ttl <= 0 && i->assigned > 0))
-			{
-				a += i->request_size - i->assigned;
-				TORRENT_ASSERT(i->assigned <= i->request_size);
-				queue.push_back(std::move(*i));
-				i = m_queue.erase(i);
-			}
-			else
-			{
-				++i;
-			}
-			m_queued_bytes -= a;
+			queued_request& r = m_queue[slot];
+			int const a = settle(r);
+			m_queued_bytes -= r.req.request_size - r.req.assigned;
+			r.req.assigned += a;
+			TORRENT_ASSERT(r.req.assigned <= r.req.request_size);
+			queue.push_back(std::move(r.req));
+			r.req.peer.reset();
+			r.id = 0;
+			m_free_slots.push_back(slot);
+			--m_queue_size;
 		}
+		m_ready.clear();
 
 		while (!queue.empty())
 		{
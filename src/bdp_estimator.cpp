@@ -0,0 +1,141 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "libtorrent/aux_/bdp_estimator.hpp"
+#include "libtorrent/assert.hpp"
+
+#include <algorithm>
+
+namespace libtorrent {
+namespace aux {
+
+namespace {
+
+	// how long a minimum round trip time is trusted, before it is measured
+	// again
+	constexpr time_duration min_rtt_window = seconds(10);
+
+	// the shortest time a probe lasts
+	constexpr time_duration min_probe_time = milliseconds(200);
+}
+
+	void bdp_estimator::on_block(time_point const now, time_duration const rtt
+		, std::int64_t const delivered)
+	{
+		if (rtt <= time_duration::zero() || delivered <= 0) return;
+
+		std::int64_t const us = total_microseconds(rtt);
+		update_bandwidth(now, std::max(std::int64_t(1), delivered * 1000000 / us));
+
+		if (m_probe_rtt)
+		{
+			m_probe_min = std::min(m_probe_min, rtt);
+			if (now < m_probe_end) return;
+			m_probe_rtt = false;
+			m_min_rtt = m_probe_min;
+			m_min_rtt_stamp = now;
+		}
+		else if (rtt <= m_min_rtt)
+		{
+			m_min_rtt = rtt;
+			m_min_rtt_stamp = now;
+		}
+		else if (now - m_min_rtt_stamp > min_rtt_window)
+		{
+			// the blocks requested after this point only queue behind the pipe
+			// worth of requests. They arrive within a couple of round trips of
+			// the current, inflated, one
+			m_probe_rtt = true;
+			m_probe_min = rtt;
+			m_probe_end = now + std::max(min_probe_time, rtt * 2);
+		}
+	}
+
+	std::int64_t bdp_estimator::target_outstanding() const
+	{
+		if (!has_estimate() || m_min_rtt == time_duration::max()) return 0;
+		std::int64_t const bdp = bandwidth() * total_microseconds(m_min_rtt) / 1000000;
+		return m_probe_rtt ? bdp : bdp * 2;
+	}
+
+	// this is the windowed max filter by Kathleen Nichols, as used by BBR. It
+	// tracks the max over the window with three samples, rather than
+	// remembering all of them
+	void bdp_estimator::update_bandwidth(time_point const now, std::int64_t const bw)
+	{
+		// the bandwidth window is 10 round trips, but no less than a second,
+		// to be robust against bursts
+		time_duration const window = m_min_rtt == time_duration::max()
+			? seconds(1)
+			: std::max(time_duration(seconds(1)), m_min_rtt * 10);
+
+		sample const s{now, bw};
+		if (bw >= m_bw[0].value || now - m_bw[2].time > window)
+		{
+			m_bw.fill(s);
+			return;
+		}
+
+		if (bw >= m_bw[1].value)
+			m_bw[2] = m_bw[1] = s;
+		else if (bw >= m_bw[2].value)
+			m_bw[2] = s;
+
+		time_duration const age = now - m_bw[0].time;
+		if (age > window)
+		{
+			// the best sample expired, promote the next ones
+			m_bw[0] = m_bw[1];
+			m_bw[1] = m_bw[2];
+			m_bw[2] = s;
+			if (now - m_bw[0].time > window)
+			{
+				m_bw[0] = m_bw[1];
+				m_bw[1] = m_bw[2];
+			}
+		}
+		else if (m_bw[1].time == m_bw[0].time && age > window / 4)
+		{
+			// a quarter of the window has passed without a second best sample.
+			// Take one from the second quarter
+			m_bw[2] = m_bw[1] = s;
+		}
+		else if (m_bw[2].time == m_bw[1].time && age > window / 2)
+		{
+			m_bw[2] = s;
+		}
+		TORRENT_ASSERT(m_bw[0].value >= m_bw[1].value);
+		TORRENT_ASSERT(m_bw[1].value >= m_bw[2].value);
+	}
+}
+}
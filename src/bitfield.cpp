@@ -36,12 +36,172 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/numeric_cast.hpp"
 #include "libtorrent/aux_/cpuid.hpp"
 
+#include <algorithm>
+
 #ifdef _MSC_VER
 #include <intrin.h>
 #endif
 
+#if TORRENT_HAS_SIMD_BITFIELD
+#include "libtorrent/aux_/disable_warnings_push.hpp"
+#include <immintrin.h>
+#include "libtorrent/aux_/disable_warnings_pop.hpp"
+
+#define TORRENT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// NEON is a mandatory part of aarch64, it doesn't need a runtime check
+#if TORRENT_HAS_ARM_NEON && defined __aarch64__
+#define TORRENT_BITFIELD_NEON 1
+#include <arm_neon.h>
+#else
+#define TORRENT_BITFIELD_NEON 0
+#endif
+
 namespace libtorrent {
 
+namespace {
+
+	// how the words of two bitfields are combined before counting bits
+	enum class bit_op { first, and_, and_not };
+
+	template <bit_op Op>
+	std::uint32_t combine(std::uint32_t const a, std::uint32_t const b)
+	{
+		return Op == bit_op::first ? a
+			: Op == bit_op::and_ ? (a & b)
+			: (a & ~b);
+	}
+
+	int popcount32(std::uint32_t const v)
+	{
+#if defined __GNUC__ || defined __clang__
+		return __builtin_popcount(v);
+#else
+		// from:
+		// http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
+		std::uint32_t c = v - ((v >> 1) & 0x55555555);
+		c = ((c >> 2) & 0x33333333) + (c & 0x33333333);
+		c = ((c >> 4) + c) & 0x0f0f0f0f;
+		return int((c * 0x01010101) >> 24);
+#endif
+	}
+
+	template <bit_op Op>
+	int count_generic(std::uint32_t const* a, std::uint32_t const* b, int const words)
+	{
+		int ret = 0;
+		for (int i = 0; i < words; ++i)
+			ret += popcount32(combine<Op>(a[i], b[i]));
+		return ret;
+	}
+
+#if TORRENT_HAS_SIMD_BITFIELD
+	template <bit_op Op>
+	TORRENT_TARGET_AVX2
+	__m256i combine_avx2(__m256i const a, __m256i const b)
+	{
+		return Op == bit_op::first ? a
+			: Op == bit_op::and_ ? _mm256_and_si256(a, b)
+			: _mm256_andnot_si256(b, a);
+	}
+
+	// counts bits 256 at a time, by looking up the popcount of each nibble
+	// with a byte shuffle
+	template <bit_op Op>
+	TORRENT_TARGET_AVX2
+	int count_avx2(std::uint32_t const* a, std::uint32_t const* b, int const words)
+	{
+		__m256i const lookup = _mm256_setr_epi8(
+			0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+			, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+		__m256i const low_mask = _mm256_set1_epi8(0x0f);
+		__m256i const zero = _mm256_setzero_si256();
+		__m256i total = zero;
+
+		int i = 0;
+		while (i + 8 <= words)
+		{
+			// every byte lane grows by at most 8 per iteration. Fold them into
+			// the 64 bit lanes of total before they can overflow
+			int const end = std::min(words - 7, i + 8 * 31);
+			__m256i bytes = zero;
+			for (; i < end; i += 8)
+			{
+				__m256i const v = combine_avx2<Op>(
+					_mm256_loadu_si256(reinterpret_cast<__m256i const*>(a + i))
+					, _mm256_loadu_si256(reinterpret_cast<__m256i const*>(b + i)));
+				__m256i const lo = _mm256_and_si256(v, low_mask);
+				__m256i const hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+				bytes = _mm256_add_epi8(bytes, _mm256_add_epi8(
+					_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi)));
+			}
+			total = _mm256_add_epi64(total, _mm256_sad_epu8(bytes, zero));
+		}
+
+		alignas(32) std::uint64_t lanes[4];
+		_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), total);
+		int ret = int(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+		for (; i < words; ++i)
+			ret += popcount32(combine<Op>(a[i], b[i]));
+		return ret;
+	}
+
+	// returns the index of the first word at or after start that's not
+	// zero, rounded down to a multiple of 8 words from start
+	TORRENT_TARGET_AVX2
+	int skip_zero_words_avx2(std::uint32_t const* b, int i, int const words)
+	{
+		for (; i + 8 <= words; i += 8)
+		{
+			__m256i const v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(b + i));
+			if (!_mm256_testz_si256(v, v)) break;
+		}
+		return i;
+	}
+#endif // TORRENT_HAS_SIMD_BITFIELD
+
+#if TORRENT_BITFIELD_NEON
+	template <bit_op Op>
+	uint32x4_t combine_neon(uint32x4_t const a, uint32x4_t const b)
+	{
+		return Op == bit_op::first ? a
+			: Op == bit_op::and_ ? vandq_u32(a, b)
+			: vbicq_u32(a, b);
+	}
+
+	template <bit_op Op>
+	int count_neon(std::uint32_t const* a, std::uint32_t const* b, int const words)
+	{
+		uint64x2_t total = vdupq_n_u64(0);
+		int i = 0;
+		for (; i + 4 <= words; i += 4)
+		{
+			uint32x4_t const v = combine_neon<Op>(vld1q_u32(a + i), vld1q_u32(b + i));
+			uint8x16_t const c = vcntq_u8(vreinterpretq_u8_u32(v));
+			total = vpadalq_u32(total, vpaddlq_u16(vpaddlq_u8(c)));
+		}
+		int ret = int(vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1));
+		for (; i < words; ++i)
+			ret += popcount32(combine<Op>(a[i], b[i]));
+		return ret;
+	}
+#endif // TORRENT_BITFIELD_NEON
+
+	template <bit_op Op>
+	int count_words(std::uint32_t const* a, std::uint32_t const* b, int const words)
+	{
+#if TORRENT_HAS_SIMD_BITFIELD
+		if (aux::avx2_support) return count_avx2<Op>(a, b, words);
+#endif
+#if TORRENT_BITFIELD_NEON
+		return count_neon<Op>(a, b, words);
+#else
+		return count_generic<Op>(a, b, words);
+#endif
+	}
+}
+
 	bool bitfield::all_set() const noexcept
 	{
 		if(size() == 0) return false;
@@ -74,10 +234,58 @@ namespace libtorrent {
 		return std::memcmp(lb, rb, std::size_t(num_words()) * 4) == 0;
 	}
 
+	bool bitfield::intersects(bitfield const& rhs) const noexcept
+	{
+		int const words = std::min(num_words(), rhs.num_words());
+		if (words == 0) return false;
+		std::uint32_t const* lb = buf();
+		std::uint32_t const* rb = rhs.buf();
+		// the tail bits of the last word are always cleared, so a partial
+		// last word doesn't need special treatment unless the sizes differ
+		std::uint32_t last = lb[words - 1] & rb[words - 1];
+		if (size() != rhs.size())
+		{
+			int const bits = std::min(size(), rhs.size());
+			if (bits & 31)
+				last &= aux::host_to_network(0xffffffff << (32 - (bits & 31)));
+		}
+		if (last != 0) return true;
+
+		// OR together a block of words at a time, to let the compiler
+		// vectorize the inner loop, and check for a match once per block
+		int i = 0;
+		for (; i + 8 <= words - 1; i += 8)
+		{
+			std::uint32_t acc = 0;
+			for (int k = 0; k < 8; ++k)
+				acc |= lb[i + k] & rb[i + k];
+			if (acc != 0) return true;
+		}
+		for (; i < words - 1; ++i)
+			if (lb[i] & rb[i]) return true;
+		return false;
+	}
+
 	int bitfield::count() const noexcept
 	{
 		int ret = 0;
 		int const words = num_words();
+#if TORRENT_HAS_SIMD_BITFIELD || TORRENT_BITFIELD_NEON
+		if (words == 0) return 0;
+#endif
+#if TORRENT_HAS_SIMD_BITFIELD
+		if (aux::avx2_support)
+		{
+			ret = count_avx2<bit_op::first>(buf(), buf(), words);
+			TORRENT_ASSERT(ret <= size());
+			return ret;
+		}
+#endif
+#if TORRENT_BITFIELD_NEON
+		ret = count_neon<bit_op::first>(buf(), buf(), words);
+		TORRENT_ASSERT(ret <= size());
+		return ret;
+#endif
 #if TORRENT_HAS_SSE
 		if (aux::mmx_support)
 		{
@@ -149,6 +357,37 @@ namespace libtorrent {
 		return ret;
 	}
 
+	int bitfield::count_and(bitfield const& rhs) const noexcept
+	{
+		TORRENT_ASSERT(size() == rhs.size());
+		int const words = num_words();
+		if (words == 0) return 0;
+		return count_words<bit_op::and_>(buf(), rhs.buf(), words);
+	}
+
+	int bitfield::count_and_not(bitfield const& rhs) const noexcept
+	{
+		TORRENT_ASSERT(size() == rhs.size());
+		int const words = num_words();
+		if (words == 0) return 0;
+		return count_words<bit_op::and_not>(buf(), rhs.buf(), words);
+	}
+
+	int bitfield::next_set_word(int i) const noexcept
+	{
+		int const words = num_words();
+		std::uint32_t const* b = buf();
+#if TORRENT_HAS_SIMD_BITFIELD
+		if (aux::avx2_support) i = skip_zero_words_avx2(b, i, words);
+#elif TORRENT_BITFIELD_NEON
+		for (; i + 4 <= words; i += 4)
+			if (vmaxvq_u32(vld1q_u32(b + i)) != 0) break;
+#endif
+		for (; i < words; ++i)
+			if (b[i] != 0) return i;
+		return words;
+	}
+
 	void bitfield::resize(int const bits, bool const val)
 	{
 		if (bits == size()) return;
@@ -188,7 +188,8 @@ namespace {
 
 	void bt_peer_connection::switch_recv_crypto(std::shared_ptr<crypto_plugin> crypto)
 	{
-		m_enc_handler.switch_recv_crypto(std::move(crypto), m_recv_buffer);
+		bool const stream_cipher = crypto && crypto == m_rc4;
+		m_enc_handler.switch_recv_crypto(std::move(crypto), m_recv_buffer, stream_cipher);
 	}
 #endif
 
@@ -1231,6 +1232,7 @@ namespace {
 
 		if (hashes.empty())
 		{
+			t->rehydrate_hashes(hr);
 			write_hash_reject(hr, file_root);
 			return;
 		}
@@ -2629,6 +2631,17 @@ namespace {
 		stats_counters().inc_stats_counter(counters::num_outgoing_extended);
 	}
 
+	bool bt_peer_connection::allow_zero_copy_send() const
+	{
+#if !defined TORRENT_DISABLE_ENCRYPTION
+		// the payload is copied and encrypted in this thread
+		if (!m_enc_handler.is_send_plaintext()) return false;
+#endif
+		// SSL and uTP sockets also copy the payload in this thread, into their
+		// own buffers
+		return !aux::is_ssl(get_socket()) && !aux::is_utp(get_socket());
+	}
+
 	void bt_peer_connection::write_piece(peer_request const& r, disk_buffer_holder buffer)
 	{
 		INVARIANT_CHECK;
@@ -0,0 +1,102 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "libtorrent/aux_/buffer_arena.hpp"
+#include "libtorrent/assert.hpp"
+
+namespace libtorrent {
+namespace aux {
+
+	constexpr int buffer_arena::min_size;
+	constexpr int buffer_arena::num_classes;
+	constexpr int buffer_arena::max_size;
+
+	buffer_arena::buffer_arena()
+	{
+		int size = min_size;
+		for (auto& c : m_classes)
+		{
+			c.reset(new slab_allocator(size));
+			size *= 2;
+		}
+	}
+
+	int buffer_arena::size_class(std::ptrdiff_t const size)
+	{
+		TORRENT_ASSERT(serves(size));
+		int ret = 0;
+		while ((std::ptrdiff_t(min_size) << ret) < size) ++ret;
+		return ret;
+	}
+
+	char* buffer_arena::allocate(std::ptrdiff_t& size)
+	{
+		int const idx = size_class(size);
+		char* const ret = m_classes[idx]->allocate();
+		if (ret != nullptr) size = std::ptrdiff_t(min_size) << idx;
+		return ret;
+	}
+
+	void buffer_arena::free(char* const buf, std::ptrdiff_t const size)
+	{
+		int const idx = size_class(size);
+		TORRENT_ASSERT((std::ptrdiff_t(min_size) << idx) == size);
+		m_classes[idx]->free(buf);
+	}
+
+	void buffer_arena::set_hugepages(bool const h)
+	{
+		for (auto& c : m_classes) c->set_hugepages(h);
+	}
+
+	void buffer_arena::set_numa_local(bool const n)
+	{
+		for (auto& c : m_classes) c->set_numa_local(n);
+	}
+
+	slab_allocator::stats_t buffer_arena::stats() const
+	{
+		slab_allocator::stats_t ret;
+		for (auto const& c : m_classes)
+		{
+			auto const st = c->stats();
+			ret.magazine_hits += st.magazine_hits;
+			ret.magazine_misses += st.magazine_misses;
+			ret.slabs += st.slabs;
+			ret.hugepage_slabs += st.hugepage_slabs;
+			ret.hugepage_fallbacks += st.hugepage_fallbacks;
+		}
+		return ret;
+	}
+}
+}
@@ -39,7 +39,62 @@ POSSIBILITY OF SUCH DAMAGE.
 namespace libtorrent {
 namespace aux {
 
-	void chained_buffer::pop_front(int bytes_to_pop)
+	void chained_buffer::pop_front(int const bytes_to_pop)
+	{
+		pop_front_impl(bytes_to_pop, [](buffer_t& b)
+		{ b.destruct_holder(static_cast<void*>(&b.holder)); });
+	}
+
+	void chained_buffer::retain_front(int const bytes_to_pop, std::uint32_t const tag)
+	{
+		TORRENT_ASSERT(m_retained.empty()
+			|| std::int32_t(tag - m_retained.back().tag) >= 0);
+		pop_front_impl(bytes_to_pop, [this, tag](buffer_t& b)
+		{
+			m_retained.emplace_back();
+			retained_t& r = m_retained.back();
+			r.tag = tag;
+			r.buffer.destruct_holder = b.destruct_holder;
+			r.buffer.move_holder = b.move_holder;
+			b.move_holder(&r.buffer.holder, &b.holder);
+			b.destruct_holder(static_cast<void*>(&b.holder));
+		});
+	}
+
+	void chained_buffer::release_retained(std::uint32_t const tag)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		TORRENT_ASSERT(!m_destructed);
+		while (!m_retained.empty()
+			&& std::int32_t(m_retained.front().tag - tag) < 0)
+		{
+			buffer_t& b = m_retained.front().buffer;
+			b.destruct_holder(static_cast<void*>(&b.holder));
+			m_retained.pop_front();
+		}
+	}
+
+	void chained_buffer::take_retained(chained_buffer& other)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		TORRENT_ASSERT(!m_destructed);
+		for (auto& o : other.m_retained)
+		{
+			TORRENT_ASSERT(m_retained.empty()
+				|| std::int32_t(o.tag - m_retained.back().tag) >= 0);
+			m_retained.emplace_back();
+			retained_t& r = m_retained.back();
+			r.tag = o.tag;
+			r.buffer.destruct_holder = o.buffer.destruct_holder;
+			r.buffer.move_holder = o.buffer.move_holder;
+			o.buffer.move_holder(&r.buffer.holder, &o.buffer.holder);
+			o.buffer.destruct_holder(static_cast<void*>(&o.buffer.holder));
+		}
+		other.m_retained.clear();
+	}
+
+	template <typename Fun>
+	void chained_buffer::pop_front_impl(int bytes_to_pop, Fun release)
 	{
 		TORRENT_ASSERT(is_single_thread());
 		TORRENT_ASSERT(!m_destructed);
@@ -60,7 +115,7 @@ namespace aux {
 				break;
 			}
 
-			b.destruct_holder(static_cast<void*>(&b.holder));
+			release(b);
 			m_bytes -= b.used_size;
 			m_capacity -= b.size;
 			bytes_to_pop -= b.used_size;
@@ -156,6 +211,9 @@ namespace aux {
 		m_bytes = 0;
 		m_capacity = 0;
 		m_vec.clear();
+		for (auto& r : m_retained)
+			r.buffer.destruct_holder(static_cast<void*>(&r.buffer.holder));
+		m_retained.clear();
 	}
 
 	chained_buffer::~chained_buffer()
@@ -95,6 +95,40 @@ namespace {
 		std::memset(&info[0], 0, sizeof(std::uint32_t) * 4);
 #endif
 	}
+
+	// the extended feature flags (leaf 7, sub-leaf 0)
+	void cpuid_ext(std::uint32_t* info) noexcept
+	{
+#if defined _MSC_VER
+		__cpuidex(reinterpret_cast<int*>(info), 7, 0);
+#elif defined __GNUC__
+		if (!__get_cpuid_count(7, 0, &info[0], &info[1], &info[2], &info[3]))
+			info[0] = info[1] = info[2] = info[3] = 0;
+#else
+		std::memset(&info[0], 0, sizeof(std::uint32_t) * 4);
+#endif
+	}
+
+	// returns true if the operating system saves the AVX (YMM) registers on
+	// context switches
+	bool os_supports_avx() noexcept
+	{
+		std::uint32_t cpui[4] = {0};
+		cpuid(cpui, 1);
+		// OSXSAVE and AVX
+		if ((cpui[2] & (1 << 27)) == 0 || (cpui[2] & (1 << 28)) == 0) return false;
+#if defined _MSC_VER
+		std::uint64_t const xcr0 = _xgetbv(0);
+#elif defined __GNUC__
+		std::uint32_t lo = 0;
+		std::uint32_t hi = 0;
+		__asm__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+		std::uint64_t const xcr0 = (std::uint64_t(hi) << 32) | lo;
+#else
+		std::uint64_t const xcr0 = 0;
+#endif
+		return (xcr0 & 6) == 6;
+	}
 #endif
 
 	bool supports_sse42() noexcept
@@ -119,6 +153,32 @@ namespace {
 #endif
 	}
 
+	bool supports_avx2() noexcept
+	{
+#if TORRENT_HAS_SSE
+		if (!os_supports_avx()) return false;
+		std::uint32_t cpui[4] = {0};
+		cpuid_ext(cpui);
+		return (cpui[1] & (1 << 5)) != 0;
+#else
+		return false;
+#endif
+	}
+
+	bool supports_sha_ni() noexcept
+	{
+#if TORRENT_HAS_SSE
+		std::uint32_t cpui[4] = {0};
+		cpuid(cpui, 1);
+		// the SHA-NI implementations also rely on SSSE3 and SSE4.1
+		if ((cpui[2] & (1 << 9)) == 0 || (cpui[2] & (1 << 19)) == 0) return false;
+		cpuid_ext(cpui);
+		return (cpui[1] & (1 << 29)) != 0;
+#else
+		return false;
+#endif
+	}
+
 	bool supports_arm_neon() noexcept
 	{
 #if TORRENT_HAS_ARM_NEON && TORRENT_HAS_AUXV
@@ -157,6 +217,8 @@ namespace {
 
 	bool const sse42_support = supports_sse42();
 	bool const mmx_support = supports_mmx();
+	bool const avx2_support = supports_avx2();
+	bool const sha_ni_support = supports_sha_ni();
 	bool const arm_neon_support = supports_arm_neon();
 	bool const arm_crc32c_support = supports_arm_crc32c();
 } }
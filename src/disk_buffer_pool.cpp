@@ -39,6 +39,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/io_context.hpp"
 #include "libtorrent/disk_observer.hpp"
 #include "libtorrent/disk_interface.hpp" // for default_block_size
+#include "libtorrent/performance_counters.hpp"
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 
@@ -79,7 +80,10 @@ namespace {
 		, m_low_watermark(std::max(m_max_use - 32, 0))
 		, m_exceeded_max_size(false)
 		, m_ios(ios)
-	{}
+	{
+		static_assert(default_block_size == slab_allocator::min_block_size
+			, "disk buffers are allocated as slab_allocator blocks");
+	}
 
 	disk_buffer_pool::~disk_buffer_pool()
 	{
@@ -89,6 +93,15 @@ namespace {
 #endif
 	}
 
+	void disk_buffer_pool::check_buffer_level()
+	{
+		// this is the common case, and doesn't need the mutex
+		if (!m_exceeded_max_size || m_in_use > m_low_watermark) return;
+
+		std::unique_lock<std::mutex> l(m_pool_mutex);
+		check_buffer_level(l);
+	}
+
 	// checks to see if we're no longer exceeding the high watermark,
 	// and if we're in fact below the low watermark. If so, we need to
 	// post the notification messages to the peers that are waiting for
@@ -108,8 +121,7 @@ namespace {
 
 	char* disk_buffer_pool::allocate_buffer(char const* category)
 	{
-		std::unique_lock<std::mutex> l(m_pool_mutex);
-		return allocate_buffer_impl(l, category);
+		return allocate_buffer_impl(category);
 	}
 
 	// we allow allocating more blocks even after we exceed the max size,
@@ -122,25 +134,31 @@ namespace {
 	char* disk_buffer_pool::allocate_buffer(bool& exceeded
 		, std::shared_ptr<disk_observer> o, char const* category)
 	{
-		std::unique_lock<std::mutex> l(m_pool_mutex);
-		char* ret = allocate_buffer_impl(l, category);
+		char* ret = allocate_buffer_impl(category);
 		if (m_exceeded_max_size)
 		{
+			std::unique_lock<std::mutex> l(m_pool_mutex);
+			// buffers may have been freed since we checked. If we're below the
+			// low watermark now, nobody would be left to notify the observer
+			if (m_in_use <= m_low_watermark)
+			{
+				check_buffer_level(l);
+				return ret;
+			}
+			if (!m_exceeded_max_size) return ret;
+
 			exceeded = true;
 			if (o) m_observers.push_back(o);
 		}
 		return ret;
 	}
 
-	char* disk_buffer_pool::allocate_buffer_impl(std::unique_lock<std::mutex>& l
-		, char const*)
+	char* disk_buffer_pool::allocate_buffer_impl(char const*)
 	{
 		TORRENT_ASSERT(m_settings_set);
 		TORRENT_ASSERT(m_magic == 0x1337);
-		TORRENT_ASSERT(l.owns_lock());
-		TORRENT_UNUSED(l);
 
-		char* ret = static_cast<char*>(std::malloc(default_block_size));
+		char* ret = m_allocator.allocate();
 
 		if (ret == nullptr)
 		{
@@ -148,22 +166,24 @@ namespace {
 			return nullptr;
 		}
 
-		++m_in_use;
+		int const in_use = ++m_in_use;
 
 #if TORRENT_USE_INVARIANT_CHECKS
 		try
 		{
+			std::lock_guard<std::mutex> l(m_pool_mutex);
 			TORRENT_ASSERT(m_buffers_in_use.count(ret) == 0);
 			m_buffers_in_use.insert(ret);
 		}
 		catch (...)
 		{
-			free_buffer_impl(ret, l);
+			free_buffer_impl(ret);
 			return nullptr;
 		}
 #endif
 
-		if (m_in_use >= m_low_watermark + (m_max_use - m_low_watermark)
+		int const low_watermark = m_low_watermark;
+		if (in_use >= low_watermark + (m_max_use - low_watermark)
 			/ 2 && !m_exceeded_max_size)
 		{
 			m_exceeded_max_size = true;
@@ -177,22 +197,20 @@ namespace {
 		// sort the pointers in order to maximize cache hits
 		std::sort(bufvec.begin(), bufvec.end());
 
-		std::unique_lock<std::mutex> l(m_pool_mutex);
 		for (char* buf : bufvec)
 		{
 			remove_buffer_in_use(buf);
-			free_buffer_impl(buf, l);
+			free_buffer_impl(buf);
 		}
 
-		check_buffer_level(l);
+		check_buffer_level();
 	}
 
 	void disk_buffer_pool::free_buffer(char* buf)
 	{
-		std::unique_lock<std::mutex> l(m_pool_mutex);
 		remove_buffer_in_use(buf);
-		free_buffer_impl(buf, l);
-		check_buffer_level(l);
+		free_buffer_impl(buf);
+		check_buffer_level();
 	}
 
 	void disk_buffer_pool::set_settings(settings_interface const& sett)
@@ -201,36 +219,63 @@ namespace {
 
 		int const pool_size = std::max(1, sett.get_int(settings_pack::max_queued_disk_bytes) / default_block_size);
 		m_max_use = pool_size;
-		m_low_watermark = m_max_use / 2;
-		if (m_in_use >= m_max_use && !m_exceeded_max_size)
+		m_low_watermark = pool_size / 2;
+		if (m_in_use >= pool_size && !m_exceeded_max_size)
 		{
 			m_exceeded_max_size = true;
 		}
 
+		m_allocator.set_lock_memory(sett.get_bool(settings_pack::lock_disk_buffers));
+		m_allocator.set_hugepages(sett.get_bool(settings_pack::hugepage_buffers));
+		bool const numa = sett.get_bool(settings_pack::numa_local_buffers);
+		m_allocator.set_numa_local(numa);
+
+		// disk threads allocate the buffers for reads, but it's the network
+		// thread that sends them, just like it fills the buffers for writes.
+		// Place them all on the network thread's node, which is the thread
+		// running m_ios
+		if (numa)
+			post(m_ios, [this] { m_allocator.set_consumer_node(m_allocator.calling_thread_node()); });
+		else
+			m_allocator.set_consumer_node(-1);
+
 #if TORRENT_USE_ASSERTS
 		m_settings_set = true;
 #endif
 	}
 
+	void disk_buffer_pool::update_stats_counters(counters& c) const
+	{
+		int const in_use = m_in_use;
+		auto const st = m_allocator.stats();
+		c.set_value(counters::disk_blocks_in_use, in_use);
+		c.set_value(counters::disk_buffer_magazine_hits, st.magazine_hits);
+		c.set_value(counters::disk_buffer_magazine_misses, st.magazine_misses);
+		c.set_value(counters::disk_buffer_slabs, st.slabs);
+		c.set_value(counters::disk_buffer_free_blocks
+			, std::max(0, st.slabs * m_allocator.blocks_per_slab() - in_use));
+		c.set_value(counters::disk_buffer_hugepage_slabs, st.hugepage_slabs);
+		c.set_value(counters::disk_buffer_hugepage_fallbacks, st.hugepage_fallbacks);
+	}
+
 	void disk_buffer_pool::remove_buffer_in_use(char* buf)
 	{
 		TORRENT_UNUSED(buf);
 #if TORRENT_USE_INVARIANT_CHECKS
+		std::lock_guard<std::mutex> l(m_pool_mutex);
 		std::set<char*>::iterator i = m_buffers_in_use.find(buf);
 		TORRENT_ASSERT(i != m_buffers_in_use.end());
 		m_buffers_in_use.erase(i);
 #endif
 	}
 
-	void disk_buffer_pool::free_buffer_impl(char* buf, std::unique_lock<std::mutex>& l)
+	void disk_buffer_pool::free_buffer_impl(char* buf)
 	{
 		TORRENT_ASSERT(buf);
 		TORRENT_ASSERT(m_magic == 0x1337);
 		TORRENT_ASSERT(m_settings_set);
-		TORRENT_ASSERT(l.owns_lock());
-		TORRENT_UNUSED(l);
 
-		std::free(buf);
+		m_allocator.free(buf);
 
 		--m_in_use;
 	}
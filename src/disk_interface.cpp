@@ -40,5 +40,6 @@ constexpr disk_job_flags_t disk_interface::sequential_access;
 constexpr disk_job_flags_t disk_interface::volatile_read;
 constexpr disk_job_flags_t disk_interface::v1_hash;
 constexpr disk_job_flags_t disk_interface::flush_piece;
+constexpr disk_job_flags_t disk_interface::zero_copy;
 
 }
@@ -61,6 +61,7 @@ namespace aux {
 		l.unlock();
 
 		ptr->action = type;
+		ptr->queued = clock_type::now();
 #if TORRENT_USE_ASSERTS
 		ptr->in_use = true;
 #endif
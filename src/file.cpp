@@ -70,6 +70,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/path.hpp" // for convert_to_native_path_string
 #include "libtorrent/string_util.hpp"
 #include <cstring>
+#include <array>
 
 #include "libtorrent/assert.hpp"
 #include "libtorrent/aux_/throw.hpp"
@@ -98,6 +99,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <unistd.h>
 #include <sys/types.h>
 #include <cerrno>
+#if TORRENT_HAS_PWRITEV
+#include <sys/uio.h> // for pwritev
+#endif
 #include <dirent.h>
 
 #include <boost/asio/error.hpp> // for boost::asio::error::eof
@@ -208,6 +212,71 @@ namespace aux {
 	}
 #endif
 
+	int pwritev_all(handle_type const handle
+		, span<span<char const> const> bufs
+		, std::int64_t file_offset
+		, error_code& ec)
+	{
+#if TORRENT_HAS_PWRITEV
+		int ret = 0;
+		// the offset into the first buffer, in case the last call ended with
+		// a short write
+		std::ptrdiff_t skip = 0;
+		while (!bufs.empty())
+		{
+			std::array<::iovec, 64> vec;
+			std::size_t num_vec = 0;
+			std::ptrdiff_t skip_vec = skip;
+			for (auto const& b : bufs)
+			{
+				if (num_vec == vec.size()) break;
+				vec[num_vec].iov_base = const_cast<char*>(b.data() + skip_vec);
+				vec[num_vec].iov_len = std::size_t(b.size() - skip_vec);
+				skip_vec = 0;
+				++num_vec;
+			}
+
+			auto r = ::pwritev(handle, vec.data(), int(num_vec), file_offset);
+			if (r == 0)
+			{
+				ec = boost::asio::error::eof;
+				return ret;
+			}
+			if (r < 0)
+			{
+				ec = error_code(errno, system_category());
+				return -1;
+			}
+			ret += int(r);
+			file_offset += r;
+			while (r > 0)
+			{
+				std::ptrdiff_t const left = bufs.front().size() - skip;
+				if (r < left)
+				{
+					skip += r;
+					break;
+				}
+				r -= left;
+				skip = 0;
+				bufs = bufs.subspan(1);
+			}
+		}
+		return ret;
+#else
+		int ret = 0;
+		for (auto const& b : bufs)
+		{
+			int const r = pwrite_all(handle, b, file_offset, ec);
+			if (r < 0) return -1;
+			ret += r;
+			if (ec || r < b.size()) return ret;
+			file_offset += r;
+		}
+		return ret;
+#endif
+	}
+
 namespace {
 #ifdef TORRENT_WINDOWS
 	// returns true if the given file has any regions that are
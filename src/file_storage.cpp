@@ -94,6 +94,18 @@ namespace libtorrent {
 		m_files.reserve(num_files);
 	}
 
+	void file_storage::set_num_pieces(int const n)
+	{
+		m_num_pieces = n;
+		update_piece_index();
+	}
+
+	void file_storage::set_piece_length(int const l)
+	{
+		m_piece_length = l;
+		update_piece_index();
+	}
+
 	int file_storage::piece_size(piece_index_t const index) const
 	{
 		TORRENT_ASSERT_PRECOND(index >= piece_index_t(0) && index < end_piece());
@@ -133,8 +145,10 @@ namespace {
 		target.offset = aux::numeric_cast<std::uint64_t>(std::int64_t(piece_length()) * static_cast<int>(index));
 		TORRENT_ASSERT(!compare_file_offset(target, m_files.front()));
 
-		auto const file_iter = std::upper_bound(
-			m_files.begin(), m_files.end(), target, compare_file_offset);
+		// the first file starting past the start of the piece
+		auto const file_iter = m_piece_file.empty()
+			? std::upper_bound(m_files.begin(), m_files.end(), target, compare_file_offset)
+			: m_files.begin() + static_cast<int>(m_piece_file[index]) + 1;
 
 		TORRENT_ASSERT(file_iter != m_files.begin());
 		if (file_iter == m_files.end()) return piece_size(index);
@@ -439,19 +453,61 @@ namespace aux {
 		target.offset = aux::numeric_cast<std::uint64_t>(offset);
 		TORRENT_ASSERT(!compare_file_offset(target, m_files.front()));
 
-		auto file_iter = std::upper_bound(
-			m_files.begin(), m_files.end(), target, compare_file_offset);
+		auto first = m_files.begin();
+		auto last = m_files.end();
+		if (!m_piece_file.empty())
+		{
+			// the file we're looking for is one of the files overlapping the
+			// piece the offset falls in. i.e. between the file the piece starts
+			// in and the file the next piece starts in
+			piece_index_t const piece(static_cast<int>(offset / m_piece_length));
+			first += static_cast<int>(m_piece_file[piece]);
+			if (next(piece) < m_piece_file.end_index())
+				last = m_files.begin() + static_cast<int>(m_piece_file[next(piece)]) + 1;
+		}
 
-		TORRENT_ASSERT(file_iter != m_files.begin());
+		auto file_iter = std::upper_bound(first, last, target, compare_file_offset);
+
+		TORRENT_ASSERT(file_iter != first);
 		--file_iter;
 		return file_index_t{int(file_iter - m_files.begin())};
 	}
 
 	file_index_t file_storage::file_index_at_piece(piece_index_t const piece) const
 	{
+		if (!m_piece_file.empty()) return m_piece_file[piece];
 		return file_index_at_offset(static_cast<int>(piece) * std::int64_t(piece_length()));
 	}
 
+	void file_storage::update_piece_index()
+	{
+		m_piece_file.clear();
+
+		// a binary search over this few files is about as quick as a lookup in
+		// the table, and for torrents with few files and many pieces, the
+		// table would be much larger than the file list
+		if (num_files() < 16 || m_piece_length <= 0) return;
+
+		// this is called as the piece size and number of pieces are set. Only
+		// build the table once they are consistent with the files
+		if (m_num_pieces != aux::calc_num_pieces(*this)) return;
+
+		m_piece_file.reserve(m_num_pieces);
+		file_index_t f{0};
+		for (piece_index_t p{0}; p < end_piece(); ++p)
+		{
+			std::uint64_t const piece_start
+				= static_cast<std::uint64_t>(static_cast<int>(p)) * std::uint64_t(m_piece_length);
+
+			// the last file starting at or before the piece does. This is the
+			// same file file_index_at_offset() would find, skipping any empty
+			// files at the start of the piece
+			while (next(f) < end_file() && m_files[next(f)].offset <= piece_start)
+				++f;
+			m_piece_file.push_back(f);
+		}
+	}
+
 	file_index_t file_storage::file_index_for_root(sha256_hash const& root_hash) const
 	{
 		// TODO: maybe it would be nice to have a better index here
@@ -482,51 +538,15 @@ namespace aux {
 #endif
 
 	std::vector<file_slice> file_storage::map_block(piece_index_t const piece
-		, std::int64_t const offset, std::int64_t size) const
+		, std::int64_t const offset, std::int64_t const size) const
 	{
-		TORRENT_ASSERT_PRECOND(piece >= piece_index_t{0});
-		TORRENT_ASSERT_PRECOND(piece < end_piece());
 		TORRENT_ASSERT_PRECOND(num_files() > 0);
-		TORRENT_ASSERT_PRECOND(size >= 0);
 		std::vector<file_slice> ret;
-
-		if (m_files.empty()) return ret;
-
-		// find the file iterator and file offset
-		aux::file_entry target;
-		TORRENT_ASSERT(max_file_offset / m_piece_length > static_cast<int>(piece));
-		target.offset = aux::numeric_cast<std::uint64_t>(static_cast<int>(piece) * std::int64_t(m_piece_length) + offset);
-		TORRENT_ASSERT_PRECOND(std::int64_t(target.offset) <= m_total_size - size);
-		TORRENT_ASSERT(!compare_file_offset(target, m_files.front()));
-
-		// in case the size is past the end, fix it up
-		if (std::int64_t(target.offset) > m_total_size - size)
-			size = m_total_size - std::int64_t(target.offset);
-
-		auto file_iter = std::upper_bound(
-			m_files.begin(), m_files.end(), target, compare_file_offset);
-
-		TORRENT_ASSERT(file_iter != m_files.begin());
-		--file_iter;
-
-		std::int64_t file_offset = target.offset - file_iter->offset;
-		for (; size > 0; file_offset -= file_iter->size, ++file_iter)
+		map_block(piece, offset, size, [&ret](file_slice const& f)
 		{
-			TORRENT_ASSERT(file_iter != m_files.end());
-			if (file_offset < std::int64_t(file_iter->size))
-			{
-				file_slice f{};
-				f.file_index = file_index_t(int(file_iter - m_files.begin()));
-				f.offset = file_offset;
-				f.size = std::min(std::int64_t(file_iter->size) - file_offset, std::int64_t(size));
-				TORRENT_ASSERT(f.size <= size);
-				size -= f.size;
-				file_offset += f.size;
-				ret.push_back(f);
-			}
-
-			TORRENT_ASSERT(size >= 0);
-		}
+			ret.push_back(f);
+			return true;
+		});
 		return ret;
 	}
 
@@ -718,6 +738,7 @@ namespace aux {
 			}
 		}
 
+		m_piece_file.clear();
 		m_files.emplace_back();
 		aux::file_entry& e = m_files.back();
 
@@ -815,6 +836,7 @@ namespace aux {
 					TORRENT_ASSERT(m_files[f].size == 0);
 					++f;
 				}
+				update_piece_index();
 			}
 			// if the last non-empty file isn't a pad file, don't do anything
 			return;
@@ -1205,6 +1227,7 @@ namespace {
 	{
 		using std::swap;
 		swap(ti.m_files, m_files);
+		swap(ti.m_piece_file, m_piece_file);
 		swap(ti.m_file_hashes, m_file_hashes);
 		swap(ti.m_symlinks, m_symlinks);
 		swap(ti.m_mtime, m_mtime);
@@ -1330,6 +1353,7 @@ namespace {
 		m_mtime = std::move(new_mtime);
 
 		m_total_size = off;
+		update_piece_index();
 	}
 
 	void file_storage::sanitize_symlinks()
@@ -0,0 +1,560 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/aux_/hash_many.hpp"
+#include "libtorrent/aux_/cpuid.hpp"
+#include "libtorrent/hasher.hpp"
+#include "libtorrent/assert.hpp"
+
+#include <cstring>
+#include <algorithm>
+#include <array>
+
+#if TORRENT_HAS_SIMD_HASH
+#include "libtorrent/aux_/disable_warnings_push.hpp"
+#include <immintrin.h>
+#include "libtorrent/aux_/disable_warnings_pop.hpp"
+
+#define TORRENT_TARGET_SHA_NI __attribute__((target("sha,sse4.1,ssse3")))
+#define TORRENT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace libtorrent {
+namespace aux {
+
+namespace {
+
+	using u32 = std::uint32_t;
+	using u64 = std::uint64_t;
+	using u8 = std::uint8_t;
+
+	alignas(32) u32 const K256[64] =
+	{
+		0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+		0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+		0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+		0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+		0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+		0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+		0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+		0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+	};
+
+	u32 const sha256_init[8] =
+	{
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+
+	// the number of buffers of the same size there needs to be for it to be
+	// worth hashing them in parallel, when the impl is not forced
+	constexpr int min_lanes = 3;
+
+	// writes the final block(s) of the SHA-256 message ``in``, i.e. the bytes
+	// past the last complete block plus the padding, into ``tail``. Returns
+	// the number of blocks written (1 or 2)
+	int pad_tail(u8* tail, span<char const> in)
+	{
+		std::size_t const len = std::size_t(in.size());
+		std::size_t const rem = len % 64;
+		int const blocks = rem < 56 ? 1 : 2;
+		std::memcpy(tail, in.data() + len - rem, rem);
+		tail[rem] = 0x80;
+		std::memset(tail + rem + 1, 0, std::size_t(blocks) * 64 - rem - 1 - 8);
+		u64 const bits = u64(len) * 8;
+		u8* p = tail + blocks * 64 - 8;
+		for (int i = 0; i < 8; ++i)
+			p[i] = u8(bits >> ((7 - i) * 8));
+		return blocks;
+	}
+
+	void store_digest(sha256_hash& out, u32 const* state)
+	{
+		u8* p = reinterpret_cast<u8*>(out.data());
+		for (int i = 0; i < 8; ++i)
+		{
+			p[i * 4 + 0] = u8(state[i] >> 24);
+			p[i * 4 + 1] = u8(state[i] >> 16);
+			p[i * 4 + 2] = u8(state[i] >> 8);
+			p[i * 4 + 3] = u8(state[i]);
+		}
+	}
+
+	void hash_generic(span<span<char const> const> in, span<sha256_hash> out)
+	{
+		for (std::ptrdiff_t i = 0; i < in.size(); ++i)
+		{
+			hasher256 h;
+			if (!in[i].empty()) h.update(in[i]);
+			out[i] = h.final();
+		}
+	}
+
+#if TORRENT_HAS_SIMD_HASH
+
+	TORRENT_TARGET_SHA_NI
+	void hash_sha_ni(span<span<char const> const> in, span<sha256_hash> out)
+	{
+		for (std::ptrdiff_t i = 0; i < in.size(); ++i)
+		{
+			u32 state[8];
+			std::memcpy(state, sha256_init, sizeof(state));
+			std::size_t const blocks = std::size_t(in[i].size()) / 64;
+			sha256_compress_ni(state, reinterpret_cast<u8 const*>(in[i].data()), blocks);
+			alignas(16) u8 tail[128];
+			int const tail_blocks = pad_tail(tail, in[i]);
+			sha256_compress_ni(state, tail, std::size_t(tail_blocks));
+			store_digest(out[i], state);
+		}
+	}
+
+	// 8 lane SHA-256, each 32 bit lane of the AVX2 registers holds the state
+	// of one message
+
+#define TORRENT_ROTR(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+
+	TORRENT_TARGET_AVX2 inline
+	__m256i add(__m256i a, __m256i b) { return _mm256_add_epi32(a, b); }
+
+	TORRENT_TARGET_AVX2 inline
+	__m256i xor3(__m256i a, __m256i b, __m256i c)
+	{ return _mm256_xor_si256(_mm256_xor_si256(a, b), c); }
+
+	// transposes the 8x8 matrix of 32 bit words in ``r``
+	TORRENT_TARGET_AVX2 inline
+	void transpose(__m256i* r)
+	{
+		__m256i const t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+		__m256i const t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+		__m256i const t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+		__m256i const t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+		__m256i const t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+		__m256i const t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+		__m256i const t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+		__m256i const t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+
+		__m256i const u0 = _mm256_unpacklo_epi64(t0, t2);
+		__m256i const u1 = _mm256_unpackhi_epi64(t0, t2);
+		__m256i const u2 = _mm256_unpacklo_epi64(t1, t3);
+		__m256i const u3 = _mm256_unpackhi_epi64(t1, t3);
+		__m256i const u4 = _mm256_unpacklo_epi64(t4, t6);
+		__m256i const u5 = _mm256_unpackhi_epi64(t4, t6);
+		__m256i const u6 = _mm256_unpacklo_epi64(t5, t7);
+		__m256i const u7 = _mm256_unpackhi_epi64(t5, t7);
+
+		r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+		r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+		r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+		r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+		r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+		r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+		r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+		r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+	}
+
+	// round T of 8 messages. Rather than moving the state words around, the
+	// roles rotate through the elements of ``v``, element (i - T) & 7 holds
+	// state word i
+	template <int T>
+	TORRENT_TARGET_AVX2 inline
+	void sha256_x8_round(__m256i* v, __m256i* w)
+	{
+		if (T >= 16)
+		{
+			__m256i const w15 = w[(T - 15) & 15];
+			__m256i const w2 = w[(T - 2) & 15];
+			__m256i const s0 = xor3(TORRENT_ROTR(w15, 7), TORRENT_ROTR(w15, 18)
+				, _mm256_srli_epi32(w15, 3));
+			__m256i const s1 = xor3(TORRENT_ROTR(w2, 17), TORRENT_ROTR(w2, 19)
+				, _mm256_srli_epi32(w2, 10));
+			w[T & 15] = add(add(w[T & 15], s0), add(w[(T - 7) & 15], s1));
+		}
+
+		__m256i const a = v[(0 - T) & 7];
+		__m256i const b = v[(1 - T) & 7];
+		__m256i const c = v[(2 - T) & 7];
+		__m256i& d = v[(3 - T) & 7];
+		__m256i const e = v[(4 - T) & 7];
+		__m256i const f = v[(5 - T) & 7];
+		__m256i const g = v[(6 - T) & 7];
+		__m256i& h = v[(7 - T) & 7];
+
+		__m256i const S1 = xor3(TORRENT_ROTR(e, 6), TORRENT_ROTR(e, 11), TORRENT_ROTR(e, 25));
+		__m256i const ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+		__m256i const t1 = add(add(add(h, S1), add(ch, _mm256_set1_epi32(int(K256[T])))), w[T & 15]);
+		__m256i const S0 = xor3(TORRENT_ROTR(a, 2), TORRENT_ROTR(a, 13), TORRENT_ROTR(a, 22));
+		__m256i const maj = _mm256_or_si256(_mm256_and_si256(_mm256_or_si256(a, b), c)
+			, _mm256_and_si256(a, b));
+		d = add(d, t1);
+		// h becomes the new a
+		h = add(t1, add(S0, maj));
+	}
+
+	template <std::size_t... T>
+	TORRENT_TARGET_AVX2 inline
+	void sha256_x8_block(__m256i* v, __m256i* w, std::index_sequence<T...>)
+	{
+		int const dummy[] = { (sha256_x8_round<int(T)>(v, w), 0)... };
+		TORRENT_UNUSED(dummy);
+	}
+
+	// runs ``num`` blocks of each of the 8 messages through the compression
+	// function. ``state`` holds one state word (of all lanes) per element
+	TORRENT_TARGET_AVX2
+	void sha256_x8_compress(__m256i* state, u8 const* const* data, std::size_t num)
+	{
+		__m256i const bswap = _mm256_set_epi8(
+			12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+			12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+		for (std::size_t blk = 0; blk < num; ++blk)
+		{
+			__m256i w[16];
+			for (int half = 0; half < 2; ++half)
+			{
+				for (int l = 0; l < 8; ++l)
+				{
+					w[half * 8 + l] = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(
+						data[l] + blk * 64 + std::size_t(half) * 32));
+				}
+				transpose(w + half * 8);
+				for (int i = half * 8; i < half * 8 + 8; ++i)
+					w[i] = _mm256_shuffle_epi8(w[i], bswap);
+			}
+
+			__m256i v[8];
+			for (int i = 0; i < 8; ++i) v[i] = state[i];
+			sha256_x8_block(v, w, std::make_index_sequence<64>{});
+
+			for (int i = 0; i < 8; ++i)
+				state[i] = add(state[i], v[i]);
+		}
+	}
+
+#undef TORRENT_ROTR
+
+	// hashes up to 8 messages, all of the same size
+	TORRENT_TARGET_AVX2
+	void hash_x8(span<span<char const> const> in, span<sha256_hash> out)
+	{
+		TORRENT_ASSERT(in.size() > 0 && in.size() <= 8);
+		int const n = int(in.size());
+		std::size_t const blocks = std::size_t(in[0].size()) / 64;
+
+		// unused lanes hash the same message as the last used lane, and their
+		// results are discarded
+		u8 const* data[8];
+		for (int l = 0; l < 8; ++l)
+			data[l] = reinterpret_cast<u8 const*>(in[std::min(l, n - 1)].data());
+
+		__m256i state[8];
+		for (int i = 0; i < 8; ++i)
+			state[i] = _mm256_set1_epi32(int(sha256_init[i]));
+
+		sha256_x8_compress(state, data, blocks);
+
+		alignas(32) u8 tail[8][128];
+		int tail_blocks = 0;
+		for (int l = 0; l < n; ++l)
+		{
+			TORRENT_ASSERT(in[l].size() == in[0].size());
+			tail_blocks = pad_tail(tail[l], in[l]);
+		}
+		u8 const* tails[8];
+		for (int l = 0; l < 8; ++l)
+			tails[l] = tail[std::min(l, n - 1)];
+
+		sha256_x8_compress(state, tails, std::size_t(tail_blocks));
+
+		alignas(32) u32 words[8][8];
+		for (int i = 0; i < 8; ++i)
+			_mm256_store_si256(reinterpret_cast<__m256i*>(words[i]), state[i]);
+
+		for (int l = 0; l < n; ++l)
+		{
+			u32 s[8];
+			for (int i = 0; i < 8; ++i) s[i] = words[i][l];
+			store_digest(out[l], s);
+		}
+	}
+
+	// hashes runs of (up to 8) consecutive buffers of the same size in
+	// parallel. Runs shorter than ``min_run`` are hashed with ``single``
+	template <typename Fun>
+	void hash_avx2(span<span<char const> const> in, span<sha256_hash> out
+		, int const min_run, Fun single)
+	{
+		std::ptrdiff_t i = 0;
+		while (i < in.size())
+		{
+			std::ptrdiff_t run = 1;
+			while (run < 8 && i + run < in.size() && in[i + run].size() == in[i].size())
+				++run;
+			if (run >= min_run)
+				hash_x8(in.subspan(i, run), out.subspan(i, run));
+			else
+				single(in.subspan(i, run), out.subspan(i, run));
+			i += run;
+		}
+	}
+
+#endif // TORRENT_HAS_SIMD_HASH
+
+} // anonymous namespace
+
+	bool hash_impl_supported(hash_impl const impl)
+	{
+		switch (impl)
+		{
+			case hash_impl::generic: return true;
+#if TORRENT_HAS_SIMD_HASH
+			case hash_impl::sha_ni: return sha_ni_support;
+			case hash_impl::avx2: return avx2_support;
+#else
+			case hash_impl::sha_ni:
+			case hash_impl::avx2: return false;
+#endif
+		}
+		return false;
+	}
+
+	void hash_many(span<span<char const> const> in, span<sha256_hash> out)
+	{
+#if TORRENT_HAS_SIMD_HASH
+		// the SHA extensions are faster than 8 AVX2 lanes
+		if (sha_ni_support) hash_sha_ni(in, out);
+		else if (avx2_support) hash_avx2(in, out, min_lanes, &hash_generic);
+		else
+#endif
+		hash_generic(in, out);
+	}
+
+	void hash_many(hash_impl const impl, span<span<char const> const> in
+		, span<sha256_hash> out)
+	{
+		TORRENT_ASSERT(in.size() <= out.size());
+		TORRENT_ASSERT(hash_impl_supported(impl));
+		switch (impl)
+		{
+			case hash_impl::generic:
+				hash_generic(in, out);
+				break;
+#if TORRENT_HAS_SIMD_HASH
+			case hash_impl::sha_ni:
+				hash_sha_ni(in, out);
+				break;
+			case hash_impl::avx2:
+				hash_avx2(in, out, 1, &hash_generic);
+				break;
+#else
+			case hash_impl::sha_ni:
+			case hash_impl::avx2:
+				hash_generic(in, out);
+				break;
+#endif
+		}
+	}
+
+	void hash_pairs(span<sha256_hash const> const in, span<sha256_hash> const out)
+	{
+		TORRENT_ASSERT(in.size() >= out.size() * 2);
+
+		// the nodes are hashed in batches, into a temporary array, to allow
+		// out to alias in. Each batch has read all of its input by the time
+		// its output is copied back
+		constexpr int batch_size = 16;
+		std::array<span<char const>, batch_size> buffers;
+		std::array<sha256_hash, batch_size> hashes;
+		for (std::ptrdiff_t i = 0; i < out.size(); i += batch_size)
+		{
+			int const n = int(std::min(std::ptrdiff_t(batch_size), out.size() - i));
+			for (int k = 0; k < n; ++k)
+			{
+				// the two children are adjacent in memory, they can be hashed
+				// as a single 64 byte buffer
+				buffers[std::size_t(k)] = {in[(i + k) * 2].data(), sha256_hash::size() * 2};
+			}
+			hash_many(span<span<char const> const>(buffers).first(n)
+				, span<sha256_hash>(hashes).first(n));
+			std::copy(hashes.begin(), hashes.begin() + n, out.begin() + i);
+		}
+	}
+
+#if TORRENT_HAS_SIMD_HASH
+
+namespace {
+
+	// one group of 4 SHA-256 rounds (2 per sha256rnds2 instruction). ``w``
+	// holds the message schedule for the last 4 groups
+	template <int G>
+	TORRENT_TARGET_SHA_NI inline
+	void sha256_rounds(__m128i& state0, __m128i& state1, __m128i* w
+		, u8 const* block, __m128i const mask)
+	{
+		if (G < 4)
+		{
+			w[G] = _mm_shuffle_epi8(_mm_loadu_si128(
+				reinterpret_cast<__m128i const*>(block + G * 16)), mask);
+		}
+		else
+		{
+			// message words 4G .. 4G+3
+			__m128i const w7 = _mm_alignr_epi8(w[(G - 1) & 3], w[(G - 2) & 3], 4);
+			__m128i const x = _mm_add_epi32(
+				_mm_sha256msg1_epu32(w[G & 3], w[(G - 3) & 3]), w7);
+			w[G & 3] = _mm_sha256msg2_epu32(x, w[(G - 1) & 3]);
+		}
+
+		__m128i msg = _mm_add_epi32(w[G & 3]
+			, _mm_load_si128(reinterpret_cast<__m128i const*>(K256 + G * 4)));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		msg = _mm_shuffle_epi32(msg, 0x0e);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+	}
+
+	template <std::size_t... G>
+	TORRENT_TARGET_SHA_NI inline
+	void sha256_block(__m128i& state0, __m128i& state1, u8 const* block
+		, __m128i const mask, std::index_sequence<G...>)
+	{
+		__m128i w[4];
+		int const dummy[] = { (sha256_rounds<int(G)>(state0, state1, w, block, mask), 0)... };
+		TORRENT_UNUSED(dummy);
+	}
+}
+
+	TORRENT_TARGET_SHA_NI
+	void sha256_compress_ni(u32* state, u8 const* blocks, std::size_t num)
+	{
+		__m128i const mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+		// the rounds instructions want the state as ABEF and CDGH
+		__m128i tmp = _mm_loadu_si128(reinterpret_cast<__m128i const*>(state));
+		__m128i state1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(state + 4));
+		tmp = _mm_shuffle_epi32(tmp, 0xb1); // CDAB
+		state1 = _mm_shuffle_epi32(state1, 0x1b); // EFGH
+		__m128i state0 = _mm_alignr_epi8(tmp, state1, 8); // ABEF
+		state1 = _mm_blend_epi16(state1, tmp, 0xf0); // CDGH
+
+		for (std::size_t blk = 0; blk < num; ++blk, blocks += 64)
+		{
+			__m128i const abef = state0;
+			__m128i const cdgh = state1;
+			sha256_block(state0, state1, blocks, mask, std::make_index_sequence<16>{});
+			state0 = _mm_add_epi32(state0, abef);
+			state1 = _mm_add_epi32(state1, cdgh);
+		}
+
+		tmp = _mm_shuffle_epi32(state0, 0x1b); // FEBA
+		state1 = _mm_shuffle_epi32(state1, 0xb1); // DCHG
+		state0 = _mm_blend_epi16(tmp, state1, 0xf0); // DCBA
+		state1 = _mm_alignr_epi8(state1, tmp, 8); // HGFE
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(state), state0);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), state1);
+	}
+
+namespace {
+
+	// one group of 4 SHA-1 rounds. ``m`` holds the message schedule for the
+	// current group (G) and the 3 following ones, ``e0`` and ``e1`` alternate
+	// between holding E for the current and the next group
+	template <int G>
+	TORRENT_TARGET_SHA_NI inline
+	void sha1_rounds(__m128i& abcd, __m128i& e0, __m128i& e1, __m128i* m
+		, u8 const* block, __m128i const mask)
+	{
+		__m128i& e_cur = (G & 1) ? e1 : e0;
+		__m128i& e_next = (G & 1) ? e0 : e1;
+
+		if (G < 4)
+		{
+			m[G] = _mm_shuffle_epi8(_mm_loadu_si128(
+				reinterpret_cast<__m128i const*>(block + G * 16)), mask);
+		}
+
+		if (G == 0) e_cur = _mm_add_epi32(e_cur, m[0]);
+		else e_cur = _mm_sha1nexte_epu32(e_cur, m[G & 3]);
+		e_next = abcd;
+
+		// finish the message words of the next group
+		if (G >= 3 && G <= 18)
+			m[(G + 1) & 3] = _mm_sha1msg2_epu32(m[(G + 1) & 3], m[G & 3]);
+
+		abcd = _mm_sha1rnds4_epu32(abcd, e_cur, G / 5);
+
+		if (G >= 1 && G <= 16)
+			m[(G - 1) & 3] = _mm_sha1msg1_epu32(m[(G - 1) & 3], m[G & 3]);
+		if (G >= 2 && G <= 17)
+			m[(G - 2) & 3] = _mm_xor_si128(m[(G - 2) & 3], m[G & 3]);
+	}
+
+	template <std::size_t... G>
+	TORRENT_TARGET_SHA_NI inline
+	void sha1_block(__m128i& abcd, __m128i& e0, u8 const* block, __m128i const mask
+		, std::index_sequence<G...>)
+	{
+		__m128i e1 = _mm_setzero_si128();
+		__m128i m[4];
+		int const dummy[] = { (sha1_rounds<int(G)>(abcd, e0, e1, m, block, mask), 0)... };
+		TORRENT_UNUSED(dummy);
+	}
+}
+
+	TORRENT_TARGET_SHA_NI
+	void sha1_compress_ni(u32* state, u8 const* blocks, std::size_t num)
+	{
+		__m128i const mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+		__m128i abcd = _mm_loadu_si128(reinterpret_cast<__m128i const*>(state));
+		abcd = _mm_shuffle_epi32(abcd, 0x1b);
+		__m128i e0 = _mm_set_epi32(int(state[4]), 0, 0, 0);
+
+		for (std::size_t blk = 0; blk < num; ++blk, blocks += 64)
+		{
+			__m128i const abcd_save = abcd;
+			__m128i const e0_save = e0;
+
+			sha1_block(abcd, e0, blocks, mask, std::make_index_sequence<20>{});
+
+			e0 = _mm_sha1nexte_epu32(e0, e0_save);
+			abcd = _mm_add_epi32(abcd, abcd_save);
+		}
+
+		abcd = _mm_shuffle_epi32(abcd, 0x1b);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(state), abcd);
+		state[4] = u32(_mm_extract_epi32(e0, 3));
+	}
+
+#endif // TORRENT_HAS_SIMD_HASH
+}
+}
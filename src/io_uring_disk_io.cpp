@@ -0,0 +1,1684 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/config.hpp"
+
+#if TORRENT_HAVE_IO_URING
+
+#include "libtorrent/io_uring_disk_io.hpp"
+#include "libtorrent/posix_disk_io.hpp"
+#include "libtorrent/disk_interface.hpp"
+#include "libtorrent/disk_buffer_holder.hpp"
+#include "libtorrent/io_context.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/settings_pack.hpp"
+#include "libtorrent/hasher.hpp"
+#include "libtorrent/add_torrent_params.hpp"
+#include "libtorrent/error.hpp"
+#include "libtorrent/platform_util.hpp"
+#include "libtorrent/tailqueue.hpp"
+#include "libtorrent/aux_/io_uring.hpp"
+#include "libtorrent/aux_/disk_buffer_pool.hpp"
+#include "libtorrent/aux_/disk_io_thread_pool.hpp"
+#include "libtorrent/aux_/mmap_disk_job.hpp" // for job_action_t
+#include "libtorrent/aux_/posix_storage.hpp"
+#include "libtorrent/aux_/store_buffer.hpp"
+#include "libtorrent/aux_/storage_free_list.hpp"
+#include "libtorrent/aux_/path.hpp"
+#include "libtorrent/aux_/time.hpp"
+#include "libtorrent/aux_/numeric_cast.hpp"
+#include "libtorrent/aux_/throw.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace libtorrent {
+
+namespace {
+
+	using aux::posix_storage;
+	using aux::job_action_t;
+
+	// the number of entries in the submission queue. The completion queue
+	// is twice as large, and bounds the number of file operations we keep
+	// in-flight at any given time
+	constexpr unsigned ring_entries = 256;
+
+	// the user_data value of the poll request on the eventfd, used to wake
+	// up the disk thread when new jobs are submitted
+	constexpr std::uint64_t wakeup_tag = std::numeric_limits<std::uint64_t>::max();
+
+	struct uring_job;
+
+	struct uring_storage
+	{
+		explicit uring_storage(storage_params const& p) : storage(p) {}
+
+		posix_storage storage;
+
+		// the remaining members are only accessed by the disk thread
+
+		// the number of jobs with file operations in-flight on this storage
+		int outstanding = 0;
+
+		// when a fence job is issued while there are outstanding jobs, it's
+		// queued up here, along with every job issued after it. They're
+		// dispatched once the outstanding jobs have completed
+		tailqueue<uring_job> blocked;
+
+		// maps file index to the slot in the open file table holding a file
+		// descriptor for it, or -1
+		aux::vector<int, file_index_t> open_files;
+	};
+
+	struct uring_job : tailqueue_node<uring_job>
+	{
+		uring_job(job_action_t const a, std::shared_ptr<uring_storage> st)
+			: action(a), storage(std::move(st)) {}
+
+		job_action_t action;
+		std::shared_ptr<uring_storage> storage;
+
+		// the index of the storage, as used by the store buffer
+		storage_index_t storage_index{0};
+
+		piece_index_t piece{0};
+
+		// for read, write and hash2 jobs, the offset into the piece and the
+		// number of bytes to transfer
+		int offset = 0;
+		int length = 0;
+
+		// for read jobs, this is the number of bytes into the buffer to read
+		// into. Used when part of the request was satisfied by the store
+		// buffer
+		int buffer_offset = 0;
+
+		disk_job_flags_t flags{};
+
+		// set for hash jobs that have been cancelled (see abort_hash_jobs())
+		bool aborted = false;
+
+		// the buffer for read, write and hash2 jobs
+		disk_buffer_holder buffer;
+
+		// for hash jobs, one buffer per block in the piece
+		std::vector<disk_buffer_holder> blocks;
+		span<sha256_hash> block_hashes;
+
+		sha1_hash piece_hash;
+		sha256_hash piece_hash2;
+
+		// the number of file operations in-flight for this job
+		int pending = 0;
+
+		storage_error error;
+		status_t ret = status_t::no_error;
+		time_point start_time;
+
+		// fence jobs (and other jobs that don't touch file contents) are
+		// executed synchronously by the disk thread, by calling this
+		std::function<void(uring_job&)> execute;
+
+		// called in the network thread once the job completes
+		std::function<void(uring_job&)> callback;
+	};
+
+	void wake_up(int const fd)
+	{
+		std::uint64_t const val = 1;
+		auto const ret = ::write(fd, &val, sizeof(val));
+		TORRENT_UNUSED(ret);
+	}
+
+	bool is_fence(job_action_t const a)
+	{
+		return a != job_action_t::read
+			&& a != job_action_t::write
+			&& a != job_action_t::hash
+			&& a != job_action_t::hash2;
+	}
+
+	// an entry in the open file table
+	struct open_file
+	{
+		std::shared_ptr<uring_storage> storage;
+		file_index_t file{0};
+		int fd = -1;
+		bool writable = false;
+
+		// the number of file operations in-flight against this file
+		int inflight = 0;
+
+		// set when the file has been superseded (say, re-opened for writing)
+		// while operations were in-flight. It's closed once they complete
+		bool orphaned = false;
+		time_point last_use;
+	};
+
+	// a single read or write submitted to the ring
+	struct file_op
+	{
+		uring_job* job = nullptr;
+		int slot = -1;
+		file_index_t file{0};
+		std::int64_t file_offset = 0;
+		bool write = false;
+		::iovec iov{};
+	};
+
+	// computes the piece hash and block hashes of a hash job, or the block
+	// hash of a hash2 job, from the blocks read into it. This is called in a
+	// hash thread, or in the disk thread if there aren't any
+	void compute_hash(uring_job& j)
+	{
+		if (j.action == job_action_t::hash2)
+		{
+			j.piece_hash2 = hasher256(j.buffer.data(), j.length).final();
+			return;
+		}
+
+		file_storage const& fs = j.storage->storage.files();
+		bool const v1 = bool(j.flags & disk_interface::v1_hash);
+		int const piece_size = v1 ? fs.piece_size(j.piece) : 0;
+		int const piece_size2 = j.block_hashes.empty() ? 0 : fs.piece_size2(j.piece);
+		int const blocks_in_piece2 = j.block_hashes.empty() ? 0 : fs.blocks_in_piece2(j.piece);
+
+		hasher ph;
+		int offset = 0;
+		for (int i = 0; i < int(j.blocks.size()); ++i, offset += default_block_size)
+		{
+			char const* buf = j.blocks[std::size_t(i)].data();
+			if (v1)
+				ph.update({buf, std::min(default_block_size, piece_size - offset)});
+			if (i < blocks_in_piece2)
+				j.block_hashes[i] = hasher256(buf, std::min(default_block_size, piece_size2 - offset)).final();
+		}
+		if (v1) j.piece_hash = ph.final();
+	}
+} // anonymous namespace
+
+	struct TORRENT_EXTRA_EXPORT io_uring_disk_io final
+		: disk_interface
+	{
+		io_uring_disk_io(io_context& ios, settings_interface const& sett, counters& cnt
+			, std::unique_ptr<aux::io_uring> ring, int wakeup_fd);
+		~io_uring_disk_io() override;
+
+		void settings_updated() override;
+		storage_holder new_torrent(storage_params const& params
+			, std::shared_ptr<void> const&) override;
+		void remove_torrent(storage_index_t) override;
+		void abort(bool wait) override;
+
+		void async_read(storage_index_t storage, peer_request const& r
+			, std::function<void(disk_buffer_holder block, storage_error const& se)> handler
+			, disk_job_flags_t flags) override;
+		bool async_write(storage_index_t storage, peer_request const& r
+			, char const* buf, std::shared_ptr<disk_observer> o
+			, std::function<void(storage_error const&)> handler
+			, disk_job_flags_t flags) override;
+		void async_hash(storage_index_t storage, piece_index_t piece
+			, span<sha256_hash> block_hashes, disk_job_flags_t flags
+			, std::function<void(piece_index_t, sha1_hash const&, storage_error const&)> handler) override;
+		void async_hash2(storage_index_t storage, piece_index_t piece, int offset
+			, disk_job_flags_t flags
+			, std::function<void(piece_index_t, sha256_hash const&, storage_error const&)> handler) override;
+		void async_move_storage(storage_index_t storage, std::string p, move_flags_t flags
+			, std::function<void(status_t, std::string const&, storage_error const&)> handler) override;
+		void async_release_files(storage_index_t storage
+			, std::function<void()> handler) override;
+		void async_delete_files(storage_index_t storage, remove_flags_t options
+			, std::function<void(storage_error const&)> handler) override;
+		void async_check_files(storage_index_t storage
+			, add_torrent_params const* resume_data
+			, aux::vector<std::string, file_index_t> links
+			, std::function<void(status_t, storage_error const&)> handler) override;
+		void async_rename_file(storage_index_t storage, file_index_t index, std::string name
+			, std::function<void(std::string const&, file_index_t, storage_error const&)> handler) override;
+		void async_stop_torrent(storage_index_t storage
+			, std::function<void()> handler) override;
+		void async_set_file_priority(storage_index_t storage
+			, aux::vector<download_priority_t, file_index_t> prio
+			, std::function<void(storage_error const&
+				, aux::vector<download_priority_t, file_index_t>)> handler) override;
+		void async_clear_piece(storage_index_t storage, piece_index_t index
+			, std::function<void(piece_index_t)> handler) override;
+
+		void update_stats_counters(counters& c) const override;
+
+		std::vector<open_file_state> get_status(storage_index_t) const override
+		{ return {}; }
+
+		void submit_jobs() override;
+
+	private:
+
+		uring_job* allocate_job(job_action_t a, storage_index_t storage);
+		// returns false if the job could not be queued because we're shutting
+		// down. The job is failed with operation_aborted in that case
+		bool add_job(uring_job* j);
+		void abort_hash_jobs(storage_index_t storage);
+
+		// these are called in the disk thread
+		void thread_fun(executor_work_guard<io_context::executor_type> work);
+		void dispatch(uring_job* j);
+		void start_io(uring_job* j);
+		int queue_file_op(uring_job* j, file_index_t file, std::int64_t file_offset
+			, span<char> buf, bool write, storage_error& ec);
+		void prepare_sqe(io_uring_sqe* sqe, int op_idx);
+		void resubmit_ops();
+		void wait_for_completions(unsigned wait_nr);
+		void handle_completion(io_uring_cqe const& cqe);
+		void finish_io(uring_job* j);
+		// returns false if there's no hash thread to take the job
+		bool hand_off_hash(uring_job* j);
+		void finish_hash(uring_job* j);
+		void retire_job(uring_job* j);
+		void complete_job(uring_job* j);
+		void post_completions();
+		void arm_wakeup();
+
+		int open_file_slot(std::shared_ptr<uring_storage> const& st
+			, file_index_t file, bool write, storage_error& ec);
+		void close_slot(int slot);
+		void close_files(uring_storage const& st);
+		void close_file(uring_storage& st, file_index_t file);
+
+		// called in the network thread
+		void call_job_handlers();
+
+		struct hash_queue : aux::pool_thread_interface
+		{
+			explicit hash_queue(io_uring_disk_io& owner) : m_owner(owner) {}
+
+			void notify_all() override { m_cond.notify_all(); }
+
+			void thread_fun(aux::disk_io_thread_pool& pool
+				, executor_work_guard<io_context::executor_type> work) override
+			{
+				m_owner.hash_thread_fun(pool);
+
+				// the work guard keeps the io_context alive until we're done
+				// posting to it
+				TORRENT_UNUSED(work);
+			}
+
+			io_uring_disk_io& m_owner;
+
+			// used to wake up hash threads when jobs are queued on
+			// m_hash_jobs
+			std::condition_variable m_cond;
+		};
+
+		// called in the hash threads
+		void hash_thread_fun(aux::disk_io_thread_pool& pool);
+
+		// returns true if the thread should exit
+		bool wait_for_hash_job(aux::disk_io_thread_pool& pool
+			, std::unique_lock<std::mutex>& l);
+
+		settings_interface const& m_settings;
+
+		// disk cache
+		aux::disk_buffer_pool m_buffer_pool;
+
+		counters& m_stats_counters;
+
+		// callbacks are posted on this
+		io_context& m_ios;
+
+		aux::vector<std::shared_ptr<uring_storage>, storage_index_t> m_torrents;
+
+		// slots that are unused in the m_torrents vector
+		aux::storage_free_list m_free_slots;
+
+		// every write job is inserted into this map while it is in-flight. This
+		// lets subsequent reads pull the buffers straight out of the queue
+		// instead of reading stale data from the file
+		aux::store_buffer m_store_buffer;
+
+		std::unique_ptr<aux::io_uring> m_ring;
+
+		// writing to this eventfd wakes up the disk thread
+		int m_wakeup_fd;
+
+		// the max number of idle file descriptors to keep open, mirrors the
+		// file_pool_size setting
+		std::atomic<int> m_max_open_files{40};
+
+		// protects m_queued_jobs and m_abort
+		mutable std::mutex m_job_mutex;
+		tailqueue<uring_job> m_queued_jobs;
+		bool m_abort = false;
+
+		// set when jobs have been queued since the disk thread was last woken
+		// up. Only accessed by the network thread
+		bool m_need_wakeup = false;
+
+		// jobs that have completed, and are waiting to be posted back to the
+		// network thread
+		std::mutex m_completed_jobs_mutex;
+		tailqueue<uring_job> m_completed_jobs;
+		bool m_job_completions_in_flight = false;
+
+		// the remaining members are only accessed by the disk thread
+
+		// jobs that completed in the disk thread since the last time
+		// completions were posted to the network thread
+		tailqueue<uring_job> m_done_jobs;
+
+		// jobs that were blocked behind a fence that has been lowered. They
+		// are dispatched from the top of the thread loop
+		tailqueue<uring_job> m_unblocked_jobs;
+
+		// table of open files. When the kernel supports it, this table is
+		// registered with the ring, and operations refer to files by slot
+		std::vector<open_file> m_files;
+		int m_num_open_files = 0;
+		bool m_registered_files = false;
+
+		// the file operations currently in-flight, indexed by the user_data of
+		// the submission queue entry
+		std::vector<file_op> m_ops;
+		std::vector<int> m_free_ops;
+
+		// file operations that transferred less than they were asked to and
+		// need to be submitted again for the remainder. They can't be submitted
+		// from within the completion handler, since that may require reaping
+		// more completions
+		std::vector<int> m_resubmit_ops;
+
+		// the number of jobs handed off to the hash threads that haven't been
+		// handed back yet
+		int m_num_hashing = 0;
+
+		// the number of hash jobs issued that haven't completed yet. This is
+		// how many hash threads we could keep busy. Only accessed by the
+		// network thread
+		int m_outstanding_hash_jobs = 0;
+
+		// protects m_hash_jobs, m_hashed_jobs and m_num_hash_workers
+		std::mutex m_hash_mutex;
+
+		// jobs whose blocks have been read, waiting for a hash thread
+		tailqueue<uring_job> m_hash_jobs;
+
+		// jobs that have been hashed, waiting for the disk thread to complete
+		// them
+		tailqueue<uring_job> m_hashed_jobs;
+
+		// the number of hash threads that are running. Once the last one has
+		// exited (or if none has started yet) hashing falls back to the disk
+		// thread
+		int m_num_hash_workers = 0;
+
+		hash_queue m_hash_queue{*this};
+
+		// SHA-1 and SHA-256 are run on these threads, leaving the disk thread
+		// free to keep the ring busy. The number of threads is controlled by
+		// the hashing_threads setting
+		aux::disk_io_thread_pool m_hash_threads;
+
+		std::thread m_thread;
+	};
+
+	io_uring_disk_io::io_uring_disk_io(io_context& ios, settings_interface const& sett
+		, counters& cnt, std::unique_ptr<aux::io_uring> ring, int const wakeup_fd)
+		: m_settings(sett)
+		, m_buffer_pool(ios)
+		, m_stats_counters(cnt)
+		, m_ios(ios)
+		, m_ring(std::move(ring))
+		, m_wakeup_fd(wakeup_fd)
+		, m_ops(m_ring->cq_entries() - 1)
+		, m_hash_threads(m_hash_queue, ios)
+	{
+		settings_updated();
+
+		m_files.resize(m_ops.size());
+		error_code ignore;
+		m_registered_files = m_ring->register_files(int(m_files.size()), ignore);
+
+		m_free_ops.reserve(m_ops.size());
+		for (int i = int(m_ops.size()) - 1; i >= 0; --i)
+			m_free_ops.push_back(i);
+
+		m_thread = std::thread([this, w = make_work_guard(m_ios)]() mutable
+			{ thread_fun(std::move(w)); });
+	}
+
+	io_uring_disk_io::~io_uring_disk_io()
+	{
+		if (m_thread.joinable()) abort(true);
+		::close(m_wakeup_fd);
+	}
+
+	void io_uring_disk_io::settings_updated()
+	{
+		m_buffer_pool.set_settings(m_settings);
+		m_max_open_files = std::max(1, m_settings.get_int(settings_pack::file_pool_size));
+		m_hash_threads.set_max_threads(m_settings.get_int(settings_pack::hashing_threads));
+	}
+
+	storage_holder io_uring_disk_io::new_torrent(storage_params const& params
+		, std::shared_ptr<void> const&)
+	{
+		// make sure we can remove this torrent without causing a memory
+		// allocation, by causing the allocation now instead
+		storage_index_t const idx = m_free_slots.new_index(m_torrents.end_index());
+		auto storage = std::make_shared<uring_storage>(params);
+		storage->open_files.resize(params.files.num_files(), -1);
+		if (idx == m_torrents.end_index()) m_torrents.emplace_back(std::move(storage));
+		else m_torrents[idx] = std::move(storage);
+		return storage_holder(idx, *this);
+	}
+
+	void io_uring_disk_io::remove_torrent(storage_index_t const idx)
+	{
+		// the file descriptors referring to this storage are closed by the disk
+		// thread, once any outstanding jobs have completed
+		uring_job* j = allocate_job(job_action_t::release_files, idx);
+		j->execute = [this](uring_job& job) { close_files(*job.storage); };
+		add_job(j);
+		submit_jobs();
+
+		m_torrents[idx].reset();
+		m_free_slots.add(idx);
+	}
+
+	void io_uring_disk_io::abort(bool const wait)
+	{
+		{
+			std::lock_guard<std::mutex> l(m_job_mutex);
+			if (m_abort) return;
+			m_abort = true;
+		}
+		wake_up(m_wakeup_fd);
+
+		if (wait) m_thread.join();
+		else m_thread.detach();
+
+		// if the disk thread is still running, it falls back to hashing
+		// on its own once the last hash thread has exited
+		m_hash_threads.abort(wait);
+	}
+
+	uring_job* io_uring_disk_io::allocate_job(job_action_t const a
+		, storage_index_t const storage)
+	{
+		auto* j = new uring_job(a, m_torrents[storage]);
+		j->storage_index = storage;
+		return j;
+	}
+
+	bool io_uring_disk_io::add_job(uring_job* j)
+	{
+		std::unique_lock<std::mutex> l(m_job_mutex);
+		if (m_abort)
+		{
+			l.unlock();
+			// we're shutting down, fail the job immediately
+			j->error = storage_error(boost::asio::error::operation_aborted);
+			j->ret = status_t::fatal_disk_error;
+			std::lock_guard<std::mutex> cl(m_completed_jobs_mutex);
+			m_completed_jobs.push_back(j);
+			if (!m_job_completions_in_flight)
+			{
+				post(m_ios, [this] { call_job_handlers(); });
+				m_job_completions_in_flight = true;
+			}
+			return false;
+		}
+		m_queued_jobs.push_back(j);
+		m_need_wakeup = true;
+		return true;
+	}
+
+	void io_uring_disk_io::submit_jobs()
+	{
+		if (!m_need_wakeup) return;
+		m_need_wakeup = false;
+		wake_up(m_wakeup_fd);
+
+		// make sure there are hash threads ready to take the hash jobs once
+		// their blocks have been read
+		if (m_outstanding_hash_jobs > 0)
+			m_hash_threads.job_queued(m_outstanding_hash_jobs);
+	}
+
+	void io_uring_disk_io::async_read(storage_index_t const storage, peer_request const& r
+		, std::function<void(disk_buffer_holder block, storage_error const& se)> handler
+		, disk_job_flags_t const flags)
+	{
+		TORRENT_ASSERT(r.length <= default_block_size);
+		TORRENT_ASSERT(r.length > 0);
+		TORRENT_ASSERT(r.start >= 0);
+
+		storage_error ec;
+		if (r.length <= 0 || r.start < 0)
+		{
+			// this is an invalid read request.
+			ec.ec = errors::invalid_request;
+			ec.operation = operation_t::file_read;
+			handler(disk_buffer_holder{}, ec);
+			return;
+		}
+
+		// the store buffer is indexed by block-aligned offsets. block_offset is
+		// the aligned offset of the first block this read touches and
+		// read_offset is the offset into that block
+		int const block_offset = r.start - (r.start % default_block_size);
+		int const read_offset = r.start - block_offset;
+
+		disk_buffer_holder buffer;
+
+		// the range of the request that still needs to be read from disk
+		int disk_start = r.start;
+		int disk_length = r.length;
+		int buffer_offset = 0;
+
+		if (read_offset + r.length > default_block_size)
+		{
+			// This is an unaligned request spanning two blocks. Either block may
+			// be in the store buffer
+			aux::torrent_location const loc1{storage, r.piece, block_offset};
+			aux::torrent_location const loc2{storage, r.piece, block_offset + default_block_size};
+			int const len1 = default_block_size - read_offset;
+
+			int const ret = m_store_buffer.get2(loc1, loc2, [&](char const* buf1, char const* buf2)
+			{
+				buffer = disk_buffer_holder(m_buffer_pool, m_buffer_pool.allocate_buffer("send buffer"), r.length);
+				if (!buffer)
+				{
+					ec.ec = error::no_memory;
+					ec.operation = operation_t::alloc_cache_piece;
+					return 3;
+				}
+
+				if (buf1)
+					std::memcpy(buffer.data(), buf1 + read_offset, std::size_t(len1));
+				if (buf2)
+					std::memcpy(buffer.data() + len1, buf2, std::size_t(r.length - len1));
+				return (buf1 ? 2 : 0) | (buf2 ? 1 : 0);
+			});
+
+			if (ret == 3)
+			{
+				// the request was satisfied by the store buffer (or we failed to
+				// allocate a buffer)
+				handler(std::move(buffer), ec);
+				return;
+			}
+
+			if (ret == 1)
+			{
+				// the second block was found, read the first part from disk
+				disk_length = len1;
+			}
+			else if (ret == 2)
+			{
+				// the first block was found, read the second part from disk
+				disk_start = block_offset + default_block_size;
+				disk_length = r.length - len1;
+				buffer_offset = len1;
+			}
+		}
+		else
+		{
+			if (m_store_buffer.get({ storage, r.piece, block_offset }, [&](char const* buf)
+			{
+				buffer = disk_buffer_holder(m_buffer_pool, m_buffer_pool.allocate_buffer("send buffer"), r.length);
+				if (!buffer)
+				{
+					ec.ec = error::no_memory;
+					ec.operation = operation_t::alloc_cache_piece;
+					return;
+				}
+
+				std::memcpy(buffer.data(), buf + read_offset, std::size_t(r.length));
+			}))
+			{
+				handler(std::move(buffer), ec);
+				return;
+			}
+		}
+
+		uring_job* j = allocate_job(job_action_t::read, storage);
+		j->piece = r.piece;
+		j->offset = disk_start;
+		j->length = disk_length;
+		j->buffer_offset = buffer_offset;
+		j->buffer = std::move(buffer);
+		j->flags = flags;
+		j->callback = [h = std::move(handler)](uring_job& job)
+			{ h(std::move(job.buffer), job.error); };
+		add_job(j);
+	}
+
+	bool io_uring_disk_io::async_write(storage_index_t const storage, peer_request const& r
+		, char const* buf, std::shared_ptr<disk_observer> o
+		, std::function<void(storage_error const&)> handler
+		, disk_job_flags_t const flags)
+	{
+		TORRENT_ASSERT(r.start % default_block_size == 0);
+		TORRENT_ASSERT(r.length <= default_block_size);
+
+		bool exceeded = false;
+		disk_buffer_holder buffer(m_buffer_pool, m_buffer_pool.allocate_buffer(
+			exceeded, std::move(o), "receive buffer"), default_block_size);
+		if (!buffer) aux::throw_ex<std::bad_alloc>();
+		std::memcpy(buffer.data(), buf, aux::numeric_cast<std::size_t>(r.length));
+
+		uring_job* j = allocate_job(job_action_t::write, storage);
+		j->piece = r.piece;
+		j->offset = r.start;
+		j->length = r.length;
+		j->buffer = std::move(buffer);
+		j->flags = flags;
+		j->callback = [h = std::move(handler)](uring_job& job) { h(job.error); };
+
+		aux::torrent_location const loc{storage, r.piece, r.start};
+		m_store_buffer.insert(loc, j->buffer.data());
+		if (!add_job(j)) m_store_buffer.erase(loc);
+		return exceeded;
+	}
+
+	void io_uring_disk_io::async_hash(storage_index_t const storage
+		, piece_index_t const piece, span<sha256_hash> const block_hashes
+		, disk_job_flags_t const flags
+		, std::function<void(piece_index_t, sha1_hash const&, storage_error const&)> handler)
+	{
+		uring_job* j = allocate_job(job_action_t::hash, storage);
+		j->piece = piece;
+		j->block_hashes = block_hashes;
+		j->flags = flags;
+		j->callback = [h = std::move(handler)](uring_job& job)
+			{ h(job.piece, job.piece_hash, job.error); };
+		++m_outstanding_hash_jobs;
+		add_job(j);
+	}
+
+	void io_uring_disk_io::async_hash2(storage_index_t const storage
+		, piece_index_t const piece, int const offset, disk_job_flags_t const flags
+		, std::function<void(piece_index_t, sha256_hash const&, storage_error const&)> handler)
+	{
+		uring_job* j = allocate_job(job_action_t::hash2, storage);
+		j->piece = piece;
+		j->offset = offset;
+		j->flags = flags;
+		j->callback = [h = std::move(handler)](uring_job& job)
+			{ h(job.piece, job.piece_hash2, job.error); };
+		++m_outstanding_hash_jobs;
+		add_job(j);
+	}
+
+	void io_uring_disk_io::async_move_storage(storage_index_t const storage
+		, std::string p, move_flags_t const flags
+		, std::function<void(status_t, std::string const&, storage_error const&)> handler)
+	{
+		uring_job* j = allocate_job(job_action_t::move_storage, storage);
+		auto path = std::make_shared<std::string>(std::move(p));
+		j->execute = [this, path, flags](uring_job& job)
+		{
+			// the files are re-opened from the new location on demand
+			close_files(*job.storage);
+			std::tie(job.ret, *path) = job.storage->storage.move_storage(*path, flags, job.error);
+		};
+		j->callback = [path, h = std::move(handler)](uring_job& job)
+			{ h(job.ret, *path, job.error); };
+		add_job(j);
+	}
+
+	void io_uring_disk_io::async_release_files(storage_index_t const storage
+		, std::function<void()> handler)
+	{
+		uring_job* j = allocate_job(job_action_t::release_files, storage);
+		j->execute = [this](uring_job& job)
+		{
+			close_files(*job.storage);
+			job.storage->storage.release_files();
+		};
+		if (handler)
+			j->callback = [h = std::move(handler)](uring_job&) { h(); };
+		add_job(j);
+	}
+
+	void io_uring_disk_io::abort_hash_jobs(storage_index_t const storage)
+	{
+		// cancel queued full-checking jobs belonging to this torrent. These jobs
+		// are likely to have a deep queue and can easily be restarted
+		std::shared_ptr<uring_storage> const& st = m_torrents[storage];
+		std::lock_guard<std::mutex> l(m_job_mutex);
+		for (auto i = m_queued_jobs.iterate(); i.get(); i.next())
+		{
+			uring_job* j = i.get();
+			if (j->storage != st) continue;
+			if (j->action != job_action_t::hash && j->action != job_action_t::hash2) continue;
+			if (!(j->flags & disk_interface::volatile_read)) continue;
+			j->aborted = true;
+		}
+	}
+
+	void io_uring_disk_io::async_delete_files(storage_index_t const storage
+		, remove_flags_t const options
+		, std::function<void(storage_error const&)> handler)
+	{
+		abort_hash_jobs(storage);
+		uring_job* j = allocate_job(job_action_t::delete_files, storage);
+		j->execute = [this, options](uring_job& job)
+		{
+			close_files(*job.storage);
+			job.storage->storage.delete_files(options, job.error);
+		};
+		j->callback = [h = std::move(handler)](uring_job& job) { h(job.error); };
+		add_job(j);
+	}
+
+	void io_uring_disk_io::async_check_files(storage_index_t const storage
+		, add_torrent_params const* resume_data
+		, aux::vector<std::string, file_index_t> links
+		, std::function<void(status_t, storage_error const&)> handler)
+	{
+		uring_job* j = allocate_job(job_action_t::check_fastresume, storage);
+		j->execute = [this, resume_data, l = std::move(links)](uring_job& job)
+		{
+			posix_storage& st = job.storage->storage;
+			add_torrent_params tmp;
+			add_torrent_params const* rd = resume_data ? resume_data : &tmp;
+
+			job.ret = [&]
+			{
+				auto const ret_flag = st.initialize(m_settings, job.error);
+				if (job.error) return status_t::fatal_disk_error | ret_flag;
+
+				bool const verify_success = st.verify_resume_data(*rd
+					, l, job.error);
+
+				if (m_settings.get_bool(settings_pack::no_recheck_incomplete_resume))
+					return status_t::no_error | ret_flag;
+
+				if (!aux::contains_resume_data(*rd))
+				{
+					// if we don't have any resume data, we still may need to trigger a
+					// full re-check, if there are *any* files.
+					storage_error ignore;
+					return ((st.has_any_file(ignore))
+						? status_t::need_full_check
+						: status_t::no_error)
+						| ret_flag;
+				}
+
+				return (verify_success
+					? status_t::no_error
+					: status_t::need_full_check)
+					| ret_flag;
+			}();
+		};
+		j->callback = [h = std::move(handler)](uring_job& job) { h(job.ret, job.error); };
+		add_job(j);
+	}
+
+	void io_uring_disk_io::async_rename_file(storage_index_t const storage
+		, file_index_t const idx, std::string name
+		, std::function<void(std::string const&, file_index_t, storage_error const&)> handler)
+	{
+		uring_job* j = allocate_job(job_action_t::rename_file, storage);
+		auto n = std::make_shared<std::string>(std::move(name));
+		j->execute = [this, idx, n](uring_job& job)
+		{
+			close_file(*job.storage, idx);
+			job.storage->storage.rename_file(idx, *n, job.error);
+		};
+		j->callback = [idx, n, h = std::move(handler)](uring_job& job)
+			{ h(*n, idx, job.error); };
+		add_job(j);
+	}
+
+	void io_uring_disk_io::async_stop_torrent(storage_index_t const storage
+		, std::function<void()> handler)
+	{
+		abort_hash_jobs(storage);
+		uring_job* j = allocate_job(job_action_t::stop_torrent, storage);
+		j->execute = [this](uring_job& job)
+		{
+			close_files(*job.storage);
+			job.storage->storage.release_files();
+		};
+		if (handler)
+			j->callback = [h = std::move(handler)](uring_job&) { h(); };
+		add_job(j);
+	}
+
+	void io_uring_disk_io::async_set_file_priority(storage_index_t const storage
+		, aux::vector<download_priority_t, file_index_t> prio
+		, std::function<void(storage_error const&
+			, aux::vector<download_priority_t, file_index_t>)> handler)
+	{
+		uring_job* j = allocate_job(job_action_t::file_priority, storage);
+		auto p = std::make_shared<aux::vector<download_priority_t, file_index_t>>(std::move(prio));
+		j->execute = [p](uring_job& job)
+		{
+			job.storage->storage.set_file_priority(*p, job.error);
+		};
+		j->callback = [p, h = std::move(handler)](uring_job& job)
+			{ h(job.error, std::move(*p)); };
+		add_job(j);
+	}
+
+	void io_uring_disk_io::async_clear_piece(storage_index_t const storage
+		, piece_index_t const index, std::function<void(piece_index_t)> handler)
+	{
+		// this is a fence job, by the time it's executed all outstanding
+		// writes to the storage have completed
+		uring_job* j = allocate_job(job_action_t::clear_piece, storage);
+		j->piece = index;
+		j->callback = [h = std::move(handler)](uring_job& job) { h(job.piece); };
+		add_job(j);
+	}
+
+	void io_uring_disk_io::update_stats_counters(counters& c) const
+	{
+		{
+			std::lock_guard<std::mutex> l(m_job_mutex);
+			c.set_value(counters::queued_disk_jobs, m_queued_jobs.size());
+		}
+		m_buffer_pool.update_stats_counters(c);
+	}
+
+	void io_uring_disk_io::thread_fun(executor_work_guard<io_context::executor_type> work)
+	{
+		set_thread_name("libtorrent-disk-thread");
+		m_stats_counters.inc_stats_counter(counters::num_running_threads, 1);
+
+		arm_wakeup();
+
+		for (;;)
+		{
+			tailqueue<uring_job> jobs;
+			bool abort;
+			{
+				std::lock_guard<std::mutex> l(m_job_mutex);
+				jobs = std::move(m_queued_jobs);
+				abort = m_abort;
+			}
+
+			tailqueue<uring_job> hashed;
+			{
+				std::lock_guard<std::mutex> l(m_hash_mutex);
+				hashed = std::move(m_hashed_jobs);
+			}
+			while (!hashed.empty())
+			{
+				TORRENT_ASSERT(m_num_hashing > 0);
+				--m_num_hashing;
+				finish_hash(hashed.pop_front());
+			}
+
+			// jobs that were blocked behind a fence were issued before any of
+			// the new jobs, so they take precedence
+			for (;;)
+			{
+				uring_job* j = nullptr;
+				if (!m_unblocked_jobs.empty()) j = m_unblocked_jobs.pop_front();
+				else if (!jobs.empty()) j = jobs.pop_front();
+				else break;
+				dispatch(j);
+			}
+
+			post_completions();
+
+			if (abort && int(m_free_ops.size()) == int(m_ops.size())
+				&& m_num_hashing == 0)
+			{
+				std::lock_guard<std::mutex> l(m_job_mutex);
+				if (m_queued_jobs.empty() && m_unblocked_jobs.empty()) break;
+			}
+
+			// submit the file operations queued up by the jobs above, and wait
+			// for at least one of them to complete (or for new jobs)
+			wait_for_completions(1);
+		}
+
+		for (int i = 0; i < int(m_files.size()); ++i)
+			close_slot(i);
+
+		m_stats_counters.inc_stats_counter(counters::num_running_threads, -1);
+
+		// the work guard is released when we return, which allows the
+		// io_context's run() to return
+		TORRENT_UNUSED(work);
+	}
+
+	void io_uring_disk_io::dispatch(uring_job* j)
+	{
+		uring_storage& st = *j->storage;
+
+		// if there's a fence up, all subsequent jobs are queued behind it
+		if (!st.blocked.empty())
+		{
+			st.blocked.push_back(j);
+			return;
+		}
+
+		if (j->aborted)
+		{
+			j->ret = status_t::fatal_disk_error;
+			j->error = storage_error(boost::asio::error::operation_aborted);
+			complete_job(j);
+			return;
+		}
+
+		if (!is_fence(j->action))
+		{
+			start_io(j);
+			return;
+		}
+
+		if (st.outstanding > 0)
+		{
+			m_stats_counters.inc_stats_counter(counters::blocked_disk_jobs);
+			st.blocked.push_back(j);
+			return;
+		}
+
+		if (j->execute)
+		{
+			try
+			{
+				j->execute(*j);
+			}
+			catch (boost::system::system_error const& err)
+			{
+				j->ret = status_t::fatal_disk_error;
+				j->error.ec = err.code();
+				j->error.operation = operation_t::exception;
+			}
+			catch (std::bad_alloc const&)
+			{
+				j->ret = status_t::fatal_disk_error;
+				j->error.ec = errors::no_memory;
+				j->error.operation = operation_t::exception;
+			}
+			catch (std::exception const&)
+			{
+				j->ret = status_t::fatal_disk_error;
+				j->error.ec = boost::asio::error::fault;
+				j->error.operation = operation_t::exception;
+			}
+		}
+		complete_job(j);
+	}
+
+	void io_uring_disk_io::start_io(uring_job* j)
+	{
+		uring_storage& st = *j->storage;
+		++st.outstanding;
+		j->start_time = clock_type::now();
+
+		// hold a reference while issuing the file operations, to not have the
+		// job complete before all of them have been queued
+		j->pending = 1;
+
+		auto read_op = [this, j](file_index_t const file, std::int64_t const file_offset
+			, span<char> buf, storage_error& ec)
+		{ return queue_file_op(j, file, file_offset, buf, false, ec); };
+
+		switch (j->action)
+		{
+			case job_action_t::read:
+			{
+				if (!j->buffer)
+				{
+					j->buffer = disk_buffer_holder(m_buffer_pool
+						, m_buffer_pool.allocate_buffer("send buffer"), default_block_size);
+				}
+				if (!j->buffer)
+				{
+					j->error.ec = error::no_memory;
+					j->error.operation = operation_t::alloc_cache_piece;
+					break;
+				}
+				span<char> const b = {j->buffer.data() + j->buffer_offset, j->length};
+				st.storage.read(m_settings, b, j->piece, j->offset, read_op, j->error);
+				break;
+			}
+			case job_action_t::write:
+			{
+				span<char> const b = {j->buffer.data(), j->length};
+				st.storage.write(m_settings, b, j->piece, j->offset
+					, [this, j](file_index_t const file, std::int64_t const file_offset
+						, span<char> buf, storage_error& ec)
+					{ return queue_file_op(j, file, file_offset, buf, true, ec); }
+					, j->error);
+				break;
+			}
+			case job_action_t::hash:
+			{
+				file_storage const& fs = st.storage.files();
+				bool const v1 = bool(j->flags & disk_interface::v1_hash);
+				bool const v2 = !j->block_hashes.empty();
+				int const piece_size = v1 ? fs.piece_size(j->piece) : 0;
+				int const piece_size2 = v2 ? fs.piece_size2(j->piece) : 0;
+				int const blocks_in_piece = v1 ? (piece_size + default_block_size - 1) / default_block_size : 0;
+				int const blocks_in_piece2 = v2 ? fs.blocks_in_piece2(j->piece) : 0;
+				int const blocks_to_read = std::max(blocks_in_piece, blocks_in_piece2);
+
+				j->blocks.reserve(std::size_t(blocks_to_read));
+				for (int i = 0; i < blocks_to_read; ++i)
+				{
+					int const offset = i * default_block_size;
+					int const len = v1 ? std::min(default_block_size, piece_size - offset) : 0;
+					int const len2 = i < blocks_in_piece2 ? std::min(default_block_size, piece_size2 - offset) : 0;
+					int const block_len = std::max(len, len2);
+
+					j->blocks.emplace_back(m_buffer_pool
+						, m_buffer_pool.allocate_buffer("hash buffer"), default_block_size);
+					char* const buf = j->blocks.back().data();
+					if (buf == nullptr)
+					{
+						j->error.ec = error::no_memory;
+						j->error.operation = operation_t::alloc_cache_piece;
+						break;
+					}
+
+					if (m_store_buffer.get({j->storage_index, j->piece, offset}
+						, [&](char const* b) { std::memcpy(buf, b, std::size_t(block_len)); }))
+						continue;
+
+					st.storage.read(m_settings, {buf, block_len}, j->piece, offset
+						, read_op, j->error);
+					if (j->error) break;
+				}
+				break;
+			}
+			case job_action_t::hash2:
+			{
+				int const piece_size = st.storage.files().piece_size2(j->piece);
+				TORRENT_ASSERT(piece_size > j->offset);
+				j->length = std::min(default_block_size, piece_size - j->offset);
+
+				j->buffer = disk_buffer_holder(m_buffer_pool
+					, m_buffer_pool.allocate_buffer("hash buffer"), default_block_size);
+				if (!j->buffer)
+				{
+					j->error.ec = error::no_memory;
+					j->error.operation = operation_t::alloc_cache_piece;
+					break;
+				}
+
+				char* const buf = j->buffer.data();
+				if (m_store_buffer.get({j->storage_index, j->piece, j->offset}
+					, [&](char const* b) { std::memcpy(buf, b, std::size_t(j->length)); }))
+					break;
+
+				st.storage.read(m_settings, {buf, j->length}, j->piece, j->offset
+					, read_op, j->error);
+				break;
+			}
+			default:
+				TORRENT_ASSERT_FAIL();
+				break;
+		}
+
+		if (--j->pending == 0) finish_io(j);
+	}
+
+	int io_uring_disk_io::queue_file_op(uring_job* j, file_index_t const file
+		, std::int64_t const file_offset, span<char> const buf, bool const write
+		, storage_error& ec)
+	{
+		// make sure there's room for another operation in the completion queue
+		while (m_free_ops.empty()) wait_for_completions(1);
+
+		int const slot = open_file_slot(j->storage, file, write, ec);
+		if (slot < 0) return -1;
+
+		io_uring_sqe* sqe = m_ring->get_sqe();
+		while (sqe == nullptr)
+		{
+			// the submission queue is full, pass the entries on to the kernel to
+			// make room
+			wait_for_completions(0);
+			sqe = m_ring->get_sqe();
+		}
+
+		int const op_idx = m_free_ops.back();
+		m_free_ops.pop_back();
+
+		file_op& op = m_ops[std::size_t(op_idx)];
+		op.job = j;
+		op.slot = slot;
+		op.file = file;
+		op.file_offset = file_offset;
+		op.write = write;
+		op.iov.iov_base = buf.data();
+		op.iov.iov_len = std::size_t(buf.size());
+
+		++m_files[std::size_t(slot)].inflight;
+		prepare_sqe(sqe, op_idx);
+
+		++j->pending;
+		return int(buf.size());
+	}
+
+	void io_uring_disk_io::prepare_sqe(io_uring_sqe* const sqe, int const op_idx)
+	{
+		file_op& op = m_ops[std::size_t(op_idx)];
+		sqe->opcode = op.write ? IORING_OP_WRITEV : IORING_OP_READV;
+		if (m_registered_files)
+		{
+			sqe->fd = op.slot;
+			sqe->flags |= IOSQE_FIXED_FILE;
+		}
+		else
+		{
+			sqe->fd = m_files[std::size_t(op.slot)].fd;
+		}
+		sqe->off = std::uint64_t(op.file_offset);
+		sqe->addr = reinterpret_cast<std::uintptr_t>(&op.iov);
+		sqe->len = 1;
+		sqe->user_data = std::uint64_t(op_idx);
+	}
+
+	void io_uring_disk_io::resubmit_ops()
+	{
+		for (int const op_idx : m_resubmit_ops)
+		{
+			io_uring_sqe* sqe = m_ring->get_sqe();
+			while (sqe == nullptr)
+			{
+				error_code ignore;
+				m_ring->submit(0, ignore);
+				sqe = m_ring->get_sqe();
+			}
+			prepare_sqe(sqe, op_idx);
+		}
+		m_resubmit_ops.clear();
+	}
+
+	void io_uring_disk_io::wait_for_completions(unsigned const wait_nr)
+	{
+		resubmit_ops();
+
+		error_code ec;
+		m_ring->submit(wait_nr, ec);
+
+		// EBUSY means the completion queue is full, which is resolved by
+		// reaping completions below. Any other error is unexpected, but is
+		// not something we can recover from by retrying
+		TORRENT_ASSERT(!ec || ec == boost::system::errc::device_or_resource_busy
+			|| ec == boost::system::errc::resource_unavailable_try_again);
+
+		bool rearm = false;
+		m_ring->for_each_completion([&](io_uring_cqe const& cqe)
+		{
+			if (cqe.user_data == wakeup_tag)
+			{
+				// drain the eventfd. The poll request is one-shot, it's re-armed
+				// once we're done iterating the completion queue
+				std::uint64_t val;
+				auto const ret = ::read(m_wakeup_fd, &val, sizeof(val));
+				TORRENT_UNUSED(ret);
+				rearm = true;
+				return;
+			}
+			handle_completion(cqe);
+		});
+		if (rearm) arm_wakeup();
+	}
+
+	void io_uring_disk_io::arm_wakeup()
+	{
+		io_uring_sqe* sqe = m_ring->get_sqe();
+		while (sqe == nullptr)
+		{
+			error_code ignore;
+			m_ring->submit(0, ignore);
+			sqe = m_ring->get_sqe();
+		}
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->fd = m_wakeup_fd;
+		sqe->poll_events = POLLIN;
+		sqe->user_data = wakeup_tag;
+	}
+
+	void io_uring_disk_io::handle_completion(io_uring_cqe const& cqe)
+	{
+		TORRENT_ASSERT(cqe.user_data < m_ops.size());
+		int const op_idx = int(cqe.user_data);
+		file_op& op = m_ops[std::size_t(op_idx)];
+		uring_job* j = op.job;
+
+		if (!j->error && op.write && cqe.res > 0
+			&& std::size_t(cqe.res) < op.iov.iov_len)
+		{
+			// a short write is not an error, the remainder is written by
+			// submitting the operation again. The file stays in-flight
+			op.iov.iov_base = static_cast<char*>(op.iov.iov_base) + cqe.res;
+			op.iov.iov_len -= std::size_t(cqe.res);
+			op.file_offset += cqe.res;
+			m_resubmit_ops.push_back(op_idx);
+			return;
+		}
+
+		open_file& f = m_files[std::size_t(op.slot)];
+		TORRENT_ASSERT(f.inflight > 0);
+		--f.inflight;
+		if (f.orphaned && f.inflight == 0) close_slot(op.slot);
+
+		if (!j->error)
+		{
+			if (cqe.res < 0)
+			{
+				j->error.ec.assign(-cqe.res, generic_category());
+				j->error.file(op.file);
+				j->error.operation = op.write ? operation_t::file_write : operation_t::file_read;
+			}
+			else if (op.write && cqe.res == 0)
+			{
+				// the kernel refused to make any progress
+				j->error.ec.assign(boost::system::errc::io_error, generic_category());
+				j->error.file(op.file);
+				j->error.operation = operation_t::file_write;
+			}
+			else if (std::size_t(cqe.res) < op.iov.iov_len)
+			{
+				// a short read means we hit the end of the file
+				j->error.ec.assign(errors::file_too_short, libtorrent_category());
+				j->error.file(op.file);
+				j->error.operation = operation_t::file_read;
+			}
+		}
+
+		op.job = nullptr;
+		m_free_ops.push_back(op_idx);
+
+		TORRENT_ASSERT(j->pending > 0);
+		if (--j->pending == 0) finish_io(j);
+	}
+
+	void io_uring_disk_io::finish_io(uring_job* j)
+	{
+		std::int64_t const elapsed = total_microseconds(clock_type::now() - j->start_time);
+		bool const failed = bool(j->error);
+
+		switch (j->action)
+		{
+			case job_action_t::read:
+				if (failed) break;
+				m_stats_counters.inc_stats_counter(counters::num_blocks_read);
+				m_stats_counters.inc_stats_counter(counters::num_read_ops);
+				m_stats_counters.inc_stats_counter(counters::disk_read_time, elapsed);
+				m_stats_counters.inc_stats_counter(counters::disk_job_time, elapsed);
+				break;
+			case job_action_t::write:
+				m_store_buffer.erase({j->storage_index, j->piece, j->offset});
+				j->buffer.reset();
+				if (failed) break;
+				m_stats_counters.inc_stats_counter(counters::num_blocks_written);
+				m_stats_counters.inc_stats_counter(counters::num_write_ops);
+				m_stats_counters.inc_stats_counter(counters::disk_write_time, elapsed);
+				m_stats_counters.inc_stats_counter(counters::disk_job_time, elapsed);
+				break;
+			case job_action_t::hash:
+			case job_action_t::hash2:
+				if (failed)
+				{
+					j->blocks.clear();
+					j->buffer.reset();
+					break;
+				}
+				// the storage keeps counting this job as outstanding until
+				// it's been hashed
+				if (hand_off_hash(j)) return;
+				compute_hash(*j);
+				finish_hash(j);
+				return;
+			default:
+				TORRENT_ASSERT_FAIL();
+				break;
+		}
+
+		retire_job(j);
+	}
+
+	bool io_uring_disk_io::hand_off_hash(uring_job* j)
+	{
+		if (m_hash_threads.max_threads() == 0) return false;
+
+		std::lock_guard<std::mutex> l(m_hash_mutex);
+		if (m_num_hash_workers == 0) return false;
+		m_hash_jobs.push_back(j);
+		++m_num_hashing;
+		m_hash_queue.m_cond.notify_one();
+		return true;
+	}
+
+	void io_uring_disk_io::finish_hash(uring_job* j)
+	{
+		std::int64_t const elapsed = total_microseconds(clock_type::now() - j->start_time);
+		int const num_blocks = j->action == job_action_t::hash
+			? int(j->blocks.size()) : 1;
+		j->blocks.clear();
+		j->buffer.reset();
+
+		m_stats_counters.inc_stats_counter(counters::num_read_back, num_blocks);
+		m_stats_counters.inc_stats_counter(counters::num_blocks_read, num_blocks);
+		m_stats_counters.inc_stats_counter(counters::num_read_ops, num_blocks);
+		m_stats_counters.inc_stats_counter(counters::disk_hash_time, elapsed);
+		m_stats_counters.inc_stats_counter(counters::disk_job_time, elapsed);
+
+		retire_job(j);
+	}
+
+	void io_uring_disk_io::retire_job(uring_job* j)
+	{
+		if (j->error) j->ret = status_t::fatal_disk_error;
+
+		// if this was the last outstanding job on the storage, lower the fence
+		// (if any) and let the thread loop dispatch the jobs blocked behind it
+		uring_storage& st = *j->storage;
+		TORRENT_ASSERT(st.outstanding > 0);
+		if (--st.outstanding == 0 && !st.blocked.empty())
+		{
+			m_stats_counters.inc_stats_counter(counters::blocked_disk_jobs, -1);
+			m_unblocked_jobs.append(std::move(st.blocked));
+		}
+
+		complete_job(j);
+	}
+
+	void io_uring_disk_io::complete_job(uring_job* j)
+	{
+		m_done_jobs.push_back(j);
+	}
+
+	void io_uring_disk_io::post_completions()
+	{
+		if (m_done_jobs.empty()) return;
+
+		std::lock_guard<std::mutex> l(m_completed_jobs_mutex);
+		m_completed_jobs.append(std::move(m_done_jobs));
+
+		if (!m_job_completions_in_flight)
+		{
+			post(m_ios, [this] { call_job_handlers(); });
+			m_job_completions_in_flight = true;
+		}
+	}
+
+	// This is run in the network thread
+	void io_uring_disk_io::call_job_handlers()
+	{
+		m_stats_counters.inc_stats_counter(counters::on_disk_counter);
+		std::unique_lock<std::mutex> l(m_completed_jobs_mutex);
+		TORRENT_ASSERT(m_job_completions_in_flight);
+		m_job_completions_in_flight = false;
+		uring_job* j = m_completed_jobs.get_all();
+		l.unlock();
+
+		while (j)
+		{
+			uring_job* next = j->next;
+			if (j->action == job_action_t::hash || j->action == job_action_t::hash2)
+			{
+				TORRENT_ASSERT(m_outstanding_hash_jobs > 0);
+				--m_outstanding_hash_jobs;
+			}
+			if (j->callback) j->callback(*j);
+			delete j;
+			j = next;
+		}
+	}
+
+	bool io_uring_disk_io::wait_for_hash_job(aux::disk_io_thread_pool& pool
+		, std::unique_lock<std::mutex>& l)
+	{
+		TORRENT_ASSERT(l.owns_lock());
+		if (!m_hash_jobs.empty()) return false;
+
+		pool.thread_idle();
+		do
+		{
+			// the last thread to exit makes sure there are no jobs left
+			// behind. Any job handed off after it has exited is hashed by the
+			// disk thread
+			if (pool.should_exit()
+				&& (m_hash_jobs.empty() || m_num_hash_workers > 1)
+				&& pool.try_thread_exit(std::this_thread::get_id()))
+			{
+				pool.thread_active();
+				return true;
+			}
+
+			using namespace std::literals::chrono_literals;
+			m_hash_queue.m_cond.wait_for(l, 1s);
+		} while (m_hash_jobs.empty());
+		pool.thread_active();
+		return false;
+	}
+
+	void io_uring_disk_io::hash_thread_fun(aux::disk_io_thread_pool& pool)
+	{
+		set_thread_name("libtorrent-hash-thread");
+		m_stats_counters.inc_stats_counter(counters::num_running_threads, 1);
+
+		std::unique_lock<std::mutex> l(m_hash_mutex);
+		++m_num_hash_workers;
+		while (!wait_for_hash_job(pool, l))
+		{
+			uring_job* j = m_hash_jobs.pop_front();
+			l.unlock();
+			compute_hash(*j);
+			l.lock();
+
+			// if there already were hashed jobs, the disk thread has been
+			// woken up already
+			bool const wake = m_hashed_jobs.empty();
+			m_hashed_jobs.push_back(j);
+			if (wake) wake_up(m_wakeup_fd);
+		}
+		--m_num_hash_workers;
+		l.unlock();
+
+		m_stats_counters.inc_stats_counter(counters::num_running_threads, -1);
+	}
+
+	int io_uring_disk_io::open_file_slot(std::shared_ptr<uring_storage> const& sp
+		, file_index_t const file, bool const write, storage_error& ec)
+	{
+		uring_storage& st = *sp;
+		int slot = st.open_files[file];
+		if (slot >= 0)
+		{
+			open_file& f = m_files[std::size_t(slot)];
+			if (!write || f.writable)
+			{
+				f.last_use = aux::time_now();
+				return slot;
+			}
+
+			// the file was opened in read-only mode, it needs to be re-opened
+			// for writing
+			close_file(st, file);
+		}
+
+		// if we're at the limit of open files, close the least recently used
+		// one that's idle. If all slots are busy we exceed the limit, until
+		// the operations complete
+		if (m_num_open_files >= m_max_open_files
+			|| m_num_open_files == int(m_files.size()))
+		{
+			int lru = -1;
+			for (int i = 0; i < int(m_files.size()); ++i)
+			{
+				open_file const& f = m_files[std::size_t(i)];
+				if (f.fd < 0 || f.inflight > 0) continue;
+				if (lru < 0 || f.last_use < m_files[std::size_t(lru)].last_use) lru = i;
+			}
+			if (lru >= 0) close_slot(lru);
+		}
+
+		auto const it = std::find_if(m_files.begin(), m_files.end()
+			, [](open_file const& f) { return f.fd < 0; });
+		// there's always room for one more file than we have operations in-flight
+		TORRENT_ASSERT(it != m_files.end());
+		slot = int(it - m_files.begin());
+
+		std::string const path = st.storage.file_path(file);
+		int const mode = (write ? (O_RDWR | O_CREAT) : O_RDONLY) | O_CLOEXEC;
+		int fd = ::open(path.c_str(), mode, 0666);
+		if (fd < 0 && write && errno == ENOENT)
+		{
+			// the directory the file is in doesn't exist, create it and try again
+			create_directories(parent_path(path), ec.ec);
+			if (ec.ec)
+			{
+				ec.file(file);
+				ec.operation = operation_t::mkdir;
+				return -1;
+			}
+			fd = ::open(path.c_str(), mode, 0666);
+		}
+		if (fd < 0)
+		{
+			ec.ec.assign(errno, generic_category());
+			ec.file(file);
+			ec.operation = operation_t::file_open;
+			return -1;
+		}
+
+		if (m_registered_files)
+		{
+			error_code e;
+			m_ring->update_file(slot, fd, e);
+			// fall back to plain file descriptors
+			if (e) m_registered_files = false;
+		}
+
+		open_file& f = *it;
+		f.storage = sp;
+		f.file = file;
+		f.fd = fd;
+		f.writable = write;
+		f.inflight = 0;
+		f.orphaned = false;
+		f.last_use = aux::time_now();
+		st.open_files[file] = slot;
+		++m_num_open_files;
+		return slot;
+	}
+
+	void io_uring_disk_io::close_slot(int const slot)
+	{
+		open_file& f = m_files[std::size_t(slot)];
+		if (f.fd < 0) return;
+		TORRENT_ASSERT(f.inflight == 0);
+
+		if (m_registered_files)
+		{
+			error_code ignore;
+			m_ring->update_file(slot, -1, ignore);
+		}
+		::close(f.fd);
+		--m_num_open_files;
+
+		if (!f.orphaned && f.storage)
+			f.storage->open_files[f.file] = -1;
+		f = open_file{};
+	}
+
+	void io_uring_disk_io::close_file(uring_storage& st, file_index_t const file)
+	{
+		int const slot = st.open_files[file];
+		if (slot < 0) return;
+		open_file& f = m_files[std::size_t(slot)];
+		if (f.inflight == 0)
+		{
+			close_slot(slot);
+			return;
+		}
+		// there are operations in-flight against this file. It's closed once
+		// they complete
+		f.orphaned = true;
+		st.open_files[file] = -1;
+	}
+
+	void io_uring_disk_io::close_files(uring_storage const& st)
+	{
+		for (int i = 0; i < int(m_files.size()); ++i)
+		{
+			open_file& f = m_files[std::size_t(i)];
+			if (f.storage.get() != &st) continue;
+			if (f.inflight == 0)
+			{
+				close_slot(i);
+			}
+			else if (!f.orphaned)
+			{
+				f.orphaned = true;
+				f.storage->open_files[f.file] = -1;
+			}
+		}
+	}
+
+	TORRENT_EXPORT std::unique_ptr<disk_interface> io_uring_disk_io_constructor(
+		io_context& ios, settings_interface const& sett, counters& cnt)
+	{
+		error_code ec;
+		auto ring = std::make_unique<aux::io_uring>(ring_entries, ec);
+		int const wakeup_fd = ec ? -1 : ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+		// if the kernel doesn't support io_uring (or it has been disabled),
+		// fall back to the portable back-end
+		if (ec || wakeup_fd < 0)
+			return posix_disk_io_constructor(ios, sett, cnt);
+
+		return std::make_unique<io_uring_disk_io>(ios, sett, cnt, std::move(ring), wakeup_fd);
+	}
+}
+
+#endif // TORRENT_HAVE_IO_URING
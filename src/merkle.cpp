@@ -34,10 +34,35 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/aux_/merkle.hpp"
 #include "libtorrent/aux_/vector.hpp"
+#include "libtorrent/aux_/hash_many.hpp"
 #include "libtorrent/bitfield.hpp"
 
+#include <algorithm>
+
 namespace libtorrent {
 
+namespace {
+
+	// calls f(first, last) for every range of consecutive indices, in
+	// [begin, end), for which pred() returns true
+	template <typename Pred, typename Fun>
+	void for_each_run(int const begin, int const end, Pred pred, Fun f)
+	{
+		int i = begin;
+		while (i < end)
+		{
+			if (!pred(i))
+			{
+				++i;
+				continue;
+			}
+			int const first = i;
+			while (i < end && pred(i)) ++i;
+			f(first, i);
+		}
+	}
+}
+
 	int merkle_layer_start(int const layer)
 	{
 		TORRENT_ASSERT(layer >= 0);
@@ -129,24 +154,30 @@ namespace libtorrent {
 
 	void merkle_fill_tree(span<sha256_hash> tree, int const num_leafs, int level_start)
 	{
-		TORRENT_ASSERT(level_start >= 0);
 		TORRENT_ASSERT(num_leafs >= 1);
+		merkle_fill_layers(tree, num_leafs, level_start, merkle_num_layers(num_leafs));
+	}
 
-		int level_size = num_leafs;
-		while (level_size > 1)
+	void merkle_fill_layers(span<sha256_hash> tree, int const num_nodes
+		, int level_start, int const num_layers)
+	{
+		TORRENT_ASSERT(level_start >= 0);
+		TORRENT_ASSERT(num_nodes >= 1);
+		TORRENT_ASSERT(num_layers >= 0);
+		TORRENT_ASSERT((num_nodes & ((1 << num_layers) - 1)) == 0);
+
+		// each level is computed in a single pass, which lets hash_pairs()
+		// hash many nodes in parallel
+		int level_size = num_nodes;
+		for (int layer = 0; layer < num_layers; ++layer)
 		{
-			int parent = merkle_get_parent(level_start);
-			for (int i = level_start; i < level_start + level_size; i += 2, ++parent)
-			{
-				hasher256 h;
-				h.update(tree[i]);
-				h.update(tree[i + 1]);
-				tree[parent] = h.final();
-			}
-			level_start = merkle_get_parent(level_start);
+			TORRENT_ASSERT((level_start & 1) == 1);
+			int const parent = merkle_get_parent(level_start);
+			aux::hash_pairs(tree.subspan(level_start, level_size)
+				, tree.subspan(parent, level_size / 2));
+			level_start = parent;
 			level_size /= 2;
 		}
-		TORRENT_ASSERT(level_size == 1);
 	}
 
 	void merkle_fill_partial_tree(span<sha256_hash> tree)
@@ -167,17 +198,18 @@ namespace libtorrent {
 			level_start = merkle_get_parent(level_start);
 			level_size /= 2;
 
-			for (int i = level_start; i < level_start + level_size; ++i)
-			{
-				int const child = merkle_get_first_child(i);
-				bool const zeros_left = tree[child].is_all_zeros();
-				bool const zeros_right = tree[child + 1].is_all_zeros();
-				if (zeros_left || zeros_right) continue;
-				hasher256 h;
-				h.update(tree[child]);
-				h.update(tree[child + 1]);
-				tree[i] = h.final();
-			}
+			// hash every run of nodes whose children are both known in one go
+			for_each_run(level_start, level_start + level_size
+				, [&](int const i)
+				{
+					int const child = merkle_get_first_child(i);
+					return !tree[child].is_all_zeros() && !tree[child + 1].is_all_zeros();
+				}
+				, [&](int const first, int const last)
+				{
+					aux::hash_pairs(tree.subspan(merkle_get_first_child(first), (last - first) * 2)
+						, tree.subspan(first, last - first));
+				});
 		}
 		TORRENT_ASSERT(level_size == 1);
 
@@ -249,14 +281,9 @@ namespace libtorrent {
 
 		while (num_leafs > 1)
 		{
-			int i = 0;
-			for (; i < int(leaves.size()) / 2; ++i)
-			{
-				scratch_space[std::size_t(i)] = hasher256()
-					.update(leaves[i * 2])
-					.update(leaves[i * 2 + 1])
-					.final();
-			}
+			int i = int(leaves.size()) / 2;
+			// scratch_space may alias leaves, which is fine for hash_pairs()
+			aux::hash_pairs(leaves.first(i * 2), span<sha256_hash>(scratch_space).first(i));
 			if (leaves.size() & 1)
 			{
 				// if we have an odd number of leaves, compute the boundary hash
@@ -374,26 +401,39 @@ namespace libtorrent {
 		if (src[0] != root) return;
 		dst[0] = src[0];
 		int const leaf_layer_start = int(src.size() - num_leafs);
-		for (int i = 0; i < leaf_layer_start; ++i)
+		std::vector<sha256_hash> hashes;
+
+		// validate one level at a time. The children of every run of known
+		// nodes are hashed in one go
+		for (int level_start = 0, level_size = 1; level_start < leaf_layer_start
+			; level_start = merkle_get_first_child(level_start), level_size *= 2)
 		{
-			if (dst[i].is_all_zeros()) continue;
-			int const left_child = merkle_get_first_child(i);
-			int const right_child = left_child + 1;
-			if (merkle_validate_node(src[left_child], src[right_child], dst[i]))
+			for_each_run(level_start, level_start + level_size
+				, [&](int const i) { return !dst[i].is_all_zeros(); }
+				, [&](int const first, int const last)
 			{
-				dst[left_child] = src[left_child];
-				dst[right_child] = src[right_child];
-				int const block_idx = left_child - leaf_layer_start;
-				if (left_child >= leaf_layer_start
-					&& block_idx < verified_leafs.size())
+				hashes.resize(std::size_t(last - first));
+				aux::hash_pairs(src.subspan(merkle_get_first_child(first), (last - first) * 2)
+					, hashes);
+				for (int i = first; i < last; ++i)
 				{
-					verified_leafs.set_bit(block_idx);
-					// the right child may be the first block of padding hash,
-					// in which case it's not part of the verified bitfield
-					if (block_idx + 1 < verified_leafs.size())
-						verified_leafs.set_bit(block_idx + 1);
+					if (hashes[std::size_t(i - first)] != dst[i]) continue;
+					int const left_child = merkle_get_first_child(i);
+					int const right_child = left_child + 1;
+					dst[left_child] = src[left_child];
+					dst[right_child] = src[right_child];
+					int const block_idx = left_child - leaf_layer_start;
+					if (left_child >= leaf_layer_start
+						&& block_idx < verified_leafs.size())
+					{
+						verified_leafs.set_bit(block_idx);
+						// the right child may be the first block of padding hash,
+						// in which case it's not part of the verified bitfield
+						if (block_idx + 1 < verified_leafs.size())
+							verified_leafs.set_bit(block_idx + 1);
+					}
 				}
-			}
+			});
 		}
 	}
 
@@ -404,16 +444,13 @@ namespace libtorrent {
 		int const end = int(tree.size());
 		TORRENT_ASSERT((num_leafs & (num_leafs - 1)) == 0);
 
-		int idx = merkle_first_leaf(num_leafs);
+		int const idx = merkle_first_leaf(num_leafs);
 		TORRENT_ASSERT(idx >= 1);
 
-		while (idx < end)
-		{
-			if (!merkle_validate_node(tree[idx], tree[idx + 1], tree[merkle_get_parent(idx)]))
-				return false;
-			idx += 2;
-		}
-		return true;
+		// hash the whole layer in one go, then compare against the parents
+		std::vector<sha256_hash> hashes(std::size_t(num_leafs / 2));
+		aux::hash_pairs(tree.subspan(idx, end - idx), hashes);
+		return std::equal(hashes.begin(), hashes.end(), tree.begin() + merkle_get_parent(idx));
 	}
 
 	std::tuple<int, int, int> merkle_find_known_subtree(span<sha256_hash const> const tree
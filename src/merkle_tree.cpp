@@ -36,6 +36,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/ffs.hpp"
 #include "libtorrent/aux_/numeric_cast.hpp"
 #include "libtorrent/aux_/invariant_check.hpp"
+#include "libtorrent/aux_/hash_many.hpp"
 
 namespace libtorrent {
 namespace aux {
@@ -225,21 +226,59 @@ namespace {
 			}
 			case mode_t::block_layer:
 			{
-				ret.reserve(num_pieces());
-				std::vector<sha256_hash> scratch_space;
-
-				int const blocks_in_piece = blocks_per_piece();
-				for (int b = 0; b < int(m_tree.size()); b += blocks_in_piece)
+				// compute the piece layer one tree level at a time, for all
+				// pieces at once. The block layer is padded with zero hashes
+				// up to a whole number of pieces
+				int const npieces = num_pieces();
+				TORRENT_ASSERT(m_tree.end_index() <= npieces << m_blocks_per_piece_log);
+				std::vector<sha256_hash> scratch_space(std::size_t(npieces << m_blocks_per_piece_log));
+				std::copy(m_tree.begin(), m_tree.end(), scratch_space.begin());
+				span<sha256_hash> layer = scratch_space;
+				while (layer.size() > npieces)
 				{
-					auto const leafs = span<sha256_hash const>(m_tree).subspan(b);
-					ret.push_back(merkle_root_scratch(leafs, blocks_in_piece, sha256_hash{}, scratch_space));
+					auto const parents = layer.first(layer.size() / 2);
+					aux::hash_pairs(layer, parents);
+					layer = parents;
 				}
+				ret.assign(layer.begin(), layer.end());
 				break;
 			}
 		}
 		return ret;
 	}
 
+	bool merkle_tree::collapse_to_piece_layer()
+	{
+		INVARIANT_CHECK;
+
+		// if there's only one block per piece, the piece layer is the block
+		// layer, and there's nothing to save
+		if (m_blocks_per_piece_log == 0) return false;
+
+		switch (m_mode)
+		{
+			case mode_t::uninitialized_tree:
+			case mode_t::empty_tree:
+			case mode_t::piece_layer:
+				return false;
+			case mode_t::full_tree:
+			{
+				int const start = piece_layer_start();
+				if (std::any_of(m_tree.begin() + start, m_tree.begin() + start + num_pieces()
+					, [](sha256_hash const& h) { return h.is_all_zeros(); }))
+					return false;
+				break;
+			}
+			case mode_t::block_layer:
+				break;
+		}
+
+		m_tree = get_piece_layer();
+		m_mode = mode_t::piece_layer;
+		m_block_verified.clear();
+		return true;
+	}
+
 	// returns false if the piece layer fails to validate against the root hash
 	bool merkle_tree::load_piece_layer(span<char const> piece_layer)
 	{
@@ -427,53 +466,69 @@ namespace {
 			&& dest_start_idx < first_piece_idx + num_pieces())
 		{
 			int const blocks_in_piece = 1 << base;
+			int const num_hashes = std::min(int(hashes.size())
+				, first_piece_idx + num_pieces() - dest_start_idx);
 
-			// it may now be possible to verify the hashes of previously received blocks
-			// try to verify as many child nodes of the received hashes as possible
-			for (int i = 0; i < int(hashes.size()); ++i)
+			// returns true if all block hashes of the piece at index i (in
+			// hashes) are known
+			auto const has_all_blocks = [&](int const i)
 			{
-				int const piece = dest_start_idx + i;
-				if (piece - first_piece_idx >= num_pieces())
-					break;
-				// the first block in this piece
-				int const block_idx = merkle_get_first_child(piece, base);
-
+				int const block_idx = merkle_get_first_child(dest_start_idx + i, base);
 				int const block_end_idx = std::min(block_idx + blocks_in_piece, first_leaf + m_num_blocks);
-				if (std::any_of(m_tree.begin() + block_idx
+				return std::none_of(m_tree.begin() + block_idx
 					, m_tree.begin() + block_end_idx
-					, [](sha256_hash const& h) { return h.is_all_zeros(); }))
-					continue;
+					, [](sha256_hash const& h) { return h.is_all_zeros(); });
+			};
 
-				// TODO: instead of overwriting the root and comparing it
-				// against hashes[], write a functions that *validates* a tree
-				// by just filling it up to the level below the root and then
-				// validates it.
-				merkle_fill_tree(m_tree, blocks_in_piece, block_idx);
-				if (m_tree[piece] != hashes[i])
+			// it may now be possible to verify the hashes of previously received blocks
+			// try to verify as many child nodes of the received hashes as possible.
+			// The piece hashes of a run of pieces whose blocks are all known
+			// are computed together, one tree level at a time
+			int i = 0;
+			while (i < num_hashes)
+			{
+				if (!has_all_blocks(i))
 				{
-					merkle_clear_tree(m_tree, blocks_in_piece, block_idx);
-					// write back the correct hash
-					m_tree[piece] = hashes[i];
-					TORRENT_ASSERT(blocks_in_piece == blocks_per_piece());
-
-					// an empty blocks vector indicates that we don't have the
-					// block hashes, and we can't know which block failed
-					// this will cause the block hashes to be requested
-					ret.failed.emplace_back(piece_index_t{piece - first_piece_idx} + file_piece_offset
-						, std::vector<int>());
+					++i;
+					continue;
 				}
-				else
+				int run_end = i + 1;
+				while (run_end < num_hashes && has_all_blocks(run_end)) ++run_end;
+
+				merkle_fill_layers(m_tree, (run_end - i) << base
+					, merkle_get_first_child(dest_start_idx + i, base), base);
+
+				for (; i < run_end; ++i)
 				{
-					ret.passed.push_back(piece_index_t{piece - first_piece_idx} + file_piece_offset);
-					// record that these block hashes are correct!
-					int const leafs_start = block_idx - block_layer_start();
-					int const leafs_end = std::min(m_num_blocks, leafs_start + blocks_in_piece);
-					// TODO: this could be done more efficiently if bitfield had a function
-					// to set a range of bits
-					for (int k = leafs_start; k < leafs_end; ++k)
-						m_block_verified.set_bit(k);
+					int const piece = dest_start_idx + i;
+					// the first block in this piece
+					int const block_idx = merkle_get_first_child(piece, base);
+					if (m_tree[piece] != hashes[i])
+					{
+						merkle_clear_tree(m_tree, blocks_in_piece, block_idx);
+						// write back the correct hash
+						m_tree[piece] = hashes[i];
+						TORRENT_ASSERT(blocks_in_piece == blocks_per_piece());
+
+						// an empty blocks vector indicates that we don't have the
+						// block hashes, and we can't know which block failed
+						// this will cause the block hashes to be requested
+						ret.failed.emplace_back(piece_index_t{piece - first_piece_idx} + file_piece_offset
+							, std::vector<int>());
+					}
+					else
+					{
+						ret.passed.push_back(piece_index_t{piece - first_piece_idx} + file_piece_offset);
+						// record that these block hashes are correct!
+						int const leafs_start = block_idx - block_layer_start();
+						int const leafs_end = std::min(m_num_blocks, leafs_start + blocks_in_piece);
+						// TODO: this could be done more efficiently if bitfield had a function
+						// to set a range of bits
+						for (int k = leafs_start; k < leafs_end; ++k)
+							m_block_verified.set_bit(k);
+					}
+					TORRENT_ASSERT((piece - first_piece_idx) >= 0);
 				}
-				TORRENT_ASSERT((piece - first_piece_idx) >= 0);
 			}
 		}
 
@@ -64,6 +64,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/file_view_pool.hpp"
 #include "libtorrent/aux_/scope_end.hpp"
 #include "libtorrent/aux_/storage_free_list.hpp"
+#include "libtorrent/aux_/latency_histogram.hpp"
 
 #ifdef TORRENT_WINDOWS
 #include "signal_error_code.hpp"
@@ -84,10 +85,6 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #define DEBUG_DISK_THREAD 0
 
-namespace libtorrent {
-char const* job_name(aux::job_action_t job);
-}
-
 #if DEBUG_DISK_THREAD
 #include <cstdarg> // for va_list
 #include <sstream>
@@ -146,6 +143,54 @@ namespace {
 		return ret;
 	}
 
+	// calls ``f`` and turns any exception it throws into a fatal disk error,
+	// reported in ``error``
+	template <typename Fun>
+	status_t catch_disk_errors(storage_error& error, Fun f)
+	{
+		try
+		{
+			return f();
+		}
+		catch (boost::system::system_error const& err)
+		{
+			error.ec = err.code();
+			error.operation = operation_t::exception;
+		}
+		catch (std::bad_alloc const&)
+		{
+			error.ec = errors::no_memory;
+			error.operation = operation_t::exception;
+		}
+		catch (std::exception const&)
+		{
+			error.ec = boost::asio::error::fault;
+			error.operation = operation_t::exception;
+		}
+		return status_t::fatal_disk_error;
+	}
+
+	// the position of a write job's block in the torrent's contiguous byte
+	// space. Adjacent blocks may belong to different pieces
+	std::int64_t torrent_offset(aux::mmap_disk_job const* j)
+	{
+		return static_cast<int>(j->piece) * std::int64_t(j->storage->files().piece_length())
+			+ j->d.io.offset;
+	}
+
+	// the "allocator" of a block handed out by a zero-copy read. It holds on
+	// to the file mapping the block points into, and is destroyed along
+	// with the block
+	struct mapped_block final : buffer_allocator_interface
+	{
+		explicit mapped_block(std::shared_ptr<aux::file_mapping> m)
+			: m_mapping(std::move(m)) {}
+		void free_disk_buffer(char*) override { delete this; }
+	private:
+		~mapped_block() = default;
+		std::shared_ptr<aux::file_mapping> m_mapping;
+	};
+
 #if TORRENT_USE_ASSERTS
 	bool valid_flags(disk_job_flags_t const flags)
 	{
@@ -153,10 +198,22 @@ namespace {
 				| disk_interface::sequential_access
 				| disk_interface::volatile_read
 				| disk_interface::v1_hash
-				| disk_interface::flush_piece))
+				| disk_interface::flush_piece
+				| disk_interface::zero_copy))
 			== disk_job_flags_t{};
 	}
 #endif
+
+	char const* job_name(aux::job_action_t const job)
+	{
+		static aux::array<char const*, static_cast<int>(aux::job_action_t::num_job_ids)
+			, aux::job_action_t> const names{{
+			"read", "write", "hash", "hash2", "move_storage", "release_files"
+			, "delete_files", "check_fastresume", "rename_file", "stop_torrent"
+			, "file_priority", "clear_piece", "partial_read"
+		}};
+		return names[job];
+	}
 } // anonymous namespace
 
 using jobqueue_t = tailqueue<aux::mmap_disk_job>;
@@ -216,6 +273,8 @@ struct TORRENT_EXTRA_EXPORT mmap_disk_io final
 
 	std::vector<open_file_state> get_status(storage_index_t) const override;
 
+	std::vector<disk_job_latency> job_latency() const override;
+
 	// this submits all queued up jobs to the thread
 	void submit_jobs() override;
 
@@ -291,6 +350,17 @@ private:
 
 	void execute_job(aux::mmap_disk_job* j);
 	void immediate_execute();
+
+	// moves the queued write jobs for blocks adjacent to the one written by
+	// ``j`` out of ``queue``, into ``run``. ``run`` ends up holding ``j`` and
+	// its neighbors, in the order they are laid out in the torrent. Must be
+	// called with m_job_mutex held
+	void coalesce_writes(job_queue& queue, aux::mmap_disk_job* j
+		, std::vector<aux::mmap_disk_job*>& run
+		, std::vector<aux::mmap_disk_job*>& scratch);
+
+	// writes all blocks of a run of adjacent write jobs, and completes them
+	void execute_write_run(span<aux::mmap_disk_job* const> run);
 	void abort_jobs();
 	void abort_hash_jobs(storage_index_t storage);
 
@@ -334,6 +404,11 @@ private:
 
 	counters& m_stats_counters;
 
+	// histograms of the time jobs spend queued and executing, per job type.
+	// These are updated by the disk threads without holding any lock
+	std::array<aux::latency_histogram, static_cast<std::size_t>(aux::job_action_t::num_job_ids)> m_queue_latency;
+	std::array<aux::latency_histogram, static_cast<std::size_t>(aux::job_action_t::num_job_ids)> m_exec_latency;
+
 	// this is the main thread io_context. Callbacks are
 	// posted on this in order to have them execute in
 	// the main thread.
@@ -574,38 +649,23 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 		m_stats_counters.inc_stats_counter(counters::num_running_disk_jobs, 1);
 
+		auto const action = static_cast<std::size_t>(j->action);
+		time_point const start_time = clock_type::now();
+		m_queue_latency[action].record(total_microseconds(start_time - j->queued));
+
 		// call disk function
 		// TODO: in the future, propagate exceptions back to the handlers
-		status_t ret = status_t::no_error;
-		try
-		{
-			int const idx = static_cast<int>(j->action);
-			ret = (this->*(job_functions[static_cast<std::size_t>(idx)]))(j);
-		}
-		catch (boost::system::system_error const& err)
-		{
-			ret = status_t::fatal_disk_error;
-			j->error.ec = err.code();
-			j->error.operation = operation_t::exception;
-		}
-		catch (std::bad_alloc const&)
+		status_t const ret = catch_disk_errors(j->error, [&]
 		{
-			ret = status_t::fatal_disk_error;
-			j->error.ec = errors::no_memory;
-			j->error.operation = operation_t::exception;
-		}
-		catch (std::exception const&)
-		{
-			ret = status_t::fatal_disk_error;
-			j->error.ec = boost::asio::error::fault;
-			j->error.operation = operation_t::exception;
-		}
+			return (this->*(job_functions[action]))(j);
+		});
 
 		// note that -2 errors are OK
 		TORRENT_ASSERT(ret != status_t::fatal_disk_error
 			|| (j->error.ec && j->error.operation != operation_t::unknown));
 
 		m_stats_counters.inc_stats_counter(counters::num_running_disk_jobs, -1);
+		m_exec_latency[action].record(total_microseconds(clock_type::now() - start_time));
 
 		j->ret = ret;
 
@@ -642,6 +702,31 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 	status_t mmap_disk_io::do_read(aux::mmap_disk_job* j)
 	{
+		if (j->flags & disk_interface::zero_copy)
+		{
+			time_point const start_time = clock_type::now();
+			char const* data = nullptr;
+			auto mapping = j->storage->mapped_read(m_settings, j->piece
+				, j->d.io.offset, j->d.io.buffer_size, file_mode_for_job(j), data
+				, j->error);
+			if (mapping)
+			{
+				// the block refers straight into the file mapping, the
+				// mapped_block keeps it alive until the buffer is freed
+				j->argument = disk_buffer_holder(*new mapped_block(std::move(mapping))
+					, const_cast<char*>(data), j->d.io.buffer_size);
+
+				std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
+				m_stats_counters.inc_stats_counter(counters::num_blocks_read);
+				m_stats_counters.inc_stats_counter(counters::num_read_ops);
+				m_stats_counters.inc_stats_counter(counters::disk_read_time, read_time);
+				m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
+				return status_t::no_error;
+			}
+			if (j->error) return status_t::no_error;
+			// fall back to copying the block into a disk buffer
+		}
+
 		j->argument = disk_buffer_holder(m_buffer_pool, m_buffer_pool.allocate_buffer("send buffer"), default_block_size);
 		auto& buffer = boost::get<disk_buffer_holder>(j->argument);
 		if (!buffer)
@@ -1045,67 +1130,97 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 		hasher h;
 		int ret = 0;
-		int offset = 0;
 		int const blocks_to_read = std::max(blocks_in_piece, blocks_in_piece2);
 		time_point const start_time = clock_type::now();
-		for (int i = 0; i < blocks_to_read; ++i)
+
+		// the v2 blocks that are not in the store buffer are hashed in
+		// batches, to hash several of them in parallel (see aux::hash_many()).
+		// The v1 hash is updated block by block as we go.
+		constexpr int hash_batch = 8;
+		for (int batch_start = 0; batch_start < blocks_to_read; batch_start += hash_batch)
 		{
-			bool const v2_block = i < blocks_in_piece2;
+			int const batch_end = std::min(blocks_to_read, batch_start + hash_batch);
 
-			DLOG("do_hash: reading (piece: %d block: %d)\n", int(j->piece), i);
+			// the v2 blocks in this batch that need to be read from disk. Since
+			// the store buffer only holds blocks that have been written
+			// recently, this is typically all of them, or none
+			int disk_blocks[hash_batch];
+			int num_disk_blocks = 0;
 
-			std::ptrdiff_t const len = v1 ? std::min(default_block_size, piece_size - offset) : 0;
-			std::ptrdiff_t const len2 = v2_block ? std::min(default_block_size, piece_size2 - offset) : 0;
+			for (int i = batch_start; i < batch_end; ++i)
+			{
+				int const offset = i * default_block_size;
+				bool const v2_block = i < blocks_in_piece2;
 
-			hasher256 h2;
+				DLOG("do_hash: reading (piece: %d block: %d)\n", int(j->piece), i);
 
-			if (!m_store_buffer.get({ j->storage->storage_index(), j->piece, offset }
-				, [&](char const* buf)
-				{
-					if (v1)
-					{
-						h.update({ buf, len });
-						ret = int(len);
-					}
-					if (v2_block)
+				std::ptrdiff_t const len = v1 ? std::min(default_block_size, piece_size - offset) : 0;
+				std::ptrdiff_t const len2 = v2_block ? std::min(default_block_size, piece_size2 - offset) : 0;
+
+				if (m_store_buffer.get({ j->storage->storage_index(), j->piece, offset }
+					, [&](char const* buf)
 					{
-						h2.update({ buf, len2 });
-						ret = int(len2);
-					}
-				}))
-			{
-				if (v1)
-				{
-					// if we will call hash2() in a bit, don't trigger a flush
-					// just yet, let hash2() do it
-					auto const flags = v2_block ? (j->flags & ~disk_interface::flush_piece) : j->flags;
-					j->error.ec.clear();
-					ret = j->storage->hash(m_settings, h, len, j->piece, offset
-						, file_mode, flags, j->error);
-					if (ret < 0) break;
-				}
-				if (v2_block)
+						if (v1)
+						{
+							h.update({ buf, len });
+							ret = int(len);
+						}
+						if (v2_block)
+						{
+							j->d.h.block_hashes[i] = hasher256(buf, int(len2)).final();
+							ret = int(len2);
+						}
+					}))
 				{
-					j->error.ec.clear();
-					ret = j->storage->hash2(m_settings, h2, len2, j->piece, offset
-						, file_mode, j->flags, j->error);
-					if (ret < 0) break;
+					if (ret <= 0) break;
+					continue;
 				}
 
+				if (v2_block) disk_blocks[num_disk_blocks++] = i;
+				if (!v1) continue;
+
+				// if we will call hash2() in a bit, don't trigger a flush
+				// just yet, let hash2() do it
+				auto const flags = v2_block ? (j->flags & ~disk_interface::flush_piece) : j->flags;
+				j->error.ec.clear();
+				ret = j->storage->hash(m_settings, h, len, j->piece, offset
+					, file_mode, flags, j->error);
+				if (ret < 0) break;
+
 				if (!j->error.ec)
 				{
 					m_stats_counters.inc_stats_counter(counters::num_read_back);
 					m_stats_counters.inc_stats_counter(counters::num_blocks_read);
 					m_stats_counters.inc_stats_counter(counters::num_read_ops);
 				}
-			}
 
-			if (v2_block)
-				j->d.h.block_hashes[i] = h2.final();
+				if (ret == 0) break;
+			}
+			if (ret < 0 || (ret == 0 && num_disk_blocks == 0)) break;
 
+			// hash runs of consecutive v2 blocks
+			for (int k = 0; k < num_disk_blocks;)
+			{
+				int run = 1;
+				while (k + run < num_disk_blocks
+					&& disk_blocks[k + run] == disk_blocks[k] + run)
+					++run;
+
+				j->error.ec.clear();
+				ret = j->storage->hash2(m_settings
+					, j->d.h.block_hashes.subspan(disk_blocks[k], run), j->piece
+					, disk_blocks[k] * default_block_size, file_mode, j->flags, j->error);
+				if (ret < 0) break;
+
+				if (!j->error.ec && !v1)
+				{
+					m_stats_counters.inc_stats_counter(counters::num_read_back, run);
+					m_stats_counters.inc_stats_counter(counters::num_blocks_read, run);
+					m_stats_counters.inc_stats_counter(counters::num_read_ops);
+				}
+				k += run;
+			}
 			if (ret <= 0) break;
-
-			offset += default_block_size;
 		}
 
 		if (!j->error.ec)
@@ -1288,7 +1403,23 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		jl.unlock();
 
 		// gauges
-		c.set_value(counters::disk_blocks_in_use, m_buffer_pool.in_use());
+		m_buffer_pool.update_stats_counters(c);
+	}
+
+	std::vector<disk_job_latency> mmap_disk_io::job_latency() const
+	{
+		std::vector<disk_job_latency> ret;
+		for (int i = 0; i < static_cast<int>(aux::job_action_t::num_job_ids); ++i)
+		{
+			disk_job_latency l;
+			l.job = job_name(static_cast<aux::job_action_t>(i));
+			l.queue_time.resize(aux::latency_buckets);
+			l.exec_time.resize(aux::latency_buckets);
+			m_queue_latency[std::size_t(i)].snapshot(l.queue_time);
+			m_exec_latency[std::size_t(i)].snapshot(l.exec_time);
+			ret.push_back(std::move(l));
+		}
+		return ret;
 	}
 
 	status_t mmap_disk_io::do_file_priority(aux::mmap_disk_job* j)
@@ -1418,6 +1549,168 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		}
 	}
 
+	void mmap_disk_io::coalesce_writes(job_queue& queue, aux::mmap_disk_job* const j
+		, std::vector<aux::mmap_disk_job*>& run
+		, std::vector<aux::mmap_disk_job*>& scratch)
+	{
+		TORRENT_ASSERT(j->action == aux::job_action_t::write);
+		run.clear();
+		run.push_back(j);
+
+		int const max_blocks = m_settings.get_int(settings_pack::write_coalesce_blocks);
+		if (max_blocks < 2 || queue.m_queued_jobs.empty()) return;
+
+		// only look at the front of the queue, to bound the cost of this when
+		// the queue is long
+		constexpr int max_scan = 128;
+		scratch.clear();
+		while (!queue.m_queued_jobs.empty() && int(scratch.size()) < max_scan)
+			scratch.push_back(queue.m_queued_jobs.pop_front());
+
+		// the candidates are the blocks of the same storage, written with
+		// the same flags (which determine how the file is opened and how the
+		// pages are treated once written). Aborted jobs are left in the queue,
+		// to be failed by execute_job()
+		auto const candidate = [j](aux::mmap_disk_job const* c)
+		{
+			return c->action == aux::job_action_t::write
+				&& !(c->flags & aux::mmap_disk_job::aborted)
+				&& c->storage == j->storage
+				&& c->flags == j->flags;
+		};
+
+		for (auto* c : scratch)
+			if (candidate(c)) run.push_back(c);
+
+		if (run.size() > 1)
+		{
+			std::sort(run.begin(), run.end()
+				, [](aux::mmap_disk_job const* lhs, aux::mmap_disk_job const* rhs)
+				{ return torrent_offset(lhs) < torrent_offset(rhs); });
+
+			// if the same block is queued to be written more than once, the
+			// writes must stay in order. Such blocks end the run
+			auto const unique = [&run](std::vector<aux::mmap_disk_job*>::iterator const i)
+			{
+				std::int64_t const o = torrent_offset(*i);
+				return (i == run.begin() || torrent_offset(*(i - 1)) != o)
+					&& (i + 1 == run.end() || torrent_offset(*(i + 1)) != o);
+			};
+
+			// extend the run in both directions from j, for as long as the
+			// blocks are adjacent
+			auto const pos = std::find(run.begin(), run.end(), j);
+			auto first = pos;
+			auto last = pos + 1;
+			std::int64_t start = torrent_offset(j);
+			std::int64_t end = start + j->d.io.buffer_size;
+			while (last - first < max_blocks)
+			{
+				if (last != run.end() && torrent_offset(*last) == end && unique(last))
+				{
+					end += (*last)->d.io.buffer_size;
+					++last;
+				}
+				else if (first != run.begin()
+					&& torrent_offset(*(first - 1)) + (*(first - 1))->d.io.buffer_size == start
+					&& unique(first - 1))
+				{
+					--first;
+					start = torrent_offset(*first);
+				}
+				else break;
+			}
+			run.erase(last, run.end());
+			run.erase(run.begin(), first);
+		}
+
+		// put back the jobs that are not part of the run, in the order they
+		// were queued
+		jobqueue_t rest;
+		for (auto* c : scratch)
+		{
+			if (run.size() > 1 && candidate(c)
+				&& std::find(run.begin(), run.end(), c) != run.end())
+				continue;
+			rest.push_back(c);
+		}
+		queue.m_queued_jobs.prepend(std::move(rest));
+	}
+
+	void mmap_disk_io::execute_write_run(span<aux::mmap_disk_job* const> run)
+	{
+		TORRENT_ASSERT(run.size() > 1);
+		aux::mmap_disk_job* const front = run.front();
+		std::shared_ptr<mmap_storage> const storage = front->storage;
+
+		auto const action = static_cast<std::size_t>(aux::job_action_t::write);
+		time_point const start_time = clock_type::now();
+		for (auto const* j : run)
+		{
+			TORRENT_ASSERT(j->storage == storage);
+			TORRENT_ASSERT(j->flags & aux::mmap_disk_job::in_progress);
+			m_queue_latency[action].record(total_microseconds(start_time - j->queued));
+		}
+
+		std::ptrdiff_t const num_jobs = run.size();
+		m_stats_counters.inc_stats_counter(counters::num_running_disk_jobs, num_jobs);
+		m_stats_counters.inc_stats_counter(counters::num_writing_threads, 1);
+
+		TORRENT_ALLOCA(bufs, span<char>, num_jobs);
+		int total_size = 0;
+		for (std::ptrdiff_t i = 0; i < num_jobs; ++i)
+		{
+			auto const& buffer = boost::get<disk_buffer_holder>(run[i]->argument);
+			bufs[i] = {buffer.data(), run[i]->d.io.buffer_size};
+			total_size += run[i]->d.io.buffer_size;
+		}
+
+		storage_error error;
+		int ret = -1;
+		status_t status = catch_disk_errors(error, [&]
+		{
+			ret = storage->write(m_settings, bufs, front->piece, front->d.io.offset
+				, file_mode_for_job(front), front->flags, error);
+			return status_t::no_error;
+		});
+		if (status == status_t::no_error && ret != total_size)
+			status = status_t::fatal_disk_error;
+
+		m_stats_counters.inc_stats_counter(counters::num_writing_threads, -1);
+
+		std::int64_t const write_time = total_microseconds(clock_type::now() - start_time);
+		if (!error.ec)
+		{
+			m_stats_counters.inc_stats_counter(counters::num_blocks_written, num_jobs);
+			m_stats_counters.inc_stats_counter(counters::num_write_ops);
+			m_stats_counters.inc_stats_counter(counters::disk_write_time, write_time);
+			m_stats_counters.inc_stats_counter(counters::disk_job_time, write_time);
+		}
+
+		{
+			std::lock_guard<std::mutex> l(m_need_tick_mutex);
+			if (!storage->set_need_tick())
+				m_need_tick.push_back({aux::time_now() + minutes(2), storage});
+		}
+
+		jobqueue_t completed_jobs;
+		for (auto* j : run)
+		{
+			// the block must not be freed until it has been removed from the
+			// store buffer, since reads may still be looking it up there
+			m_store_buffer.erase({storage->storage_index(), j->piece, j->d.io.offset});
+			boost::get<disk_buffer_holder>(j->argument).reset();
+
+			j->error = error;
+			j->ret = status;
+			m_exec_latency[action].record(write_time);
+			completed_jobs.push_back(j);
+		}
+		m_stats_counters.inc_stats_counter(counters::num_running_disk_jobs, -num_jobs);
+
+		add_completed_jobs(std::move(completed_jobs));
+	}
+
 	void mmap_disk_io::immediate_execute()
 	{
 		while (!m_generic_io_jobs.m_queued_jobs.empty())
@@ -1539,12 +1832,23 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		time_point next_flush_file = min_time();
 #endif
 
+		// the run of adjacent write jobs to perform together, see
+		// coalesce_writes()
+		std::vector<aux::mmap_disk_job*> write_run;
+		std::vector<aux::mmap_disk_job*> scratch;
+
 		for (;;)
 		{
 			aux::mmap_disk_job* j = nullptr;
 			bool const should_exit = wait_for_job(queue, pool, l);
 			if (should_exit) break;
 			j = queue.m_queued_jobs.pop_front();
+			write_run.clear();
+			if (j->action == aux::job_action_t::write
+				&& !(j->flags & aux::mmap_disk_job::aborted))
+			{
+				coalesce_writes(queue, j, write_run, scratch);
+			}
 			l.unlock();
 
 			TORRENT_ASSERT((j->flags & aux::mmap_disk_job::in_progress) || !j->storage);
@@ -1593,7 +1897,10 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 #endif
 			}
 
-			execute_job(j);
+			if (write_run.size() > 1)
+				execute_write_run(write_run);
+			else
+				execute_job(j);
 
 			l.lock();
 		}
@@ -63,6 +63,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/drive_info.hpp"
 #include "libtorrent/stat_cache.hpp"
 #include "libtorrent/hex.hpp" // to_hex
+#include "libtorrent/aux_/hash_many.hpp"
+#include "libtorrent/aux_/alloca.hpp"
 
 #if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
 
@@ -103,6 +105,37 @@ error_code translate_error(std::error_code const& err, bool const write)
 
 #endif
 }
+	// hands out consecutive ranges of a list of buffers, as if they were a
+	// single contiguous buffer
+	struct buffer_cursor
+	{
+		explicit buffer_cursor(span<span<char> const> bufs) : m_bufs(bufs) {}
+
+		// calls ``f`` with the (partial) buffers making up the next ``len``
+		// bytes
+		template <typename Fun>
+		void advance(std::ptrdiff_t len, Fun f)
+		{
+			while (len > 0)
+			{
+				TORRENT_ASSERT(!m_bufs.empty());
+				span<char> const b = m_bufs.front().subspan(m_pos);
+				std::ptrdiff_t const n = std::min(len, b.size());
+				f(b.first(n));
+				len -= n;
+				m_pos += n;
+				if (m_pos == m_bufs.front().size())
+				{
+					m_bufs = m_bufs.subspan(1);
+					m_pos = 0;
+				}
+			}
+		}
+
+	private:
+		span<span<char> const> m_bufs;
+		std::ptrdiff_t m_pos = 0;
+	};
 } // namespace
 
 
@@ -604,6 +637,58 @@ error_code translate_error(std::error_code const& err, bool const write)
 		});
 	}
 
+	std::shared_ptr<aux::file_mapping> mmap_storage::mapped_read(
+		settings_interface const& sett
+		, piece_index_t const piece, int const offset, int const length
+		, aux::open_mode_t const mode
+		, char const*& buf, storage_error& error)
+	{
+		file_storage const& fs = files();
+		std::int64_t const torrent_offset = static_cast<int>(piece)
+			* std::int64_t(fs.piece_length()) + offset;
+		file_index_t const file_index = fs.file_index_at_offset(torrent_offset);
+		std::int64_t const file_offset = torrent_offset - fs.file_offset(file_index);
+
+		if (file_offset + length > fs.file_size(file_index)
+			|| fs.pad_file_at(file_index))
+			return {};
+
+		if (file_index < m_file_priority.end_index()
+			&& m_file_priority[file_index] == dont_download
+			&& use_partfile(file_index))
+			return {};
+
+		auto handle = open_file(sett, file_index, mode, error);
+		if (error) return {};
+		if (!handle->has_memory_map()) return {};
+
+		span<byte const> const file_range = handle->range();
+		if (file_range.size() < file_offset + length) return {};
+
+		char const* const data = reinterpret_cast<char const*>(file_range.data()) + file_offset;
+		try
+		{
+			// make sure the pages are resident, the network thread should not
+			// block on (or crash because of) a page fault
+			sig::try_signal([&]{
+				char volatile sum = 0;
+				for (int i = 0; i < length; i += 4096) sum = char(sum + data[i]);
+				sum = char(sum + data[length - 1]);
+				TORRENT_UNUSED(sum);
+			});
+		}
+		catch (std::system_error const& err)
+		{
+			error.ec = translate_error(err.code(), false);
+			error.operation = operation_t::file_read;
+			error.file(file_index);
+			return {};
+		}
+
+		buf = data;
+		return handle;
+	}
+
 	int mmap_storage::write(settings_interface const& sett
 		, span<char> buffer
 		, piece_index_t const piece, int const offset
@@ -611,17 +696,38 @@ error_code translate_error(std::error_code const& err, bool const write)
 		, disk_job_flags_t const flags
 		, storage_error& error)
 	{
+		span<char> const bufs[] = {buffer};
+		return write(sett, span<span<char> const>(bufs), piece, offset, mode, flags, error);
+	}
+
+	int mmap_storage::write(settings_interface const& sett
+		, span<span<char> const> bufs
+		, piece_index_t const piece, int const offset
+		, aux::open_mode_t const mode
+		, disk_job_flags_t const flags
+		, storage_error& error)
+	{
 #ifdef TORRENT_SIMULATE_SLOW_WRITE
 		std::this_thread::sleep_for(milliseconds(rand() % 800));
 #endif
-		return readwrite(files(), buffer, piece, offset, error
-			, [this, mode, flags, &sett](file_index_t const file_index
+		std::ptrdiff_t const len = std::accumulate(bufs.begin(), bufs.end()
+			, std::ptrdiff_t(0), [](std::ptrdiff_t const acc, span<char> const b)
+			{ return acc + b.size(); });
+
+		// readwrite() splits the (virtual) contiguous buffer by file. The
+		// cursor keeps track of which of our buffers those ranges correspond
+		// to
+		buffer_cursor cursor(bufs);
+		char dummy;
+		return readwrite(files(), {&dummy, len}, piece, offset, error
+			, [this, mode, flags, &sett, &cursor, &bufs](file_index_t const file_index
 				, std::int64_t const file_offset
-				, span<char> buf, storage_error& ec)
+				, span<char> const buf, storage_error& ec)
 		{
 			if (files().pad_file_at(file_index))
 			{
 				// writing to a pad-file is a no-op
+				cursor.advance(buf.size(), [](span<char>) {});
 				return int(buf.size());
 			}
 
@@ -631,10 +737,17 @@ error_code translate_error(std::error_code const& err, bool const write)
 			{
 				TORRENT_ASSERT(m_part_file);
 
+				// each buffer is a block, which never spans pieces. So every
+				// range can be mapped to a part file slot on its own
+				int ret = 0;
 				error_code e;
-				peer_request map = files().map_file(file_index
-					, file_offset, 0);
-				int const ret = m_part_file->write(buf, map.piece, map.start, e);
+				cursor.advance(buf.size(), [&](span<char> const b)
+				{
+					if (e) return;
+					peer_request const map = files().map_file(file_index
+						, file_offset + ret, 0);
+					ret += m_part_file->write(b, map.piece, map.start, e);
+				});
 
 				if (e)
 				{
@@ -660,9 +773,16 @@ error_code translate_error(std::error_code const& err, bool const write)
 			ec.operation = operation_t::file_write;
 
 			if (!m_use_mmap_writes || !handle->has_memory_map())
-				return aux::pwrite_all(handle->fd(), buf, file_offset, ec.ec);
+			{
+				// a range can't be split into more pieces than there are
+				// buffers, plus one for the partial buffer at the start
+				TORRENT_ALLOCA(vec, span<char const>, bufs.size() + 1);
+				std::ptrdiff_t num_vec = 0;
+				cursor.advance(buf.size(), [&](span<char> const b)
+					{ vec[num_vec++] = b; });
+				return aux::pwritev_all(handle->fd(), vec.first(num_vec), file_offset, ec.ec);
+			}
 
-			int ret = 0;
 			span<byte> file_range = handle->range().subspan(static_cast<std::ptrdiff_t>(file_offset));
 
 			try
@@ -670,11 +790,13 @@ error_code translate_error(std::error_code const& err, bool const write)
 				TORRENT_ASSERT(file_range.size() >= buf.size());
 
 				sig::try_signal([&]{
-					std::memcpy(const_cast<char*>(file_range.data()), buf.data(), static_cast<std::size_t>(buf.size()));
+					char* dst = const_cast<char*>(file_range.data());
+					cursor.advance(buf.size(), [&](span<char> const b)
+					{
+						std::memcpy(dst, b.data(), static_cast<std::size_t>(b.size()));
+						dst += b.size();
 					});
-
-				file_range = file_range.subspan(buf.size());
-				ret += static_cast<int>(buf.size());
+				});
 
 				if (flags & disk_interface::volatile_read)
 					handle->dont_need(file_range.first(buf.size()));
@@ -688,10 +810,10 @@ error_code translate_error(std::error_code const& err, bool const write)
 			}
 
 #if TORRENT_HAVE_MAP_VIEW_OF_FILE
-			m_pool.record_file_write(storage_index(), file_index, ret);
+			m_pool.record_file_write(storage_index(), file_index, int(buf.size()));
 #endif
 
-			return ret;
+			return int(buf.size());
 		});
 	}
 
@@ -836,6 +958,105 @@ error_code translate_error(std::error_code const& err, bool const write)
 		return static_cast<int>(file_range.size());
 	}
 
+	int mmap_storage::hash2(settings_interface const& sett
+		, span<sha256_hash> const hashes
+		, piece_index_t const piece, int const offset
+		, aux::open_mode_t const mode
+		, disk_job_flags_t const flags
+		, storage_error& error)
+	{
+		int const piece_size = files().piece_size2(piece);
+		int const num_blocks = int(hashes.size());
+		TORRENT_ASSERT(num_blocks > 0);
+		TORRENT_ASSERT(offset % default_block_size == 0);
+		TORRENT_ASSERT(offset + (num_blocks - 1) * default_block_size < piece_size);
+
+		// all blocks of a v2 piece belong to the same file
+		std::int64_t const start_offset = static_cast<int>(piece) * std::int64_t(files().piece_length()) + offset;
+		file_index_t const file_index = files().file_index_at_offset(start_offset);
+		std::int64_t const file_offset = start_offset - files().file_offset(file_index);
+		TORRENT_ASSERT(file_offset >= 0);
+		TORRENT_ASSERT(!files().pad_file_at(file_index));
+
+		auto block_size = [&](int const block_offset)
+		{ return std::min(default_block_size, piece_size - block_offset); };
+
+		auto hash_one_by_one = [&]
+		{
+			int ret = 0;
+			for (int i = 0; i < num_blocks; ++i)
+			{
+				int const block_offset = offset + i * default_block_size;
+				hasher256 ph;
+				int const r = hash2(sett, ph, block_size(block_offset), piece
+					, block_offset, mode, flags, error);
+				if (r < 0) return -1;
+				hashes[i] = ph.final();
+				ret += r;
+			}
+			return ret;
+		};
+
+		if (file_index < m_file_priority.end_index()
+			&& m_file_priority[file_index] == dont_download
+			&& use_partfile(file_index))
+		{
+			return hash_one_by_one();
+		}
+
+		auto handle = open_file(sett, file_index, mode, error);
+		if (error) return -1;
+
+		if (!handle->has_memory_map()) return hash_one_by_one();
+
+		span<byte const> file_range = handle->range();
+		if (std::int64_t(file_range.size()) <= file_offset)
+		{
+			error.ec = boost::asio::error::eof;
+			error.file(file_index);
+			error.operation = operation_t::file_read;
+			return -1;
+		}
+		file_range = file_range.subspan(std::ptrdiff_t(file_offset));
+
+		// if the file is short, only the blocks that start within it are
+		// hashed, and the last of those may be truncated. This mirrors hashing
+		// them one at a time
+		TORRENT_ALLOCA(blocks, span<char const>, num_blocks);
+		int num_mapped = 0;
+		std::ptrdiff_t total = 0;
+		for (int i = 0; i < num_blocks; ++i)
+		{
+			std::ptrdiff_t const start = std::ptrdiff_t(i) * default_block_size;
+			if (start >= file_range.size()) break;
+			std::ptrdiff_t const len = std::min(std::ptrdiff_t(block_size(offset + i * default_block_size))
+				, file_range.size() - start);
+			blocks[i] = {reinterpret_cast<char const*>(file_range.data()) + start, len};
+			total = start + len;
+			++num_mapped;
+		}
+
+		sig::try_signal([&]{
+			aux::hash_many(blocks.first(num_mapped), hashes.first(num_mapped));
+		});
+
+		file_range = file_range.first(total);
+		if (flags & disk_interface::volatile_read)
+			handle->dont_need(file_range);
+		if (flags & disk_interface::flush_piece)
+			handle->page_out(file_range);
+
+		if (num_mapped < num_blocks)
+		{
+			error.ec = boost::asio::error::eof;
+			error.file(file_index);
+			error.operation = operation_t::file_read;
+			return -1;
+		}
+
+		return static_cast<int>(total);
+	}
+
 	// a wrapper around open_file_impl that, if it fails, makes sure the
 	// directories have been created and retries
 	std::shared_ptr<aux::file_mapping> mmap_storage::open_file(settings_interface const& sett
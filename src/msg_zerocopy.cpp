@@ -0,0 +1,248 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "libtorrent/config.hpp"
+
+#if TORRENT_USE_MSG_ZEROCOPY
+
+#include "libtorrent/aux_/msg_zerocopy.hpp"
+#include "libtorrent/assert.hpp"
+#include "libtorrent/aux_/time.hpp"
+
+#include <cstring>
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <linux/errqueue.h>
+
+// these were added in Linux 4.14, but may be missing from older headers
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+
+namespace libtorrent {
+namespace aux {
+
+namespace {
+
+	// compares send numbers, which wrap around
+	bool before(std::uint32_t const lhs, std::uint32_t const rhs)
+	{
+		return std::int32_t(lhs - rhs) < 0;
+	}
+}
+
+	int const zerocopy_tracker::send_flag = MSG_ZEROCOPY;
+
+	bool zerocopy_tracker::enable(int const fd, error_code& ec)
+	{
+		if (m_state != state_t::unknown) return m_state == state_t::enabled;
+
+		int const one = 1;
+		if (::setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0)
+		{
+			ec.assign(errno, system_category());
+			m_state = state_t::unsupported;
+			return false;
+		}
+		m_state = state_t::enabled;
+		return true;
+	}
+
+	bool zerocopy_tracker::reap(int const fd)
+	{
+		if (!outstanding()) return false;
+
+		std::uint32_t const prev = m_completed;
+		for (;;)
+		{
+			// the notification is delivered as a control message, followed by
+			// the offender address. There's no payload
+			alignas(cmsghdr) char control[128];
+			msghdr msg{};
+			msg.msg_control = control;
+			msg.msg_controllen = sizeof(control);
+
+			// EAGAIN means the queue is drained
+			if (::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) break;
+
+			// sockets without an error queue may report end-of-file instead,
+			// forever
+			if (!(msg.msg_flags & MSG_ERRQUEUE)) break;
+
+			for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm))
+			{
+				if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+					&& !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+					continue;
+
+				sock_extended_err err;
+				std::memcpy(&err, CMSG_DATA(cm), sizeof(err));
+				if (err.ee_origin != SO_EE_ORIGIN_ZEROCOPY || err.ee_errno != 0)
+					continue;
+
+				// whether the kernel ended up copying the data anyway
+				// (SO_EE_CODE_ZEROCOPY_COPIED) doesn't matter here, either way
+				// it's done with the buffers
+				on_completion(err.ee_info, err.ee_data);
+			}
+		}
+		return m_completed != prev;
+	}
+
+	void zerocopy_tracker::on_completion(std::uint32_t const first
+		, std::uint32_t const last)
+	{
+		TORRENT_ASSERT(!before(last, first));
+		if (before(m_completed, first))
+		{
+			m_early.emplace_back(first, last);
+			return;
+		}
+		if (before(m_completed, last + 1)) m_completed = last + 1;
+
+		// pick up any ranges that arrived early, and are now contiguous
+		for (auto i = m_early.begin(); i != m_early.end();)
+		{
+			if (before(m_completed, i->first))
+			{
+				++i;
+				continue;
+			}
+			if (before(m_completed, i->second + 1)) m_completed = i->second + 1;
+			m_early.erase(i);
+			i = m_early.begin();
+		}
+		TORRENT_ASSERT(!before(m_issued, m_completed));
+	}
+
+	constexpr seconds zerocopy_reaper::linger_time;
+
+	zerocopy_reaper::~zerocopy_reaper()
+	{
+		abort();
+	}
+
+	int zerocopy_reaper::keep_open(int const fd)
+	{
+		return ::dup(fd);
+	}
+
+	void zerocopy_reaper::add(int const fd, zerocopy_tracker const& t
+		, chained_buffer& buffers)
+	{
+		entry e;
+		e.fd = fd;
+		e.tracker = t;
+		e.buffers.reset(new chained_buffer);
+		e.buffers->take_retained(buffers);
+		e.deadline = aux::time_now() + linger_time;
+
+		// the connection is being closed. Let the kernel send what's queued
+		// on the socket (and reference the buffers) before it sends the FIN
+		::shutdown(fd, SHUT_RDWR);
+
+		if (reap(e))
+		{
+			close(e);
+			return;
+		}
+		m_entries.push_back(std::move(e));
+	}
+
+	void zerocopy_reaper::tick(time_point const now)
+	{
+		for (auto i = m_entries.begin(); i != m_entries.end();)
+		{
+			if (reap(*i))
+			{
+				close(*i);
+				i = m_entries.erase(i);
+				continue;
+			}
+
+			if (!i->reset && now > i->deadline)
+			{
+				// the peer isn't reading
+				reset(*i);
+			}
+			++i;
+		}
+	}
+
+	void zerocopy_reaper::abort()
+	{
+		for (auto& e : m_entries)
+		{
+			if (!e.reset) reset(e);
+			reap(e);
+			close(e);
+		}
+		m_entries.clear();
+	}
+
+	bool zerocopy_reaper::reap(entry& e)
+	{
+		if (e.tracker.reap(e.fd))
+			e.buffers->release_retained(e.tracker.completed());
+		return !e.tracker.outstanding();
+	}
+
+	void zerocopy_reaper::reset(entry& e)
+	{
+		// disconnecting the socket resets the connection and drops its send
+		// queue, which completes the sends. Unlike close(), this keeps the
+		// error queue around for us to read the notifications
+		sockaddr sa{};
+		sa.sa_family = AF_UNSPEC;
+		::connect(e.fd, &sa, sizeof(sa));
+		e.reset = true;
+	}
+
+	void zerocopy_reaper::close(entry& e)
+	{
+		e.buffers.reset();
+		::close(e.fd);
+	}
+}
+}
+
+#endif // TORRENT_USE_MSG_ZEROCOPY
@@ -37,6 +37,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #if !defined TORRENT_DISABLE_ENCRYPTION
 
 #include <cstdint>
+#include <cstring>
 #include <algorithm>
 #include <random>
 
@@ -86,9 +87,6 @@ namespace libtorrent {
 		return ret;
 	}
 
-	void rc4_init(const unsigned char* in, std::size_t len, rc4 *state);
-	std::size_t rc4_encrypt(unsigned char *out, std::size_t outlen, rc4 *state);
-
 	// Set the prime P and the generator, generate local public key
 	dh_key_exchange::dh_key_exchange()
 	{
@@ -219,6 +217,31 @@ namespace libtorrent {
 		, std::size_t& bytes_transferred)
 	{
 		TORRENT_ASSERT(!is_recv_plaintext());
+		if (m_dec_stream)
+		{
+			// decrypt everything that has been received in one go, not just
+			// the bytes passed on to the upper layer now. The remainder is
+			// usually the rest of the current message, and the messages after
+			// it, which are passed on one at a time
+			int const bytes = int(bytes_transferred);
+			if (bytes <= m_decrypted_ahead)
+			{
+				m_decrypted_ahead -= bytes;
+				return 0;
+			}
+			int const pending = bytes - m_decrypted_ahead;
+			span<char> wr_buf = recv_buffer.mutable_buffer_ahead(pending);
+			int consume = 0;
+			int produce = 0;
+			int packet_size = 0;
+			std::tie(consume, produce, packet_size) = m_dec_handler->decrypt(wr_buf);
+			TORRENT_ASSERT(consume == 0);
+			TORRENT_ASSERT(packet_size == 0);
+			TORRENT_ASSERT(produce == int(wr_buf.size()));
+			m_decrypted_ahead = int(wr_buf.size()) - pending;
+			return 0;
+		}
+
 		int consume = 0;
 		if (recv_buffer.crypto_packet_finished())
 		{
@@ -260,8 +283,13 @@ namespace libtorrent {
 	}
 
 	void encryption_handler::switch_recv_crypto(std::shared_ptr<crypto_plugin> crypto
-		, aux::crypto_receive_buffer& recv_buffer)
+		, aux::crypto_receive_buffer& recv_buffer, bool const stream_cipher)
 	{
+		// any bytes the previous stream cipher decrypted ahead of the receive
+		// position are not passed through the new one. Switching away from
+		// the built-in RC4 mid-stream is not supported
+		m_decrypted_ahead = 0;
+		m_dec_stream = crypto && stream_cipher;
 		m_dec_handler = crypto;
 		int packet_size = 0;
 		if (crypto)
@@ -317,17 +345,9 @@ namespace libtorrent {
 		if (bufs.empty()) return std::make_tuple(0, empty);
 
 		int bytes_processed = 0;
-		for (auto& buf : bufs)
-		{
-			auto* const pos = reinterpret_cast<unsigned char*>(buf.data());
-			int const len = int(buf.size());
-
-			TORRENT_ASSERT(len >= 0);
-			TORRENT_ASSERT(pos);
-
-			bytes_processed += len;
-			rc4_encrypt(pos, std::uint32_t(len), &m_rc4_outgoing);
-		}
+		for (auto const& buf : bufs)
+			bytes_processed += int(buf.size());
+		rc4_crypt(bufs, m_rc4_outgoing);
 		return std::make_tuple(bytes_processed, empty);
 	}
 
@@ -336,17 +356,9 @@ namespace libtorrent {
 		if (!m_decrypt) return std::make_tuple(0, 0, 0);
 
 		int bytes_processed = 0;
-		for (auto& buf : bufs)
-		{
-			auto* const pos = reinterpret_cast<unsigned char*>(buf.data());
-			int const len = int(buf.size());
-
-			TORRENT_ASSERT(len >= 0);
-			TORRENT_ASSERT(pos);
-
-			bytes_processed += len;
-			rc4_encrypt(pos, std::uint32_t(len), &m_rc4_incoming);
-		}
+		for (auto const& buf : bufs)
+			bytes_processed += int(buf.size());
+		rc4_crypt(bufs, m_rc4_incoming);
 		return std::make_tuple(0, bytes_processed, 0);
 	}
 
@@ -356,63 +368,79 @@ namespace libtorrent {
 
 void rc4_init(const unsigned char* in, std::size_t len, rc4 *state)
 {
-	std::size_t const key_size = sizeof(state->buf);
+	std::size_t const key_size = 256;
 	aux::array<std::uint8_t, key_size> key;
-	std::uint8_t tmp, *s;
-	int keylen, x, y, j;
 
 	TORRENT_ASSERT(state != nullptr);
+	TORRENT_ASSERT(len > 0);
 	TORRENT_ASSERT(len <= key_size);
 	if (len > key_size) len = key_size;
-
-	state->x = 0;
-	while (len--) {
-		state->buf[state->x++] = *in++;
-	}
-
-	/* extract the key */
-	s = state->buf.data();
-	std::memcpy(key.data(), s, key_size);
-	keylen = state->x;
+	std::memcpy(key.data(), in, len);
+	int const keylen = int(len);
 
 	/* make RC4 perm and shuffle */
-	for (x = 0; x < int(key_size); ++x) {
-		s[x] = x & 0xff;
+	auto& s = state->buf;
+	for (int x = 0; x < int(key_size); ++x) {
+		s[x] = std::uint32_t(x);
 	}
 
-	for (j = x = y = 0; x < int(key_size); x++) {
-		y = (y + state->buf[x] + key[j++]) & 255;
+	std::uint32_t y = 0;
+	for (int j = 0, x = 0; x < int(key_size); x++) {
+		y = (y + s[x] + key[j++]) & 255;
 		if (j == keylen) {
 			j = 0;
 		}
-		tmp = s[x]; s[x] = s[y]; s[y] = tmp;
+		std::swap(s[x], s[y]);
 	}
 	state->x = 0;
 	state->y = 0;
 }
 
-std::size_t rc4_encrypt(unsigned char *out, std::size_t outlen, rc4 *state)
+void rc4_crypt(span<span<char>> bufs, rc4& state)
 {
-	std::uint8_t x, y, *s, tmp;
-	std::size_t n;
-
-	TORRENT_ASSERT(out != nullptr);
-	TORRENT_ASSERT(state != nullptr);
+	// the state is kept in locals across all buffers. Writing to the buffers
+	// through a char pointer would otherwise force the compiler to reload
+	// the permutation after every byte, since it may alias it
+	std::uint32_t* const s = state.buf.data();
+	std::uint32_t x = std::uint32_t(state.x);
+	std::uint32_t y = std::uint32_t(state.y);
+
+	auto next = [&]
+	{
+		x = (x + 1) & 0xff;
+		std::uint32_t const sx = s[x];
+		y = (y + sx) & 0xff;
+		std::uint32_t const sy = s[y];
+		s[x] = sy;
+		s[y] = sx;
+		return std::uint8_t(s[(sx + sy) & 0xff]);
+	};
+
+	for (auto const& b : bufs)
+	{
+		TORRENT_ASSERT(b.data() != nullptr || b.empty());
+		char* buf = b.data();
+		std::size_t len = std::size_t(b.size());
 
-	n = outlen;
-	x = state->x & 0xff;
-	y = state->y & 0xff;
-	s = state->buf.data();
-	while (outlen--) {
-		x = (x + 1) & 255;
-		y = (y + s[x]) & 255;
-		tmp = s[x]; s[x] = s[y]; s[y] = tmp;
-		tmp = (s[x] + s[y]) & 255;
-		*out++ ^= s[tmp];
+		// generate 8 bytes of keystream at a time and apply it with a single
+		// 64 bit XOR
+		for (; len >= 8; len -= 8, buf += 8)
+		{
+			std::uint8_t ks[8];
+			for (auto& k : ks) k = next();
+			std::uint64_t ks64;
+			std::uint64_t data;
+			std::memcpy(&ks64, ks, 8);
+			std::memcpy(&data, buf, 8);
+			data ^= ks64;
+			std::memcpy(buf, &data, 8);
+		}
+		for (; len > 0; --len, ++buf)
+			*buf = char(std::uint8_t(*buf) ^ next());
 	}
-	state->x = x;
-	state->y = y;
-	return n;
+
+	state.x = int(x);
+	state.y = int(y);
 }
 
 } // namespace libtorrent
@@ -41,6 +41,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <vector>
 #include <functional>
 #include <cstdint>
+#include <cinttypes> // for PRId64
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <boost/logic/tribool.hpp>
@@ -188,6 +189,8 @@ namespace libtorrent {
 		m_quota[0] = 0;
 		m_quota[1] = 0;
 
+		m_recv_buffer.set_arena(m_ses.receive_buffer_arena());
+
 		TORRENT_ASSERT(pack.peerinfo == nullptr || pack.peerinfo->banned == false);
 #ifndef TORRENT_DISABLE_LOGGING
 		if (should_log(m_outgoing ? peer_log_alert::outgoing : peer_log_alert::incoming))
@@ -860,6 +863,11 @@ namespace libtorrent {
 		}
 		if (!m_peer_choked)
 			m_counters.inc_stats_counter(counters::num_peers_down_unchoked, -1);
+
+#if TORRENT_USE_MSG_ZEROCOPY
+		hand_off_zerocopy_sends();
+#endif
+
 		if (m_connected)
 			m_counters.inc_stats_counter(counters::num_peers_connected, -1);
 		m_connected = false;
@@ -1660,12 +1668,9 @@ namespace libtorrent {
 		if (is_disconnecting()) return;
 
 		if (m_request_queue.empty() && m_download_queue.size() < 2)
-		{
-			if (request_a_block(*t, *this))
-				m_counters.inc_stats_counter(counters::reject_piece_picks);
-		}
-
-		send_block_requests();
+			t->refill_requests(this, counters::reject_piece_picks);
+		else
+			send_block_requests();
 	}
 
 	// -----------------------------
@@ -1763,11 +1768,7 @@ namespace libtorrent {
 		if (is_disconnecting()) return;
 
 		if (is_interesting())
-		{
-			if (request_a_block(*t, *this))
-				m_counters.inc_stats_counter(counters::unchoke_piece_picks);
-			send_block_requests();
-		}
+			t->refill_requests(this, counters::unchoke_piece_picks);
 	}
 
 	// -----------------------------
@@ -2906,6 +2907,14 @@ namespace libtorrent {
 		TORRENT_ASSERT_VAL(m_received_in_piece == p.length, m_received_in_piece);
 		m_received_in_piece = 0;
 #endif
+		// requests that timed out may have been sent again, so we don't know
+		// which one this is the response to
+		if (b->sent && !b->timed_out)
+		{
+			m_bdp.on_block(now, now - b->send_time.get(m_connect)
+				, std::uint32_t(m_statistics.total_payload_download()) - b->delivered_at_send);
+		}
+
 		// if the block we got is already finished, then ignore it
 		if (picker.is_downloaded(block_finished))
 		{
@@ -2938,9 +2947,7 @@ namespace libtorrent {
 			if (!m_download_queue.empty())
 				m_requested.set(m_connect, now);
 
-			if (request_a_block(*t, *this))
-				m_counters.inc_stats_counter(counters::incoming_redundant_piece_picks);
-			send_block_requests();
+			t->refill_requests(this, counters::incoming_redundant_piece_picks);
 			return;
 		}
 
@@ -3109,9 +3116,7 @@ namespace libtorrent {
 
 		if (is_disconnecting()) return;
 
-		if (request_a_block(*t, *this))
-			m_counters.inc_stats_counter(counters::incoming_piece_picks);
-		send_block_requests();
+		t->refill_requests(this, counters::incoming_piece_picks);
 	}
 
 	void peer_connection::check_graceful_pause()
@@ -4306,6 +4311,9 @@ namespace libtorrent {
 		{
 			// make sure we free up all send buffers that are owned
 			// by the disk thread
+#if TORRENT_USE_MSG_ZEROCOPY
+			hand_off_zerocopy_sends();
+#endif
 			m_send_buffer.clear();
 		}
 
@@ -4450,6 +4458,20 @@ namespace libtorrent {
 
 		m_disconnecting = true;
 
+#if TORRENT_USE_MSG_ZEROCOPY
+		keep_zerocopy_socket();
+#endif
+
+		// leave the rate limiter queues right away. Otherwise the queued
+		// requests keep this peer alive, and dilute the share of the peers
+		// still connected, until they expire
+		for (int i = 0; i < 2; ++i)
+		{
+			if (!(m_channel_state[i] & peer_info::bw_limit)) continue;
+			m_ses.get_bandwidth_manager(i)->cancel_request(this);
+			m_channel_state[i] &= ~peer_info::bw_limit;
+		}
+
 		if (t)
 		{
 			if (ec)
@@ -4795,7 +4817,23 @@ namespace libtorrent {
 		// when we're in slow-start mode we increase the desired queue size every
 		// time we receive a piece, no need to adjust it here (other than
 		// enforcing the upper limit)
-		if (!m_slow_start)
+		std::shared_ptr<torrent> t = m_torrent.lock();
+		int const bs = t->block_size();
+		TORRENT_ASSERT(bs > 0);
+
+		std::int64_t const bdp_target
+			= m_settings.get_bool(settings_pack::bdp_request_queue)
+			? m_bdp.target_outstanding() : 0;
+
+		if (bdp_target > 0)
+		{
+			// once we have an estimate of the bandwidth-delay product, it
+			// supersedes both slow-start and request_queue_time
+			m_slow_start = false;
+			m_desired_queue_size = std::uint16_t(std::min(std::int64_t(m_max_out_request_queue)
+				, (bdp_target + bs - 1) / bs));
+		}
+		else if (!m_slow_start)
 		{
 			// (if the latency is more than this, the download will stall)
 			// so, the queue size is queue_time * down_rate / 16 kiB
@@ -4803,11 +4841,6 @@ namespace libtorrent {
 			// the minimum number of requests is 2 and the maximum is 48
 			// the block size doesn't have to be 16. So we first query the
 			// torrent for it
-			std::shared_ptr<torrent> t = m_torrent.lock();
-			int const bs = t->block_size();
-
-			TORRENT_ASSERT(bs > 0);
-
 			m_desired_queue_size = std::uint16_t(queue_time * download_rate / bs);
 		}
 
@@ -4820,9 +4853,9 @@ namespace libtorrent {
 		if (previous_queue_size != m_desired_queue_size)
 		{
 			peer_log(peer_log_alert::info, "UPDATE_QUEUE_SIZE"
-				, "dqs: %d max: %d dl: %d qt: %d snubbed: %d slow-start: %d"
+				, "dqs: %d max: %d dl: %d qt: %d snubbed: %d slow-start: %d bdp: %" PRId64
 				, int(m_desired_queue_size), int(m_max_out_request_queue)
-				, download_rate, queue_time, int(m_snubbed), int(m_slow_start));
+				, download_rate, queue_time, int(m_snubbed), int(m_slow_start), bdp_target);
 		}
 #endif
 	}
@@ -4839,6 +4872,12 @@ namespace libtorrent {
 
 		std::shared_ptr<torrent> t = m_torrent.lock();
 
+#if TORRENT_USE_MSG_ZEROCOPY
+		// completions for the last writes, after we stopped sending, are
+		// only picked up here
+		reap_zerocopy_sends();
+#endif
+
 		int warning = 0;
 		// drain the IP overhead from the bandwidth limiters
 		if (m_settings.get_bool(settings_pack::rate_limit_ip_overhead) && t)
@@ -5377,6 +5416,9 @@ namespace libtorrent {
 				auto const read_mode = m_settings.get_int(settings_pack::disk_io_read_mode);
 				if (read_mode == settings_pack::disable_os_cache)
 					flags |= disk_interface::volatile_read;
+				if (m_settings.get_bool(settings_pack::zero_copy_send)
+					&& allow_zero_copy_send())
+					flags |= disk_interface::zero_copy;
 
 				m_disk_thread.async_read(t->storage(), r
 					, [conn = self(), r](disk_buffer_holder buf, storage_error const& ec)
@@ -5919,12 +5961,81 @@ namespace libtorrent {
 			>;
 		static_assert(sizeof(write_handler_type) == sizeof(std::shared_ptr<peer_connection>)
 			, "write handler does not have the expected size");
-		m_socket.async_write_some(vec, write_handler_type(self()));
+#if TORRENT_USE_MSG_ZEROCOPY
+		m_zerocopy_write = use_msg_zerocopy(amount_to_send);
+		if (m_zerocopy_write)
+		{
+			boost::get<tcp::socket>(m_socket).async_send(vec
+				, tcp::socket::message_flags(aux::zerocopy_tracker::send_flag)
+				, write_handler_type(self()));
+		}
+		else
+#endif
+		{
+			m_socket.async_write_some(vec, write_handler_type(self()));
+		}
 
 		m_channel_state[upload_channel] |= peer_info::bw_network;
 		m_last_sent.set(m_connect, aux::time_now());
 	}
 
+#if TORRENT_USE_MSG_ZEROCOPY
+	bool peer_connection::use_msg_zerocopy(int const bytes)
+	{
+		// for small writes, pinning the pages and handling the completion
+		// notification costs more than the copy it saves
+		if (bytes < default_block_size) return false;
+		if (!m_settings.get_bool(settings_pack::msg_zerocopy_send)) return false;
+
+		// only direct TCP connections. SSL and uTP sockets copy the payload
+		// into their own buffers anyway
+		auto* const sock = boost::get<tcp::socket>(&m_socket);
+		if (sock == nullptr) return false;
+
+		error_code ec;
+		if (m_zerocopy.enable(sock->native_handle(), ec)) return true;
+#ifndef TORRENT_DISABLE_LOGGING
+		if (ec && should_log(peer_log_alert::info))
+		{
+			peer_log(peer_log_alert::info, "MSG_ZEROCOPY", "not supported: %s"
+				, ec.message().c_str());
+		}
+#endif
+		return false;
+	}
+
+	void peer_connection::reap_zerocopy_sends()
+	{
+		if (!m_zerocopy.outstanding()) return;
+		auto* const sock = boost::get<tcp::socket>(&m_socket);
+		if (sock == nullptr || !sock->is_open()) return;
+		if (m_zerocopy.reap(sock->native_handle()))
+			m_send_buffer.release_retained(m_zerocopy.completed());
+	}
+
+	void peer_connection::keep_zerocopy_socket()
+	{
+		if (!m_zerocopy.outstanding() && !m_zerocopy_write) return;
+		auto* const sock = boost::get<tcp::socket>(&m_socket);
+		if (sock == nullptr || !sock->is_open()) return;
+		m_zerocopy_fd = aux::zerocopy_reaper::keep_open(sock->native_handle());
+	}
+
+	void peer_connection::hand_off_zerocopy_sends()
+	{
+		if (m_zerocopy_fd < 0) return;
+		int const fd = m_zerocopy_fd;
+		m_zerocopy_fd = -1;
+
+		// the buffers of completed writes have already been retained, but the
+		// one at the front of the send buffer may have been sent in part. The
+		// rest was never passed to the kernel, but is simply retained along
+		// with it
+		m_send_buffer.retain_front(m_send_buffer.size(), m_zerocopy.last_sent());
+		m_ses.get_zerocopy_reaper().add(fd, m_zerocopy, m_send_buffer);
+	}
+#endif
+
 	void peer_connection::on_disk()
 	{
 		TORRENT_ASSERT(is_single_thread());
@@ -6455,7 +6566,25 @@ namespace libtorrent {
 
 		TORRENT_ASSERT(m_channel_state[upload_channel] & peer_info::bw_network);
 
-		m_send_buffer.pop_front(int(bytes_transferred));
+#if TORRENT_USE_MSG_ZEROCOPY
+		if (m_zerocopy_write)
+		{
+			m_zerocopy_write = false;
+			m_zerocopy.on_send(bytes_transferred > 0);
+		}
+		// if the kernel may still be reading from any buffer we have sent
+		// with MSG_ZEROCOPY, including the one at the front of the queue, the
+		// buffers must outlive the last such send
+		if (m_zerocopy.outstanding())
+		{
+			m_send_buffer.retain_front(int(bytes_transferred), m_zerocopy.last_sent());
+			reap_zerocopy_sends();
+		}
+		else
+#endif
+		{
+			m_send_buffer.pop_front(int(bytes_transferred));
+		}
 
 		time_point const now = clock_type::now();
 
@@ -6464,7 +6593,12 @@ namespace libtorrent {
 			if (block.send_buffer_offset == pending_block::not_in_buffer)
 				continue;
 			if (block.send_buffer_offset < int(bytes_transferred))
+			{
 				block.send_buffer_offset = pending_block::not_in_buffer;
+				block.sent = true;
+				block.send_time.set(m_connect, now);
+				block.delivered_at_send = std::uint32_t(m_statistics.total_payload_download());
+			}
 			else
 				block.send_buffer_offset -= int(bytes_transferred);
 		}
@@ -6500,6 +6634,9 @@ namespace libtorrent {
 		{
 			// make sure we free up all send buffers that are owned
 			// by the disk thread
+#if TORRENT_USE_MSG_ZEROCOPY
+			hand_off_zerocopy_sends();
+#endif
 			m_send_buffer.clear();
 			return;
 		}
@@ -36,6 +36,7 @@ POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <functional>
+#include <limits>
 
 #include "libtorrent/peer_connection.hpp"
 #include "libtorrent/web_peer_connection.hpp"
@@ -84,6 +85,105 @@ namespace {
 		std::uint16_t m_port;
 	};
 
+	std::uint64_t rotl64(std::uint64_t const x, int const b)
+	{
+		return (x << b) | (x >> (64 - b));
+	}
+
+	void sip_round(std::uint64_t (&v)[4])
+	{
+		v[0] += v[1]; v[1] = rotl64(v[1], 13); v[1] ^= v[0]; v[0] = rotl64(v[0], 32);
+		v[2] += v[3]; v[3] = rotl64(v[3], 16); v[3] ^= v[2];
+		v[0] += v[3]; v[3] = rotl64(v[3], 21); v[3] ^= v[0];
+		v[2] += v[1]; v[1] = rotl64(v[1], 17); v[1] ^= v[2]; v[2] = rotl64(v[2], 32);
+	}
+
+	// SipHash-2-4. The peer_list address index is keyed by addresses other
+	// peers (via PEX, the DHT and trackers) get to pick. With a predictable
+	// hash function they could make all of them land in the same probe
+	// sequence, turning every lookup into a linear scan. Keying the hash with
+	// a random key prevents that
+	std::uint32_t siphash(peer_list::hash_key const& k
+		, std::uint8_t const* in, std::size_t const len)
+	{
+		std::uint64_t v[4] = {
+			k[0] ^ 0x736f6d6570736575ULL
+			, k[1] ^ 0x646f72616e646f6dULL
+			, k[0] ^ 0x6c7967656e657261ULL
+			, k[1] ^ 0x7465646279746573ULL };
+
+		std::size_t i = 0;
+		for (; i + 8 <= len; i += 8)
+		{
+			std::uint64_t m = 0;
+			for (std::size_t j = 0; j < 8; ++j)
+				m |= std::uint64_t(in[i + j]) << (8 * j);
+			v[3] ^= m;
+			sip_round(v);
+			sip_round(v);
+			v[0] ^= m;
+		}
+
+		std::uint64_t m = std::uint64_t(len & 0xff) << 56;
+		for (std::size_t j = 0; i + j < len; ++j)
+			m |= std::uint64_t(in[i + j]) << (8 * j);
+		v[3] ^= m;
+		sip_round(v);
+		sip_round(v);
+		v[0] ^= m;
+
+		v[2] ^= 0xff;
+		for (int r = 0; r < 4; ++r) sip_round(v);
+		return std::uint32_t(v[0] ^ v[1] ^ v[2] ^ v[3]);
+	}
+
+	std::uint32_t hash_peer_address(peer_list::hash_key const& k, address const& a)
+	{
+		if (a.is_v4())
+		{
+			auto const b = a.to_v4().to_bytes();
+			return siphash(k, b.data(), b.size());
+		}
+		auto const b = a.to_v6().to_bytes();
+		return siphash(k, b.data(), b.size());
+	}
+
+#if TORRENT_USE_I2P
+	std::uint32_t hash_i2p_dest(peer_list::hash_key const& k, string_view const dest)
+	{
+		return siphash(k, reinterpret_cast<std::uint8_t const*>(dest.data()), dest.size());
+	}
+#endif
+
+	std::uint32_t hash_peer(peer_list::hash_key const& k, torrent_peer const& p)
+	{
+#if TORRENT_USE_I2P
+		if (p.is_i2p_addr) return hash_i2p_dest(k, p.dest());
+#endif
+		return hash_peer_address(k, p.address());
+	}
+
+	bool is_ip_peer(torrent_peer const& p)
+	{
+#if TORRENT_USE_I2P
+		return !p.is_i2p_addr;
+#else
+		TORRENT_UNUSED(p);
+		return true;
+#endif
+	}
+
+	// puts position ``pos`` in the first free slot of ``index``, starting at
+	// ``hash``
+	void index_put(aux::vector<std::uint32_t>& index, std::uint32_t const hash
+		, int const pos)
+	{
+		int const mask = int(index.size()) - 1;
+		int slot = int(hash) & mask;
+		while (index[slot] != 0) slot = (slot + 1) & mask;
+		index[slot] = std::uint32_t(pos) + 1;
+	}
+
 	// this returns true if lhs is a better erase candidate than rhs
 	bool compare_peer_erase(torrent_peer const& lhs, torrent_peer const& rhs)
 	{
@@ -154,13 +254,16 @@ namespace libtorrent {
 		, m_finished(0)
 	{
 		thread_started();
+		aux::random_bytes({reinterpret_cast<char*>(m_hash_key.data())
+			, std::ptrdiff_t(sizeof(m_hash_key))});
 	}
 
 	void peer_list::clear()
 	{
-		for (auto const p : m_peers)
-			m_peer_allocator.free_peer_entry(p);
+		for (auto const h : m_peers)
+			m_peer_allocator.free_peer_entry(h);
 		m_peers.clear();
+		m_index.clear();
 		m_candidate_cache.clear();
 		m_num_connect_candidates = 0;
 		m_num_seeds = 0;
@@ -168,8 +271,8 @@ namespace libtorrent {
 
 	peer_list::~peer_list()
 	{
-		for (auto const p : m_peers)
-			m_peer_allocator.free_peer_entry(p);
+		for (auto const h : m_peers)
+			m_peer_allocator.free_peer_entry(h);
 	}
 
 	void peer_list::set_max_failcount(torrent_state* state)
@@ -190,55 +293,46 @@ namespace libtorrent {
 		TORRENT_ASSERT(is_single_thread());
 		INVARIANT_CHECK;
 
-		for (auto i = m_peers.begin(); i != m_peers.end();)
+		for (int current = 0; current < int(m_peers.size());)
 		{
-			if ((filter.access((*i)->address()) & ip_filter::blocked) == 0)
+			torrent_peer* const i = peer_at(current);
+			if ((filter.access(i->address()) & ip_filter::blocked) == 0)
 			{
-				++i;
+				++current;
 				continue;
 			}
-			if (*i == m_locked_peer)
+			if (i == m_locked_peer)
 			{
-				++i;
+				++current;
 				continue;
 			}
 
-			int const current = int(i - m_peers.begin());
-			TORRENT_ASSERT(current >= 0);
-			TORRENT_ASSERT(m_peers.size() > 0);
-			TORRENT_ASSERT(i != m_peers.end());
-
-			if ((*i)->connection)
+			if (i->connection)
 			{
 				// disconnecting the peer here may also delete the
 				// peer_info_struct. If that is the case, just continue
 				size_t count = m_peers.size();
-				peer_connection_interface* p = (*i)->connection;
+				peer_connection_interface* p = i->connection;
 
 				banned.push_back(p->remote().address());
 
 				p->disconnect(errors::banned_by_ip_filter
 					, operation_t::bittorrent);
 
-				// what *i refers to has changed, i.e. cur was deleted
-				if (m_peers.size() < count)
-				{
-					i = m_peers.begin() + current;
-					continue;
-				}
-				TORRENT_ASSERT((*i)->connection == nullptr
-					|| (*i)->connection->peer_info_struct() == nullptr);
+				// what current refers to has changed, i.e. i was deleted
+				if (m_peers.size() < count) continue;
+				TORRENT_ASSERT(i->connection == nullptr
+					|| i->connection->peer_info_struct() == nullptr);
 			}
 
-			erase_peer(i, state);
-			i = m_peers.begin() + current;
+			erase_peer_at(current, state);
 		}
 	}
 
 	void peer_list::clear_peer_prio()
 	{
 		INVARIANT_CHECK;
-		for (auto& p : m_peers)
+		for (auto const p : *this)
 			p->peer_rank = 0;
 	}
 
@@ -252,46 +346,37 @@ namespace libtorrent {
 		TORRENT_ASSERT(is_single_thread());
 		INVARIANT_CHECK;
 
-		for (auto i = m_peers.begin(); i != m_peers.end();)
+		for (int current = 0; current < int(m_peers.size());)
 		{
-			if ((filter.access((*i)->port) & port_filter::blocked) == 0)
+			torrent_peer* const i = peer_at(current);
+			if ((filter.access(i->port) & port_filter::blocked) == 0)
 			{
-				++i;
+				++current;
 				continue;
 			}
-			if (*i == m_locked_peer)
+			if (i == m_locked_peer)
 			{
-				++i;
+				++current;
 				continue;
 			}
 
-			int const current = int(i - m_peers.begin());
-			TORRENT_ASSERT(current >= 0);
-			TORRENT_ASSERT(m_peers.size() > 0);
-			TORRENT_ASSERT(i != m_peers.end());
-
-			if ((*i)->connection)
+			if (i->connection)
 			{
 				// disconnecting the peer here may also delete the
 				// peer_info_struct. If that is the case, just continue
 				int count = int(m_peers.size());
-				peer_connection_interface* p = (*i)->connection;
+				peer_connection_interface* p = i->connection;
 
 				banned.push_back(p->remote());
 
 				p->disconnect(errors::banned_by_port_filter, operation_t::bittorrent);
-				// what *i refers to has changed, i.e. cur was deleted
-				if (int(m_peers.size()) < count)
-				{
-					i = m_peers.begin() + current;
-					continue;
-				}
-				TORRENT_ASSERT((*i)->connection == nullptr
-					|| (*i)->connection->peer_info_struct() == nullptr);
+				// what current refers to has changed, i.e. i was deleted
+				if (int(m_peers.size()) < count) continue;
+				TORRENT_ASSERT(i->connection == nullptr
+					|| i->connection->peer_info_struct() == nullptr);
 			}
 
-			erase_peer(i, state);
-			i = m_peers.begin() + current;
+			erase_peer_at(current, state);
 		}
 	}
 
@@ -303,44 +388,68 @@ namespace libtorrent {
 		TORRENT_ASSERT(p->in_use);
 		TORRENT_ASSERT(m_locked_peer != p);
 
-		auto const range = std::equal_range(m_peers.begin(), m_peers.end(), p, peer_address_compare{});
-		auto const iter = std::find_if(range.first, range.second, [&](torrent_peer const* needle) {
-			return torrent_peer_equal(needle, p);
-		});
-		if (iter == range.second) return;
-		erase_peer(iter, state);
+		int const pos = position_of(p);
+		if (pos < 0) return;
+		erase_peer_at(pos, state);
 	}
 
 	// any peer that is erased from m_peers will be
 	// erased through this function. This way we can make
 	// sure that any references to the peer are removed
 	// as well, such as in the piece picker.
-	void peer_list::erase_peer(iterator i, torrent_state* state)
+	// The last peer in m_peers is moved into the slot of the erased one. If
+	// that slot is behind the round-robin cursor, it's swapped with the peer
+	// right behind the cursor, and the cursor is moved back onto it. This
+	// keeps the peers that have not been visited yet in this round ahead of
+	// the cursor. Any other peers keep their position.
+	void peer_list::erase_peer_at(int const pos, torrent_state* state)
 	{
 		TORRENT_ASSERT(is_single_thread());
 		INVARIANT_CHECK;
-		TORRENT_ASSERT(i != m_peers.end());
-		TORRENT_ASSERT(m_locked_peer != *i);
+		TORRENT_ASSERT(pos >= 0 && pos < int(m_peers.size()));
+		peer_handle const h = m_peers[pos];
+		torrent_peer* const p = m_peer_allocator.peer_at(h);
+		TORRENT_ASSERT(m_locked_peer != p);
 
-		state->erased.push_back(*i);
-		if ((*i)->seed)
+		state->erased.push_back(p);
+		if (p->seed)
 		{
 			TORRENT_ASSERT(m_num_seeds > 0);
 			--m_num_seeds;
 		}
-		if (is_connect_candidate(**i))
+		if (is_connect_candidate(*p))
 			update_connect_candidates(-1);
 		TORRENT_ASSERT(m_num_connect_candidates < int(m_peers.size()));
-		if (m_round_robin > i - m_peers.begin()) --m_round_robin;
-		if (m_round_robin >= int(m_peers.size())) m_round_robin = 0;
 
 		// if this peer is in the connect candidate
 		// cache, erase it from there as well
-		auto const ci = std::find(m_candidate_cache.begin(), m_candidate_cache.end(), *i);
+		auto const ci = std::find(m_candidate_cache.begin(), m_candidate_cache.end(), p);
 		if (ci != m_candidate_cache.end()) m_candidate_cache.erase(ci);
 
-		m_peer_allocator.free_peer_entry(*i);
-		m_peers.erase(i);
+		int const last = int(m_peers.size()) - 1;
+		index_erase(pos);
+		if (pos != last)
+		{
+			index_move(last, pos);
+			m_peers[pos] = m_peers[last];
+		}
+		m_peers.pop_back();
+		if (pos < m_round_robin)
+		{
+			int const prev = m_round_robin - 1;
+			if (pos != prev && pos < int(m_peers.size()))
+			{
+				int const pos_slot = index_slot(pos);
+				int const prev_slot = index_slot(prev);
+				m_index[pos_slot] = std::uint32_t(prev) + 1;
+				m_index[prev_slot] = std::uint32_t(pos) + 1;
+				std::swap(m_peers[pos], m_peers[prev]);
+			}
+			m_round_robin = prev;
+		}
+		if (m_round_robin >= int(m_peers.size())) m_round_robin = 0;
+
+		m_peer_allocator.free_peer_entry(h);
 	}
 
 	bool peer_list::should_erase_immediately(torrent_peer const& p) const
@@ -380,8 +489,10 @@ namespace libtorrent {
 
 		if (max_peerlist_size == 0 || m_peers.empty()) return;
 
-		int erase_candidate = -1;
-		int force_erase_candidate = -1;
+		// erasing a peer may move other peers around in m_peers, so the
+		// candidates are tracked by pointer
+		torrent_peer* erase_candidate = nullptr;
+		torrent_peer* force_erase_candidate = nullptr;
 
 		if (bool(m_finished) != state->is_finished)
 			recalculate_connect_candidates(state);
@@ -399,46 +510,44 @@ namespace libtorrent {
 
 			if (round_robin == int(m_peers.size())) round_robin = 0;
 
-			torrent_peer& pe = *m_peers[round_robin];
+			torrent_peer& pe = *peer_at(round_robin);
 			TORRENT_ASSERT(pe.in_use);
 			int const current = round_robin;
 
 			if (is_erase_candidate(pe)
-				&& (erase_candidate == -1
-					|| !compare_peer_erase(*m_peers[erase_candidate], pe)))
+				&& (erase_candidate == nullptr
+					|| !compare_peer_erase(*erase_candidate, pe)))
 			{
 				if (should_erase_immediately(pe))
 				{
-					if (erase_candidate > current) --erase_candidate;
-					if (force_erase_candidate > current) --force_erase_candidate;
+					if (erase_candidate == &pe) erase_candidate = nullptr;
+					if (force_erase_candidate == &pe) force_erase_candidate = nullptr;
 					TORRENT_ASSERT(current >= 0 && current < int(m_peers.size()));
-					erase_peer(m_peers.begin() + current, state);
+					erase_peer_at(current, state);
 					continue;
 				}
 				else
 				{
-					erase_candidate = current;
+					erase_candidate = &pe;
 				}
 			}
 			if (is_force_erase_candidate(pe)
-				&& (force_erase_candidate == -1
-					|| !compare_peer_erase(*m_peers[force_erase_candidate], pe)))
+				&& (force_erase_candidate == nullptr
+					|| !compare_peer_erase(*force_erase_candidate, pe)))
 			{
-				force_erase_candidate = current;
+				force_erase_candidate = &pe;
 			}
 
 			++round_robin;
 		}
 
-		if (erase_candidate > -1)
+		if (erase_candidate != nullptr)
 		{
-			TORRENT_ASSERT(erase_candidate >= 0 && erase_candidate < int(m_peers.size()));
-			erase_peer(m_peers.begin() + erase_candidate, state);
+			erase_peer(erase_candidate, state);
 		}
-		else if ((flags & force_erase) && force_erase_candidate > -1)
+		else if ((flags & force_erase) && force_erase_candidate != nullptr)
 		{
-			TORRENT_ASSERT(force_erase_candidate >= 0 && force_erase_candidate < int(m_peers.size()));
-			erase_peer(m_peers.begin() + force_erase_candidate, state);
+			erase_peer(force_erase_candidate, state);
 		}
 	}
 
@@ -536,9 +645,14 @@ namespace libtorrent {
 
 		int max_peerlist_size = state->max_peerlist_size;
 
-		// TODO: 2 it would be nice if there was a way to iterate over these
-		// torrent_peer objects in the order they are allocated in the pool
-		// instead. It would probably be more efficient
+		// if we visit every peer, we know exactly when the earliest one that's
+		// waiting for its reconnect timeout may be tried again
+		bool const full_scan = int(m_peers.size()) <= 300;
+		int next_connect = std::numeric_limits<int>::max();
+
+		// since m_peers is in insertion order, which roughly is the order
+		// the torrent_peer objects were allocated from the pool, this scan
+		// mostly touches memory sequentially
 		for (int iterations = std::min(int(m_peers.size()), 300);
 			iterations > 0; --iterations)
 		{
@@ -546,7 +660,7 @@ namespace libtorrent {
 
 			if (m_round_robin >= int(m_peers.size())) m_round_robin = 0;
 
-			torrent_peer& pe = *m_peers[m_round_robin];
+			torrent_peer& pe = *peer_at(m_round_robin);
 			TORRENT_ASSERT(pe.in_use);
 			int current = m_round_robin;
 
@@ -558,12 +672,13 @@ namespace libtorrent {
 			{
 				if (is_erase_candidate(pe)
 					&& (erase_candidate == -1
-						|| !compare_peer_erase(*m_peers[erase_candidate], pe)))
+						|| !compare_peer_erase(*peer_at(erase_candidate), pe)))
 				{
 					if (should_erase_immediately(pe))
 					{
-						if (erase_candidate > current) --erase_candidate;
-						erase_peer(m_peers.begin() + current, state);
+						if (erase_candidate == int(m_peers.size()) - 1)
+							erase_candidate = current;
+						erase_peer_at(current, state);
 						continue;
 					}
 					else
@@ -577,10 +692,13 @@ namespace libtorrent {
 
 			if (!is_connect_candidate(pe)) continue;
 
+			int const reconnect_time = (int(pe.failcount) + 1) * state->min_reconnect_time;
 			if (pe.last_connected
-				&& session_time - pe.last_connected <
-				(int(pe.failcount) + 1) * state->min_reconnect_time)
+				&& session_time - pe.last_connected < reconnect_time)
+			{
+				next_connect = std::min(next_connect, pe.last_connected + reconnect_time);
 				continue;
+			}
 
 			// compare peer returns true if lhs is better than rhs. In this
 			// case, it returns true if the current candidate is better than
@@ -601,8 +719,11 @@ namespace libtorrent {
 
 		if (erase_candidate > -1)
 		{
-			erase_peer(m_peers.begin() + erase_candidate, state);
+			erase_peer_at(erase_candidate, state);
 		}
+
+		if (peers.empty() && full_scan && next_connect != std::numeric_limits<int>::max())
+			state->next_connect_time = next_connect;
 	}
 
 	bool peer_list::new_connection(peer_connection_interface& c, int session_time
@@ -613,7 +734,6 @@ namespace libtorrent {
 
 		INVARIANT_CHECK;
 
-		iterator iter;
 		torrent_peer* i = nullptr;
 
 #if TORRENT_USE_I2P
@@ -622,63 +742,26 @@ namespace libtorrent {
 		std::string const i2p_dest;
 #endif
 
-		bool found = false;
+		int pos = -1;
 		// this check doesn't support i2p peers
 		if (state->allow_multiple_connections_per_ip && i2p_dest.empty())
 		{
 			auto const& remote = c.remote();
-			auto const addr = remote.address();
-			auto const range = find_peers(addr);
-			iter = std::find_if(range.first, range.second, match_peer_endpoint(addr, remote.port()));
-
-			if (iter != range.second)
-			{
-				TORRENT_ASSERT((*iter)->in_use);
-				found = true;
-			}
+			pos = find_peer(remote.address(), remote.port());
 		}
 		else
 		{
 #if TORRENT_USE_I2P
 			if (!i2p_dest.empty())
-			{
-				iter = std::lower_bound(
-					m_peers.begin(), m_peers.end()
-					, i2p_dest, peer_address_compare()
-					);
-
-				if (iter != m_peers.end() && (*iter)->is_i2p_addr && (*iter)->dest() == i2p_dest)
-				{
-					TORRENT_ASSERT((*iter)->in_use);
-					found = true;
-				}
-			}
+				pos = find_peer(i2p_dest);
 			else
 #endif
-			{
-				iter = std::lower_bound(
-					m_peers.begin(), m_peers.end()
-					, c.remote().address(), peer_address_compare()
-					);
-
-				if (iter != m_peers.end() && (*iter)->address() == c.remote().address())
-				{
-					TORRENT_ASSERT((*iter)->in_use);
-					found = true;
-				}
-			}
+				pos = find_peer(c.remote().address());
 		}
 
-		// make sure the iterator we got is properly sorted relative
-		// to the connection's address
-//		TORRENT_ASSERT(m_peers.empty()
-//			|| (iter == m_peers.end() && (*(iter-1))->address() < c.remote().address())
-//			|| (iter != m_peers.end() && c.remote().address() < (*iter)->address())
-//			|| (iter != m_peers.end() && iter != m_peers.begin() && (*(iter-1))->address() < c.remote().address()));
-
-		if (found)
+		if (pos >= 0)
 		{
-			i = *iter;
+			i = peer_at(pos);
 			TORRENT_ASSERT(i->in_use);
 			TORRENT_ASSERT(i->connection != &c);
 			TORRENT_ASSERT(i->address() == c.remote().address());
@@ -838,18 +921,12 @@ namespace libtorrent {
 			if (state->max_peerlist_size
 				&& int(m_peers.size()) >= state->max_peerlist_size)
 			{
-				// this may invalidate our iterator!
 				erase_peers(state, force_erase);
 				if (int(m_peers.size()) >= state->max_peerlist_size)
 				{
 					c.disconnect(errors::too_many_connections, operation_t::bittorrent);
 					return false;
 				}
-				// restore it
-				iter = std::lower_bound(
-					m_peers.begin(), m_peers.end()
-					, c.remote().address(), peer_address_compare()
-				);
 			}
 
 #if TORRENT_USE_I2P
@@ -864,21 +941,18 @@ namespace libtorrent {
 #endif
 			{
 				bool const is_v6 = lt::aux::is_v6(c.remote());
-				torrent_peer* p = m_peer_allocator.allocate_peer_entry(
+				peer_handle const h = m_peer_allocator.allocate_peer_entry(
 					is_v6 ? torrent_peer_allocator_interface::ipv6_peer_type
 					: torrent_peer_allocator_interface::ipv4_peer_type);
-				if (p == nullptr) return false;
+				if (h == torrent_peer_allocator_interface::invalid_handle) return false;
 
+				void* const mem = m_peer_allocator.peer_at(h);
 				if (is_v6)
-					p = new (p) ipv6_peer(c.remote(), false, {});
+					i = new (mem) ipv6_peer(c.remote(), false, {});
 				else
-					p = new (p) ipv4_peer(c.remote(), false, {});
-
-				iter = m_peers.insert(iter, p);
+					i = new (mem) ipv4_peer(c.remote(), false, {});
 
-				if (m_round_robin >= iter - m_peers.begin()) ++m_round_robin;
-
-				i = *iter;
+				append_peer(h);
 
 				i->source = static_cast<std::uint8_t>(peer_info::incoming);
 			}
@@ -920,13 +994,10 @@ namespace libtorrent {
 
 		if (state->allow_multiple_connections_per_ip)
 		{
-			auto const addr = p->address();
-			auto const range = find_peers(addr);
-			auto const i = std::find_if(range.first, range.second
-				, match_peer_endpoint(addr, std::uint16_t(port)));
-			if (i != range.second)
+			int const pos = find_peer(p->address(), std::uint16_t(port));
+			if (pos >= 0)
 			{
-				torrent_peer& pp = **i;
+				torrent_peer& pp = *peer_at(pos);
 				TORRENT_ASSERT(pp.in_use);
 				if (pp.connection)
 				{
@@ -950,14 +1021,13 @@ namespace libtorrent {
 					erase_peer(p, state);
 					return false;
 				}
-				erase_peer(i, state);
+				erase_peer_at(pos, state);
 			}
 		}
 #if TORRENT_USE_ASSERTS
 		else
 		{
-			std::pair<iterator, iterator> range = find_peers(p->address());
-			TORRENT_ASSERT(std::distance(range.first, range.second) == 1);
+			TORRENT_ASSERT(find_peers(p->address()).size() == 1);
 		}
 #endif
 
@@ -978,7 +1048,126 @@ namespace libtorrent {
 	{
 		TORRENT_ASSERT(is_single_thread());
 		// find p in m_peers
-		return std::find(m_peers.begin(), m_peers.end(), p) != m_peers.end();
+		return std::find(begin(), end(), p) != end();
+	}
+
+	std::vector<torrent_peer*> peer_list::find_peers(address const& a) const
+	{
+		TORRENT_ASSERT(is_single_thread());
+		std::vector<torrent_peer*> ret;
+#if TORRENT_USE_I2P
+		if (a == address()) return ret;
+#endif
+		find_in_index(hash_peer_address(m_hash_key, a), [&](torrent_peer& p)
+		{
+			if (is_ip_peer(p) && p.address() == a) ret.push_back(&p);
+			return false;
+		});
+		return ret;
+	}
+
+	template <typename Pred>
+	int peer_list::find_in_index(std::uint32_t const hash, Pred pred) const
+	{
+		if (m_index.empty()) return -1;
+		int const mask = int(m_index.size()) - 1;
+		// the table is never full, so we're guaranteed to hit an empty slot
+		for (int slot = int(hash) & mask;; slot = (slot + 1) & mask)
+		{
+			std::uint32_t const e = m_index[slot];
+			if (e == 0) return -1;
+			int const pos = int(e - 1);
+			TORRENT_ASSERT(pos < int(m_peers.size()));
+			if (pred(*peer_at(pos))) return pos;
+		}
+	}
+
+	int peer_list::find_peer(address const& a) const
+	{
+		return find_in_index(hash_peer_address(m_hash_key, a), [&](torrent_peer const& p)
+			{ return is_ip_peer(p) && p.address() == a; });
+	}
+
+	int peer_list::find_peer(address const& a, std::uint16_t const port) const
+	{
+		match_peer_endpoint const match(a, port);
+		return find_in_index(hash_peer_address(m_hash_key, a), [&](torrent_peer const& p)
+			{ return is_ip_peer(p) && match(&p); });
+	}
+
+#if TORRENT_USE_I2P
+	int peer_list::find_peer(string_view const dest) const
+	{
+		return find_in_index(hash_i2p_dest(m_hash_key, dest), [&](torrent_peer const& p)
+			{ return p.is_i2p_addr && p.dest() == dest; });
+	}
+#endif
+
+	int peer_list::position_of(torrent_peer const* p) const
+	{
+		return find_in_index(hash_peer(m_hash_key, *p), [&](torrent_peer const& e)
+			{ return &e == p; });
+	}
+
+	void peer_list::append_peer(peer_handle const h)
+	{
+		m_peers.push_back(h);
+		index_insert(int(m_peers.size()) - 1);
+	}
+
+	void peer_list::index_insert(int const pos)
+	{
+		// keep the load factor at or below 3/4, to keep probe sequences short
+		if (int(m_peers.size()) * 4 > int(m_index.size()) * 3)
+		{
+			// this re-inserts every peer, including the one at pos
+			rehash(std::max(16, int(m_index.size()) * 2));
+			return;
+		}
+		index_put(m_index, hash_peer(m_hash_key, *peer_at(pos)), pos);
+	}
+
+	int peer_list::index_slot(int const pos) const
+	{
+		int const mask = int(m_index.size()) - 1;
+		int slot = int(hash_peer(m_hash_key, *peer_at(pos))) & mask;
+		while (m_index[slot] != std::uint32_t(pos) + 1) slot = (slot + 1) & mask;
+		return slot;
+	}
+
+	void peer_list::index_erase(int const pos)
+	{
+		int const mask = int(m_index.size()) - 1;
+		int hole = index_slot(pos);
+
+		// shift subsequent entries of the probe sequence back, into the hole,
+		// unless that would put them before their home slot. This avoids
+		// the need for tombstones
+		for (int next = (hole + 1) & mask;; next = (next + 1) & mask)
+		{
+			std::uint32_t const e = m_index[next];
+			if (e == 0) break;
+			int const home = int(hash_peer(m_hash_key, *peer_at(int(e - 1)))) & mask;
+			if (((next - home) & mask) < ((next - hole) & mask)) continue;
+			m_index[hole] = e;
+			hole = next;
+		}
+		m_index[hole] = 0;
+	}
+
+	void peer_list::index_move(int const from, int const to)
+	{
+		m_index[index_slot(from)] = std::uint32_t(to) + 1;
+	}
+
+	void peer_list::rehash(int const capacity)
+	{
+		TORRENT_ASSERT((capacity & (capacity - 1)) == 0);
+		TORRENT_ASSERT(int(m_peers.size()) < capacity);
+		m_index.clear();
+		m_index.resize(capacity, 0);
+		for (int i = 0; i < int(m_peers.size()); ++i)
+			index_put(m_index, hash_peer(m_hash_key, *peer_at(i)), i);
 	}
 
 	void peer_list::set_seed(torrent_peer* p, bool s)
@@ -1006,12 +1195,11 @@ namespace libtorrent {
 	}
 
 	// this is an internal function
-	bool peer_list::insert_peer(torrent_peer* p, iterator iter
-		, pex_flags_t const flags
+	bool peer_list::insert_peer(peer_handle const h, pex_flags_t const flags
 		, torrent_state* state)
 	{
 		TORRENT_ASSERT(is_single_thread());
-		TORRENT_ASSERT(p);
+		torrent_peer* const p = m_peer_allocator.peer_at(h);
 		TORRENT_ASSERT(p->in_use);
 
 		int const max_peerlist_size = state->max_peerlist_size;
@@ -1024,26 +1212,9 @@ namespace libtorrent {
 			erase_peers(state);
 			if (int(m_peers.size()) >= max_peerlist_size)
 				return false;
-
-			// since some peers were removed, we need to
-			// update the iterator to make it valid again
-#if TORRENT_USE_I2P
-			if (p->is_i2p_addr)
-			{
-				iter = std::lower_bound(
-					m_peers.begin(), m_peers.end()
-					, p->dest(), peer_address_compare());
-			}
-			else
-#endif
-			iter = std::lower_bound(
-				m_peers.begin(), m_peers.end()
-				, p->address(), peer_address_compare());
 		}
 
-		iter = m_peers.insert(iter, p);
-
-		if (m_round_robin >= iter - m_peers.begin()) ++m_round_robin;
+		append_peer(h);
 
 #if !defined TORRENT_DISABLE_ENCRYPTION
 		if (flags & pex_encryption) p->pe_support = true;
@@ -1120,25 +1291,24 @@ namespace libtorrent {
 		TORRENT_ASSERT(is_single_thread());
 		INVARIANT_CHECK;
 
-		auto iter = std::lower_bound(m_peers.begin(), m_peers.end()
-			, destination, peer_address_compare());
-
-		if (iter != m_peers.end() && (*iter)->dest() == destination)
+		int const pos = find_peer(destination);
+		if (pos >= 0)
 		{
-			update_peer(*iter, src, flags, tcp::endpoint());
-			return *iter;
+			torrent_peer* p = peer_at(pos);
+			update_peer(p, src, flags, tcp::endpoint());
+			return p;
 		}
 
 		// we don't have any info about this peer.
 		// add a new entry
-		torrent_peer* p = m_peer_allocator.allocate_peer_entry(
+		peer_handle const h = m_peer_allocator.allocate_peer_entry(
 			torrent_peer_allocator_interface::i2p_peer_type);
-		if (p == nullptr) return nullptr;
-		p = new (p) i2p_peer(destination, true, src);
+		if (h == torrent_peer_allocator_interface::invalid_handle) return nullptr;
+		torrent_peer* p = new (m_peer_allocator.peer_at(h)) i2p_peer(destination, true, src);
 
-		if (!insert_peer(p, iter, flags, state))
+		if (!insert_peer(h, flags, state))
 		{
-			m_peer_allocator.free_peer_entry(p);
+			m_peer_allocator.free_peer_entry(h);
 			return nullptr;
 		}
 		return p;
@@ -1165,59 +1335,47 @@ namespace libtorrent {
 		if (remote_address.is_v6() && remote_address.to_v6().is_link_local())
 			return nullptr;
 
-		iterator iter;
 		torrent_peer* p = nullptr;
 
-		bool found = false;
-		if (state->allow_multiple_connections_per_ip)
-		{
-			auto const range = find_peers(remote_address);
-			iter = std::find_if(range.first, range.second
-				, match_peer_endpoint(remote_address, remote.port()));
-			if (iter != range.second) found = true;
-		}
-		else
-		{
-			iter = std::lower_bound(m_peers.begin(), m_peers.end()
-				, remote_address, peer_address_compare());
-
-			if (iter != m_peers.end() && (*iter)->address() == remote_address) found = true;
-		}
+		int const pos = state->allow_multiple_connections_per_ip
+			? find_peer(remote_address, remote.port())
+			: find_peer(remote_address);
 
-		if (!found)
+		if (pos < 0)
 		{
 			// we don't have any info about this peer.
 			// add a new entry
 
 			bool const is_v6 = remote_address.is_v6();
-			p = m_peer_allocator.allocate_peer_entry(
+			peer_handle const h = m_peer_allocator.allocate_peer_entry(
 				is_v6 ? torrent_peer_allocator_interface::ipv6_peer_type
 				: torrent_peer_allocator_interface::ipv4_peer_type);
-			if (p == nullptr) return nullptr;
+			if (h == torrent_peer_allocator_interface::invalid_handle) return nullptr;
 
+			void* const mem = m_peer_allocator.peer_at(h);
 			if (is_v6)
-				p = new (p) ipv6_peer(remote, true, src);
+				p = new (mem) ipv6_peer(remote, true, src);
 			else
-				p = new (p) ipv4_peer(remote, true, src);
+				p = new (mem) ipv4_peer(remote, true, src);
 
 			try
 			{
-				if (!insert_peer(p, iter, flags, state))
+				if (!insert_peer(h, flags, state))
 				{
-					m_peer_allocator.free_peer_entry(p);
+					m_peer_allocator.free_peer_entry(h);
 					return nullptr;
 				}
 			}
 			catch (std::exception const&)
 			{
-				m_peer_allocator.free_peer_entry(p);
+				m_peer_allocator.free_peer_entry(h);
 				return nullptr;
 			}
 			state->first_time_seen = true;
 		}
 		else
 		{
-			p = *iter;
+			p = peer_at(pos);
 			TORRENT_ASSERT(p->in_use);
 			update_peer(p, src, flags, remote);
 			state->first_time_seen = false;
@@ -1288,7 +1446,7 @@ namespace libtorrent {
 		// web seeds are special, they're not connected via the peer list
 		// so they're not kept in m_peers
 		TORRENT_ASSERT(p->web_seed
-			|| std::any_of(m_peers.begin(), m_peers.end()
+			|| std::any_of(begin(), end()
 				, [&c](torrent_peer const* tp)
 				{
 					TORRENT_ASSERT(tp->in_use);
@@ -1351,7 +1509,7 @@ namespace libtorrent {
 		m_finished = state->is_finished;
 		m_max_failcount = state->max_failcount;
 
-		m_num_connect_candidates += static_cast<int>(std::count_if(m_peers.begin(), m_peers.end()
+		m_num_connect_candidates += static_cast<int>(std::count_if(begin(), end()
 			, [this](torrent_peer const* p) { return this->is_connect_candidate(*p); } ));
 
 #if TORRENT_USE_INVARIANT_CHECKS
@@ -1369,13 +1527,10 @@ namespace libtorrent {
 
 		TORRENT_ASSERT(c);
 
-		auto const iter = std::lower_bound(m_peers.begin(), m_peers.end()
-			, c->remote().address(), peer_address_compare());
-
-		if (iter != m_peers.end() && (*iter)->address() == c->remote().address())
+		if (find_peer(c->remote().address()) >= 0)
 			return true;
 
-		return std::any_of(m_peers.begin(), m_peers.end()
+		return std::any_of(begin(), end()
 			, [c](torrent_peer const* p)
 			{
 				TORRENT_ASSERT(p->in_use);
@@ -1391,20 +1546,18 @@ namespace libtorrent {
 		TORRENT_ASSERT(is_single_thread());
 		TORRENT_ASSERT(m_num_connect_candidates >= 0);
 		TORRENT_ASSERT(m_num_connect_candidates <= int(m_peers.size()));
+		TORRENT_ASSERT(int(m_peers.size()) * 4 <= int(m_index.size()) * 3);
 
 #ifdef TORRENT_EXPENSIVE_INVARIANT_CHECKS
 		int connect_candidates = 0;
 
-		const_iterator prev = m_peers.end();
-		for (const_iterator i = m_peers.begin(); i != m_peers.end(); ++i)
+		TORRENT_ASSERT(int(std::count_if(m_index.begin(), m_index.end()
+			, [](std::uint32_t const e) { return e != 0; })) == int(m_peers.size()));
+
+		for (int i = 0; i < int(m_peers.size()); ++i)
 		{
-			if (prev != m_peers.end()) ++prev;
-			if (i == m_peers.begin() + 1) prev = m_peers.begin();
-			if (prev != m_peers.end())
-			{
-				TORRENT_ASSERT(!((*i)->address() < (*prev)->address()));
-			}
-			torrent_peer const& p = **i;
+			TORRENT_ASSERT(position_of(peer_at(i)) == i);
+			torrent_peer const& p = *peer_at(i);
 			TORRENT_ASSERT(p.in_use);
 			if (is_connect_candidate(p)) ++connect_candidates;
 			if (!p.connection)
@@ -188,6 +188,8 @@ namespace libtorrent {
 		m_cursor = piece_index_t(0);
 
 		for (auto& c : m_downloads) c.clear();
+		m_dl_slot.clear();
+		m_dl_slot.resize(num_pieces, 0);
 		m_block_info.clear();
 		m_free_block_infos.clear();
 
@@ -291,10 +293,8 @@ namespace libtorrent {
 		downloading_piece ret;
 		ret.index = piece;
 		auto const download_state = piece_pos::piece_downloading;
-		auto downloading_iter = std::lower_bound(m_downloads[download_state].begin()
-			, m_downloads[download_state].end(), ret);
-		TORRENT_ASSERT(downloading_iter == m_downloads[download_state].end()
-			|| downloading_iter->index != piece);
+		TORRENT_ASSERT(find_dl_piece(download_state, piece)
+			== m_downloads[download_state].end());
 		TORRENT_ASSERT(block_index >= 0);
 		TORRENT_ASSERT(block_index < std::numeric_limits<std::uint16_t>::max());
 		ret.info_idx = std::uint16_t(block_index);
@@ -327,7 +327,7 @@ namespace libtorrent {
 			info.peers.clear();
 #endif
 		}
-		downloading_iter = m_downloads[download_state].insert(downloading_iter, ret);
+		auto downloading_iter = insert_dl_piece(download_state, ret);
 
 		// in case every block was a pad block, we need to make sure the piece
 		// structure is correctly categorised
@@ -358,7 +358,7 @@ namespace libtorrent {
 
 		TORRENT_ASSERT(find_dl_piece(download_state, i->index) == i);
 		m_piece_map[i->index].state(piece_pos::piece_open);
-		m_downloads[download_state].erase(i);
+		remove_dl_piece(download_state, i);
 
 		TORRENT_ASSERT(prev_size == int(m_downloads[download_state].size()) + 1);
 
@@ -373,9 +373,14 @@ namespace libtorrent {
 		check_piece_state();
 #endif
 
+		// the download queues aren't kept in any particular order. Return each
+		// one sorted by piece index, to present a stable view
 		std::vector<downloading_piece> ret;
 		for (auto const& c : m_downloads)
-			ret.insert(ret.end(), c.begin(), c.end());
+		{
+			auto const first = ret.insert(ret.end(), c.begin(), c.end());
+			std::sort(first, ret.end());
+		}
 		return ret;
 	}
 
@@ -414,12 +419,10 @@ namespace libtorrent {
 	{
 		for (auto const k : categories())
 		{
-			if (m_downloads[k].empty()) continue;
-			for (auto i = m_downloads[k].begin(); i != m_downloads[k].end() - 1; ++i)
+			for (auto i = m_downloads[k].begin(); i != m_downloads[k].end(); ++i)
 			{
 				downloading_piece const& dp = *i;
-				downloading_piece const& next = *(i + 1);
-				TORRENT_ASSERT(dp.index < next.index);
+				TORRENT_ASSERT(int(m_dl_slot[dp.index]) == int(i - m_downloads[k].begin()));
 				TORRENT_ASSERT(int(dp.info_idx) * blocks_per_piece()
 					+ blocks_per_piece() <= int(m_block_info.size()));
 				for (auto const& bl : blocks_for_piece(dp))
@@ -1316,10 +1319,12 @@ namespace libtorrent {
 		std::cerr << "[" << this << "] " << "inc_refcount(bitfield)" << std::endl;
 #endif
 
+		int const num_inc = bitmask.count();
+
 		// nothing set, nothing to do here
-		if (bitmask.none_set()) return;
+		if (num_inc == 0) return;
 
-		if (bitmask.all_set() && bitmask.size() == int(m_piece_map.size()))
+		if (num_inc == int(m_piece_map.size()))
 		{
 			inc_refcount_all(peer);
 			return;
@@ -1330,74 +1335,42 @@ namespace libtorrent {
 		// this is an optimization where if just a few
 		// pieces end up changing, instead of making
 		// the piece list dirty, just update those pieces
-		// instead
-		TORRENT_ALLOCA(incremented, piece_index_t, size);
-
-		if (!m_dirty)
+		// instead. If it's more than that, or if we're already dirty, just
+		// update the counters and mark the picker as dirty, so we'll rebuild
+		// it next time we need it
+		if (!m_dirty && num_inc < size)
 		{
-			// first count how many pieces we're updating. If it's few (less than half)
-			// we'll just update them one at a time. Otherwise we'll just update the counters
-			// and mark the picker as dirty, so we'll rebuild it next time we need it.
-			// this only matters if we're not already dirty, in which case the fasted
-			// thing to do is to just update the counters and be done
-			piece_index_t index = piece_index_t(0);
-			int num_inc = 0;
-			for (auto i = bitmask.begin(), end(bitmask.end()); i != end; ++i, ++index)
-			{
-				if (!*i) continue;
-				if (num_inc < size) incremented[num_inc] = index;
-				++num_inc;
-				if (num_inc >= size) break;
-			}
-
-			if (num_inc < size)
+			bitmask.for_each_set_bit([&](piece_index_t const piece)
 			{
-				// not that many pieces were updated
-				// just update those individually instead of
-				// rebuilding the whole piece list
-				for (int i = 0; i < num_inc; ++i)
-				{
-					piece_index_t const piece = incremented[i];
-					piece_pos& p = m_piece_map[piece];
-					int prev_priority = p.priority(this);
-					++p.peer_count;
+				piece_pos& p = m_piece_map[piece];
+				int const prev_priority = p.priority(this);
+				++p.peer_count;
 #ifdef TORRENT_DEBUG_REFCOUNTS
-					TORRENT_ASSERT(p.have_peers.count(peer) == 0);
-					p.have_peers.insert(peer);
+				TORRENT_ASSERT(p.have_peers.count(peer) == 0);
+				p.have_peers.insert(peer);
 #else
-					TORRENT_UNUSED(peer);
+				TORRENT_UNUSED(peer);
 #endif
-					int new_priority = p.priority(this);
-					if (prev_priority == new_priority) continue;
-					else if (prev_priority >= 0) update(prev_priority, p.index);
-					else add(piece);
-				}
-				return;
-			}
+				int const new_priority = p.priority(this);
+				if (prev_priority == new_priority) return;
+				else if (prev_priority >= 0) update(prev_priority, p.index);
+				else add(piece);
+			});
+			return;
 		}
 
-		piece_index_t index = piece_index_t(0);
-		bool updated = false;
-		for (auto i = bitmask.begin(), end(bitmask.end()); i != end; ++i, ++index)
+		bitmask.for_each_set_bit([&](piece_index_t const index)
 		{
-			if (*i)
-			{
 #ifdef TORRENT_DEBUG_REFCOUNTS
-				TORRENT_ASSERT(m_piece_map[index].have_peers.count(peer) == 0);
-				m_piece_map[index].have_peers.insert(peer);
+			TORRENT_ASSERT(m_piece_map[index].have_peers.count(peer) == 0);
+			m_piece_map[index].have_peers.insert(peer);
 #else
-				TORRENT_UNUSED(peer);
+			TORRENT_UNUSED(peer);
 #endif
+			++m_piece_map[index].peer_count;
+		});
 
-				++m_piece_map[index].peer_count;
-				updated = true;
-			}
-		}
-
-		// if we're already dirty, no point in doing anything more
-		if (m_dirty) return;
-
-		if (updated) m_dirty = true;
+		m_dirty = true;
 	}
 
 	void piece_picker::dec_refcount(typed_bitfield<piece_index_t> const& bitmask
@@ -1412,10 +1385,12 @@ namespace libtorrent {
 		std::cerr << "[" << this << "] " << "dec_refcount(bitfield)" << std::endl;
 #endif
 
+		int const num_dec = bitmask.count();
+
 		// nothing set, nothing to do here
-		if (bitmask.none_set()) return;
+		if (num_dec == 0) return;
 
-		if (bitmask.all_set() && bitmask.size() == int(m_piece_map.size()))
+		if (num_dec == int(m_piece_map.size()))
 		{
 			dec_refcount_all(peer);
 			return;
@@ -1423,98 +1398,38 @@ namespace libtorrent {
 
 		int const size = std::min(50, int(bitmask.size() / 2));
 
-		// this is an optimization where if just a few
-		// pieces end up changing, instead of making
-		// the piece list dirty, just update those pieces
-		// instead
-		TORRENT_ALLOCA(decremented, piece_index_t, size);
+		// just like inc_refcount(), a few pieces are updated individually
+		// rather than rebuilding the whole piece list
+		bool const update_individually = !m_dirty && num_dec < size;
 
-		if (!m_dirty)
+		bitmask.for_each_set_bit([&](piece_index_t const index)
 		{
-			// first count how many pieces we're updating. If it's few (less than half)
-			// we'll just update them one at a time. Otherwise we'll just update the counters
-			// and mark the picker as dirty, so we'll rebuild it next time we need it.
-			// this only matters if we're not already dirty, in which case the fasted
-			// thing to do is to just update the counters and be done
-			piece_index_t index = piece_index_t(0);
-			int num_dec = 0;
-			for (auto i = bitmask.begin(), end(bitmask.end()); i != end; ++i, ++index)
-			{
-				if (!*i) continue;
-				if (num_dec < size) decremented[num_dec] = index;
-				++num_dec;
-				if (num_dec >= size) break;
-			}
+			piece_pos& p = m_piece_map[index];
+			int const prev_priority = update_individually ? p.priority(this) : -1;
 
-			if (num_dec < size)
+			if (p.peer_count == 0)
 			{
-				// not that many pieces were updated
-				// just update those individually instead of
-				// rebuilding the whole piece list
-				for (int i = 0; i < num_dec; ++i)
-				{
-					piece_index_t const piece = decremented[i];
-					piece_pos& p = m_piece_map[piece];
-					int prev_priority = p.priority(this);
-
-					if (p.peer_count == 0)
-					{
-						TORRENT_ASSERT(m_seeds > 0);
-						// this is the case where we have one or more
-						// seeds, and one of them saying: I don't have this
-						// piece anymore. we need to break up one of the seed
-						// counters into actual peer counters on the pieces
-						break_one_seed();
-					}
-
-#ifdef TORRENT_DEBUG_REFCOUNTS
-					TORRENT_ASSERT(p.have_peers.count(peer) == 1);
-					p.have_peers.erase(peer);
-#else
-					TORRENT_UNUSED(peer);
-#endif
-					TORRENT_ASSERT(p.peer_count > 0);
-					--p.peer_count;
-					if (!m_dirty && prev_priority >= 0) update(prev_priority, p.index);
-				}
-				return;
+				TORRENT_ASSERT(m_seeds > 0);
+				// this is the case where we have one or more
+				// seeds, and one of them saying: I don't have this
+				// piece anymore. we need to break up one of the seed
+				// counters into actual peer counters on the pieces
+				break_one_seed();
 			}
-		}
-
-		piece_index_t index = piece_index_t(0);
-		bool updated = false;
-		for (auto i = bitmask.begin(), end(bitmask.end()); i != end; ++i, ++index)
-		{
-			if (*i)
-			{
-				piece_pos& p = m_piece_map[index];
-				if (p.peer_count == 0)
-				{
-					TORRENT_ASSERT(m_seeds > 0);
-					// this is the case where we have one or more
-					// seeds, and one of them saying: I don't have this
-					// piece anymore. we need to break up one of the seed
-					// counters into actual peer counters on the pieces
-					break_one_seed();
-				}
 
 #ifdef TORRENT_DEBUG_REFCOUNTS
-				TORRENT_ASSERT(p.have_peers.count(peer) == 1);
-				p.have_peers.erase(peer);
+			TORRENT_ASSERT(p.have_peers.count(peer) == 1);
+			p.have_peers.erase(peer);
 #else
-				TORRENT_UNUSED(peer);
+			TORRENT_UNUSED(peer);
 #endif
+			TORRENT_ASSERT(p.peer_count > 0);
+			--p.peer_count;
+			if (update_individually && !m_dirty && prev_priority >= 0)
+				update(prev_priority, p.index);
+		});
 
-				TORRENT_ASSERT(p.peer_count > 0);
-				--p.peer_count;
-				updated = true;
-			}
-		}
-
-		// if we're already dirty, no point in doing anything more
-		if (m_dirty) return;
-
-		if (updated) m_dirty = true;
+		if (!update_individually) m_dirty = true;
 	}
 
 	void piece_picker::update_pieces() const
@@ -1950,7 +1865,12 @@ namespace {
 		// being complete.
 		int lhs_blocks = lhs->finished + lhs->writing + lhs->requested;
 		int rhs_blocks = rhs->finished + rhs->writing + rhs->requested;
-		return lhs_blocks > rhs_blocks;
+		if (lhs_blocks != rhs_blocks)
+			return lhs_blocks > rhs_blocks;
+
+		// the download queue isn't ordered, use the piece index as the final
+		// tie breaker to make the order deterministic
+		return lhs->index < rhs->index;
 	}
 
 	// pieces describes which pieces the peer we're requesting from has.
@@ -2042,11 +1962,9 @@ namespace {
 		{
 			// first, allocate a small array on the stack of all the partial
 			// pieces (downloading_piece). We'll then sort this list by
-			// availability or by some other condition. The list of partial pieces
-			// in m_downloads is ordered by piece index, this is to have O(log n)
-			// lookups when finding a downloading_piece for a specific piece index.
-			// this is important and needs to stay sorted that way, that's why
-			// we're copying it here
+			// availability or by piece index. The list of partial pieces in
+			// m_downloads is not ordered (pieces are looked up via m_dl_slot),
+			// and it must not be reordered here, that's why we're copying it
 			TORRENT_ALLOCA(ordered_partials, downloading_piece const*
 				, m_downloads[piece_pos::piece_downloading].size());
 			int num_ordered_partials = 0;
@@ -2080,6 +1998,12 @@ namespace {
 					, std::bind(&piece_picker::partial_compare_rarest_first, this
 						, _1, _2));
 			}
+			else
+			{
+				std::sort(ordered_partials.begin(), ordered_partials.begin() + num_ordered_partials
+					, [](downloading_piece const* lhs, downloading_piece const* rhs)
+					{ return lhs->index < rhs->index; });
+			}
 
 			for (int i = 0; i < num_ordered_partials; ++i)
 			{
@@ -2538,6 +2462,105 @@ get_out:
 		return ret;
 	}
 
+	void piece_picker::pick_pieces_batch(span<batch_pick> const peers
+		, counters& pc) const
+	{
+#ifdef TORRENT_EXPENSIVE_INVARIANT_CHECKS
+		INVARIANT_CHECK;
+#endif
+		if (peers.empty()) return;
+
+		if (m_dirty) update_pieces();
+		TORRENT_ASSERT(!m_dirty);
+
+		// m_pieces holds exactly the pieces that are pickable, i.e. the ones
+		// we don't have, aren't filtered and aren't fully requested
+		typed_bitfield<piece_index_t> want(num_pieces(), false);
+		for (piece_index_t const i : m_pieces) want.set_bit(i);
+
+		// the peers that still want blocks, and have at least one piece we
+		// want. Satisfied peers are swapped out of this list as we go
+		std::vector<int> active;
+		active.reserve(std::size_t(peers.size()));
+		for (int i = 0; i < int(peers.size()); ++i)
+		{
+			batch_pick const& p = peers[i];
+			TORRENT_ASSERT(p.pieces != nullptr);
+			TORRENT_ASSERT(p.pieces->size() == num_pieces());
+			if (p.num_blocks <= 0) continue;
+			if (!p.pieces->intersects(want)) continue;
+			active.push_back(i);
+		}
+
+		for (piece_index_t const piece : m_pieces)
+		{
+			if (active.empty()) break;
+
+			pc.inc_stats_counter(counters::piece_picker_rare_loops);
+
+			auto const state = m_piece_map[piece].download_queue();
+			span<block_info const> binfo;
+			int num_blocks_in_piece;
+			if (state == piece_pos::piece_downloading)
+			{
+				auto const dp = find_dl_piece(state, piece);
+				TORRENT_ASSERT(dp != m_downloads[state].end());
+
+				// this piece failed to write. We're currently restoring
+				// it. It's not OK to send more requests to it right now.
+				if (dp->locked) continue;
+				binfo = blocks_for_piece(*dp);
+				num_blocks_in_piece = int(binfo.size());
+			}
+			else if (state == piece_pos::piece_open)
+			{
+				num_blocks_in_piece = blocks_in_piece(piece)
+					- pad_bytes_in_piece(piece) / block_size();
+			}
+			else
+			{
+				continue;
+			}
+
+			// hand out the free blocks of this piece to the peers that have
+			// it, in order, until we run out of blocks
+			int block = 0;
+			for (std::size_t k = 0; k < active.size();)
+			{
+				batch_pick& p = peers[active[k]];
+				if (!(*p.pieces)[piece])
+				{
+					++k;
+					continue;
+				}
+
+				for (; block < num_blocks_in_piece && p.num_blocks > 0; ++block)
+				{
+					if (!binfo.empty() && binfo[block].state != block_info::state_none)
+						continue;
+					p.picked.emplace_back(piece, block);
+					--p.num_blocks;
+				}
+
+				if (p.num_blocks <= 0)
+				{
+					active[k] = active.back();
+					active.pop_back();
+				}
+				else
+				{
+					++k;
+				}
+				if (block == num_blocks_in_piece) break;
+			}
+		}
+
+#if TORRENT_USE_INVARIANT_CHECKS
+		for (batch_pick const& p : peers)
+			verify_pick(p.picked, *p.pieces);
+#endif
+	}
+
 	// have piece means that the piece passed hash check
 	// AND has been successfully written to disk
 	bool piece_picker::have_piece(piece_index_t const index) const
@@ -2942,13 +2965,13 @@ get_out:
 			|| queue == piece_pos::piece_finished
 			|| queue == piece_pos::piece_zero_prio);
 
-		downloading_piece cmp;
-		cmp.index = index;
-		auto const i = std::lower_bound(
-			m_downloads[queue].begin(), m_downloads[queue].end(), cmp);
-		if (i == m_downloads[queue].end()) return i;
-		if (i->index == index) return i;
-		return m_downloads[queue].end();
+		// m_dl_slot is only valid for the queue the piece is in, and stale for
+		// pieces that aren't downloading. Verify that it refers to this piece
+		auto& q = m_downloads[queue];
+		int const slot = m_dl_slot[index];
+		if (slot < int(q.size()) && q[slot].index == index)
+			return q.begin() + slot;
+		return q.end();
 	}
 
 	std::vector<piece_picker::downloading_piece>::const_iterator piece_picker::find_dl_piece(
@@ -2957,6 +2980,31 @@ get_out:
 		return const_cast<piece_picker*>(this)->find_dl_piece(queue, index);
 	}
 
+	std::vector<piece_picker::downloading_piece>::iterator
+	piece_picker::insert_dl_piece(download_queue_t const queue
+		, downloading_piece const& dp)
+	{
+		auto& q = m_downloads[queue];
+		TORRENT_ASSERT(q.size() < std::numeric_limits<std::uint16_t>::max());
+		m_dl_slot[dp.index] = std::uint16_t(q.size());
+		q.push_back(dp);
+		return q.end() - 1;
+	}
+
+	void piece_picker::remove_dl_piece(download_queue_t const queue
+		, std::vector<downloading_piece>::iterator const i)
+	{
+		auto& q = m_downloads[queue];
+		TORRENT_ASSERT(i != q.end());
+		auto const last = q.end() - 1;
+		if (i != last)
+		{
+			*i = *last;
+			m_dl_slot[i->index] = std::uint16_t(i - q.begin());
+		}
+		q.pop_back();
+	}
+
 	std::vector<piece_picker::downloading_piece>::iterator
 	piece_picker::update_piece_state(
 		std::vector<piece_picker::downloading_piece>::iterator dp)
@@ -3014,7 +3062,7 @@ get_out:
 		// remove the downloading_piece from the list corresponding
 		// to the old state
 		downloading_piece dp_info = *dp;
-		m_downloads[p.download_queue()].erase(dp);
+		remove_dl_piece(p.download_queue(), dp);
 
 		int const prio = p.priority(this);
 		TORRENT_ASSERT(prio < int(m_priority_boundaries.size()) || m_dirty);
@@ -3025,13 +3073,7 @@ get_out:
 
 		// insert the downloading_piece in the list corresponding to
 		// the new state
-		downloading_piece cmp;
-		cmp.index = dp_info.index;
-		auto i = std::lower_bound(m_downloads[p.download_queue()].begin()
-			, m_downloads[p.download_queue()].end(), cmp);
-		TORRENT_ASSERT(i == m_downloads[p.download_queue()].end()
-			|| i->index != dp_info.index);
-		i = m_downloads[p.download_queue()].insert(i, dp_info);
+		auto const i = insert_dl_piece(p.download_queue(), dp_info);
 
 		if (!m_dirty)
 		{
@@ -369,7 +369,10 @@ namespace {
 			post(m_ios, [=, h = std::move(handler)]{ h(index); });
 		}
 
-		void update_stats_counters(counters&) const override {}
+		void update_stats_counters(counters& c) const override
+		{
+			m_buffer_pool.update_stats_counters(c);
+		}
 
 		std::vector<open_file_state> get_status(storage_index_t) const override
 		{ return {}; }
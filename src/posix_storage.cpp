@@ -161,25 +161,59 @@ namespace aux {
 		}
 	}
 
+	int posix_storage::read(settings_interface const& sett
+		, span<char> buffer
+		, piece_index_t const piece, int const offset
+		, storage_error& error)
+	{
+		return read(sett, buffer, piece, offset
+			, [this](file_index_t const file_index
+				, std::int64_t const file_offset
+				, span<char> buf, storage_error& ec)
+		{
+			file_pointer const f = open_file(file_index, open_mode::read_only
+				, file_offset, ec);
+			if (ec.ec) return -1;
+
+			// set this unconditionally in case the upper layer would like to treat
+			// short reads as errors
+			ec.operation = operation_t::file_read;
+
+			int ret = 0;
+			int const r = static_cast<int>(std::fread(buf.data(), 1
+				, static_cast<std::size_t>(buf.size()), f.file()));
+			if (r == 0)
+			{
+				if (std::ferror(f.file())) ec.ec.assign(errno, generic_category());
+				else ec.ec.assign(errors::file_too_short, libtorrent_category());
+			}
+			ret += r;
+
+			// we either get an error or 0 or more bytes read
+			TORRENT_ASSERT(ec.ec || ret > 0);
+			TORRENT_ASSERT(ret <= buf.size());
+			return ret;
+		}, error);
+	}
+
 	int posix_storage::read(settings_interface const&
 		, span<char> buffer
 		, piece_index_t const piece, int const offset
+		, fileop const& op
 		, storage_error& error)
 	{
 #ifdef TORRENT_SIMULATE_SLOW_READ
 		std::this_thread::sleep_for(milliseconds(rand() % 2000));
 #endif
 		return readwrite(files(), buffer, piece, offset, error
-			, [this](file_index_t const file_index
+			, [this, &op](file_index_t const file_index
 				, std::int64_t const file_offset
 				, span<char> buf, storage_error& ec)
 		{
 			// reading from a pad file yields zeroes
 			if (files().pad_file_at(file_index)) return aux::read_zeroes(buf);
 
-			if (file_index < m_file_priority.end_index()
-				&& m_file_priority[file_index] == dont_download
-				&& use_partfile(file_index))
+			if (in_part_file(file_index))
 			{
 				TORRENT_ASSERT(m_part_file);
 
@@ -196,41 +230,52 @@ namespace aux {
 				return ret;
 			}
 
-			file_pointer const f = open_file(file_index, open_mode::read_only
+			return op(file_index, file_offset, buf, ec);
+		});
+	}
+
+	int posix_storage::write(settings_interface const& sett
+		, span<char> buffer
+		, piece_index_t const piece, int const offset
+		, storage_error& error)
+	{
+		return write(sett, buffer, piece, offset
+			, [this](file_index_t const file_index
+				, std::int64_t const file_offset
+				, span<char> buf, storage_error& ec)
+		{
+			file_pointer const f = open_file(file_index, open_mode::write
 				, file_offset, ec);
 			if (ec.ec) return -1;
 
 			// set this unconditionally in case the upper layer would like to treat
 			// short reads as errors
-			ec.operation = operation_t::file_read;
+			ec.operation = operation_t::file_write;
 
 			int ret = 0;
-			int const r = static_cast<int>(std::fread(buf.data(), 1
+			auto const r = static_cast<int>(std::fwrite(buf.data(), 1
 				, static_cast<std::size_t>(buf.size()), f.file()));
-			if (r == 0)
+			if (r != buf.size())
 			{
 				if (std::ferror(f.file())) ec.ec.assign(errno, generic_category());
 				else ec.ec.assign(errors::file_too_short, libtorrent_category());
 			}
 			ret += r;
-
-			// we either get an error or 0 or more bytes read
-			TORRENT_ASSERT(ec.ec || ret > 0);
-			TORRENT_ASSERT(ret <= buf.size());
 			return ret;
-		});
+		}, error);
 	}
 
 	int posix_storage::write(settings_interface const&
 		, span<char> buffer
 		, piece_index_t const piece, int const offset
+		, fileop const& op
 		, storage_error& error)
 	{
 #ifdef TORRENT_SIMULATE_SLOW_WRITE
 		std::this_thread::sleep_for(milliseconds(rand() % 800));
 #endif
 		return readwrite(files(), buffer, piece, offset, error
-			, [this](file_index_t const file_index
+			, [this, &op](file_index_t const file_index
 				, std::int64_t const file_offset
 				, span<char> buf, storage_error& ec)
 		{
@@ -240,9 +285,7 @@ namespace aux {
 				return int(buf.size());
 			}
 
-			if (file_index < m_file_priority.end_index()
-				&& m_file_priority[file_index] == dont_download
-				&& use_partfile(file_index))
+			if (in_part_file(file_index))
 			{
 				TORRENT_ASSERT(m_part_file);
 
@@ -259,23 +302,7 @@ namespace aux {
 				return ret;
 			}
 
-			file_pointer const f = open_file(file_index, open_mode::write
-				, file_offset, ec);
-			if (ec.ec) return -1;
-
-			// set this unconditionally in case the upper layer would like to treat
-			// short reads as errors
-			ec.operation = operation_t::file_write;
-
-			int ret = 0;
-			auto const r = static_cast<int>(std::fwrite(buf.data(), 1
-				, static_cast<std::size_t>(buf.size()), f.file()));
-			if (r != buf.size())
-			{
-				if (std::ferror(f.file())) ec.ec.assign(errno, generic_category());
-				else ec.ec.assign(errors::file_too_short, libtorrent_category());
-			}
-			ret += r;
+			int const ret = op(file_index, file_offset, buf, ec);
 
 			// invalidate our stat cache for this file, since
 			// we're writing to it
@@ -284,6 +311,18 @@ namespace aux {
 		});
 	}
 
+	bool posix_storage::in_part_file(file_index_t const file_index) const
+	{
+		return file_index < m_file_priority.end_index()
+			&& m_file_priority[file_index] == dont_download
+			&& use_partfile(file_index);
+	}
+
+	std::string posix_storage::file_path(file_index_t const file_index) const
+	{
+		return files().file_path(file_index, m_save_path);
+	}
+
 	bool posix_storage::has_any_file(storage_error& error)
 	{
 		m_stat_cache.reserve(files().num_files());
@@ -58,7 +58,7 @@ span<char> receive_buffer::reserve(int const size)
 	if (int(m_recv_buffer.size()) < m_recv_end + size)
 	{
 		int const new_size = std::max(m_recv_end + size, m_packet_size);
-		buffer new_buffer(new_size, {m_recv_buffer.data(), m_recv_end});
+		buffer new_buffer(new_size, {m_recv_buffer.data(), m_recv_end}, m_arena.get());
 		m_recv_buffer = std::move(new_buffer);
 
 		// since we just increased the size of the buffer, reset the watermark to
@@ -80,7 +80,7 @@ void receive_buffer::grow(int const limit)
 		? m_packet_size : std::min(current_size * 3 / 2, limit);
 
 	// re-allocate the buffer and copy over the part of it that's used
-	buffer new_buffer(new_size, {m_recv_buffer.data(), m_recv_end});
+	buffer new_buffer(new_size, {m_recv_buffer.data(), m_recv_end}, m_arena.get());
 	m_recv_buffer = std::move(new_buffer);
 
 	// since we just increased the size of the buffer, reset the watermark to
@@ -167,6 +167,15 @@ span<char> receive_buffer::mutable_buffer(int const bytes)
 	// before we received these bytes was (m_recv_pos - bytes)
 	return span<char>(m_recv_buffer).subspan(m_recv_start + m_recv_pos - bytes, bytes);
 }
+
+span<char> receive_buffer::mutable_buffer_ahead(int const bytes)
+{
+	INVARIANT_CHECK;
+	TORRENT_ASSERT(bytes <= m_recv_pos);
+	TORRENT_ASSERT(m_recv_start + m_recv_pos <= m_recv_end);
+	int const start = m_recv_start + m_recv_pos - bytes;
+	return span<char>(m_recv_buffer).subspan(start, m_recv_end - start);
+}
 #endif
 
 // the purpose of this function is to free up and cut off all messages
@@ -192,12 +201,12 @@ void receive_buffer::normalize(int const force_shrink)
 	{
 		int const target_size = std::max(std::max(force_shrink
 			, int(bytes_to_shift.size())), m_packet_size);
-		buffer new_buffer(target_size, bytes_to_shift);
+		buffer new_buffer(target_size, bytes_to_shift, m_arena.get());
 		m_recv_buffer = std::move(new_buffer);
 	}
 	else if (shrink_buffer)
 	{
-		buffer new_buffer(m_watermark.mean(), bytes_to_shift);
+		buffer new_buffer(m_watermark.mean(), bytes_to_shift, m_arena.get());
 		m_recv_buffer = std::move(new_buffer);
 	}
 	else if (m_recv_end > m_recv_start
@@ -215,6 +224,12 @@ void receive_buffer::normalize(int const force_shrink)
 #endif
 }
 
+void receive_buffer::set_arena(std::shared_ptr<buffer_arena> a)
+{
+	TORRENT_ASSERT(m_recv_buffer.empty());
+	m_arena = std::move(a);
+}
+
 void receive_buffer::reset(int const packet_size)
 {
 	INVARIANT_CHECK;
@@ -335,6 +350,12 @@ span<char> crypto_receive_buffer::mutable_buffer(
 		: bytes;
 	return m_connection_buffer.mutable_buffer(pending_decryption);
 }
+
+span<char> crypto_receive_buffer::mutable_buffer_ahead(int const bytes)
+{
+	TORRENT_ASSERT(m_recv_pos == INT_MAX);
+	return m_connection_buffer.mutable_buffer_ahead(bytes);
+}
 #endif // TORRENT_DISABLE_ENCRYPTION
 
 } // namespace aux
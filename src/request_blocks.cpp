@@ -55,13 +55,10 @@ namespace libtorrent {
 		return ret;
 	}
 
-	// the case where ignore_peer is motivated is if two peers
-	// have only one piece that we don't have, and it's the
-	// same piece for both peers. Then they might get into an
-	// infinite loop, fighting to request the same blocks.
-	// returns false if the function is aborted by an early-exit
-	// condition.
-	bool request_a_block(torrent& t, peer_connection& c)
+namespace {
+
+	// returns false if we should not request any blocks from this peer
+	bool can_request(torrent& t, peer_connection& c)
 	{
 		if (t.is_seed()) return false;
 		if (c.no_download()) return false;
@@ -80,6 +77,63 @@ namespace libtorrent {
 
 		TORRENT_ASSERT(c.peer_info_struct() != nullptr
 			|| c.type() != connection_type::bittorrent);
+		return true;
+	}
+
+	int contiguous_blocks(torrent& t, peer_connection& c
+		, bool const time_critical_mode)
+	{
+		int prefer_contiguous_blocks = c.prefer_contiguous_blocks();
+
+		if (prefer_contiguous_blocks == 0
+			&& !time_critical_mode
+			&& t.settings().get_int(settings_pack::whole_pieces_threshold) > 0)
+		{
+			// if our download rate lets us download a whole piece in
+			// "whole_pieces_threshold" seconds, we prefer to pick an entire piece.
+			// If we can download multiple whole pieces, we prefer to download that
+			// many contiguous pieces.
+
+			// download_rate times the whole piece threshold (seconds) gives the
+			// number of bytes downloaded in one window of that threshold, divided
+			// by the piece size give us the number of (whole) pieces downloaded
+			// in the window.
+			int const contiguous_pieces =
+				std::min(c.statistics().download_payload_rate()
+				* t.settings().get_int(settings_pack::whole_pieces_threshold)
+				, 8 * 1024 * 1024)
+				/ t.torrent_file().piece_length();
+
+			int const blocks_per_piece = t.torrent_file().piece_length() / t.block_size();
+
+			prefer_contiguous_blocks = contiguous_pieces * blocks_per_piece;
+		}
+		return prefer_contiguous_blocks;
+	}
+
+	// don't request blocks we already have in our request queue
+	// This happens when pieces time out or the peer sends us
+	// blocks we didn't request. Those aren't marked in the
+	// piece picker, but we still keep track of them in the
+	// download queue
+	bool in_queue(peer_connection const& c, piece_block const& pb)
+	{
+		std::vector<pending_block> const& dq = c.download_queue();
+		std::vector<pending_block> const& rq = c.request_queue();
+		return std::find_if(dq.begin(), dq.end(), aux::has_block(pb)) != dq.end()
+			|| std::find_if(rq.begin(), rq.end(), aux::has_block(pb)) != rq.end();
+	}
+}
+
+	// the case where ignore_peer is motivated is if two peers
+	// have only one piece that we don't have, and it's the
+	// same piece for both peers. Then they might get into an
+	// infinite loop, fighting to request the same blocks.
+	// returns false if the function is aborted by an early-exit
+	// condition.
+	bool request_a_block(torrent& t, peer_connection& c)
+	{
+		if (!can_request(t, c)) return false;
 
 		bool const time_critical_mode = t.num_time_critical_pieces() > 0;
 
@@ -111,31 +165,8 @@ namespace libtorrent {
 		std::vector<piece_block> interesting_pieces;
 		interesting_pieces.reserve(100);
 
-		int prefer_contiguous_blocks = c.prefer_contiguous_blocks();
-
-		if (prefer_contiguous_blocks == 0
-			&& !time_critical_mode
-			&& t.settings().get_int(settings_pack::whole_pieces_threshold) > 0)
-		{
-			// if our download rate lets us download a whole piece in
-			// "whole_pieces_threshold" seconds, we prefer to pick an entire piece.
-			// If we can download multiple whole pieces, we prefer to download that
-			// many contiguous pieces.
-
-			// download_rate times the whole piece threshold (seconds) gives the
-			// number of bytes downloaded in one window of that threshold, divided
-			// by the piece size give us the number of (whole) pieces downloaded
-			// in the window.
-			int const contiguous_pieces =
-				std::min(c.statistics().download_payload_rate()
-				* t.settings().get_int(settings_pack::whole_pieces_threshold)
-				, 8 * 1024 * 1024)
-				/ t.torrent_file().piece_length();
-
-			int const blocks_per_piece = t.torrent_file().piece_length() / t.block_size();
-
-			prefer_contiguous_blocks = contiguous_pieces * blocks_per_piece;
-		}
+		int const prefer_contiguous_blocks = contiguous_blocks(t, c
+			, time_critical_mode);
 
 		// if we prefer whole pieces, the piece picker will pick at least
 		// the number of blocks we want, but it will try to make the picked
@@ -231,13 +262,7 @@ namespace libtorrent {
 
 			TORRENT_ASSERT(p.num_peers(pb) == 0);
 
-			// don't request pieces we already have in our request queue
-			// This happens when pieces time out or the peer sends us
-			// pieces we didn't request. Those aren't marked in the
-			// piece picker, but we still keep track of them in the
-			// download queue
-			if (std::find_if(dq.begin(), dq.end(), aux::has_block(pb)) != dq.end()
-				|| std::find_if(rq.begin(), rq.end(), aux::has_block(pb)) != rq.end())
+			if (in_queue(c, pb))
 			{
 #if TORRENT_USE_ASSERTS
 				auto const j = std::find_if(dq.begin(), dq.end(), aux::has_block(pb));
@@ -304,4 +329,100 @@ namespace libtorrent {
 		return true;
 	}
 
+	int request_blocks(torrent& t, span<peer_connection* const> peers
+		, std::vector<peer_connection*>* picked_peers)
+	{
+		bool const time_critical_mode = t.num_time_critical_pieces() > 0;
+
+		std::vector<piece_picker::batch_pick> batch;
+		std::vector<peer_connection*> batch_peers;
+
+		// peers that need something other than plain rarest-first picking, or
+		// that could not be satisfied by the batch, are handled one at a time
+		std::vector<peer_connection*> single;
+
+		for (peer_connection* c : peers)
+		{
+			if (!can_request(t, *c)) continue;
+
+			int const num_requests = c->desired_queue_size()
+				- int(c->download_queue().size())
+				- int(c->request_queue().size());
+			if (num_requests <= 0) continue;
+
+			if (time_critical_mode
+				|| c->has_peer_choked()
+				|| !c->suggested_pieces().empty()
+				|| c->picker_options() != piece_picker::rarest_first
+				|| contiguous_blocks(t, *c, time_critical_mode) > 0)
+			{
+				single.push_back(c);
+				continue;
+			}
+
+			batch.push_back({&c->get_bitfield(), c->peer_info_struct()
+				, num_requests, {}});
+			batch_peers.push_back(c);
+		}
+
+		// the batch peers that fall back to request_a_block() have already
+		// had the piece picker invoked for them
+		std::size_t const num_single = single.size();
+
+		int ret = 0;
+		if (!batch.empty())
+		{
+			t.need_picker();
+			piece_picker& p = t.picker();
+			p.pick_pieces_batch(batch, t.session().stats_counters());
+			ret += int(batch_peers.size());
+			if (picked_peers != nullptr)
+				picked_peers->insert(picked_peers->end(), batch_peers.begin(), batch_peers.end());
+
+			for (std::size_t i = 0; i < batch.size(); ++i)
+			{
+				peer_connection& c = *batch_peers[i];
+				std::vector<piece_block> const& picked = batch[i].picked;
+
+#ifndef TORRENT_DISABLE_LOGGING
+				if (t.alerts().should_post<picker_log_alert>() && !picked.empty())
+				{
+					t.alerts().emplace_alert<picker_log_alert>(t.get_handle()
+						, c.remote(), c.pid(), picker_log_alert::rarest_first, picked);
+				}
+				c.peer_log(peer_log_alert::info, "PIECE_PICKER"
+					, "batch picked: %d", int(picked.size()));
+#endif
+
+				for (piece_block const& pb : picked)
+				{
+					TORRENT_ASSERT(p.num_peers(pb) == 0);
+					if (in_queue(c, pb)) continue;
+					c.add_request(pb, {});
+				}
+
+				// if there weren't enough free blocks to fill the request queue,
+				// we may be in end-game mode. Let the regular picker sort that out
+				if (int(c.download_queue().size() + c.request_queue().size())
+					< c.desired_queue_size())
+				{
+					single.push_back(&c);
+				}
+				else
+				{
+					c.set_endgame(false);
+				}
+			}
+		}
+
+		for (std::size_t i = 0; i < single.size(); ++i)
+		{
+			if (!request_a_block(t, *single[i]) || i >= num_single) continue;
+			++ret;
+			if (picked_peers != nullptr) picked_peers->push_back(single[i]);
+		}
+
+		return ret;
+	}
+
 }
@@ -235,6 +235,11 @@ namespace libtorrent {
 		async_call(&session_impl::post_dht_stats);
 	}
 
+	void session_handle::post_disk_latency()
+	{
+		async_call(&session_impl::post_disk_latency);
+	}
+
 	io_context& session_handle::get_context()
 	{
 		std::shared_ptr<session_impl> s = m_impl.lock();
@@ -1182,6 +1187,13 @@ namespace {
 		s->pop_alerts(alerts);
 	}
 
+	void session_handle::pop_alerts(std::function<void(alert*)> const& handler)
+	{
+		std::shared_ptr<session_impl> s = m_impl.lock();
+		if (!s) aux::throw_ex<system_error>(errors::invalid_session_handle);
+		s->pop_alerts(handler);
+	}
+
 	alert* session_handle::wait_for_alert(time_duration max_wait)
 	{
 		std::shared_ptr<session_impl> s = m_impl.lock();
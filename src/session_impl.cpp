@@ -111,6 +111,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/ffs.hpp"
 #include "libtorrent/aux_/array.hpp"
 #include "libtorrent/aux_/set_traffic_class.hpp"
+#include "libtorrent/aux_/stats_export.hpp"
 
 #ifndef TORRENT_DISABLE_LOGGING
 
@@ -545,6 +546,8 @@ bool ssl_server_name_callback(ssl::stream_handle_type stream_handle, std::string
 		, m_created(clock_type::now())
 		, m_last_tick(m_created)
 		, m_last_second_tick(m_created - milliseconds(900))
+		, m_torrent_ticks(milliseconds(100), m_created)
+		, m_handshake_timeouts(milliseconds(100), m_created)
 		, m_last_choke(m_created)
 		, m_last_auto_manage(m_created)
 #ifndef TORRENT_DISABLE_DHT
@@ -552,12 +555,14 @@ bool ssl_server_name_callback(ssl::stream_handle_type stream_handle, std::string
 #endif
 		, m_utp_socket_manager(
 			std::bind(&session_impl::send_udp_packet, this, _1, _2, _3, _4, _5)
+			, std::bind(&session_impl::cork_udp_socket, this, _1, _2)
 			, [this](socket_type s) { this->incoming_connection(std::move(s)); }
 			, m_io_context
 			, m_settings, m_stats_counters, nullptr)
 #ifdef TORRENT_SSL_PEERS
 		, m_ssl_utp_socket_manager(
 			std::bind(&session_impl::send_udp_packet, this, _1, _2, _3, _4, _5)
+			, std::bind(&session_impl::cork_udp_socket, this, _1, _2)
 			, std::bind(&session_impl::on_incoming_utp_ssl, this, _1)
 			, m_io_context
 			, m_settings, m_stats_counters
@@ -566,6 +571,7 @@ bool ssl_server_name_callback(ssl::stream_handle_type stream_handle, std::string
 		, m_timer(m_io_context)
 		, m_lsd_announce_timer(m_io_context)
 		, m_close_file_timer(m_io_context)
+		, m_stats_export_timer(m_io_context)
 		, m_paused(flags & session::paused)
 	{
 #if !defined TORRENT_DISABLE_LOGGING || TORRENT_USE_ASSERTS
@@ -1060,6 +1066,8 @@ bool ssl_server_name_callback(ssl::stream_handle_type stream_handle, std::string
 		m_host_resolver.abort();
 
 		m_close_file_timer.cancel();
+		m_stats_export_timer.cancel();
+		m_stats_export.reset();
 
 		// abort the main thread
 		m_abort = true;
@@ -1166,6 +1174,11 @@ bool ssl_server_name_callback(ssl::stream_handle_type stream_handle, std::string
 		m_download_rate.close();
 		m_upload_rate.close();
 
+#if TORRENT_USE_MSG_ZEROCOPY
+		// the buffers held by the reaper may belong to the disk thread
+		m_zerocopy_reaper.abort();
+#endif
+
 		// it's OK to detach the threads here. The disk_io_thread
 		// has an internal counter and won't release the network
 		// thread until they're all dead (via m_work).
@@ -1944,6 +1957,24 @@ namespace {
 		ret->udp_sock->sock.set_proxy_settings(proxy(), m_alerts, get_resolver()
 			, settings().get_bool(settings_pack::socks5_udp_send_local_ep));
 
+		if (m_settings.get_bool(settings_pack::enable_udp_gro))
+		{
+			ret->udp_sock->sock.set_gro(true, err);
+#ifndef TORRENT_DISABLE_LOGGING
+			if (err && should_log())
+			{
+				session_log("failed to enable UDP GRO [ udp %s ] %s"
+					, print_endpoint(ret->udp_sock->local_endpoint()).c_str()
+					, print_error(err).c_str());
+			}
+#endif
+		}
+
+		ret->udp_sock->sock.set_send_error_handler(
+			[this, ls = std::weak_ptr<listen_socket_t>(ret), ssl = ret->ssl]
+			(udp::endpoint const& ep, int const size, error_code const& e)
+			{ this->on_udp_send_error(ls, ssl, ep, size, e); });
+
 		ADD_OUTSTANDING_ASYNC("session_impl::on_udp_packet");
 		ret->udp_sock->sock.async_read(aux::make_handler([this, ret](error_code const& e)
 			{ this->on_udp_packet(ret->udp_sock, ret, ret->ssl, e); }
@@ -2480,15 +2511,7 @@ namespace {
 		auto s = std::static_pointer_cast<aux::listen_socket_t>(si)->udp_sock;
 
 		s->sock.send_hostname(hostname, port, p, ec, flags);
-
-		if ((ec == error::would_block || ec == error::try_again)
-			&& !s->write_blocked)
-		{
-			s->write_blocked = true;
-			ADD_OUTSTANDING_ASYNC("session_impl::on_udp_writeable");
-			s->sock.async_write(std::bind(&session_impl::on_udp_writeable
-				, this, s, _1));
-		}
+		udp_send_blocked(s, ec);
 	}
 
 	void session_impl::send_udp_packet(std::weak_ptr<utp_socket_interface> sock
@@ -2514,7 +2537,12 @@ namespace {
 			|| s->sock.local_endpoint().protocol() == ep.protocol());
 
 		s->sock.send(ep, p, ec, flags);
+		udp_send_blocked(s, ec);
+	}
 
+	void session_impl::udp_send_blocked(std::shared_ptr<session_udp_socket> const& s
+		, error_code const& ec)
+	{
 		if ((ec == error::would_block || ec == error::try_again) && !s->write_blocked)
 		{
 			s->write_blocked = true;
@@ -2524,6 +2552,43 @@ namespace {
 		}
 	}
 
+	void session_impl::uncork_udp_socket(std::shared_ptr<session_udp_socket> const& s)
+	{
+		error_code ec;
+		s->sock.uncork(ec);
+		udp_send_blocked(s, ec);
+	}
+
+	void session_impl::cork_udp_socket(std::weak_ptr<utp_socket_interface> sock
+		, bool const cork)
+	{
+		auto si = sock.lock();
+		if (!si) return;
+
+		auto s = std::static_pointer_cast<aux::listen_socket_t>(si)->udp_sock;
+		if (cork) s->sock.cork();
+		else uncork_udp_socket(s);
+	}
+
+	void session_impl::on_udp_send_error(std::weak_ptr<listen_socket_t> const& ls
+		, transport const ssl, udp::endpoint const& ep, int const size
+		, error_code const& ec)
+	{
+		// the queue may have been flushed from within a uTP socket's send
+		// loop, since it was full. Don't pull the rug out from under it
+		post(m_io_context, [this, ls, ssl, ep, size, ec]
+		{
+			TORRENT_UNUSED(ssl);
+			struct utp_socket_manager& mgr =
+#ifdef TORRENT_SSL_PEERS
+				ssl == transport::ssl ? m_ssl_utp_socket_manager :
+#endif
+				m_utp_socket_manager;
+
+			mgr.send_failed(ls, ep, size, ec);
+		});
+	}
+
 	void session_impl::on_udp_writeable(std::weak_ptr<session_udp_socket> sock, error_code const& ec)
 	{
 		COMPLETE_ASYNC("session_impl::on_udp_writeable");
@@ -2534,6 +2599,16 @@ namespace {
 
 		s->write_blocked = false;
 
+		// datagrams left over from a batch must go out before the uTP sockets
+		// are allowed to send again
+		error_code err;
+		s->sock.flush(err);
+		if (err)
+		{
+			udp_send_blocked(s, err);
+			if (s->write_blocked) return;
+		}
+
 #ifdef TORRENT_SSL_PEERS
 		auto i = std::find_if(
 			m_listen_sockets.begin(), m_listen_sockets.end()
@@ -2591,6 +2666,10 @@ namespace {
 #endif
 			m_utp_socket_manager;
 
+		// the packets sent in response to the ones we receive are passed on
+		// to the kernel in batches, once the socket is drained
+		s->sock.cork();
+
 		for (;;)
 		{
 			aux::array<udp_socket::packet, 50> p;
@@ -2695,6 +2774,7 @@ namespace {
 				{
 					// fatal errors. Don't try to read from this socket again
 					mgr.socket_drained();
+					uncork_udp_socket(s);
 					return;
 				}
 				// non-fatal UDP errors get here, we should re-issue the read.
@@ -2703,6 +2783,7 @@ namespace {
 		}
 
 		mgr.socket_drained();
+		uncork_udp_socket(s);
 
 		ADD_OUTSTANDING_ASYNC("session_impl::on_udp_packet");
 		s->sock.async_read(make_handler([this, socket, ls, ssl](error_code const& e)
@@ -3199,6 +3280,12 @@ namespace {
 			m_undead_peers.reserve(m_undead_peers.size() + m_connections.size() + 1);
 			m_connections.insert(c);
 			c->start();
+
+			if (!c->is_disconnecting())
+			{
+				m_handshake_timeouts.schedule(c->connected_time()
+					+ handshake_timeout(*c) + milliseconds(1), c);
+			}
 		}
 	}
 
@@ -3462,11 +3549,26 @@ namespace {
 
 		m_last_tick = now;
 
+		// batch up the packets sent by the uTP sockets this tick
+		for (auto const& l : m_listen_sockets)
+			if (l->udp_sock) l->udp_sock->sock.cork();
+
 		m_utp_socket_manager.tick(now);
 #ifdef TORRENT_SSL_PEERS
 		m_ssl_utp_socket_manager.tick(now);
 #endif
 
+		for (auto const& l : m_listen_sockets)
+			if (l->udp_sock) uncork_udp_socket(l->udp_sock);
+
+		// torrents and connections are scheduled individually, only the ones
+		// that are due are visited
+		if (!m_abort)
+		{
+			check_handshake_timeouts(now);
+			tick_torrents(now);
+		}
+
 		// only tick the following once per second
 		if (now - m_last_second_tick < seconds(1)) return;
 
@@ -3482,6 +3584,10 @@ namespace {
 		m_ssl_utp_socket_manager.decay();
 #endif
 
+#if TORRENT_USE_MSG_ZEROCOPY
+		m_zerocopy_reaper.tick(now);
+#endif
+
 		int const tick_interval_ms = aux::numeric_cast<int>(total_milliseconds(now - m_last_second_tick));
 		m_last_second_tick = now;
 
@@ -3573,51 +3679,10 @@ namespace {
 			recalculate_auto_managed_torrents();
 		}
 
-		// --------------------------------------------------------------
-		// check for incoming connections that might have timed out
-		// --------------------------------------------------------------
-
-		for (auto i = m_connections.begin(); i != m_connections.end();)
-		{
-			peer_connection* p = (*i).get();
-			++i;
-			// ignore connections that already have a torrent, since they
-			// are ticked through the torrents' second_tick
-			if (!p->associated_torrent().expired()) continue;
-
-			// TODO: have a separate list for these connections, instead of having to loop through all of them
-			int timeout = m_settings.get_int(settings_pack::handshake_timeout);
-#if TORRENT_USE_I2P
-			timeout *= is_i2p(p->get_socket()) ? 4 : 1;
-#endif
-			if (m_last_tick - p->connected_time () > seconds(timeout))
-				p->disconnect(errors::timed_out, operation_t::bittorrent);
-		}
-
-		// --------------------------------------------------------------
-		// second_tick every torrent (that wants it)
-		// --------------------------------------------------------------
-
 #if TORRENT_DEBUG_STREAMING > 0
 		std::printf("\033[2J\033[0;0H");
 #endif
 
-		aux::vector<torrent*>& want_tick = m_torrent_lists[torrent_want_tick];
-		for (int i = 0; i < int(want_tick.size()); ++i)
-		{
-			torrent& t = *want_tick[i];
-			TORRENT_ASSERT(t.want_tick());
-			TORRENT_ASSERT(!t.is_aborted());
-
-			t.second_tick(tick_interval_ms);
-
-			// if the call to second_tick caused the torrent
-			// to no longer want to be ticked (i.e. it was
-			// removed from the list) we need to back up the counter
-			// to not miss the torrent after it
-			if (!t.want_tick()) --i;
-		}
-
 		// TODO: this should apply to all bandwidth channels
 		if (m_settings.get_bool(settings_pack::rate_limit_ip_overhead))
 		{
@@ -3780,6 +3845,24 @@ namespace {
 		m_prio_torrents.emplace_back(t, 10);
 	}
 
+	namespace {
+		// orders the deferred connects heap by earliest expiry first
+		struct later_deferral
+		{
+			bool operator()(std::pair<time_point, std::weak_ptr<torrent>> const& lhs
+				, std::pair<time_point, std::weak_ptr<torrent>> const& rhs) const
+			{ return lhs.first > rhs.first; }
+		};
+	}
+
+	void session_impl::defer_connect_attempts(std::weak_ptr<torrent> t
+		, seconds32 const delay)
+	{
+		m_deferred_connects.emplace_back(aux::time_now() + delay, std::move(t));
+		std::push_heap(m_deferred_connects.begin(), m_deferred_connects.end()
+			, later_deferral{});
+	}
+
 #ifndef TORRENT_DISABLE_DHT
 
 	void session_impl::add_dht_node(udp::endpoint const& n)
@@ -4277,6 +4360,19 @@ namespace {
 	{
 		if (m_abort) return;
 
+		// let torrents whose reconnect timeouts have passed back into the
+		// want-peers lists
+		time_point const now = aux::time_now();
+		while (!m_deferred_connects.empty()
+			&& m_deferred_connects.front().first <= now)
+		{
+			std::pop_heap(m_deferred_connects.begin(), m_deferred_connects.end()
+				, later_deferral{});
+			std::shared_ptr<torrent> t = m_deferred_connects.back().second.lock();
+			m_deferred_connects.pop_back();
+			if (t) t->resume_connect_attempts();
+		}
+
 		if (num_connections() >= m_settings.get_int(settings_pack::connections_limit))
 			return;
 
@@ -4814,6 +4910,12 @@ namespace {
 			m_posted_stats_header = true;
 			m_alerts.emplace_alert<session_stats_header_alert>();
 		}
+		update_stats_gauges();
+		m_alerts.emplace_alert<session_stats_alert>(m_stats_counters);
+	}
+
+	void session_impl::update_stats_gauges()
+	{
 		m_disk_thread->update_stats_counters(m_stats_counters);
 
 #ifndef TORRENT_DISABLE_DHT
@@ -4831,7 +4933,80 @@ namespace {
 		m_stats_counters.set_value(counters::limiter_down_bytes
 			, m_download_rate.queued_bytes());
 
-		m_alerts.emplace_alert<session_stats_alert>(m_stats_counters);
+		auto const arena = m_receive_arena
+			? m_receive_arena->stats() : aux::slab_allocator::stats_t{};
+		m_stats_counters.set_value(counters::recv_buffer_arena_slabs, arena.slabs);
+		m_stats_counters.set_value(counters::recv_buffer_arena_hugepage_slabs
+			, arena.hugepage_slabs);
+	}
+
+	void session_impl::update_stats_export()
+	{
+#if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
+		std::string const& path = m_settings.get_str(settings_pack::stats_export_path);
+		if (path.empty() || m_abort)
+		{
+			m_stats_export.reset();
+			m_stats_export_timer.cancel();
+			return;
+		}
+
+		if (!m_stats_export || m_stats_export->path() != path)
+		{
+			m_stats_export.reset();
+			error_code ec;
+			try
+			{
+				m_stats_export = std::make_unique<stats_export>(path);
+			}
+			catch (storage_error const& e) { ec = e.ec; }
+			catch (system_error const& e) { ec = e.code(); }
+
+			if (ec)
+			{
+#ifndef TORRENT_DISABLE_LOGGING
+				session_log("failed to open stats export file \"%s\": %s"
+					, path.c_str(), ec.message().c_str());
+#endif
+				if (m_alerts.should_post<session_error_alert>())
+					m_alerts.emplace_alert<session_error_alert>(ec
+						, "failed to open stats export file: " + path);
+				m_stats_export_timer.cancel();
+				return;
+			}
+		}
+
+		// (re-)start the timer, to pick up a new interval
+		m_stats_export_timer.cancel();
+		ADD_OUTSTANDING_ASYNC("session_impl::on_stats_export");
+		m_stats_export_timer.expires_after(milliseconds(
+			std::max(1, m_settings.get_int(settings_pack::stats_export_interval))));
+		m_stats_export_timer.async_wait([this](error_code const& e) {
+			wrap(&session_impl::on_stats_export, e); });
+#endif
+	}
+
+	void session_impl::on_stats_export(error_code const& e)
+	{
+		COMPLETE_ASYNC("session_impl::on_stats_export");
+		TORRENT_ASSERT(is_single_thread());
+		if (e || m_abort || !m_stats_export) return;
+
+#if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
+		update_stats_gauges();
+		m_stats_export->update(m_stats_counters);
+
+		ADD_OUTSTANDING_ASYNC("session_impl::on_stats_export");
+		m_stats_export_timer.expires_after(milliseconds(
+			std::max(1, m_settings.get_int(settings_pack::stats_export_interval))));
+		m_stats_export_timer.async_wait([this](error_code const& err) {
+			wrap(&session_impl::on_stats_export, err); });
+#endif
+	}
+
+	void session_impl::post_disk_latency()
+	{
+		m_alerts.emplace_alert<disk_latency_alert>(m_disk_thread->job_latency());
 	}
 
 	void session_impl::post_dht_stats()
@@ -5413,6 +5588,20 @@ namespace {
 			i->update_max_failcount();
 	}
 
+	void session_impl::update_min_reconnect_time()
+	{
+		// the deferrals were computed with the old reconnect time. Let all
+		// those torrents back in, the ones that still have no candidate to
+		// connect to will be deferred again, based on the new setting
+		std::vector<std::pair<time_point, std::weak_ptr<torrent>>> deferred;
+		deferred.swap(m_deferred_connects);
+		for (auto const& d : deferred)
+		{
+			std::shared_ptr<torrent> t = d.second.lock();
+			if (t) t->resume_connect_attempts();
+		}
+	}
+
 	void session_impl::update_resolver_cache_timeout()
 	{
 		int const timeout = m_settings.get_int(settings_pack::resolver_cache_timeout);
@@ -6516,6 +6705,79 @@ namespace {
 			m_settings.set_int(settings_pack::hashing_threads, 0);
 	}
 
+	void session_impl::update_buffer_arenas()
+	{
+		bool const hugepages = m_settings.get_bool(settings_pack::hugepage_buffers);
+		bool const numa = m_settings.get_bool(settings_pack::numa_local_buffers);
+		if (!hugepages && !numa)
+		{
+			// connections still using the arena keep it alive until they
+			// close
+			m_receive_arena.reset();
+			return;
+		}
+
+		if (!m_receive_arena) m_receive_arena = std::make_shared<aux::buffer_arena>();
+		m_receive_arena->set_hugepages(hugepages);
+		m_receive_arena->set_numa_local(numa);
+	}
+
+	void session_impl::schedule_tick(std::weak_ptr<torrent> t)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		time_point const now = aux::time_now();
+		time_point const due = now + seconds(1);
+		m_torrent_ticks.schedule(due, torrent_tick{std::move(t), now, due});
+	}
+
+	void session_impl::tick_torrents(time_point const now)
+	{
+		m_torrent_ticks.advance(now, [this, now](torrent_tick& e)
+		{
+			std::shared_ptr<torrent> t = e.tor.lock();
+			if (!t) return;
+
+			int const tick_interval_ms = aux::numeric_cast<int>(
+				total_milliseconds(now - e.last));
+			if (!t->tick_timer(tick_interval_ms)) return;
+
+			// stay on the once-a-second cadence, even though the timer fires
+			// up to a tick_interval late
+			time_point due = e.due + seconds(1);
+			if (due <= now) due = now + seconds(1);
+			m_torrent_ticks.schedule(due, torrent_tick{std::move(e.tor), now, due});
+		});
+	}
+
+	time_duration session_impl::handshake_timeout(peer_connection const& p) const
+	{
+		int timeout = m_settings.get_int(settings_pack::handshake_timeout);
+#if TORRENT_USE_I2P
+		timeout *= is_i2p(p.get_socket()) ? 4 : 1;
+#else
+		TORRENT_UNUSED(p);
+#endif
+		return seconds(timeout);
+	}
+
+	void session_impl::check_handshake_timeouts(time_point const now)
+	{
+		m_handshake_timeouts.advance(now, [this, now](std::weak_ptr<peer_connection>& wp)
+		{
+			std::shared_ptr<peer_connection> p = wp.lock();
+			// connections that have been attached to a torrent are ticked
+			// through the torrent's second_tick
+			if (!p || p->is_disconnecting() || !p->associated_torrent().expired())
+				return;
+
+			time_point const expiry = p->connected_time() + handshake_timeout(*p);
+			if (now > expiry)
+				p->disconnect(errors::timed_out, operation_t::bittorrent);
+			else
+				m_handshake_timeouts.schedule(expiry + milliseconds(1), std::move(wp));
+		});
+	}
+
 	void session_impl::update_report_web_seed_downloads()
 	{
 		// if this flag changed, update all web seed connections
@@ -6588,6 +6850,26 @@ namespace {
 		}
 	}
 
+	void session_impl::update_udp_gro()
+	{
+		bool const gro = m_settings.get_bool(settings_pack::enable_udp_gro);
+		for (auto const& l : m_listen_sockets)
+		{
+			if (!l->udp_sock) continue;
+			error_code ec;
+			l->udp_sock->sock.set_gro(gro, ec);
+#ifndef TORRENT_DISABLE_LOGGING
+			if (ec && should_log())
+			{
+				session_log("failed to %s UDP GRO [ udp %s ] %s"
+					, gro ? "enable" : "disable"
+					, print_endpoint(l->udp_sock->local_endpoint()).c_str()
+					, print_error(ec).c_str());
+			}
+#endif
+		}
+	}
+
 	void session_impl::update_dht_announce_interval()
 	{
 #ifndef TORRENT_DISABLE_DHT
@@ -6753,6 +7035,11 @@ namespace {
 		m_alerts.get_all(*alerts);
 	}
 
+	void session_impl::pop_alerts(std::function<void(alert*)> const& handler)
+	{
+		m_alerts.get_all(handler);
+	}
+
 #if TORRENT_ABI_VERSION == 1
 	void session_impl::update_rate_limit_utp()
 	{
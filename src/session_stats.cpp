@@ -201,6 +201,13 @@ namespace {
 		METRIC(net, limiter_up_bytes)
 		METRIC(net, limiter_down_bytes)
 
+		// when peer receive buffers are allocated from an arena (see
+		// settings_pack::hugepage_buffers and numa_local_buffers), the number
+		// of 2 MiB slabs the arena has allocated, and how many of them are
+		// backed by explicit huge pages
+		METRIC(net, recv_buffer_arena_slabs)
+		METRIC(net, recv_buffer_arena_hugepage_slabs)
+
 		// the number of bytes downloaded that had to be discarded because they
 		// failed the hash check
 		METRIC(net, recv_failed_bytes)
@@ -335,6 +342,20 @@ namespace {
 
 		METRIC(disk, disk_blocks_in_use)
 
+		// disk buffers are allocated in 2 MiB slabs. ``disk_buffer_slabs`` is
+		// the number of slabs currently allocated, and
+		// ``disk_buffer_free_blocks`` the number of blocks in them that are
+		// not in use. The latter are held on to by the per-thread caches, or
+		// are stranded in slabs that still have some blocks in use.
+		METRIC(disk, disk_buffer_slabs)
+		METRIC(disk, disk_buffer_free_blocks)
+
+		// the number of disk buffer slabs backed by a single explicit 2 MiB
+		// huge page (see settings_pack::hugepage_buffers). Each of those
+		// takes one TLB entry, where a slab of regular pages takes 512. The
+		// remaining slabs may still be backed by transparent huge pages.
+		METRIC(disk, disk_buffer_hugepage_slabs)
+
 		// ``queued_disk_jobs`` is the number of disk jobs currently queued,
 		// waiting to be executed by a disk thread.
 		METRIC(disk, queued_disk_jobs)
@@ -372,6 +393,17 @@ namespace {
 		// hash a piece (when verifying against the piece hash)
 		METRIC(disk, num_read_back)
 
+		// the number of disk buffer allocations and frees that were served
+		// by the calling thread's cache (hits), and the number that had to
+		// exchange a batch of buffers with the shared pool (misses)
+		METRIC(disk, disk_buffer_magazine_hits)
+		METRIC(disk, disk_buffer_magazine_misses)
+
+		// the number of disk buffer slabs that were meant to be backed by a
+		// huge page, but had to fall back to regular pages, because there
+		// were no free huge pages reserved
+		METRIC(disk, disk_buffer_hugepage_fallbacks)
+
 		// cumulative time spent in various disk jobs, as well
 		// as total for all disk jobs. Measured in microseconds
 		METRIC(disk, disk_read_time)
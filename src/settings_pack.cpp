@@ -149,7 +149,8 @@ constexpr int DISK_WRITE_MODE = settings_pack::enable_os_cache;
 		SET(proxy_password, "", &session_impl::update_proxy),
 		SET(i2p_hostname, "", &session_impl::update_i2p_bridge),
 		SET(peer_fingerprint, "-LT20B0-", nullptr),
-		SET(dht_bootstrap_nodes, "dht.libtorrent.org:25401", &session_impl::update_dht_bootstrap_nodes)
+		SET(dht_bootstrap_nodes, "dht.libtorrent.org:25401", &session_impl::update_dht_bootstrap_nodes),
+		SET(stats_export_path, "", &session_impl::update_stats_export)
 	}});
 
 	CONSTEXPR_SETTINGS
@@ -239,6 +240,14 @@ constexpr int DISK_WRITE_MODE = settings_pack::enable_os_cache;
 		SET(allow_idna, false, nullptr),
 		SET(enable_set_file_valid_data, false, nullptr),
 		SET(socks5_udp_send_local_ep, false, nullptr),
+		SET(enable_udp_gro, false, &session_impl::update_udp_gro),
+		SET(compact_merkle_trees, false, nullptr),
+		SET(zero_copy_send, false, nullptr),
+		SET(msg_zerocopy_send, false, nullptr),
+		SET(bdp_request_queue, false, nullptr),
+		SET(lock_disk_buffers, false, nullptr),
+		SET(hugepage_buffers, false, &session_impl::update_buffer_arenas),
+		SET(numa_local_buffers, false, &session_impl::update_buffer_arenas),
 	}});
 
 	CONSTEXPR_SETTINGS
@@ -260,7 +269,7 @@ constexpr int DISK_WRITE_MODE = settings_pack::enable_os_cache;
 		SET(urlseed_wait_retry, 30, nullptr),
 		SET(file_pool_size, 40, nullptr),
 		SET(max_failcount, 3, &session_impl::update_max_failcount),
-		SET(min_reconnect_time, 60, nullptr),
+		SET(min_reconnect_time, 60, &session_impl::update_min_reconnect_time),
 		SET(peer_connect_timeout, 15, nullptr),
 		SET(connection_speed, 30, &session_impl::update_connection_speed),
 		SET(inactivity_timeout, 600, nullptr),
@@ -401,7 +410,9 @@ constexpr int DISK_WRITE_MODE = settings_pack::enable_os_cache;
 		SET(i2p_inbound_quantity, 3, nullptr),
 		SET(i2p_outbound_quantity, 3, nullptr),
 		SET(i2p_inbound_length, 3, nullptr),
-		SET(i2p_outbound_length, 3, nullptr)
+		SET(i2p_outbound_length, 3, nullptr),
+		SET(stats_export_interval, 100, &session_impl::update_stats_export),
+		SET(write_coalesce_blocks, 64, nullptr)
 	}});
 
 #undef SET
@@ -21,6 +21,9 @@ changelog at the end of the file.
 #include <cstdio>
 #include <cstring>
 
+#include "libtorrent/aux_/cpuid.hpp"
+#include "libtorrent/aux_/hash_many.hpp"
+
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <boost/predef/other/endian.h>
 #include "libtorrent/aux_/disable_warnings_pop.hpp"
@@ -124,6 +127,21 @@ using u8 = std::uint8_t;
 		state[4] += e;
 	}
 
+	// runs ``num`` consecutive blocks through SHA1transform
+	template <class BlkFun>
+	void SHA1transform_n(u32 state[5], u8 const* buffer, size_t num)
+	{
+#if TORRENT_HAS_SIMD_HASH
+		if (aux::sha_ni_support)
+		{
+			aux::sha1_compress_ni(state, buffer, num);
+			return;
+		}
+#endif
+		for (size_t i = 0; i < num; ++i)
+			SHA1transform<BlkFun>(state, buffer + i * 64);
+	}
+
 #ifdef VERBOSE
 	void SHAPrintContext(sha1_ctx *context, char *msg)
 	{
@@ -154,11 +172,10 @@ using u8 = std::uint8_t;
 		if ((j + len) > 63)
 		{
 			memcpy(&context->buffer[j], data, (i = 64-j));
-			SHA1transform<BlkFun>(context->state, context->buffer);
-			for ( ; i + 63 < len; i += 64)
-			{
-				SHA1transform<BlkFun>(context->state, &data[i]);
-			}
+			SHA1transform_n<BlkFun>(context->state, context->buffer, 1);
+			size_t const blocks = (len - i) / 64;
+			SHA1transform_n<BlkFun>(context->state, &data[i], blocks);
+			i += blocks * 64;
 			j = 0;
 		}
 		else
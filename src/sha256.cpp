@@ -9,6 +9,9 @@
 
 #include <cstring>
 
+#include "libtorrent/aux_/cpuid.hpp"
+#include "libtorrent/aux_/hash_many.hpp"
+
 namespace libtorrent { namespace {
 
 	using u32 = std::uint32_t;
@@ -64,6 +67,13 @@ namespace libtorrent { namespace {
 
 	void sha_compress(sha256_ctx& md, const unsigned char* buf)
 	{
+#if TORRENT_HAS_SIMD_HASH
+		if (aux::sha_ni_support)
+		{
+			aux::sha256_compress_ni(md.state, buf, 1);
+			return;
+		}
+#endif
 		u32 S[8], W[64], t0, t1, t;
 
 		// Copy state into S
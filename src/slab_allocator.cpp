@@ -0,0 +1,496 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/aux_/slab_allocator.hpp"
+#include "libtorrent/assert.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+
+#include "libtorrent/aux_/disable_warnings_push.hpp"
+
+#ifdef TORRENT_WINDOWS
+#include "libtorrent/aux_/windows.hpp"
+#else
+#include <sys/mman.h>
+#endif
+
+#ifdef TORRENT_LINUX
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef TORRENT_ADDRESS_SANITIZER
+#include <sanitizer/asan_interface.h>
+#endif
+
+#include "libtorrent/aux_/disable_warnings_pop.hpp"
+
+namespace libtorrent {
+namespace aux {
+
+namespace {
+
+	// the number of full magazines the depot holds on to, per NUMA node.
+	// Beyond this, the blocks are returned to their slabs, to let slabs
+	// become free
+	constexpr int max_depot_magazines = 8;
+
+	// the NUMA node the calling thread is currently running on
+	int current_node()
+	{
+#if defined TORRENT_LINUX && defined SYS_getcpu
+		unsigned cpu = 0;
+		unsigned node = 0;
+		if (::syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) return 0;
+		return int(node);
+#else
+		return 0;
+#endif
+	}
+
+	// make the kernel prefer allocating the physical pages backing this
+	// range from the specified node. This has to happen before the pages
+	// are first touched
+	void bind_to_node(char* const base, std::size_t const size, int const node)
+	{
+#if defined TORRENT_LINUX && defined SYS_mbind
+		unsigned long mask = 0;
+		if (node < 0 || node >= int(sizeof(mask) * 8)) return;
+		mask = 1UL << node;
+		// MPOL_PREFERRED. If the node runs out of memory, pages are allocated
+		// from other nodes rather than failing. Binding may fail on kernels
+		// without NUMA support, in which case it doesn't matter anyway
+		int const mpol_preferred = 1;
+		::syscall(SYS_mbind, base, size, mpol_preferred, &mask
+			, sizeof(mask) * 8 + 1, 0);
+#else
+		TORRENT_UNUSED(base);
+		TORRENT_UNUSED(size);
+		TORRENT_UNUSED(node);
+#endif
+	}
+
+	// maps a slab_size region aligned to slab_size. If ``hugepage`` is set,
+	// an explicit huge page is tried first, and ``got_hugepage`` reports
+	// whether that worked. ``node`` is the NUMA node to bind the memory to,
+	// or -1 to leave it up to the system
+	char* map_slab(bool const hugepage, int const node, bool& got_hugepage)
+	{
+		std::size_t const size = slab_allocator::slab_size;
+		got_hugepage = false;
+#ifdef TORRENT_WINDOWS
+		TORRENT_UNUSED(node);
+		if (hugepage)
+		{
+			// this requires the SeLockMemoryPrivilege
+			std::size_t const large_page = GetLargePageMinimum();
+			if (large_page > 0 && size % large_page == 0)
+			{
+				void* const p = VirtualAlloc(nullptr, size
+					, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+				if (p != nullptr)
+				{
+					got_hugepage = true;
+					return static_cast<char*>(p);
+				}
+			}
+		}
+		return static_cast<char*>(VirtualAlloc(nullptr, size
+			, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+#else
+#ifdef MAP_HUGETLB
+		if (hugepage)
+		{
+			int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+#ifdef MAP_HUGE_SHIFT
+			// ask for 2 MiB pages specifically, in case the default huge page
+			// size is something else
+			flags |= 21 << MAP_HUGE_SHIFT;
+#endif
+			// huge page mappings are always aligned to the huge page size.
+			// This fails if there are no free huge pages reserved
+			void* const p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE
+				, flags, -1, 0);
+			if (p != MAP_FAILED)
+			{
+				bind_to_node(static_cast<char*>(p), size, node);
+				got_hugepage = true;
+				return static_cast<char*>(p);
+			}
+		}
+#else
+		TORRENT_UNUSED(hugepage);
+#endif
+
+		// transparent huge pages can only back ranges aligned to the huge page
+		// size. Map twice the size, to be able to trim it to an aligned slab
+		void* const p = ::mmap(nullptr, size * 2, PROT_READ | PROT_WRITE
+			, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) return nullptr;
+		char* const start = static_cast<char*>(p);
+		char* const base = reinterpret_cast<char*>(
+			(reinterpret_cast<std::uintptr_t>(start) + size - 1) & ~std::uintptr_t(size - 1));
+		if (base != start) ::munmap(start, std::size_t(base - start));
+		::munmap(base + size, std::size_t(start + size * 2 - (base + size)));
+		bind_to_node(base, size, node);
+#ifdef MADV_HUGEPAGE
+		::madvise(base, size, MADV_HUGEPAGE);
+#endif
+		return base;
+#endif
+	}
+
+	void unmap_slab(char* const base)
+	{
+#ifdef TORRENT_WINDOWS
+		VirtualFree(base, 0, MEM_RELEASE);
+#else
+		::munmap(base, slab_allocator::slab_size);
+#endif
+	}
+
+	void lock_slab(char* const base, bool const lock)
+	{
+		std::size_t const size = slab_allocator::slab_size;
+		// failing to lock the memory (typically because of RLIMIT_MEMLOCK) is
+		// not fatal, the slab is just pageable
+#ifdef TORRENT_WINDOWS
+		if (lock) VirtualLock(base, size);
+		else VirtualUnlock(base, size);
+#else
+		if (lock) ::mlock(base, size);
+		else ::munlock(base, size);
+#endif
+	}
+
+	int lowest_bit(std::uint64_t const v)
+	{
+		TORRENT_ASSERT(v != 0);
+#if defined __GNUC__ || defined __clang__
+		return __builtin_ctzll(v);
+#else
+		int ret = 0;
+		while (((v >> ret) & 1) == 0) ++ret;
+		return ret;
+#endif
+	}
+}
+
+	constexpr int slab_allocator::slab_size;
+	constexpr int slab_allocator::min_block_size;
+	constexpr int slab_allocator::max_blocks_per_slab;
+
+	slab_allocator::slab_allocator(int const block_size)
+		: m_block_size(block_size)
+		, m_current_node(&current_node)
+	{
+		TORRENT_ASSERT(block_size >= min_block_size);
+		TORRENT_ASSERT(block_size <= slab_size);
+		TORRENT_ASSERT((block_size & (block_size - 1)) == 0);
+	}
+
+	slab_allocator::~slab_allocator()
+	{
+		for (auto const& s : m_slabs)
+			release_slab(s);
+	}
+
+	slab_allocator::thread_cache& slab_allocator::local_cache()
+	{
+		// threads are assigned caches round-robin, the first time they
+		// allocate or free a block
+		static std::atomic<int> next_cache{0};
+		thread_local int const idx
+			= next_cache.fetch_add(1, std::memory_order_relaxed) % num_caches;
+		return m_caches[idx];
+	}
+
+	int slab_allocator::local_node() const
+	{
+		if (!m_numa_local) return 0;
+		int const consumer = m_consumer_node.load(std::memory_order_relaxed);
+		if (consumer >= 0) return consumer;
+		// threads may migrate between nodes, so this is not cached. It's only
+		// needed when going to the depot
+		return m_current_node();
+	}
+
+	void slab_allocator::set_consumer_node(int const node)
+	{
+		m_consumer_node.store(node, std::memory_order_relaxed);
+	}
+
+	void slab_allocator::set_node_function(node_function const f)
+	{
+		m_current_node = f;
+	}
+
+	char* slab_allocator::allocate()
+	{
+		thread_cache& c = local_cache();
+		std::lock_guard<std::mutex> l(c.mutex);
+
+		if (c.loaded.empty() && !c.previous.empty())
+			std::swap(c.loaded, c.previous);
+
+		if (c.loaded.empty())
+		{
+			++c.misses;
+			int const node = local_node();
+			std::lock_guard<std::mutex> dl(m_depot_mutex);
+			auto const it = std::find_if(m_depot.rbegin(), m_depot.rend()
+				, [node](magazine const& m) { return m.node == node; });
+			if (it != m_depot.rend())
+			{
+				c.loaded = *it;
+				m_depot.erase(std::next(it).base());
+			}
+			else
+			{
+				refill(c.loaded, node);
+				if (c.loaded.empty()) return nullptr;
+			}
+		}
+		else
+		{
+			++c.hits;
+		}
+
+		char* const ret = c.loaded.blocks[std::size_t(--c.loaded.size)];
+#ifdef TORRENT_ADDRESS_SANITIZER
+		__asan_unpoison_memory_region(ret, std::size_t(m_block_size));
+#endif
+		return ret;
+	}
+
+	void slab_allocator::free(char* const buf)
+	{
+		TORRENT_ASSERT(buf != nullptr);
+#ifdef TORRENT_ADDRESS_SANITIZER
+		__asan_poison_memory_region(buf, std::size_t(m_block_size));
+#endif
+		thread_cache& c = local_cache();
+		std::lock_guard<std::mutex> l(c.mutex);
+
+		if (c.loaded.full() && c.previous.empty())
+			std::swap(c.loaded, c.previous);
+
+		if (c.loaded.full())
+		{
+			++c.misses;
+			int const node = local_node();
+			std::lock_guard<std::mutex> dl(m_depot_mutex);
+			// blocks may be freed by a thread on a different node than the
+			// one they were allocated on. The depot hands out magazines by
+			// node, so those blocks go back to their slabs instead
+			if (m_numa_local) return_foreign_blocks(c.previous, node);
+			if (!c.previous.empty())
+			{
+				c.previous.node = node;
+				m_depot.push_back(c.previous);
+			}
+			c.previous = c.loaded;
+			c.loaded.size = 0;
+
+			auto const same_node = [node](magazine const& m) { return m.node == node; };
+			if (std::count_if(m_depot.begin(), m_depot.end(), same_node) > max_depot_magazines)
+			{
+				// the oldest magazine has the coldest blocks
+				auto const it = std::find_if(m_depot.begin(), m_depot.end(), same_node);
+				return_blocks(*it);
+				m_depot.erase(it);
+			}
+		}
+		else
+		{
+			++c.hits;
+		}
+
+		c.loaded.blocks[std::size_t(c.loaded.size++)] = buf;
+	}
+
+	void slab_allocator::set_lock_memory(bool const l)
+	{
+		std::lock_guard<std::mutex> dl(m_depot_mutex);
+		if (l == m_lock_memory) return;
+		m_lock_memory = l;
+		for (auto const& s : m_slabs)
+			lock_slab(s.base, l);
+	}
+
+	void slab_allocator::set_hugepages(bool const h)
+	{
+		// this only affects slabs allocated from now on
+		std::lock_guard<std::mutex> dl(m_depot_mutex);
+		m_hugepages = h;
+	}
+
+	void slab_allocator::set_numa_local(bool const n)
+	{
+		std::lock_guard<std::mutex> dl(m_depot_mutex);
+		m_numa_local = n;
+	}
+
+	slab_allocator::stats_t slab_allocator::stats() const
+	{
+		stats_t ret;
+		for (auto const& c : m_caches)
+		{
+			std::lock_guard<std::mutex> l(c.mutex);
+			ret.magazine_hits += c.hits;
+			ret.magazine_misses += c.misses;
+		}
+		std::lock_guard<std::mutex> dl(m_depot_mutex);
+		ret.slabs = int(m_slabs.size());
+		ret.hugepage_slabs = int(std::count_if(m_slabs.begin(), m_slabs.end()
+			, [](slab const& s) { return s.hugepage; }));
+		ret.hugepage_fallbacks = m_hugepage_fallbacks;
+		return ret;
+	}
+
+	void slab_allocator::refill(magazine& m, int const node)
+	{
+		// with large blocks, don't map more than one slab's worth at a time
+		int const target = std::min(int(magazine_size), blocks_per_slab());
+		while (m.size < target)
+		{
+			// take blocks from the fullest slab, to give the emptier ones a
+			// chance to become free
+			slab* s = nullptr;
+			for (auto& i : m_slabs)
+			{
+				if (i.num_free > 0 && i.node == node
+					&& (s == nullptr || i.num_free < s->num_free))
+					s = &i;
+			}
+
+			if (s == nullptr)
+			{
+				if (!add_slab(node)) return;
+				continue;
+			}
+
+			for (std::size_t w = 0; w < s->free_mask.size() && m.size < target; ++w)
+			{
+				while (s->free_mask[w] != 0 && m.size < target)
+				{
+					int const bit = lowest_bit(s->free_mask[w]);
+					s->free_mask[w] &= ~(std::uint64_t(1) << bit);
+					--s->num_free;
+					m.blocks[std::size_t(m.size++)] = s->base
+						+ (int(w) * 64 + bit) * m_block_size;
+				}
+			}
+		}
+	}
+
+	std::vector<slab_allocator::slab>::iterator slab_allocator::find_slab(char const* const b)
+	{
+		auto const it = std::upper_bound(m_slabs.begin(), m_slabs.end(), b
+			, [](char const* p, slab const& s) { return p < s.base; }) - 1;
+		TORRENT_ASSERT(it >= m_slabs.begin());
+		TORRENT_ASSERT(b >= it->base && b < it->base + slab_size);
+		return it;
+	}
+
+	void slab_allocator::return_block(char* const b)
+	{
+		auto const it = find_slab(b);
+		int const idx = int((b - it->base) / m_block_size);
+		TORRENT_ASSERT((it->free_mask[std::size_t(idx / 64)] & (std::uint64_t(1) << (idx % 64))) == 0);
+		it->free_mask[std::size_t(idx / 64)] |= std::uint64_t(1) << (idx % 64);
+		if (++it->num_free < blocks_per_slab()) return;
+
+		release_slab(*it);
+		m_slabs.erase(it);
+	}
+
+	void slab_allocator::return_blocks(magazine& m)
+	{
+		for (int i = 0; i < m.size; ++i)
+			return_block(m.blocks[std::size_t(i)]);
+		m.size = 0;
+	}
+
+	void slab_allocator::return_foreign_blocks(magazine& m, int const node)
+	{
+		int keep = 0;
+		for (int i = 0; i < m.size; ++i)
+		{
+			char* const b = m.blocks[std::size_t(i)];
+			if (find_slab(b)->node == node)
+				m.blocks[std::size_t(keep++)] = b;
+			else
+				return_block(b);
+		}
+		m.size = keep;
+	}
+
+	void slab_allocator::release_slab(slab const& s)
+	{
+		if (m_lock_memory) lock_slab(s.base, false);
+#ifdef TORRENT_ADDRESS_SANITIZER
+		__asan_unpoison_memory_region(s.base, slab_size);
+#endif
+		unmap_slab(s.base);
+	}
+
+	bool slab_allocator::add_slab(int const node)
+	{
+		bool hugepage = false;
+		char* const base = map_slab(m_hugepages, m_numa_local ? node : -1, hugepage);
+		if (base == nullptr) return false;
+		if (m_hugepages && !hugepage) ++m_hugepage_fallbacks;
+		if (m_lock_memory) lock_slab(base, true);
+#ifdef TORRENT_ADDRESS_SANITIZER
+		__asan_poison_memory_region(base, slab_size);
+#endif
+
+		slab s;
+		s.base = base;
+		s.free_mask.fill(0);
+		s.num_free = blocks_per_slab();
+		for (int i = 0; i < s.num_free; ++i)
+			s.free_mask[std::size_t(i / 64)] |= std::uint64_t(1) << (i % 64);
+		s.node = node;
+		s.hugepage = hugepage;
+		auto const it = std::upper_bound(m_slabs.begin(), m_slabs.end(), base
+			, [](char const* p, slab const& e) { return p < e.base; });
+		m_slabs.insert(it, s);
+		return true;
+	}
+}
+}
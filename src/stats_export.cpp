@@ -0,0 +1,173 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/config.hpp"
+
+#if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
+
+#include "libtorrent/aux_/stats_export.hpp"
+#include "libtorrent/aux_/open_mode.hpp"
+#include "libtorrent/session_stats.hpp"
+#include "libtorrent/time.hpp"
+#include "libtorrent/file.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <new>
+
+namespace libtorrent {
+namespace aux {
+
+namespace {
+
+	char const stats_export_magic[8] = "LTSTATS";
+
+	constexpr std::uint32_t metrics_offset = 64;
+
+	constexpr std::uint32_t align_up(std::uint32_t const v, std::uint32_t const a)
+	{
+		return (v + a - 1) & ~(a - 1);
+	}
+
+	constexpr std::uint32_t values_offset = align_up(metrics_offset
+		+ counters::num_counters * std::uint32_t(sizeof(stats_export_metric)), 64);
+
+	constexpr std::uint32_t export_file_size = values_offset
+		+ counters::num_counters * std::uint32_t(sizeof(std::int64_t));
+
+	static_assert(sizeof(stats_export_header) <= metrics_offset
+		, "the stats export header must fit in front of the metrics");
+	static_assert(sizeof(std::atomic<std::int64_t>) == sizeof(std::int64_t)
+		, "values in the stats export file are plain 64 bit integers");
+
+	file_mapping open_export_file(std::string const& path)
+	{
+		open_mode_t const mode = open_mode::write | open_mode::truncate
+			| open_mode::random_access;
+		file_handle f(path, export_file_size, mode);
+#if TORRENT_HAVE_MAP_VIEW_OF_FILE
+		return file_mapping(std::move(f), mode, export_file_size
+			, std::make_shared<std::mutex>());
+#else
+		return file_mapping(std::move(f), mode, export_file_size);
+#endif
+	}
+}
+
+	stats_export::stats_export(std::string path)
+		: m_path(std::move(path))
+		, m_file(open_export_file(m_path))
+	{
+		char* const base = m_file.range().data();
+
+		auto const metrics = session_stats_metrics();
+		auto* m = reinterpret_cast<stats_export_metric*>(base + metrics_offset);
+		for (auto const& metric : metrics)
+		{
+			TORRENT_ASSERT(std::strlen(metric.name) < sizeof(m->name));
+			m->value_index = std::uint32_t(metric.value_index);
+			m->type = metric.type == metric_type_t::gauge ? 1 : 0;
+			std::strncpy(m->name, metric.name, sizeof(m->name) - 1);
+			m->name[sizeof(m->name) - 1] = '\0';
+			++m;
+		}
+
+		m_values = new (base + values_offset) std::atomic<std::int64_t>[counters::num_counters];
+		for (int i = 0; i < counters::num_counters; ++i)
+			m_values[i].store(0, std::memory_order_relaxed);
+
+		m_header = new (base) stats_export_header;
+		m_header->version = version;
+		m_header->num_metrics = std::uint32_t(metrics.size());
+		m_header->num_values = counters::num_counters;
+		m_header->metrics_offset = metrics_offset;
+		m_header->values_offset = values_offset;
+		m_header->reserved = 0;
+		m_header->sequence.store(0, std::memory_order_relaxed);
+		m_header->timestamp.store(0, std::memory_order_relaxed);
+
+		// the magic is written last, a reader seeing it can trust the rest of
+		// the header
+		std::atomic_thread_fence(std::memory_order_release);
+		std::memcpy(m_header->magic, stats_export_magic, sizeof(m_header->magic));
+	}
+
+	void stats_export::update(counters const& c)
+	{
+		std::uint64_t const seq = m_header->sequence.load(std::memory_order_relaxed);
+		m_header->sequence.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for (int i = 0; i < counters::num_counters; ++i)
+			m_values[i].store(c[i], std::memory_order_relaxed);
+		m_header->timestamp.store(total_microseconds(clock_type::now().time_since_epoch())
+			, std::memory_order_relaxed);
+
+		m_header->sequence.store(seq + 2, std::memory_order_release);
+	}
+
+	int read_stats_export(span<char const> const file, span<std::int64_t> const out)
+	{
+		if (file.size() < std::ptrdiff_t(sizeof(stats_export_header))) return -1;
+
+		auto const* hdr = reinterpret_cast<stats_export_header const*>(file.data());
+		if (std::memcmp(hdr->magic, stats_export_magic, sizeof(hdr->magic)) != 0)
+			return -1;
+		if (hdr->version != stats_export::version) return -1;
+		if (hdr->values_offset % alignof(std::int64_t) != 0) return -1;
+		if (std::int64_t(hdr->values_offset) + std::int64_t(hdr->num_values) * 8 > file.size())
+			return -1;
+
+		auto const* values = reinterpret_cast<std::atomic<std::int64_t> const*>(
+			file.data() + hdr->values_offset);
+		int const n = int(std::min(std::ptrdiff_t(hdr->num_values), out.size()));
+
+		// if the writer holds the lock for this long, it most likely died
+		// while updating
+		for (int attempt = 0; attempt < 10000; ++attempt)
+		{
+			std::uint64_t const seq = hdr->sequence.load(std::memory_order_acquire);
+			if (seq & 1) continue;
+
+			for (int i = 0; i < n; ++i)
+				out[i] = values[i].load(std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (hdr->sequence.load(std::memory_order_relaxed) == seq) return n;
+		}
+		return -1;
+	}
+}
+}
+
+#endif // TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
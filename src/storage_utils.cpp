@@ -72,71 +72,45 @@ namespace libtorrent { namespace aux {
 		TORRENT_ASSERT(static_cast<int>(piece) * static_cast<std::int64_t>(files.piece_length())
 			+ offset + buf.size() <= files.total_size());
 
-		// find the file iterator and file offset
-		std::int64_t const torrent_offset = static_cast<int>(piece) * std::int64_t(files.piece_length()) + offset;
-		file_index_t file_index = files.file_index_at_offset(torrent_offset);
-		TORRENT_ASSERT(torrent_offset >= files.file_offset(file_index));
-		TORRENT_ASSERT(torrent_offset < files.file_offset(file_index) + files.file_size(file_index));
-		std::int64_t file_offset = torrent_offset - files.file_offset(file_index);
-
 		int ret = 0;
 
-		while (buf.size() > 0)
+		files.map_block(piece, offset, buf.size(), [&](file_slice const& slice)
 		{
-			// the number of bytes left to read in the current file (specified by
-			// file_index). This is the minimum of (file_size - file_offset) and
-			// buf.size().
-			int file_bytes_left = int(buf.size());
-			if (file_offset + file_bytes_left > files.file_size(file_index))
-				file_bytes_left = std::max(static_cast<int>(files.file_size(file_index) - file_offset), 0);
-
-			// there are no bytes left in this file, move to the next one
-			// this loop skips over empty files
-			if (file_bytes_left == 0)
+			std::int64_t file_offset = slice.offset;
+			// the file operation may transfer less than it's asked to, keep
+			// calling it until this slice of the file is done
+			int file_bytes_left = int(slice.size);
+			TORRENT_ASSERT(file_bytes_left > 0);
+
+			while (file_bytes_left > 0)
 			{
-				do
+				int const bytes_transferred = op(slice.file_index, file_offset
+					, buf.first(file_bytes_left), ec);
+				TORRENT_ASSERT(bytes_transferred <= file_bytes_left);
+				if (ec)
 				{
-					++file_index;
-					file_offset = 0;
-					TORRENT_ASSERT(file_index < files.end_file());
-
-					// this should not happen. buf.size() should be clamped by the total
-					// size of the torrent, so we should never run off the end of it
-					if (file_index >= files.end_file()) return ret;
-
-					// skip empty files
+					ec.file(slice.file_index);
+					return false;
 				}
-				while (files.file_size(file_index) == 0);
-
-				file_bytes_left = int(buf.size());
-				if (file_offset + file_bytes_left > files.file_size(file_index))
-					file_bytes_left = std::max(static_cast<int>(files.file_size(file_index) - file_offset), 0);
-				TORRENT_ASSERT(file_bytes_left > 0);
-			}
-
-			int const bytes_transferred = op(file_index, file_offset
-				, buf.first(file_bytes_left), ec);
-			TORRENT_ASSERT(bytes_transferred <= file_bytes_left);
-			if (ec)
-			{
-				ec.file(file_index);
-				return ret;
-			}
 
-			buf = buf.subspan(bytes_transferred);
-			file_offset += bytes_transferred;
-			ret += bytes_transferred;
+				buf = buf.subspan(bytes_transferred);
+				file_offset += bytes_transferred;
+				file_bytes_left -= bytes_transferred;
+				ret += bytes_transferred;
 
-			// if the file operation returned 0, we've hit end-of-file. We're done
-			if (bytes_transferred == 0 && file_bytes_left > 0 )
-			{
-				// fill in this information in case the caller wants to treat
-				// a short-read as an error
-				ec.operation = operation_t::file_read;
-				ec.ec = boost::asio::error::eof;
-				ec.file(file_index);
+				// if the file operation returned 0, we've hit end-of-file. We're done
+				if (bytes_transferred == 0)
+				{
+					// fill in this information in case the caller wants to treat
+					// a short-read as an error
+					ec.operation = operation_t::file_read;
+					ec.ec = boost::asio::error::eof;
+					ec.file(slice.file_index);
+					return false;
+				}
 			}
-		}
+			return true;
+		});
 		return ret;
 	}
 
@@ -548,10 +522,7 @@ std::int64_t get_filesize(stat_cache& stat, file_index_t const file_index
 		{
 			if (rd.have_pieces.get_bit(i) == false) continue;
 
-			std::vector<file_slice> f = fs.map_block(i, 0, 1);
-			TORRENT_ASSERT(!f.empty());
-
-			file_index_t const file_index = f[0].file_index;
+			file_index_t const file_index = fs.file_index_at_piece(i);
 
 			// files with priority zero may not have been saved to disk at their
 			// expected location, but is likely to be in a partfile. Just exempt it
@@ -232,6 +232,7 @@ bool is_downloading_state(int const st)
 		, m_apply_ip_filter(p.flags & torrent_flags::apply_ip_filter)
 		, m_pending_active_change(false)
 		, m_v2_piece_layers_validated(false)
+		, m_tick_scheduled(false)
 		, m_connect_boost_counter(static_cast<std::uint8_t>(settings().get_int(settings_pack::torrent_connect_boost)))
 		, m_incomplete(0xffffff)
 		, m_announce_to_dht(!(p.flags & torrent_flags::paused))
@@ -249,6 +250,7 @@ bool is_downloading_state(int const st)
 		, m_torrent_initialized(false)
 		, m_outstanding_file_priority(false)
 		, m_complete_sent(false)
+		, m_connects_deferred(false)
 	{
 		if (p.flags & torrent_flags::need_save_resume)
 		{
@@ -1176,6 +1178,7 @@ bool is_downloading_state(int const st)
 		update_gauge();
 		// some peers that previously was no longer interesting may
 		// now have become interesting, since we lack this one piece now.
+		std::vector<peer_connection*> request_peers;
 		for (auto i = begin(); i != end();)
 		{
 			peer_connection* p = *i;
@@ -1187,10 +1190,18 @@ bool is_downloading_state(int const st)
 			// only make uninteresting peers interesting again.
 			if (p->is_interesting()) continue;
 			p->update_interest();
-			if (!m_abort)
+			if (!m_abort && !p->is_disconnecting())
+				request_peers.push_back(p);
+		}
+
+		if (!m_abort && !request_peers.empty())
+		{
+			int const picks = request_blocks(*this, request_peers);
+			if (picks > 0)
+				inc_stats_counter(counters::hash_fail_piece_picks, picks);
+			for (auto p : request_peers)
 			{
-				if (request_a_block(*this, *p))
-					inc_stats_counter(counters::hash_fail_piece_picks);
+				if (p->is_disconnecting()) continue;
 				p->send_block_requests();
 			}
 		}
@@ -4718,9 +4729,7 @@ namespace {
 			&& c.allowed_fast().empty())
 			return;
 
-		if (request_a_block(*this, c))
-			inc_stats_counter(counters::interesting_piece_picks);
-		c.send_block_requests();
+		refill_requests(&c, counters::interesting_piece_picks);
 	}
 
 	void torrent::on_piece_sync(piece_index_t const piece, std::vector<int> const& blocks) try
@@ -6116,6 +6125,13 @@ namespace {
 			m_outgoing_pids.erase(it);
 		}
 
+		if (p->deferred_request() >= 0)
+		{
+			p->deferred_request(-1);
+			m_deferred_requests.erase(std::remove(m_deferred_requests.begin()
+				, m_deferred_requests.end(), p.get()), m_deferred_requests.end());
+		}
+
 		// only schedule the peer for actual removal if in fact
 		// we can be sure peer_connection will be kept alive until
 		// the deferred function is called. If a peer_connection
@@ -6220,6 +6236,63 @@ namespace {
 		update_want_tick();
 	}
 
+	void torrent::refill_requests(peer_connection* p, int const counter)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		TORRENT_ASSERT(counter >= 0);
+		TORRENT_ASSERT(p->associated_torrent().lock().get() == this);
+
+		if (p->deferred_request() >= 0) return;
+
+		if (!m_refill_posted)
+		{
+			// this is the first peer in this round of the message loop. Don't
+			// make it wait for others that may never come, but queue up any
+			// that do until the end of the round
+			m_refill_posted = true;
+			auto self = shared_from_this();
+			post(m_ses.get_context(), [self] { self->wrap(&torrent::on_refill_requests); });
+
+			if (request_a_block(*this, *p))
+				inc_stats_counter(counter);
+			p->send_block_requests();
+			return;
+		}
+
+		p->deferred_request(counter);
+		m_deferred_requests.push_back(p);
+	}
+
+	void torrent::on_refill_requests()
+	{
+		TORRENT_ASSERT(is_single_thread());
+
+		m_refill_posted = false;
+		if (m_deferred_requests.empty()) return;
+
+		std::vector<peer_connection*> peers;
+		peers.swap(m_deferred_requests);
+		if (m_abort)
+		{
+			for (auto p : peers) p->deferred_request(-1);
+			return;
+		}
+
+		// the piece picker stats are counted per peer, by the reason the peer
+		// needed more requests
+		std::vector<peer_connection*> picked;
+		request_blocks(*this, peers, &picked);
+		for (auto p : picked)
+			inc_stats_counter(p->deferred_request());
+
+		for (auto p : peers)
+		{
+			p->deferred_request(-1);
+			if (p->is_disconnecting()) continue;
+			p->send_block_requests();
+		}
+	}
+
 	void torrent::on_remove_peers() noexcept
 	{
 		TORRENT_ASSERT(is_single_thread());
@@ -6861,6 +6934,110 @@ namespace {
 		return f.get_hashes(req.base, req.index, req.count, req.proof_layers);
 	}
 
+	void torrent::rehydrate_hashes(hash_request const& req)
+	{
+		if (!settings().get_bool(settings_pack::compact_merkle_trees)) return;
+		if (!m_storage || m_abort) return;
+
+		file_storage const& fs = m_torrent_file->orig_files();
+		int const blocks_per_piece = fs.blocks_per_piece();
+
+		// only the layers below the piece layer are dropped when collapsing
+		// a tree
+		if ((1 << req.base) >= blocks_per_piece) return;
+
+		// don't let peers make us read too much at a time
+		int const max_rehydrating_pieces = 64;
+
+		auto& tree = m_merkle_trees[req.file];
+		int const file_blocks = fs.file_num_blocks(req.file);
+		piece_index_t const file_first_piece(int(fs.file_offset(req.file) / fs.piece_length()));
+
+		// the range of blocks covered by the request
+		int const first = (req.index << req.base) / blocks_per_piece * blocks_per_piece;
+		int const last = std::min((req.index + req.count) << req.base, file_blocks);
+		for (int block = first; block < last; block += blocks_per_piece)
+		{
+			piece_index_t const piece = file_first_piece + piece_index_t::diff_type(block / blocks_per_piece);
+			int const num_blocks = std::min(blocks_per_piece, file_blocks - block);
+			if (!have_piece(piece)) continue;
+			if (tree.blocks_verified(block, num_blocks)) continue;
+			if (std::find(m_rehydrating_pieces.begin(), m_rehydrating_pieces.end(), piece)
+				!= m_rehydrating_pieces.end())
+				continue;
+			if (int(m_rehydrating_pieces.size()) >= max_rehydrating_pieces) break;
+
+			aux::vector<sha256_hash> hashes(fs.blocks_in_piece2(piece));
+			span<sha256_hash> v2_span(hashes);
+			m_ses.disk_thread().async_hash(m_storage, piece, v2_span, {}
+				, [self = shared_from_this(), hashes1 = std::move(hashes)]
+				(piece_index_t p, sha1_hash const&, storage_error const& error) mutable
+				{ self->on_hashes_rehydrated(std::move(hashes1), p, error); });
+			m_rehydrating_pieces.push_back(piece);
+		}
+		m_last_rehydrate = aux::time_now32();
+		m_ses.deferred_submit_jobs();
+	}
+
+	void torrent::on_hashes_rehydrated(aux::vector<sha256_hash> block_hashes
+		, piece_index_t const piece, storage_error const& error)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		auto const i = std::find(m_rehydrating_pieces.begin(), m_rehydrating_pieces.end(), piece);
+		if (i != m_rehydrating_pieces.end()) m_rehydrating_pieces.erase(i);
+
+		if (m_abort || error) return;
+
+		file_storage const& fs = m_torrent_file->orig_files();
+		file_index_t const file = fs.file_index_at_piece(piece);
+		piece_index_t const file_first_piece(int(fs.file_offset(file) / fs.piece_length()));
+		int const first_block = static_cast<int>(piece - file_first_piece) * fs.blocks_per_piece();
+
+		auto& tree = m_merkle_trees[file];
+		for (int k = 0; k < int(block_hashes.size()); ++k)
+		{
+			// the hash job may have failed part-way
+			if (block_hashes[k].is_all_zeros()) break;
+			auto const result = std::get<0>(tree.set_block(first_block + k, block_hashes[k]));
+			if (result == aux::merkle_tree::set_block_result::hash_failed
+				|| result == aux::merkle_tree::set_block_result::block_hash_failed)
+			{
+#ifndef TORRENT_DISABLE_LOGGING
+				debug_log("*** REHYDRATING BLOCK HASHES FAILED [ piece: %d ]"
+					, static_cast<int>(piece));
+#endif
+				break;
+			}
+		}
+		m_merkle_trees_rehydrated = true;
+	}
+
+	void torrent::collapse_merkle_trees()
+	{
+		m_merkle_trees_rehydrated = false;
+		if (!settings().get_bool(settings_pack::compact_merkle_trees)) return;
+		if (!m_torrent_file->is_valid()) return;
+
+		file_storage const& fs = m_torrent_file->orig_files();
+		bool const seed = is_seed();
+		for (file_index_t const f : m_merkle_trees.range())
+		{
+			if (!seed)
+			{
+				piece_index_t const file_first_piece(int(fs.file_offset(f) / fs.piece_length()));
+				bool have_all = true;
+				for (auto const p : fs.file_piece_range(f))
+				{
+					if (have_piece(file_first_piece + p)) continue;
+					have_all = false;
+					break;
+				}
+				if (!have_all) continue;
+			}
+			m_merkle_trees[f].collapse_to_piece_layer();
+		}
+	}
+
 	bool torrent::add_hashes(hash_request const& req, span<sha256_hash> hashes)
 	{
 		need_hash_picker();
@@ -8121,7 +8298,29 @@ namespace {
 
 	void torrent::update_want_tick()
 	{
-		update_list(aux::session_interface::torrent_want_tick, want_tick());
+		bool const tick = want_tick();
+		update_list(aux::session_interface::torrent_want_tick, tick);
+
+		// once scheduled, the torrent stays scheduled until its tick finds it
+		// no longer wants to be ticked
+		if (tick && !m_tick_scheduled)
+		{
+			m_tick_scheduled = true;
+			m_ses.schedule_tick(shared_from_this());
+		}
+	}
+
+	bool torrent::tick_timer(int const tick_interval_ms)
+	{
+		TORRENT_ASSERT(m_tick_scheduled);
+		if (want_tick())
+		{
+			TORRENT_ASSERT(!is_aborted());
+			second_tick(tick_interval_ms);
+			if (want_tick()) return true;
+		}
+		m_tick_scheduled = false;
+		return false;
 	}
 
 	// this function adjusts which lists this torrent is part of (checking,
@@ -8180,6 +8379,9 @@ namespace {
 		if (!m_peer_list || m_peer_list->num_connect_candidates() == 0)
 			return false;
 
+		// all the candidates are waiting for their reconnect timeout
+		if (m_connects_deferred) return false;
+
 		// if the user disabled outgoing connections for seeding torrents,
 		// don't make any
 		if (!settings().get_bool(settings_pack::seeding_outgoing_connections)
@@ -8364,6 +8566,10 @@ namespace {
 
 		m_became_finished = aux::time_now32();
 
+		// we won't need the block hashes of the files we have anymore,
+		// except to serve them to peers
+		collapse_merkle_trees();
+
 		// we have to call completed() before we start
 		// disconnecting peers, since there's an assert
 		// to make sure we're cleared the piece picker
@@ -8607,6 +8813,11 @@ namespace {
 
 		update_want_tick();
 
+		// the peers to request blocks from, once all connections have been
+		// initialized. Picking for all of them at once lets the piece picker
+		// do a single pass over the pieces
+		std::vector<peer_connection*> request_peers;
+
 		for (auto pc : m_connections)
 		{
 			TORRENT_INCREMENT(m_iterating_connections);
@@ -8624,13 +8835,16 @@ namespace {
 			pc->peer_log(peer_log_alert::info, "ON_FILES_CHECKED");
 #endif
 			if (pc->is_interesting() && !pc->has_peer_choked())
-			{
-				if (request_a_block(*this, *pc))
-				{
-					inc_stats_counter(counters::unchoke_piece_picks);
-					pc->send_block_requests();
-				}
-			}
+				request_peers.push_back(pc);
+		}
+
+		if (!request_peers.empty())
+		{
+			int const picks = request_blocks(*this, request_peers);
+			if (picks > 0)
+				inc_stats_counter(counters::unchoke_piece_picks, picks);
+			for (auto pc : request_peers)
+				pc->send_block_requests();
 		}
 
 		start_announcing();
@@ -8997,22 +9211,6 @@ namespace {
 			TORRENT_ASSERT(m_abort || m_error || !m_picker || m_picker->num_pieces() == 0);
 		}
 
-#ifdef TORRENT_EXPENSIVE_INVARIANT_CHECKS
-		// make sure we haven't modified the peer object
-		// in a way that breaks the sort order
-		if (m_peer_list && m_peer_list->begin() != m_peer_list->end())
-		{
-			auto i = m_peer_list->begin();
-			auto p = i++;
-			auto end(m_peer_list->end());
-			peer_address_compare cmp;
-			for (; i != end; ++i, ++p)
-			{
-				TORRENT_ASSERT(!cmp(*i, *p));
-			}
-		}
-#endif
-
 /*
 		if (m_picker && !m_abort)
 		{
@@ -10238,6 +10436,16 @@ namespace {
 
 		maybe_connect_web_seeds();
 
+		// merkle trees whose block hashes were recomputed to serve hash
+		// requests are collapsed again once they haven't been needed for a
+		// while
+		if (m_merkle_trees_rehydrated
+			&& m_rehydrating_pieces.empty()
+			&& aux::time_now32() - m_last_rehydrate > minutes(2))
+		{
+			collapse_merkle_trees();
+		}
+
 		m_swarm_last_seen_complete = m_last_seen_complete;
 		for (auto p : m_connections)
 		{
@@ -11142,6 +11350,14 @@ namespace {
 		if (p == nullptr)
 		{
 			m_stats_counters.inc_stats_counter(counters::no_peer_connection_attempts);
+			int const delay = st.next_connect_time - int(m_ses.session_time());
+			if (delay > 0)
+			{
+				// there's no point in asking the peer list again until one
+				// of the candidates may be tried again
+				m_connects_deferred = true;
+				m_ses.defer_connect_attempts(shared_from_this(), seconds32(delay));
+			}
 			update_want_peers();
 			return false;
 		}
@@ -11158,6 +11374,14 @@ namespace {
 		return true;
 	}
 
+	void torrent::resume_connect_attempts()
+	{
+		TORRENT_ASSERT(is_single_thread());
+		if (!m_connects_deferred) return;
+		m_connects_deferred = false;
+		update_want_peers();
+	}
+
 	torrent_peer* torrent::add_peer(tcp::endpoint const& adr
 		, peer_source_flags_t const source, pex_flags_t flags)
 	{
@@ -11248,6 +11472,8 @@ namespace {
 			notify_extension_add_peer(adr, source, torrent_plugin::filtered);
 #endif
 		}
+		// a peer we haven't seen before may be connected to right away
+		if (p && st.first_time_seen) m_connects_deferred = false;
 		update_want_peers();
 		state_updated();
 		return p;
@@ -11289,10 +11515,11 @@ namespace {
 	{
 		need_peer_list();
 		m_peer_list->set_failcount(p, 0);
+		m_connects_deferred = false;
 		update_want_peers();
 	}
 
-	std::pair<peer_list::iterator, peer_list::iterator> torrent::find_peers(address const& a)
+	std::vector<torrent_peer*> torrent::find_peers(address const& a)
 	{
 		need_peer_list();
 		return m_peer_list->find_peers(a);
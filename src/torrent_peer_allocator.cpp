@@ -36,80 +36,104 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/assert.hpp"
 #include "libtorrent/torrent_peer_allocator.hpp"
 
+#include <cstdlib>
+#include <cstring>
+
 namespace libtorrent {
 
-	torrent_peer* torrent_peer_allocator::allocate_peer_entry(int type)
+	constexpr peer_handle torrent_peer_allocator_interface::invalid_handle;
+
+	torrent_peer_allocator::torrent_peer_allocator()
 	{
-		TORRENT_ASSERT(m_in_use);
-		torrent_peer* p = nullptr;
-		switch(type)
-		{
-			case torrent_peer_allocator_interface::ipv4_peer_type:
-				p = static_cast<torrent_peer*>(m_ipv4_peer_pool.malloc());
-				if (p == nullptr) return nullptr;
-				m_ipv4_peer_pool.set_next_size(500);
-				m_total_bytes += sizeof(libtorrent::ipv4_peer);
-				m_live_bytes += sizeof(libtorrent::ipv4_peer);
-				++m_live_allocations;
-				++m_total_allocations;
-				break;
-			case torrent_peer_allocator_interface::ipv6_peer_type:
-				p = static_cast<torrent_peer*>(m_ipv6_peer_pool.malloc());
-				if (p == nullptr) return nullptr;
-				m_ipv6_peer_pool.set_next_size(500);
-				m_total_bytes += sizeof(libtorrent::ipv6_peer);
-				m_live_bytes += sizeof(libtorrent::ipv6_peer);
-				++m_live_allocations;
-				++m_total_allocations;
-				break;
+		m_types[ipv4_peer_type].entry_size = sizeof(libtorrent::ipv4_peer);
+		m_types[ipv6_peer_type].entry_size = sizeof(libtorrent::ipv6_peer);
 #if TORRENT_USE_I2P
-			case torrent_peer_allocator_interface::i2p_peer_type:
-				p = static_cast<torrent_peer*>(m_i2p_peer_pool.malloc());
-				if (p == nullptr) return nullptr;
-				m_i2p_peer_pool.set_next_size(500);
-				m_total_bytes += sizeof(libtorrent::i2p_peer);
-				m_live_bytes += sizeof(libtorrent::i2p_peer);
-				++m_live_allocations;
-				++m_total_allocations;
-				break;
+		m_types[i2p_peer_type].entry_size = sizeof(libtorrent::i2p_peer);
 #endif
+	}
+
+	torrent_peer_allocator::~torrent_peer_allocator()
+	{
+#if TORRENT_USE_ASSERTS
+		m_in_use = false;
+#endif
+		for (auto& l : m_types)
+			for (char* s : l.slabs) std::free(s);
+	}
+
+	bool torrent_peer_allocator::add_slab(int const type)
+	{
+		slab_list& l = m_types[std::size_t(type)];
+		TORRENT_ASSERT(l.entry_size >= sizeof(peer_handle));
+		if (l.slabs.size() > (~type_mask >> slab_shift)) return false;
+
+		char* const slab = static_cast<char*>(std::malloc(l.entry_size * slab_entries));
+		if (slab == nullptr) return false;
+
+		peer_handle const first = (peer_handle(type) << type_shift)
+			| (peer_handle(l.slabs.size()) << slab_shift);
+		l.slabs.push_back(slab);
+
+		// thread the new entries onto the free list, lowest address first
+		for (int i = slab_entries - 1; i >= 0; --i)
+		{
+			std::memcpy(slab + std::size_t(i) * l.entry_size, &l.free_list, sizeof(peer_handle));
+			l.free_list = first | peer_handle(i);
 		}
-		return p;
+		return true;
 	}
 
-	void torrent_peer_allocator::free_peer_entry(torrent_peer* p)
+	peer_handle torrent_peer_allocator::allocate_peer_entry(int const type)
 	{
 		TORRENT_ASSERT(m_in_use);
+		TORRENT_ASSERT(type >= 0 && type < int(m_types.size()));
+#if !TORRENT_USE_I2P
+		if (type == i2p_peer_type) return invalid_handle;
+#endif
+		slab_list& l = m_types[std::size_t(type)];
+		if (l.free_list == invalid_handle && !add_slab(type))
+			return invalid_handle;
+
+		peer_handle const h = l.free_list;
+		std::memcpy(&l.free_list, peer_at(h), sizeof(peer_handle));
+
+		m_total_bytes += l.entry_size;
+		m_live_bytes += int(l.entry_size);
+		++m_live_allocations;
+		++m_total_allocations;
+		return h;
+	}
+
+	void torrent_peer_allocator::free_peer_entry(peer_handle const h)
+	{
+		TORRENT_ASSERT(m_in_use);
+		torrent_peer* const p = peer_at(h);
 		TORRENT_ASSERT(p->in_use);
-		if (p->is_v6_addr)
+		std::size_t const type = h >> type_shift;
+		switch (type)
 		{
-			TORRENT_ASSERT(m_ipv6_peer_pool.is_from(static_cast<libtorrent::ipv6_peer*>(p)));
-			static_cast<libtorrent::ipv6_peer*>(p)->~ipv6_peer();
-			m_ipv6_peer_pool.free(p);
-			TORRENT_ASSERT(m_live_bytes >= int(sizeof(ipv6_peer)));
-			m_live_bytes -= int(sizeof(ipv6_peer));
-			TORRENT_ASSERT(m_live_allocations > 0);
-			--m_live_allocations;
-			return;
-		}
+			case ipv6_peer_type:
+				TORRENT_ASSERT(p->is_v6_addr);
+				static_cast<libtorrent::ipv6_peer*>(p)->~ipv6_peer();
+				break;
 #if TORRENT_USE_I2P
-		if (p->is_i2p_addr)
-		{
-			TORRENT_ASSERT(m_i2p_peer_pool.is_from(static_cast<libtorrent::i2p_peer*>(p)));
-			static_cast<libtorrent::i2p_peer*>(p)->~i2p_peer();
-			m_i2p_peer_pool.free(p);
-			TORRENT_ASSERT(m_live_bytes >= int(sizeof(i2p_peer)));
-			m_live_bytes -= int(sizeof(i2p_peer));
-			TORRENT_ASSERT(m_live_allocations > 0);
-			--m_live_allocations;
-			return;
-		}
+			case i2p_peer_type:
+				TORRENT_ASSERT(p->is_i2p_addr);
+				static_cast<libtorrent::i2p_peer*>(p)->~i2p_peer();
+				break;
 #endif
-		TORRENT_ASSERT(m_ipv4_peer_pool.is_from(static_cast<libtorrent::ipv4_peer*>(p)));
-		static_cast<libtorrent::ipv4_peer*>(p)->~ipv4_peer();
-		m_ipv4_peer_pool.free(p);
-		TORRENT_ASSERT(m_live_bytes >= int(sizeof(ipv4_peer)));
-		m_live_bytes -= int(sizeof(ipv4_peer));
+			default:
+				TORRENT_ASSERT(type == ipv4_peer_type);
+				static_cast<libtorrent::ipv4_peer*>(p)->~ipv4_peer();
+				break;
+		}
+
+		slab_list& l = m_types[type];
+		std::memcpy(static_cast<void*>(p), &l.free_list, sizeof(peer_handle));
+		l.free_list = h;
+
+		TORRENT_ASSERT(m_live_bytes >= int(l.entry_size));
+		m_live_bytes -= int(l.entry_size);
 		TORRENT_ASSERT(m_live_allocations > 0);
 		--m_live_allocations;
 	}
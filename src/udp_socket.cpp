@@ -51,8 +51,22 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/resolver_interface.hpp"
 
 #include <cstdlib>
+#include <cstring> // for memcpy
 #include <functional>
 
+#if TORRENT_HAS_MMSG
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/udp.h> // for UDP_SEGMENT and UDP_GRO
+#endif
+
+#if TORRENT_HAS_MMSG && defined UDP_SEGMENT && defined UDP_GRO
+#define TORRENT_USE_UDP_OFFLOAD 1
+#else
+#define TORRENT_USE_UDP_OFFLOAD 0
+#endif
+
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <boost/asio/ip/v6_only.hpp>
 #include "libtorrent/aux_/disable_warnings_pop.hpp"
@@ -185,25 +199,227 @@ struct set_dont_frag
 { set_dont_frag(udp::socket&, int) {} };
 #endif
 
+namespace {
+
+#if TORRENT_USE_UDP_OFFLOAD
+	// with GRO enabled, a single received datagram may be a train of up to 64
+	// kB worth of segments
+	constexpr int gro_buffer_size = 0x10000;
+	constexpr int gro_batch_size = 8;
+
+	// room for a UDP_SEGMENT or UDP_GRO control message
+	union control_buffer
+	{
+		char buf[CMSG_SPACE(sizeof(int))];
+		::cmsghdr align;
+	};
+#endif
+}
+
+struct udp_socket::receive_buffer
+{
+	receive_buffer(int const size, int const num)
+		: buffer(new char[std::size_t(size) * std::size_t(num)])
+		, slot_size(size)
+		, num_slots(num)
+	{}
+
+	char* slot(int const idx) const
+	{ return buffer.get() + std::ptrdiff_t(idx) * slot_size; }
+
+	std::unique_ptr<char[]> buffer;
+	int const slot_size;
+	int const num_slots;
+
+	// the datagrams received by the last system call. With GRO, each may
+	// contain several segments of segment_size bytes (the last one may be
+	// shorter)
+	std::array<udp::endpoint, max_batch_size> from;
+	std::array<int, max_batch_size> size;
+	std::array<int, max_batch_size> segment_size;
+
+	// the number of datagrams received by the last system call, and the
+	// position of the next segment to return from read()
+	int num = 0;
+	int next = 0;
+	int offset = 0;
+
+	bool empty() const { return next == num; }
+};
+
+#if TORRENT_HAS_MMSG
+// the datagrams queued up by send() while the socket is corked. They're
+// copied into fixed size slots, datagrams that don't fit are sent
+// immediately (after flushing the queue)
+struct udp_socket::send_queue
+{
+	std::array<std::array<char, max_datagram_size>, max_batch_size> buffers;
+	std::array<udp::endpoint, max_batch_size> targets;
+	std::array<int, max_batch_size> sizes;
+
+	// the datagrams in the range [first, end) have not been sent yet
+	int first = 0;
+	int end = 0;
+
+	bool empty() const { return first == end; }
+	bool full() const { return end == max_batch_size; }
+	void clear() { first = 0; end = 0; }
+
+	// returns the number of datagrams, starting at idx, that can be sent as
+	// a single GSO message. They must all go to the same endpoint, and all
+	// but the last one must be of the same size
+	int gso_run(int const idx) const
+	{
+		int const seg = sizes[std::size_t(idx)];
+		if (seg == 0) return 1;
+		int n = 1;
+		while (idx + n < end
+			&& sizes[std::size_t(idx + n - 1)] == seg
+			&& sizes[std::size_t(idx + n)] <= seg
+			&& targets[std::size_t(idx + n)] == targets[std::size_t(idx)])
+			++n;
+		return n;
+	}
+};
+#endif
+
 udp_socket::udp_socket(io_context& ios, aux::listen_socket_handle ls)
 	: m_socket(ios)
 	, m_ioc(ios)
-	, m_buf(new receive_buffer())
 	, m_listen_socket(std::move(ls))
 	, m_bind_port(0)
 	, m_abort(true)
+	, m_gso(false)
+	, m_gro(false)
+	, m_cork_depth(0)
 {}
 
+udp_socket::~udp_socket() = default;
+
+int udp_socket::receive(span<packet> pkts, error_code& ec)
+{
+	TORRENT_ASSERT(!pkts.empty());
+	ec.clear();
+
+	if (!m_buf || m_buf->empty())
+	{
+#if TORRENT_USE_UDP_OFFLOAD
+		int const slot_size = m_gro ? gro_buffer_size : max_datagram_size;
+		int const num_slots = m_gro ? gro_batch_size : max_batch_size;
+#else
+		int const slot_size = max_datagram_size;
+		int const num_slots = max_batch_size;
+#endif
+		if (!m_buf || m_buf->slot_size != slot_size)
+			m_buf.reset(new receive_buffer(slot_size, num_slots));
+
+		receive_buffer& rb = *m_buf;
+		rb.num = 0;
+		rb.next = 0;
+		rb.offset = 0;
+
+#if TORRENT_HAS_MMSG
+		std::array<::mmsghdr, max_batch_size> msgs;
+		std::array<::iovec, max_batch_size> iov;
+#if TORRENT_USE_UDP_OFFLOAD
+		std::array<control_buffer, max_batch_size> control;
+#endif
+		int const num = std::min(int(pkts.size()), rb.num_slots);
+		for (int i = 0; i < num; ++i)
+		{
+			auto const idx = std::size_t(i);
+			iov[idx].iov_base = rb.slot(i);
+			iov[idx].iov_len = std::size_t(rb.slot_size);
+
+			::msghdr& h = msgs[idx].msg_hdr;
+			h = ::msghdr{};
+			h.msg_name = rb.from[idx].data();
+			h.msg_namelen = static_cast<socklen_t>(rb.from[idx].capacity());
+			h.msg_iov = &iov[idx];
+			h.msg_iovlen = 1;
+#if TORRENT_USE_UDP_OFFLOAD
+			if (m_gro)
+			{
+				h.msg_control = control[idx].buf;
+				h.msg_controllen = sizeof(control[idx].buf);
+			}
+#endif
+		}
+
+		int const ret = ::recvmmsg(m_socket.native_handle(), msgs.data()
+			, static_cast<unsigned int>(num), 0, nullptr);
+		if (ret < 0)
+		{
+			ec.assign(errno, system_category());
+			return 0;
+		}
+
+		for (int i = 0; i < ret; ++i)
+		{
+			auto const idx = std::size_t(i);
+			::msghdr& h = msgs[idx].msg_hdr;
+			rb.from[idx].resize(h.msg_namelen);
+			rb.size[idx] = int(msgs[idx].msg_len);
+			rb.segment_size[idx] = rb.size[idx];
+#if TORRENT_USE_UDP_OFFLOAD
+			if (!m_gro) continue;
+			for (::cmsghdr* cm = CMSG_FIRSTHDR(&h); cm != nullptr; cm = CMSG_NXTHDR(&h, cm))
+			{
+				if (cm->cmsg_level != SOL_UDP || cm->cmsg_type != UDP_GRO) continue;
+				int seg = 0;
+				std::memcpy(&seg, CMSG_DATA(cm), sizeof(seg));
+				if (seg > 0) rb.segment_size[idx] = seg;
+			}
+#endif
+		}
+		rb.num = ret;
+#else
+		int const len = int(m_socket.receive_from(boost::asio::buffer(rb.slot(0)
+			, std::size_t(rb.slot_size)), rb.from[0], 0, ec));
+		if (ec) return 0;
+
+		rb.size[0] = len;
+		rb.segment_size[0] = len;
+		rb.num = 1;
+#endif
+	}
+
+	// hand out the received datagrams (or segments of them) until we run out
+	// of datagrams or packets to fill in. Any left over will be returned by
+	// the next call
+	receive_buffer& rb = *m_buf;
+	int ret = 0;
+	while (ret < int(pkts.size()) && !rb.empty())
+	{
+		auto const idx = std::size_t(rb.next);
+		int const len = std::min(rb.size[idx] - rb.offset, rb.segment_size[idx]);
+
+		packet& p = pkts[ret];
+		p.from = rb.from[idx];
+		p.data = {rb.slot(rb.next) + rb.offset, len};
+		p.hostname = string_view();
+		p.error.clear();
+		++ret;
+
+		rb.offset += len;
+		if (rb.offset >= rb.size[idx])
+		{
+			++rb.next;
+			rb.offset = 0;
+		}
+	}
+	return ret;
+}
+
 int udp_socket::read(span<packet> pkts, error_code& ec)
 {
-	auto const num = int(pkts.size());
 	int ret = 0;
-	packet p;
 
-	while (ret < num)
+	// the buffers are reused by the system calls in receive(), so once we
+	// have some packets to return, we can't receive any more
+	while (ret == 0 && !pkts.empty())
 	{
-		int const len = int(m_socket.receive_from(boost::asio::buffer(*m_buf)
-			, p.from, 0, ec));
+		int const num = receive(pkts, ec);
 
 		if (ec == error::would_block
 			|| ec == error::try_again
@@ -225,13 +441,15 @@ int udp_socket::read(span<packet> pkts, error_code& ec)
 			// a proxy we must ignore these
 			if (m_proxy_settings.type != settings_pack::none) continue;
 
+			packet& p = pkts[0];
 			p.error = ec;
 			p.data = span<char>();
+			p.hostname = string_view();
+			return 1;
 		}
-		else
-		{
-			p.data = {m_buf->data(), len};
 
+		for (packet& p : pkts.first(num))
+		{
 			// support packets coming from the SOCKS5 proxy
 			if (active_socks5())
 			{
@@ -253,15 +471,11 @@ int udp_socket::read(span<packet> pkts, error_code& ec)
 				// the proxy
 				if (m_proxy_settings.type != settings_pack::none && proxy_only) continue;
 			}
-		}
 
-		pkts[ret] = p;
-		++ret;
-
-		// we only have a single buffer for now, so we can only return a
-		// single packet. In the future though, we could attempt to drain
-		// the socket here, or maybe even use recvmmsg()
-		break;
+			// compact the accepted packets to the front of the span
+			if (&pkts[ret] != &p) pkts[ret] = p;
+			++ret;
+		}
 	}
 
 	return ret;
@@ -342,6 +556,20 @@ void udp_socket::send(udp::endpoint const& ep, span<char const> p
 		return;
 	}
 
+#if TORRENT_HAS_MMSG
+	// datagrams with the DF flag set are sent immediately, since the flag is
+	// a socket option
+	if (m_cork_depth > 0 && !(flags & dont_fragment) && queue_packet(ep, p, ec))
+		return;
+
+	// datagrams queued up earlier must go out first, to preserve the order
+	if (m_send_queue && !m_send_queue->empty())
+	{
+		flush(ec);
+		if (ec) return;
+	}
+#endif
+
 	// set the DF flag for the socket and clear it again in the destructor
 	set_dont_frag df(m_socket, (flags & dont_fragment)
 		&& aux::is_v4(ep));
@@ -349,6 +577,186 @@ void udp_socket::send(udp::endpoint const& ep, span<char const> p
 	m_socket.send_to(boost::asio::buffer(p.data(), static_cast<std::size_t>(p.size())), ep, 0, ec);
 }
 
+#if TORRENT_HAS_MMSG
+bool udp_socket::queue_packet(udp::endpoint const& ep, span<char const> p
+	, error_code& ec)
+{
+	if (p.size() > max_datagram_size) return false;
+
+	TORRENT_ASSERT(m_send_queue);
+	send_queue& q = *m_send_queue;
+	if (q.full())
+	{
+		// if the queue can't be drained, report the send buffer as full
+		flush(ec);
+		if (ec) return true;
+	}
+
+	auto const idx = std::size_t(q.end);
+	std::memcpy(q.buffers[idx].data(), p.data(), std::size_t(p.size()));
+	q.targets[idx] = ep;
+	q.sizes[idx] = int(p.size());
+	++q.end;
+	ec.clear();
+	return true;
+}
+#endif
+
+void udp_socket::cork()
+{
+	TORRENT_ASSERT(is_single_thread());
+#if TORRENT_HAS_MMSG
+	if (!m_send_queue) m_send_queue.reset(new send_queue);
+	TORRENT_ASSERT(m_cork_depth < 0xff);
+	++m_cork_depth;
+#endif
+}
+
+void udp_socket::uncork(error_code& ec)
+{
+	TORRENT_ASSERT(is_single_thread());
+	ec.clear();
+#if TORRENT_HAS_MMSG
+	// the socket may have been closed while corked
+	if (m_cork_depth == 0) return;
+	if (--m_cork_depth > 0) return;
+	flush(ec);
+#endif
+}
+
+void udp_socket::flush(error_code& ec)
+{
+	TORRENT_ASSERT(is_single_thread());
+	ec.clear();
+
+#if TORRENT_HAS_MMSG
+	if (!m_send_queue) return;
+	send_queue& q = *m_send_queue;
+
+	// the datagrams that failed to be sent. They're reported once we're done
+	// with the queue, since the handler may send more datagrams
+	struct send_failure
+	{
+		udp::endpoint target;
+		int size;
+		error_code error;
+	};
+	std::array<send_failure, max_batch_size> failed;
+	int num_failed = 0;
+
+	// datagrams before this index are sent individually, because the GSO
+	// message they were part of failed
+	int split_end = q.first;
+
+	while (!q.empty())
+	{
+		std::array<::mmsghdr, max_batch_size> msgs;
+		std::array<::iovec, max_batch_size> iov;
+		// the number of queued datagrams sent by each message
+		std::array<int, max_batch_size> counts;
+#if TORRENT_USE_UDP_OFFLOAD
+		std::array<control_buffer, max_batch_size> control;
+#endif
+		int num_msgs = 0;
+		for (int i = q.first; i < q.end;)
+		{
+#if TORRENT_USE_UDP_OFFLOAD
+			int const n = (m_gso && i >= split_end) ? q.gso_run(i) : 1;
+#else
+			int const n = 1;
+#endif
+			for (int k = 0; k < n; ++k)
+			{
+				auto const idx = std::size_t(i + k);
+				iov[idx - std::size_t(q.first)].iov_base = q.buffers[idx].data();
+				iov[idx - std::size_t(q.first)].iov_len = std::size_t(q.sizes[idx]);
+			}
+
+			::msghdr& h = msgs[std::size_t(num_msgs)].msg_hdr;
+			h = ::msghdr{};
+			h.msg_name = q.targets[std::size_t(i)].data();
+			h.msg_namelen = static_cast<socklen_t>(q.targets[std::size_t(i)].size());
+			h.msg_iov = &iov[std::size_t(i - q.first)];
+			h.msg_iovlen = std::size_t(n);
+
+#if TORRENT_USE_UDP_OFFLOAD
+			if (n > 1)
+			{
+				// let the kernel (or NIC) split the buffer back up into
+				// datagrams of the first one's size
+				auto& c = control[std::size_t(num_msgs)];
+				h.msg_control = c.buf;
+				h.msg_controllen = CMSG_SPACE(sizeof(std::uint16_t));
+				::cmsghdr* cm = CMSG_FIRSTHDR(&h);
+				cm->cmsg_level = SOL_UDP;
+				cm->cmsg_type = UDP_SEGMENT;
+				cm->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+				auto const seg = static_cast<std::uint16_t>(q.sizes[std::size_t(i)]);
+				std::memcpy(CMSG_DATA(cm), &seg, sizeof(seg));
+			}
+#endif
+			counts[std::size_t(num_msgs)] = n;
+			++num_msgs;
+			i += n;
+		}
+
+		int const ret = ::sendmmsg(m_socket.native_handle(), msgs.data()
+			, static_cast<unsigned int>(num_msgs), 0);
+		if (ret >= 0)
+		{
+			for (int i = 0; i < ret; ++i)
+				q.first += counts[std::size_t(i)];
+			continue;
+		}
+
+		error_code const err(errno, system_category());
+		if (err == error::interrupted) continue;
+
+		if (err == error::would_block || err == error::try_again)
+		{
+			// keep the remaining datagrams, the caller is expected to call
+			// flush() again once the socket is writable
+			ec = err;
+			break;
+		}
+
+		if (err == error::bad_descriptor)
+		{
+			q.clear();
+			ec = err;
+			break;
+		}
+
+#if TORRENT_USE_UDP_OFFLOAD
+		if (counts[0] > 1)
+		{
+			// EIO means the device doesn't support segmentation offload (and
+			// the kernel won't do it in software). Stop coalescing datagrams
+			if (err == error_code(EIO, system_category())) m_gso = false;
+
+			// the error may only apply to some of the datagrams in the run.
+			// Send them one at a time to find out which
+			split_end = q.first + counts[0];
+			continue;
+		}
+#endif
+
+		// the first datagram could not be sent, for instance because its
+		// destination is unreachable or it's too large. Report it and carry
+		// on with the rest
+		auto const idx = std::size_t(q.first);
+		failed[std::size_t(num_failed)] = {q.targets[idx], q.sizes[idx], err};
+		++num_failed;
+		++q.first;
+	}
+	if (q.empty()) q.clear();
+
+	if (!m_send_error) return;
+	for (auto const& f : span<send_failure const>(failed).first(num_failed))
+		m_send_error(f.target, f.size, f.error);
+#endif
+}
+
 void udp_socket::wrap(udp::endpoint const& ep, span<char const> p
 	, error_code& ec, udp_send_flags_t const flags)
 {
@@ -461,6 +869,10 @@ void udp_socket::close()
 	error_code ec;
 	m_socket.close(ec);
 	TORRENT_ASSERT_VAL(!ec || ec == error::bad_descriptor, ec);
+#if TORRENT_HAS_MMSG
+	if (m_send_queue) m_send_queue->clear();
+#endif
+	m_cork_depth = 0;
 	if (m_socks5_connection)
 	{
 		m_socks5_connection->close();
@@ -480,6 +892,18 @@ void udp_socket::open(udp const& protocol, error_code& ec)
 
 	m_socket.open(protocol, ec);
 	if (ec) return;
+
+	m_gro = false;
+#if TORRENT_USE_UDP_OFFLOAD
+	// UDP_SEGMENT was introduced in Linux 4.18. If we can query it, we can
+	// use it
+	{
+		int seg = 0;
+		socklen_t len = sizeof(seg);
+		m_gso = ::getsockopt(m_socket.native_handle(), SOL_UDP, UDP_SEGMENT
+			, &seg, &len) == 0;
+	}
+#endif
 	if (protocol == udp::v6())
 	{
 		error_code err;
@@ -498,6 +922,25 @@ void udp_socket::open(udp const& protocol, error_code& ec)
 #endif
 }
 
+void udp_socket::set_gro(bool const enable, error_code& ec)
+{
+	TORRENT_ASSERT(is_single_thread());
+	ec.clear();
+#if TORRENT_USE_UDP_OFFLOAD
+	int const val = enable ? 1 : 0;
+	if (::setsockopt(m_socket.native_handle(), SOL_UDP, UDP_GRO
+		, &val, sizeof(val)) != 0)
+	{
+		ec.assign(errno, system_category());
+		return;
+	}
+	// the receive buffers are resized before the next system call
+	m_gro = enable;
+#else
+	if (enable) ec = boost::asio::error::operation_not_supported;
+#endif
+}
+
 void udp_socket::bind(udp::endpoint const& ep, error_code& ec)
 {
 	if (!m_socket.is_open()) open(ep.protocol(), ec);
@@ -1069,5 +1512,7 @@ constexpr udp_send_flags_t udp_socket::peer_connection;
 constexpr udp_send_flags_t udp_socket::tracker_connection;
 constexpr udp_send_flags_t udp_socket::dont_queue;
 constexpr udp_send_flags_t udp_socket::dont_fragment;
+constexpr int udp_socket::max_batch_size;
+constexpr int udp_socket::max_datagram_size;
 
 }
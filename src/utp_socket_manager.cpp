@@ -52,12 +52,14 @@ namespace aux {
 
 	utp_socket_manager::utp_socket_manager(
 		send_fun_t send_fun
+		, cork_fun_t cork_fun
 		, incoming_utp_callback_t cb
 		, io_context& ios
 		, aux::session_settings const& sett
 		, counters& cnt
 		, void* ssl_context)
 		: m_send_fun(std::move(send_fun))
+		, m_cork_fun(std::move(cork_fun))
 		, m_cb(std::move(cb))
 		, m_sett(sett)
 		, m_counters(cnt)
@@ -252,6 +254,22 @@ namespace aux {
 		}
 	}
 
+	void utp_socket_manager::send_failed(std::weak_ptr<utp_socket_interface> const& sock
+		, udp::endpoint const& ep, int const size, error_code const& ec)
+	{
+		auto const s = sock.lock();
+		m_temp_sockets.clear();
+		for (auto const& e : m_utp_sockets)
+		{
+			utp_socket_impl* impl = e.second.get();
+			if (impl->remote_endpoint() != ep) continue;
+			if (impl->m_sock.lock() != s) continue;
+			m_temp_sockets.push_back(impl);
+		}
+		for (auto const& impl : m_temp_sockets)
+			impl->send_failed(size, ec);
+	}
+
 	void utp_socket_manager::socket_drained()
 	{
 		if (m_deferred_ack)
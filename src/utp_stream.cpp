@@ -723,8 +723,12 @@ void utp_socket_impl::issue_write()
 
 	// try to write. send_pkt returns false if there's
 	// no more payload to send or if the congestion window
-	// is full and we can't send more packets right now
+	// is full and we can't send more packets right now.
+	// The packets are batched up (and coalesced into GSO sends,
+	// where supported) by corking the UDP socket
+	m_sm.cork(m_sock);
 	while (send_pkt());
+	m_sm.uncork(m_sock);
 
 	maybe_trigger_send_callback({});
 }
@@ -746,7 +750,9 @@ std::size_t utp_socket_impl::write_some(bool const clear_buffers)
 	m_written = 0;
 
 	// try to write if the congestion window allows it
+	m_sm.cork(m_sock);
 	while (send_pkt());
+	m_sm.uncork(m_sock);
 
 	if (clear_buffers)
 	{
@@ -1053,6 +1059,38 @@ void utp_socket_impl::send_syn()
 }
 
 // if a send ever failed with EWOULDBLOCK, we
+void utp_socket_impl::send_failed(int const size, error_code const& ec)
+{
+	INVARIANT_CHECK;
+
+	if (state() == state_t::error_wait || state() == state_t::deleting) return;
+
+#if TORRENT_UTP_LOG
+	UTP_LOGV("%8p: failed to send queued packet: size:%d error:%s\n"
+		, static_cast<void*>(this), size, ec.message().c_str());
+#endif
+
+	if (ec == error::message_size)
+	{
+		// MTU probes are never queued, so this packet was sized by the
+		// current MTU. Make sure we don't send packets this large again. The
+		// packet itself is recovered like any other lost packet
+		int const ceiling = std::max(size - 1
+			, TORRENT_INET_MIN_MTU - TORRENT_IPV4_HEADER - TORRENT_UDP_HEADER);
+		if (ceiling >= m_mtu_ceiling) return;
+		m_mtu_ceiling = std::uint16_t(ceiling);
+		if (m_mtu_floor > m_mtu_ceiling) m_mtu_floor = m_mtu_ceiling;
+		update_mtu_limits();
+		return;
+	}
+
+	// any other error (e.g. the destination being unreachable) is fatal, just
+	// like when send_packet() fails directly in send_pkt()
+	m_error = ec;
+	set_state(state_t::error_wait);
+	test_socket_state();
+}
+
 // subscribe to the udp socket and will be
 // signalled with this function.
 void utp_socket_impl::writable()
@@ -1068,7 +1106,11 @@ void utp_socket_impl::writable()
 	// if the socket stalled while sending an ack then there will be a
 	// pending deferred ack. make sure it gets sent out
 	else if (!m_deferred_ack || send_pkt(pkt_ack))
+	{
+		m_sm.cork(m_sock);
 		while(send_pkt());
+		m_sm.uncork(m_sock);
+	}
 
 	// try to flush the last part of the send buffer before sending a FIN
 	if (m_out_eof && m_nagle_packet) send_pkt();
@@ -295,6 +295,73 @@ TORRENT_TEST(get_all_empty)
 	TEST_CHECK(alerts.empty());
 }
 
+TORRENT_TEST(get_all_callback)
+{
+	aux::alert_manager mgr(100, alert_category::all);
+
+	for (int i = 0; i < 5; ++i)
+		mgr.emplace_alert<piece_finished_alert>(torrent_handle(), piece_index_t(i));
+
+	std::vector<alert*> alerts;
+	mgr.get_all([&](alert* a) { alerts.push_back(a); });
+
+	TEST_EQUAL(alerts.size(), 5);
+	for (int i = 0; i < int(alerts.size()); ++i)
+	{
+		auto const* pf = alert_cast<piece_finished_alert>(alerts[std::size_t(i)]);
+		TEST_CHECK(pf != nullptr);
+		if (pf == nullptr) continue;
+		TEST_EQUAL(pf->piece_index, piece_index_t(i));
+	}
+	TEST_CHECK(!mgr.pending());
+
+	int calls = 0;
+	mgr.get_all([&](alert*) { ++calls; });
+	TEST_EQUAL(calls, 0);
+}
+
+// alerts posted from multiple threads are all delivered, and alerts posted by
+// any one thread are delivered in the order they were posted
+TORRENT_TEST(multi_thread_post)
+{
+	int const num_threads = 6;
+	int const per_thread = 1000;
+	aux::alert_manager mgr(num_threads * per_thread, alert_category::all);
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < num_threads; ++t)
+	{
+		threads.emplace_back([&mgr, t] {
+			for (int i = 0; i < per_thread; ++i)
+				mgr.emplace_alert<piece_finished_alert>(torrent_handle()
+					, piece_index_t(t * per_thread + i));
+		});
+	}
+
+	std::vector<int> last(num_threads, -1);
+	int received = 0;
+	auto const check = [&](alert* a) {
+		auto const* pf = alert_cast<piece_finished_alert>(a);
+		TEST_CHECK(pf != nullptr);
+		if (pf == nullptr) return;
+		int const idx = static_cast<int>(pf->piece_index);
+		int const t = idx / per_thread;
+		TEST_CHECK(idx % per_thread > last[std::size_t(t)]);
+		last[std::size_t(t)] = idx % per_thread;
+		++received;
+	};
+
+	while (received < num_threads * per_thread / 2)
+		mgr.get_all(check);
+
+	for (auto& t : threads) t.join();
+	mgr.get_all(check);
+
+	TEST_EQUAL(received, num_threads * per_thread);
+	for (int const l : last)
+		TEST_EQUAL(l, per_thread - 1);
+}
+
 TORRENT_TEST(dropped_alerts)
 {
 	aux::alert_manager mgr(1, alert_category::all);
@@ -74,7 +74,7 @@ struct peer_connection: aux::bandwidth_socket, std::enable_shared_from_this<peer
 		, m_quota(0)
 	{}
 
-	bool is_disconnecting() const override { return false; }
+	bool is_disconnecting() const override { return m_disconnecting; }
 	void assign_bandwidth(int channel, int amount) override;
 
 	void throttle(int limit) { m_bandwidth_channel.throttle(limit); }
@@ -90,6 +90,8 @@ struct peer_connection: aux::bandwidth_socket, std::enable_shared_from_this<peer
 	bool m_ignore_limits;
 	std::string m_name;
 	std::int64_t m_quota;
+	int m_request_size = 400000000;
+	bool m_disconnecting = false;
 };
 
 void peer_connection::assign_bandwidth(int /*channel*/, int amount)
@@ -99,6 +101,11 @@ void peer_connection::assign_bandwidth(int /*channel*/, int amount)
 	std::cout << " [" << m_name
 		<< "] assign bandwidth, " << amount << std::endl;
 #endif
+	if (m_disconnecting)
+	{
+		TEST_EQUAL(amount, 0);
+		return;
+	}
 	TEST_CHECK(amount > 0);
 	start();
 }
@@ -111,7 +118,7 @@ void peer_connection::start()
 		, &global_bwc
 	};
 
-	m_bwm.request_bandwidth(shared_from_this(), 400000000, m_priority, channels, 3);
+	m_bwm.request_bandwidth(shared_from_this(), m_request_size, m_priority, channels, 3);
 }
 
 
@@ -152,15 +159,19 @@ static void nop() {}
 
 void run_test(connections_t& v
 	, aux::bandwidth_manager& manager
-	, std::function<void()> f = &nop)
+	, std::function<void()> f = &nop
+	, int tick_interval = 0)
 {
 	std::cout << "-------------" << std::endl;
 
 	std::for_each(v.begin(), v.end()
 		, std::bind(&peer_connection::start, _1));
 
-	lt::aux::session_settings s;
-	int tick_interval = s.get_int(settings_pack::tick_interval);
+	if (tick_interval == 0)
+	{
+		lt::aux::session_settings s;
+		tick_interval = s.get_int(settings_pack::tick_interval);
+	}
 
 	for (int i = 0; i < int(sample_time * 1000 / tick_interval); ++i)
 	{
@@ -458,6 +469,120 @@ void test_no_starvation(int limit)
 	TEST_CHECK(close_to(p->m_quota / sample_time, float(limit) / 200 / num_peers, 5));
 }
 
+// requests small enough to be satisfied within a round or two are dispatched
+// as soon as their channels have handed out what they asked for, rather than
+// when their ttl runs out
+void test_small_requests(int num, int limit, int request_size, int tick_interval)
+{
+	std::cout << "\ntest small requests " << num
+		<< " l: " << limit
+		<< " r: " << request_size
+		<< " t: " << tick_interval << std::endl;
+	aux::bandwidth_manager manager(0);
+	global_bwc = aux::bandwidth_channel();
+	global_bwc.throttle(limit);
+
+	aux::bandwidth_channel t1;
+
+	connections_t v;
+	spawn_connections(v, manager, t1, num, "p");
+	for (auto& p : v) p->m_request_size = request_size;
+	run_test(v, manager, &nop, tick_interval);
+
+	float sum = 0.f;
+	float const err = std::max(limit / num * 0.1f, 100.f);
+	for (auto const& p : v)
+	{
+		sum += p->m_quota;
+		std::cout << p->m_quota / sample_time
+			<< " target: " << (limit / num) << " eps: " << err << std::endl;
+		TEST_CHECK(close_to(p->m_quota / sample_time, float(limit) / num, err));
+	}
+	sum /= sample_time;
+	std::cout << "sum: " << sum << " target: " << limit << std::endl;
+	TEST_CHECK(close_to(sum, float(limit), limit * 0.05f));
+}
+
+void test_disconnect(int limit)
+{
+	std::cout << "\ntest disconnect " << limit << std::endl;
+	aux::bandwidth_manager manager(0);
+	global_bwc = aux::bandwidth_channel();
+	global_bwc.throttle(limit);
+
+	aux::bandwidth_channel t1;
+
+	connections_t v;
+	spawn_connections(v, manager, t1, 2, "p");
+	run_test(v, manager);
+	TEST_EQUAL(manager.queue_size(), 2);
+
+	// a peer that disconnects while waiting for bandwidth is dispatched
+	// without any, and what it had been handed is returned to its channels
+	v[0]->m_disconnecting = true;
+	std::int64_t const quota0 = v[0]->m_quota;
+	std::int64_t const quota1 = v[1]->m_quota;
+	for (int i = 0; i < int(sample_time * 1000 / 500); ++i)
+		manager.update_quotas(milliseconds(500));
+
+	TEST_EQUAL(manager.queue_size(), 1);
+	TEST_EQUAL(v[0]->m_quota, quota0);
+
+	float const rate = (v[1]->m_quota - quota1) / sample_time;
+	std::cout << rate << " target: " << limit << std::endl;
+	TEST_CHECK(close_to(rate, float(limit), limit * 0.2f));
+
+	// closing the manager dispatches everything still queued
+	v[1]->m_disconnecting = true;
+	manager.close();
+	TEST_EQUAL(manager.queue_size(), 0);
+	TEST_EQUAL(manager.queued_bytes(), 0);
+}
+
+void test_cancel(int limit)
+{
+	std::cout << "\ntest cancel " << limit << std::endl;
+	aux::bandwidth_manager manager(0);
+	global_bwc = aux::bandwidth_channel();
+	global_bwc.throttle(limit);
+
+	aux::bandwidth_channel t1;
+
+	connections_t v;
+	spawn_connections(v, manager, t1, 2, "p");
+	for (auto& c : v) c->m_request_size = limit;
+	run_test(v, manager);
+	TEST_EQUAL(manager.queue_size(), 2);
+
+	// a peer that cancels its request when it disconnects leaves the queue
+	// immediately, and the remaining peer gets the full rate from the next
+	// round on, rather than once the cancelled request expires
+	v[0]->m_disconnecting = true;
+	std::int64_t const quota0 = v[0]->m_quota;
+	std::int64_t const quota1 = v[1]->m_quota;
+	manager.cancel_request(v[0].get());
+	TEST_EQUAL(manager.queue_size(), 1);
+	TEST_EQUAL(manager.queued_bytes(), v[1]->m_request_size);
+	TEST_EQUAL(v[0].use_count(), 1);
+
+	// cancelling a peer that isn't queued is a no-op
+	manager.cancel_request(v[0].get());
+	TEST_EQUAL(manager.queue_size(), 1);
+
+	int const rounds = 16;
+	for (int i = 0; i < rounds; ++i)
+		manager.update_quotas(milliseconds(500));
+
+	TEST_EQUAL(v[0]->m_quota, quota0);
+	float const rate = (v[1]->m_quota - quota1) / (rounds * 0.5f);
+	std::cout << rate << " target: " << limit << std::endl;
+	TEST_CHECK(close_to(rate, float(limit), limit * 0.2f));
+
+	v[1]->m_disconnecting = true;
+	manager.close();
+	TEST_EQUAL(manager.queue_size(), 0);
+}
+
 } // anonymous namespace
 
 TORRENT_TEST(equal_connection)
@@ -517,3 +642,22 @@ TORRENT_TEST(no_starvation)
 {
 	test_no_starvation(40000);
 }
+
+TORRENT_TEST(small_requests)
+{
+	test_small_requests( 1,  40000, 30000, 500);
+	test_small_requests( 5,  40000,  6000, 500);
+	test_small_requests(10,  40000,  1000,  50);
+	test_small_requests(33, 500000,  3000, 100);
+	test_small_requests(20,  40000, 16384,  20);
+}
+
+TORRENT_TEST(disconnect)
+{
+	test_disconnect(40000);
+}
+
+TORRENT_TEST(cancel)
+{
+	test_cancel(40000);
+}
@@ -0,0 +1,201 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "test.hpp"
+#include "libtorrent/aux_/bdp_estimator.hpp"
+
+#include <deque>
+#include <algorithm>
+
+using namespace lt;
+
+namespace {
+
+	int const block_size = 0x4000;
+
+	struct request
+	{
+		time_point sent;
+		time_point received;
+		std::int64_t delivered_at_send;
+	};
+
+	// simulates downloading from a peer that serves requests one at a time,
+	// at ``rate`` bytes per second, over a link with a round trip time of
+	// ``rtt``. The request queue is sized from the estimator, the same way
+	// the peer_connection does. Returns the queue size at the end
+	int simulate(aux::bdp_estimator& est, time_point const start
+		, time_duration const duration, std::int64_t const rate, time_duration const rtt)
+	{
+		time_duration const service = microseconds(std::int64_t(block_size) * 1000000 / rate);
+		std::deque<request> queue;
+		time_point peer_free = start;
+		std::int64_t delivered = 0;
+		int desired = 2;
+		time_point now = start;
+
+		while (now < start + duration)
+		{
+			while (int(queue.size()) < desired)
+			{
+				time_point const served = std::max(now + rtt / 2, peer_free) + service;
+				peer_free = served;
+				queue.push_back({now, served + rtt / 2, delivered});
+			}
+
+			request const r = queue.front();
+			queue.pop_front();
+			now = r.received;
+			delivered += block_size;
+			est.on_block(now, now - r.sent, delivered - r.delivered_at_send);
+
+			std::int64_t const target = est.target_outstanding();
+			if (target > 0)
+				desired = std::max(2, int((target + block_size - 1) / block_size));
+		}
+		return desired;
+	}
+}
+
+TORRENT_TEST(no_estimate)
+{
+	aux::bdp_estimator est;
+	TEST_CHECK(!est.has_estimate());
+	TEST_EQUAL(est.target_outstanding(), 0);
+	TEST_EQUAL(est.bandwidth(), 0);
+}
+
+TORRENT_TEST(converge)
+{
+	// 2 MB/s and 100 ms makes the pipe 200 kB, or about 12 blocks. The
+	// queue is twice that
+	aux::bdp_estimator est;
+	int const queue = simulate(est, clock_type::now(), seconds(2)
+		, 2000000, milliseconds(100));
+
+	TEST_CHECK(est.has_estimate());
+	TEST_CHECK(est.bandwidth() > 2000000 * 9 / 10);
+	TEST_CHECK(est.bandwidth() <= 2000000 * 11 / 10);
+	TEST_CHECK(est.min_rtt() >= milliseconds(100));
+	TEST_CHECK(est.min_rtt() < milliseconds(120));
+	TEST_CHECK(queue >= 22);
+	TEST_CHECK(queue <= 28);
+}
+
+TORRENT_TEST(converge_high_bdp)
+{
+	// a fast, far away, peer. 10 MB/s at 500 ms is a 5 MB pipe. It should
+	// still only take a few round trips to fill
+	aux::bdp_estimator est;
+	int const queue = simulate(est, clock_type::now(), seconds(6)
+		, 10000000, milliseconds(500));
+
+	TEST_CHECK(est.bandwidth() > 10000000 * 9 / 10);
+	TEST_CHECK(queue >= 2 * 5000000 / block_size * 9 / 10);
+}
+
+TORRENT_TEST(bandwidth_window)
+{
+	aux::bdp_estimator est;
+	time_point const start = clock_type::now();
+
+	est.on_block(start, milliseconds(100), 1000000);
+	TEST_EQUAL(est.bandwidth(), 10000000);
+
+	// lower samples don't replace the max while it's within the window
+	// (10 round trips, but at least a second)
+	time_point now = start;
+	for (int i = 0; i < 9; ++i)
+	{
+		now += milliseconds(100);
+		est.on_block(now, milliseconds(100), 500000);
+	}
+	TEST_EQUAL(est.bandwidth(), 10000000);
+
+	// but once the max is older than the window, it's forgotten
+	for (int i = 0; i < 5; ++i)
+	{
+		now += milliseconds(100);
+		est.on_block(now, milliseconds(100), 500000);
+	}
+	TEST_EQUAL(est.bandwidth(), 5000000);
+}
+
+TORRENT_TEST(min_rtt)
+{
+	aux::bdp_estimator est;
+	time_point const start = clock_type::now();
+
+	est.on_block(start, milliseconds(100), 100000);
+	est.on_block(start + milliseconds(10), milliseconds(50), 50000);
+	est.on_block(start + milliseconds(20), milliseconds(80), 80000);
+	TEST_CHECK(est.min_rtt() == milliseconds(50));
+	TEST_CHECK(!est.probing_rtt());
+
+	// 1 MB/s * 50 ms, times two
+	TEST_EQUAL(est.target_outstanding(), 100000);
+}
+
+TORRENT_TEST(probe_rtt)
+{
+	aux::bdp_estimator est;
+	time_point const start = clock_type::now();
+
+	est.on_block(start, milliseconds(50), 50000);
+
+	// our own requests are queued at the peer, inflating the round trip time
+	time_point now = start;
+	for (int i = 0; i < 110; ++i)
+	{
+		now += milliseconds(100);
+		est.on_block(now, milliseconds(150), 150000);
+		if (est.probing_rtt()) break;
+	}
+
+	// the minimum has not been seen in 10 seconds. The estimator drains the
+	// queue down to the pipe size, to measure it again
+	TEST_CHECK(est.probing_rtt());
+	TEST_CHECK(now - start > seconds(10));
+	TEST_EQUAL(est.target_outstanding(), 1000000 * 50 / 1000);
+
+	// the path got longer since the last time, and the minimum is updated
+	// to reflect that once the probe completes
+	for (int i = 0; i < 4; ++i)
+	{
+		now += milliseconds(100);
+		est.on_block(now, milliseconds(70), 70000);
+	}
+	TEST_CHECK(!est.probing_rtt());
+	TEST_CHECK(est.min_rtt() == milliseconds(70));
+	TEST_EQUAL(est.target_outstanding(), 2 * 1000000 * 70 / 1000);
+}
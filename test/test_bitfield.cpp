@@ -36,7 +36,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "test.hpp"
 #include "libtorrent/bitfield.hpp"
 #include "libtorrent/aux_/cpuid.hpp"
+#include "libtorrent/units.hpp"
 #include <cstdlib>
+#include <vector>
 
 using namespace lt;
 
@@ -429,3 +431,86 @@ TORRENT_TEST(bitfield_index_range)
 	TEST_EQUAL(sum, 15 * 16 / 2);
 }
 
+
+namespace {
+
+bitfield random_bitfield(int const bits, int const one_in)
+{
+	bitfield ret(bits, false);
+	for (int i = 0; i < bits; ++i)
+		if (std::rand() % one_in == 0) ret.set_bit(i);
+	return ret;
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(count_kernels)
+{
+	// the sizes cover partial words, partial vectors and enough words for
+	// the vectorized counters to have to fold their accumulators
+	for (int const bits : {0, 1, 31, 33, 255, 257, 1000, 8 * 32 * 40 + 17, 200000})
+	{
+		for (int const one_in : {1, 2, 7, 1000})
+		{
+			bitfield const a = random_bitfield(bits, one_in);
+			bitfield const b = random_bitfield(bits, 3);
+
+			int num = 0;
+			int num_and = 0;
+			int num_and_not = 0;
+			for (int i = 0; i < bits; ++i)
+			{
+				num += a.get_bit(i);
+				num_and += a.get_bit(i) && b.get_bit(i);
+				num_and_not += a.get_bit(i) && !b.get_bit(i);
+			}
+			TEST_EQUAL(a.count(), num);
+			TEST_EQUAL(a.count_and(b), num_and);
+			TEST_EQUAL(a.count_and_not(b), num_and_not);
+			TEST_EQUAL(a.intersects(b), num_and > 0);
+		}
+	}
+}
+
+TORRENT_TEST(intersects_different_size)
+{
+	bitfield a(40, false);
+	bitfield b(35, false);
+	a.set_bit(37);
+	b.set_bit(2);
+	TEST_CHECK(!a.intersects(b));
+	TEST_CHECK(!b.intersects(a));
+	a.set_bit(2);
+	TEST_CHECK(a.intersects(b));
+	TEST_CHECK(b.intersects(a));
+}
+
+TORRENT_TEST(for_each_set_bit)
+{
+	for (int const bits : {0, 1, 32, 100, 1000, 100000})
+	{
+		for (int const one_in : {1, 3, 5000})
+		{
+			bitfield const a = random_bitfield(bits, one_in);
+			std::vector<int> expected;
+			for (int i = 0; i < bits; ++i)
+				if (a.get_bit(i)) expected.push_back(i);
+
+			std::vector<int> found;
+			a.for_each_set_bit([&](int const i) { found.push_back(i); });
+			TEST_CHECK(found == expected);
+		}
+	}
+}
+
+TORRENT_TEST(for_each_set_bit_typed)
+{
+	typed_bitfield<piece_index_t> a(300, false);
+	a.set_bit(piece_index_t(0));
+	a.set_bit(piece_index_t(31));
+	a.set_bit(piece_index_t(299));
+	std::vector<piece_index_t> found;
+	a.for_each_set_bit([&](piece_index_t const i) { found.push_back(i); });
+	TEST_CHECK((found == std::vector<piece_index_t>{
+		piece_index_t(0), piece_index_t(31), piece_index_t(299)}));
+}
@@ -38,10 +38,16 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/aux_/buffer.hpp"
 #include "libtorrent/aux_/chained_buffer.hpp"
+#include "libtorrent/aux_/msg_zerocopy.hpp"
 #include "libtorrent/socket.hpp"
 
 #include "test.hpp"
 
+#if TORRENT_USE_MSG_ZEROCOPY
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
 using namespace lt;
 using lt::aux::buffer;
 using lt::aux::chained_buffer;
@@ -309,3 +315,167 @@ TORRENT_TEST(chained_buffer)
 	}
 	TEST_CHECK(buffer_list.empty());
 }
+
+TORRENT_TEST(chained_buffer_retain)
+{
+	char data_test[] = "foobar";
+	{
+		chained_buffer b;
+
+		for (int i = 0; i < 3; ++i)
+		{
+			char* buf = allocate_buffer(6);
+			std::memcpy(buf, data_test, 6);
+			b.append_buffer(holder(buf, 6), 6);
+		}
+		TEST_EQUAL(buffer_list.size(), 3);
+
+		// the first buffer is sent completely, and the second partially
+		b.retain_front(9, 0);
+		TEST_EQUAL(b.size(), 9);
+		TEST_CHECK(b.has_retained());
+		TEST_EQUAL(buffer_list.size(), 3);
+		TEST_CHECK(compare_chained_buffer(b, "barfoobar", 9));
+
+		b.retain_front(3, 1);
+		TEST_EQUAL(b.size(), 6);
+		TEST_EQUAL(buffer_list.size(), 3);
+
+		// send 0 is complete, but 1 is not
+		b.release_retained(1);
+		TEST_EQUAL(buffer_list.size(), 2);
+		TEST_CHECK(b.has_retained());
+
+		b.release_retained(2);
+		TEST_EQUAL(buffer_list.size(), 1);
+		TEST_CHECK(!b.has_retained());
+
+		// tags wrap around
+		b.retain_front(6, 0xffffffff);
+		TEST_EQUAL(buffer_list.size(), 1);
+		b.release_retained(0xffffffff);
+		TEST_EQUAL(buffer_list.size(), 1);
+		b.release_retained(0);
+		TEST_CHECK(buffer_list.empty());
+		TEST_CHECK(b.empty());
+
+		// retained buffers are freed along with the chained_buffer
+		char* buf = allocate_buffer(6);
+		b.append_buffer(holder(buf, 6), 6);
+		b.retain_front(6, 1);
+		TEST_EQUAL(buffer_list.size(), 1);
+	}
+	TEST_CHECK(buffer_list.empty());
+}
+
+TORRENT_TEST(chained_buffer_take_retained)
+{
+	char data_test[] = "foobar";
+	{
+		chained_buffer a;
+		chained_buffer b;
+
+		for (int i = 0; i < 3; ++i)
+		{
+			char* buf = allocate_buffer(6);
+			std::memcpy(buf, data_test, 6);
+			b.append_buffer(holder(buf, 6), 6);
+		}
+		b.retain_front(6, 0);
+		b.retain_front(6, 1);
+
+		a.take_retained(b);
+		TEST_CHECK(a.has_retained());
+		TEST_CHECK(a.empty());
+		TEST_CHECK(!b.has_retained());
+		TEST_EQUAL(b.size(), 6);
+		TEST_EQUAL(buffer_list.size(), 3);
+
+		// the tags are kept
+		a.release_retained(1);
+		TEST_EQUAL(buffer_list.size(), 2);
+
+		// the buffers that weren't retained stay behind
+		b.clear();
+		TEST_EQUAL(buffer_list.size(), 1);
+		TEST_CHECK(a.has_retained());
+	}
+	TEST_CHECK(buffer_list.empty());
+}
+
+#if TORRENT_USE_MSG_ZEROCOPY
+TORRENT_TEST(zerocopy_tracker)
+{
+	lt::aux::zerocopy_tracker t;
+	TEST_CHECK(!t.outstanding());
+
+	for (int i = 0; i < 6; ++i) t.on_send(true);
+	// failed sends are not numbered
+	t.on_send(false);
+	TEST_CHECK(t.outstanding());
+	TEST_EQUAL(t.last_sent(), 5);
+
+	t.on_completion(0, 1);
+	TEST_EQUAL(t.completed(), 2);
+
+	// out of order completions are held until the gap is filled
+	t.on_completion(4, 4);
+	TEST_EQUAL(t.completed(), 2);
+	t.on_completion(3, 3);
+	TEST_EQUAL(t.completed(), 2);
+	t.on_completion(2, 2);
+	TEST_EQUAL(t.completed(), 5);
+	TEST_CHECK(t.outstanding());
+
+	t.on_completion(5, 5);
+	TEST_EQUAL(t.completed(), 6);
+	TEST_CHECK(!t.outstanding());
+}
+
+TORRENT_TEST(zerocopy_reaper)
+{
+	int fds[2];
+	TEST_EQUAL(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+	{
+		lt::aux::zerocopy_reaper r;
+		chained_buffer b;
+		char* buf = allocate_buffer(6);
+		b.append_buffer(holder(buf, 6), 6);
+
+		// nothing outstanding, the buffers and the socket are released
+		// right away
+		lt::aux::zerocopy_tracker t;
+		b.retain_front(6, t.last_sent());
+		r.add(lt::aux::zerocopy_reaper::keep_open(fds[0]), t, b);
+		TEST_EQUAL(r.num_sockets(), 0);
+		TEST_CHECK(buffer_list.empty());
+
+		// the buffers of outstanding sends are kept until the notification
+		// arrives, which it won't on this socket
+		buf = allocate_buffer(6);
+		b.append_buffer(holder(buf, 6), 6);
+		t.on_send(true);
+		b.retain_front(6, t.last_sent());
+		r.add(lt::aux::zerocopy_reaper::keep_open(fds[0]), t, b);
+		TEST_EQUAL(r.num_sockets(), 1);
+		TEST_CHECK(!b.has_retained());
+		TEST_EQUAL(buffer_list.size(), 1);
+
+		// the socket was shut down, even though fds[0] is still open
+		char c;
+		TEST_EQUAL(::recv(fds[1], &c, 1, 0), 0);
+
+		r.tick(lt::clock_type::now());
+		TEST_EQUAL(r.num_sockets(), 1);
+		TEST_EQUAL(buffer_list.size(), 1);
+
+		r.abort();
+		TEST_EQUAL(r.num_sockets(), 0);
+		TEST_CHECK(buffer_list.empty());
+	}
+
+	::close(fds[0]);
+	::close(fds[1]);
+}
+#endif
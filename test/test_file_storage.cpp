@@ -482,6 +482,162 @@ TORRENT_TEST(map_block_mid)
 	}
 }
 
+namespace {
+
+// the file at the given offset, found the slow way
+file_index_t linear_file_at_offset(file_storage const& fs, std::int64_t const offset)
+{
+	file_index_t ret{0};
+	for (auto const f : fs.file_range())
+	{
+		if (fs.file_offset(f) > offset) break;
+		if (fs.file_size(f) > 0) ret = f;
+	}
+	return ret;
+}
+
+void check_file_lookup(file_storage const& fs)
+{
+	for (std::int64_t offset = 0; offset < fs.total_size(); ++offset)
+		TEST_EQUAL(fs.file_index_at_offset(offset), linear_file_at_offset(fs, offset));
+
+	for (auto const p : fs.piece_range())
+	{
+		TEST_EQUAL(fs.file_index_at_piece(p)
+			, linear_file_at_offset(fs, static_cast<int>(p) * std::int64_t(fs.piece_length())));
+	}
+}
+
+}
+
+TORRENT_TEST(file_index_at_offset_many_files)
+{
+	// many small files (some empty), and a few spanning several pieces
+	file_storage fs;
+	fs.set_piece_length(0x4000);
+	for (int i = 0; i < 300; ++i)
+	{
+		std::int64_t const size = (i % 7 == 0) ? 0
+			: (i % 50 == 1) ? 0x4000 * 3 + i
+			: i * 37;
+		fs.add_file("test/" + std::to_string(i), size);
+	}
+	fs.set_num_pieces(aux::calc_num_pieces(fs));
+	check_file_lookup(fs);
+
+	// copies have the same lookup table
+	file_storage const copy = fs;
+	check_file_lookup(copy);
+
+	// adding a file invalidates the table until the number of pieces is
+	// updated
+	fs.add_file("test/last", 0x5000);
+	TEST_EQUAL(fs.file_index_at_offset(fs.total_size() - 1), file_index_t{300});
+	fs.set_num_pieces(aux::calc_num_pieces(fs));
+	check_file_lookup(fs);
+}
+
+namespace {
+
+std::vector<file_slice> map_block_slices(file_storage const& fs
+	, piece_index_t const p, std::int64_t const offset, std::int64_t const size)
+{
+	std::vector<file_slice> ret;
+	fs.map_block(p, offset, size, [&](file_slice const& f)
+	{
+		ret.push_back(f);
+		return true;
+	});
+	return ret;
+}
+
+void check_slices(std::vector<file_slice> const& slices
+	, std::vector<file_slice> const& expected)
+{
+	TEST_EQUAL(int(slices.size()), int(expected.size()));
+	for (int i = 0; i < int(std::min(slices.size(), expected.size())); ++i)
+	{
+		TEST_EQUAL(slices[std::size_t(i)].file_index, expected[std::size_t(i)].file_index);
+		TEST_EQUAL(slices[std::size_t(i)].offset, expected[std::size_t(i)].offset);
+		TEST_EQUAL(slices[std::size_t(i)].size, expected[std::size_t(i)].size);
+	}
+}
+
+}
+
+TORRENT_TEST(map_block_callback)
+{
+	// piece 0: file 0 and a pad file
+	// piece 1: the 16 small files 2 - 17, an empty file 18 and the start of
+	//          file 19
+	// piece 2: file 19
+	// piece 3: the end of file 19 (3232 bytes) and an empty file 20
+	file_storage fs;
+	fs.set_piece_length(0x4000);
+	fs.add_file("test/a", 0x3000);
+	fs.add_file("test/.pad/4096", 0x1000, file_storage::flag_pad_file);
+	for (int i = 0; i < 16; ++i)
+		fs.add_file("test/small/" + std::to_string(i), 1000);
+	fs.add_file("test/empty1", 0);
+	fs.add_file("test/b", 20000);
+	fs.add_file("test/empty2", 0);
+	fs.set_num_pieces(aux::calc_num_pieces(fs));
+	TEST_EQUAL(fs.num_files(), 21);
+	TEST_EQUAL(fs.num_pieces(), 4);
+	TEST_EQUAL(fs.total_size(), 52384);
+	TEST_EQUAL(fs.piece_size(3_piece), 3232);
+
+	// the file each piece starts in, as recorded by the lookup table
+	TEST_EQUAL(fs.file_index_at_piece(0_piece), file_index_t{0});
+	TEST_EQUAL(fs.file_index_at_piece(1_piece), file_index_t{2});
+	TEST_EQUAL(fs.file_index_at_piece(2_piece), file_index_t{19});
+	TEST_EQUAL(fs.file_index_at_piece(3_piece), file_index_t{19});
+
+	// the end of a file and a pad file
+	check_slices(map_block_slices(fs, 0_piece, 0x2000, 0x2000), {
+		{file_index_t{0}, 0x2000, 0x1000},
+		{file_index_t{1}, 0, 0x1000}});
+
+	// a block within the small files
+	check_slices(map_block_slices(fs, 1_piece, 500, 3000), {
+		{file_index_t{2}, 500, 500},
+		{file_index_t{3}, 0, 1000},
+		{file_index_t{4}, 0, 1000},
+		{file_index_t{5}, 0, 500}});
+
+	// a whole piece spanning all the small files, skipping the empty file
+	std::vector<file_slice> expected;
+	for (int i = 2; i < 18; ++i)
+		expected.push_back({file_index_t{i}, 0, 1000});
+	expected.push_back({file_index_t{19}, 0, 384});
+	check_slices(map_block_slices(fs, 1_piece, 0, 0x4000), expected);
+
+	// a block across the end of the last small file and the empty file
+	check_slices(map_block_slices(fs, 1_piece, 0x3e00, 0x200), {
+		{file_index_t{17}, 872, 128},
+		{file_index_t{19}, 0, 384}});
+
+	// a block in the middle of a file
+	check_slices(map_block_slices(fs, 2_piece, 0x100, 0x1000), {
+		{file_index_t{19}, 640, 0x1000}});
+
+	// the last piece, which is followed by an empty file
+	check_slices(map_block_slices(fs, 3_piece, 0, 3232), {
+		{file_index_t{19}, 16768, 3232}});
+
+	// the vector overload is the same mapping
+	check_slices(fs.map_block(1_piece, 500, 3000), map_block_slices(fs, 1_piece, 500, 3000));
+
+	// returning false stops the mapping
+	int calls = 0;
+	fs.map_block(0_piece, 0, fs.piece_length(), [&](file_slice const&)
+	{
+		++calls;
+		return false;
+	});
+	TEST_EQUAL(calls, 1);
+}
+
 #ifdef TORRENT_WINDOWS
 #define SEP "\\"
 #else
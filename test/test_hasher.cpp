@@ -35,10 +35,15 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/hasher.hpp"
 #include "libtorrent/hex.hpp"
+#include "libtorrent/aux_/hash_many.hpp"
+#include "libtorrent/aux_/cpuid.hpp"
+#include "libtorrent/random.hpp"
 
 #include "test.hpp"
 
 #include <iostream>
+#include <algorithm>
+#include <cctype>
 
 using namespace lt;
 
@@ -144,3 +149,89 @@ TORRENT_TEST(hasher256)
 	}
 }
 
+
+TORRENT_TEST(hash_many)
+{
+	// runs of buffers of the same size are hashed in parallel, make sure to
+	// cover partial runs, sizes around the padding boundaries and more
+	// than one run
+	std::vector<int> sizes = {0, 1, 55, 56, 63, 64, 65, 119, 120, 128, 1000};
+	for (int i = 0; i < 11; ++i) sizes.push_back(0x4000);
+	for (int i = 0; i < 3; ++i) sizes.push_back(64);
+	sizes.push_back(3);
+
+	std::vector<std::vector<char>> buffers;
+	std::vector<span<char const>> in;
+	std::vector<sha256_hash> expected;
+	for (int const s : sizes)
+	{
+		buffers.emplace_back(std::size_t(s));
+		aux::random_bytes(buffers.back());
+	}
+	for (auto const& b : buffers)
+	{
+		in.emplace_back(b);
+		hasher256 h;
+		if (!b.empty()) h.update(b);
+		expected.push_back(h.final());
+	}
+
+	for (auto const impl : {aux::hash_impl::generic, aux::hash_impl::sha_ni, aux::hash_impl::avx2})
+	{
+		if (!aux::hash_impl_supported(impl)) continue;
+		std::vector<sha256_hash> out(in.size());
+		aux::hash_many(impl, in, out);
+		TEST_CHECK(out == expected);
+	}
+
+	std::vector<sha256_hash> out(in.size());
+	aux::hash_many(in, out);
+	TEST_CHECK(out == expected);
+}
+
+#if TORRENT_HAS_SIMD_HASH
+TORRENT_TEST(sha_ni_vectors)
+{
+	if (!aux::sha_ni_support) return;
+
+	// pads the message, as the hasher would do before calling the compression
+	// function
+	auto pad = [](test_vector_t const& t)
+	{
+		std::string msg;
+		for (int i = 0; i < t.repetitions; ++i) msg.append(t.input.data(), t.input.size());
+		std::uint64_t const bits = msg.size() * 8;
+		msg.push_back('\x80');
+		while (msg.size() % 64 != 56) msg.push_back('\0');
+		for (int i = 7; i >= 0; --i) msg.push_back(char(bits >> (i * 8)));
+		return msg;
+	};
+
+	auto digest = [](std::uint32_t const* state, int const words)
+	{
+		std::string ret;
+		for (int i = 0; i < words; ++i)
+			for (int k = 3; k >= 0; --k) ret.push_back(char(state[i] >> (k * 8)));
+		return aux::to_hex(ret);
+	};
+
+	for (auto const& t : sha1_vectors)
+	{
+		std::string const msg = pad(t);
+		std::uint32_t state[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+		aux::sha1_compress_ni(state, reinterpret_cast<std::uint8_t const*>(msg.data()), msg.size() / 64);
+		std::string expected = t.hex_output.to_string();
+		std::transform(expected.begin(), expected.end(), expected.begin(), [](char c) { return char(std::tolower(c)); });
+		TEST_EQUAL(digest(state, 5), expected);
+	}
+
+	for (auto const& t : sha256_vectors)
+	{
+		std::string const msg = pad(t);
+		std::uint32_t state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a
+			, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+		aux::sha256_compress_ni(state, reinterpret_cast<std::uint8_t const*>(msg.data()), msg.size() / 64);
+		TEST_EQUAL(digest(state, 8), t.hex_output);
+	}
+}
+#endif
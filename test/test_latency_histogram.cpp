@@ -0,0 +1,106 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/aux_/latency_histogram.hpp"
+#include "libtorrent/alert_types.hpp"
+#include "test.hpp"
+
+#include <limits>
+#include <vector>
+
+using namespace lt;
+
+TORRENT_TEST(latency_bucket_boundaries)
+{
+	// small values are exact
+	for (int i = 0; i < aux::latency_sub_buckets; ++i)
+	{
+		TEST_EQUAL(aux::latency_bucket(i), i);
+		TEST_EQUAL(aux::latency_bucket_floor(i), i);
+	}
+
+	TEST_EQUAL(aux::latency_bucket(-1), 0);
+
+	// every bucket starts where the previous one ends
+	for (int b = 1; b < aux::latency_buckets; ++b)
+	{
+		std::int64_t const floor = aux::latency_bucket_floor(b);
+		TEST_CHECK(floor > aux::latency_bucket_floor(b - 1));
+		TEST_EQUAL(aux::latency_bucket(floor), b);
+		TEST_EQUAL(aux::latency_bucket(floor - 1), b - 1);
+	}
+
+	// huge values are clamped to the last bucket
+	TEST_EQUAL(aux::latency_bucket(std::int64_t(1) << 50), aux::latency_buckets - 1);
+	TEST_EQUAL(aux::latency_bucket(std::numeric_limits<std::int64_t>::max())
+		, aux::latency_buckets - 1);
+}
+
+TORRENT_TEST(latency_bucket_precision)
+{
+	for (std::int64_t v = 1; v < (std::int64_t(1) << 36); v = v * 3 + 1)
+	{
+		int const b = aux::latency_bucket(v);
+		std::int64_t const floor = aux::latency_bucket_floor(b);
+		TEST_CHECK(floor <= v);
+		// the bucket is at most 1/8 of its lower bound wide
+		TEST_CHECK(v - floor <= floor / aux::latency_sub_buckets);
+	}
+}
+
+TORRENT_TEST(latency_percentile)
+{
+	aux::latency_histogram h;
+	std::vector<std::int64_t> buckets(aux::latency_buckets);
+
+	h.snapshot(buckets);
+	TEST_EQUAL(aux::latency_percentile(buckets, 0.99), 0);
+
+	// 990 fast samples and 10 slow ones
+	for (int i = 0; i < 990; ++i) h.record(5);
+	for (int i = 0; i < 9; ++i) h.record(1000);
+	h.record(100000);
+	h.snapshot(buckets);
+
+	TEST_EQUAL(aux::latency_percentile(buckets, 0.5), 5);
+	TEST_EQUAL(aux::latency_percentile(buckets, 0.99), 5);
+
+	std::int64_t const p999 = aux::latency_percentile(buckets, 0.999);
+	TEST_CHECK(p999 >= 1000);
+	TEST_CHECK(p999 <= 1000 + 1000 / 8);
+
+	std::int64_t const max = disk_latency_alert::percentile(buckets, 1.0);
+	TEST_CHECK(max >= 100000);
+	TEST_CHECK(max <= 100000 + 100000 / 8);
+	TEST_EQUAL(disk_latency_alert::bucket_floor(aux::latency_bucket(1000))
+		, aux::latency_bucket_floor(aux::latency_bucket(1000)));
+}
@@ -35,6 +35,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/merkle.hpp"
 #include "libtorrent/bitfield.hpp"
 #include <iostream>
+#include <string>
 
 using namespace lt;
 
@@ -413,6 +414,81 @@ TORRENT_TEST(merkle_fill_tree)
 	}
 }
 
+TORRENT_TEST(merkle_fill_layers)
+{
+	// fill one layer of two sub-trees
+	{
+		v tree{
+		       o,
+		   o,      o,
+		  o, o,   o, o,
+		a,b,c,d,e,f,g,h};
+
+		merkle_fill_layers(tree, 8, 7, 1);
+
+		TEST_CHECK((tree ==
+		     v{
+		       o,
+		   o,      o,
+		 ab, cd, ef, gh,
+		a,b,c,d,e,f,g,h}));
+	}
+
+	// fill two layers of the right half of the tree
+	{
+		v tree{
+		       o,
+		   o,      o,
+		  o, o,   o, o,
+		o,o,o,o,e,f,g,h};
+
+		merkle_fill_layers(tree, 4, 11, 2);
+
+		TEST_CHECK((tree ==
+		     v{
+		       o,
+		   o,      eh,
+		 o,  o,  ef, gh,
+		o,o,o,o,e,f,g,h}));
+	}
+
+	// zero layers is a no-op
+	{
+		v tree{o, a, b};
+		merkle_fill_layers(tree, 2, 1, 0);
+		TEST_CHECK((tree == v{o, a, b}));
+	}
+}
+
+TORRENT_TEST(merkle_fill_tree_large)
+{
+	// large enough for the levels to be hashed in several batches
+	int const num_leafs = 1024;
+	v tree(std::size_t(merkle_num_nodes(num_leafs)));
+	int const first_leaf = merkle_first_leaf(num_leafs);
+	for (int i = 0; i < num_leafs; ++i)
+		tree[std::size_t(first_leaf + i)] = H(a, sha256_hash(std::to_string(i).append(32, ' ').c_str()));
+
+	v expected = tree;
+	for (int i = first_leaf - 1; i >= 0; --i)
+		expected[std::size_t(i)] = H(expected[std::size_t(i * 2 + 1)], expected[std::size_t(i * 2 + 2)]);
+
+	merkle_fill_tree(tree, num_leafs);
+	TEST_CHECK(tree == expected);
+
+	std::vector<sha256_hash> buf;
+	v const leafs(expected.begin() + first_leaf, expected.end());
+	TEST_CHECK(merkle_root(leafs) == expected[0]);
+	TEST_CHECK(merkle_root_scratch(leafs, num_leafs, o, buf) == expected[0]);
+	TEST_CHECK(merkle_validate_single_layer(expected));
+
+	bitfield verified(num_leafs);
+	v dst(expected.size());
+	merkle_validate_copy(expected, dst, expected[0], verified);
+	TEST_CHECK(dst == expected);
+	TEST_CHECK(verified.all_set());
+}
+
 TORRENT_TEST(merkle_fill_partial_tree)
 {
 	// fill whole tree
@@ -397,6 +397,41 @@ TORRENT_TEST(get_piece_layer_piece_layer_mode)
 	}
 }
 
+TORRENT_TEST(collapse_to_piece_layer)
+{
+	// 8 blocks per piece.
+	aux::merkle_tree t(num_blocks, 8, f[0].data());
+
+	// there's nothing to collapse in an empty tree
+	TEST_CHECK(!t.collapse_to_piece_layer());
+
+	t.load_tree(span<sha256_hash const>(f).first(int(t.size())), empty_verified);
+	TEST_CHECK(t.is_complete());
+	auto const piece_layer = t.get_piece_layer();
+
+	TEST_CHECK(t.collapse_to_piece_layer());
+	TEST_CHECK(!t.is_complete());
+	TEST_CHECK(t.get_piece_layer() == piece_layer);
+	TEST_CHECK(t.verified_leafs() == none_set(num_blocks));
+	TEST_CHECK(t.get_hashes(0, 0, 8, 0).empty());
+	TEST_CHECK(!t.collapse_to_piece_layer());
+
+	// add back the block hashes of the first piece
+	int const first_leaf = merkle_first_leaf(num_leafs);
+	auto result = aux::merkle_tree::set_block_result::unknown;
+	for (int i = 0; i < 8; ++i)
+		result = std::get<0>(t.set_block(i, f[first_leaf + i]));
+	TEST_CHECK(result == aux::merkle_tree::set_block_result::ok);
+	TEST_CHECK(t.blocks_verified(0, 8));
+	TEST_CHECK(t.get_hashes(0, 0, 8, 0) == std::vector<sha256_hash>(f.begin() + first_leaf
+		, f.begin() + first_leaf + 8));
+
+	// collapsing again drops them
+	TEST_CHECK(t.collapse_to_piece_layer());
+	TEST_CHECK(!t.blocks_verified(0, 8));
+	TEST_CHECK(t.get_piece_layer() == piece_layer);
+}
+
 TORRENT_TEST(merkle_tree_get_hashes)
 {
 	aux::merkle_tree t(num_blocks, 2, f[0].data());
@@ -35,8 +35,12 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <algorithm>
 #include <iostream>
+#include <cstring>
+#include <string>
+#include <vector>
 
 #include "libtorrent/hasher.hpp"
+#include "libtorrent/hex.hpp"
 #include "libtorrent/pe_crypto.hpp"
 #include "libtorrent/random.hpp"
 #include "libtorrent/span.hpp"
@@ -155,6 +159,109 @@ TORRENT_TEST(rc4)
 	test_enc_handler(rc41, rc42);
 }
 
+TORRENT_TEST(rc4_known_answer)
+{
+	auto check = [](char const* key, std::string text, char const* expected)
+	{
+		lt::rc4 state;
+		lt::rc4_init(reinterpret_cast<unsigned char const*>(key), std::strlen(key), &state);
+		lt::span<char> buf(&text[0], int(text.size()));
+		lt::rc4_crypt(buf, state);
+		TEST_EQUAL(lt::aux::to_hex(text), expected);
+	};
+	check("Key", "Plaintext", "bbf316e8d940af0ad3");
+	check("Wiki", "pedia", "1021bf0420");
+	check("Secret", "Attack at dawn", "45a01f645fc35b383552544b9bf5");
+}
+
+TORRENT_TEST(rc4_split_buffers)
+{
+	std::vector<char> whole(1000);
+	lt::aux::random_bytes(whole);
+	std::vector<char> split = whole;
+
+	lt::rc4 state1;
+	lt::rc4 state2;
+	char const key[] = "split buffer key";
+	lt::rc4_init(reinterpret_cast<unsigned char const*>(key), sizeof(key) - 1, &state1);
+	state2 = state1;
+
+	lt::span<char> whole_buf(whole);
+	lt::rc4_crypt(whole_buf, state1);
+
+	// the keystream must continue across buffers of all sizes, including the
+	// ones not a multiple of the 8 bytes processed at a time
+	std::vector<lt::span<char>> bufs;
+	int offset = 0;
+	for (int len = 0; offset + len <= int(split.size()); offset += len, ++len)
+		bufs.emplace_back(split.data() + offset, len);
+	bufs.emplace_back(split.data() + offset, int(split.size()) - offset);
+	lt::rc4_crypt(bufs, state2);
+
+	TEST_CHECK(whole == split);
+	TEST_EQUAL(state1.x, state2.x);
+	TEST_EQUAL(state1.y, state2.y);
+}
+
+TORRENT_TEST(rc4_decrypt_ahead)
+{
+	using namespace lt;
+
+	sha1_hash const key = hasher("test1_key", 8).final();
+
+	std::vector<char> plain(1000);
+	aux::random_bytes(plain);
+
+	for (bool const stream_cipher : {false, true})
+	{
+		rc4_handler enc;
+		enc.set_outgoing_key(key);
+		auto dec = std::make_shared<rc4_handler>();
+		dec->set_incoming_key(key);
+
+		std::vector<char> wire = plain;
+		span<char> wire_buf(wire);
+		enc.encrypt(wire_buf);
+
+		aux::receive_buffer buf;
+		aux::crypto_receive_buffer crypto_buf(buf);
+		encryption_handler handler;
+		handler.switch_recv_crypto(dec, crypto_buf, stream_cipher);
+		buf.reset(100);
+
+		// the data arrives in two chunks that don't line up with the 100
+		// byte messages. The messages are passed on one at a time
+		int received = 0;
+		int parsed = 0;
+		for (int const chunk : {550, 450})
+		{
+			buf.normalize();
+			span<char> const dst = buf.reserve(chunk);
+			std::copy(wire.begin() + received, wire.begin() + received + chunk, dst.begin());
+			buf.received(chunk);
+			received += chunk;
+
+			int bytes = chunk;
+			while (bytes > 0)
+			{
+				int const sub = buf.advance_pos(bytes);
+				bytes -= sub;
+				std::size_t transferred = std::size_t(sub);
+				handler.decrypt(crypto_buf, transferred);
+				TEST_EQUAL(int(transferred), sub);
+				if (!buf.packet_finished()) continue;
+
+				span<char const> const msg = buf.get();
+				TEST_EQUAL(msg.size(), 100);
+				TEST_CHECK(std::equal(msg.begin(), msg.end(), plain.begin() + parsed));
+				parsed += 100;
+				buf.cut(100, 100);
+			}
+		}
+		TEST_EQUAL(parsed, 1000);
+	}
+}
+
 #else
 TORRENT_TEST(disabled)
 {
@@ -47,6 +47,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <vector>
 #include <memory> // for shared_ptr
 #include <cstdarg>
+#include <cstdio>
+#include <algorithm>
+#include <set>
 
 using namespace lt;
 
@@ -191,8 +194,7 @@ void mock_peer_connection::disconnect(error_code const&
 
 bool has_peer(peer_list const& p, tcp::endpoint const& ep)
 {
-	auto const its = p.find_peers(ep.address());
-	return its.first != its.second;
+	return !p.find_peers(ep.address()).empty();
 }
 
 torrent_state init_state()
@@ -732,6 +734,117 @@ TORRENT_TEST(has_peer)
 	TEST_EQUAL(p.has_peer(peer2), true);
 }
 
+// add enough peers to grow the address index a few times, then erase a
+// range of them and make sure lookups still find exactly the right ones
+TORRENT_TEST(address_index)
+{
+	torrent_state st = init_state();
+	st.max_peerlist_size = 0;
+	st.allow_multiple_connections_per_ip = true;
+	std::vector<address> banned;
+
+	mock_torrent t(&st);
+	peer_list p(allocator);
+	t.m_p = &p;
+
+	for (int i = 0; i < 2000; ++i)
+	{
+		char buf[30];
+		std::snprintf(buf, sizeof(buf), "10.%d.%d.1", i / 200, i % 200);
+		TEST_CHECK(add_peer(p, st, ep(buf, 1000)));
+		TEST_CHECK(add_peer(p, st, ep(buf, 2000)));
+		std::snprintf(buf, sizeof(buf), "2001::%x", i);
+		TEST_CHECK(add_peer(p, st, ep(buf, 1000)));
+	}
+	TEST_EQUAL(p.num_peers(), 6000);
+
+	// adding a known endpoint again does not create a new entry
+	torrent_peer* known = p.add_peer(ep("10.3.7.1", 2000), {}, {}, &st);
+	TEST_CHECK(known);
+	TEST_EQUAL(st.first_time_seen, false);
+	TEST_EQUAL(p.num_peers(), 6000);
+
+	ip_filter filter;
+	filter.add_rule(addr4("10.2.0.0"), addr4("10.4.255.255"), ip_filter::blocked);
+	p.apply_ip_filter(filter, &st, banned);
+	TEST_EQUAL(int(st.erased.size()), 1200);
+	st.erased.clear();
+	TEST_EQUAL(p.num_peers(), 4800);
+	TEST_EQUAL(p.num_connect_candidates(), 4800);
+
+	TEST_CHECK(p.find_peers(addr4("10.3.7.1")).empty());
+	TEST_EQUAL(p.find_peers(addr4("10.1.7.1")).size(), 2);
+	TEST_EQUAL(p.find_peers(addr4("10.5.7.1")).size(), 2);
+	TEST_EQUAL(p.find_peers(addr6("2001::4ff")).size(), 1);
+	TEST_CHECK(p.find_peers(addr6("2001::ffff")).empty());
+
+	for (torrent_peer const* pe : p)
+	{
+		auto const peers = p.find_peers(pe->address());
+		TEST_CHECK(std::find(peers.begin(), peers.end(), pe) != peers.end());
+	}
+}
+
+// when all candidates are waiting for their reconnect timeout, the peer list
+// reports when the first of them may be tried again
+TORRENT_TEST(next_connect_time)
+{
+	torrent_state st = init_state();
+	st.min_reconnect_time = 60;
+	mock_torrent t(&st);
+	peer_list p(allocator);
+	t.m_p = &p;
+
+	torrent_peer* peer1 = add_peer(p, st, ep("10.0.0.1", 4000));
+	torrent_peer* peer2 = add_peer(p, st, ep("10.0.0.2", 4000));
+	TEST_CHECK(peer1 && peer2);
+	peer1->last_connected = 100;
+	p.set_failcount(peer1, 1);
+	peer2->last_connected = 150;
+	TEST_EQUAL(p.num_connect_candidates(), 2);
+
+	// peer1 may be tried again at 100 + 2 * 60, peer2 at 150 + 60
+	TEST_CHECK(p.connect_one_peer(160, &st) == nullptr);
+	TEST_EQUAL(st.next_connect_time, 210);
+
+	st.next_connect_time = 0;
+	TEST_CHECK(p.connect_one_peer(210, &st) == peer2);
+	TEST_EQUAL(st.next_connect_time, 0);
+}
+
+// erasing a peer behind the round-robin cursor moves the last peer into its
+// slot. Make sure that peer is still visited by the next scan, rather than
+// only once the cursor wraps around
+TORRENT_TEST(erase_peer_round_robin)
+{
+	torrent_state st = init_state();
+	st.max_peerlist_size = 0;
+	mock_torrent t(&st);
+	peer_list p(allocator);
+	t.m_p = &p;
+
+	torrent_peer* candidate = nullptr;
+	for (int i = 0; i < 700; ++i)
+	{
+		char buf[30];
+		std::snprintf(buf, sizeof(buf), "10.0.%d.%d", i / 200, i % 200 + 1);
+		candidate = add_peer(p, st, ep(buf, 1000));
+		TEST_CHECK(candidate);
+		// only the last peer is a connect candidate
+		if (i < 699) p.set_failcount(candidate, 3);
+	}
+	TEST_EQUAL(p.num_connect_candidates(), 1);
+
+	// the first scan visits the first 300 peers
+	TEST_CHECK(p.connect_one_peer(0, &st) == nullptr);
+
+	p.erase_peer(*std::next(p.begin(), 5), &st);
+	st.erased.clear();
+	TEST_EQUAL(p.num_peers(), 699);
+
+	TEST_CHECK(p.connect_one_peer(0, &st) == candidate);
+}
+
 // test connect_candidates torrent_finish
 TORRENT_TEST(connect_candidates_finish)
 {
@@ -1238,6 +1351,50 @@ TORRENT_TEST(clear_peers)
 	TEST_EQUAL(p.num_seeds(), 0);
 }
 
+// peers are allocated in slabs and referred to by 32 bit handles, which
+// must keep resolving to the same peer
+TORRENT_TEST(peer_allocator_handles)
+{
+	torrent_peer_allocator a;
+	std::vector<peer_handle> handles;
+	std::set<torrent_peer const*> addresses;
+
+	// more than a slab's worth of each type
+	for (int i = 0; i < 3000; ++i)
+	{
+		bool const v6 = (i % 2) != 0;
+		peer_handle const h = a.allocate_peer_entry(v6
+			? torrent_peer_allocator_interface::ipv6_peer_type
+			: torrent_peer_allocator_interface::ipv4_peer_type);
+		TEST_CHECK(h != torrent_peer_allocator_interface::invalid_handle);
+		void* const mem = a.peer_at(h);
+		torrent_peer* const pe = v6
+			? static_cast<torrent_peer*>(new (mem) ipv6_peer(ep("2001::1", std::uint16_t(i + 1)), true, {}))
+			: static_cast<torrent_peer*>(new (mem) ipv4_peer(ep("10.0.0.1", std::uint16_t(i + 1)), true, {}));
+		addresses.insert(pe);
+		handles.push_back(h);
+	}
+	TEST_EQUAL(addresses.size(), 3000);
+	TEST_EQUAL(a.live_allocations(), 3000);
+
+	for (int i = 0; i < 3000; ++i)
+	{
+		torrent_peer const* pe = a.peer_at(handles[std::size_t(i)]);
+		TEST_EQUAL(pe->port, i + 1);
+		TEST_EQUAL(bool(pe->is_v6_addr), (i % 2) != 0);
+	}
+
+	// a freed entry is the first to be reused
+	a.free_peer_entry(handles[10]);
+	peer_handle const h = a.allocate_peer_entry(
+		torrent_peer_allocator_interface::ipv4_peer_type);
+	TEST_EQUAL(h, handles[10]);
+	new (a.peer_at(h)) ipv4_peer(ep("10.0.0.2", 11), true, {});
+
+	for (auto const e : handles) a.free_peer_entry(e);
+	TEST_EQUAL(a.live_allocations(), 0);
+}
+
 // TODO: test erasing peers
 // TODO: test update_peer_port with allow_multiple_connections_per_ip and without
 // TODO: test add i2p peers
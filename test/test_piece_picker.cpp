@@ -1624,6 +1624,38 @@ TORRENT_TEST(seed_optimization)
 	TEST_CHECK(verify_availability(p, "1110111111111111"));
 }
 
+TORRENT_TEST(bitfield_refcount_large)
+{
+	// with many pieces, a sparse bitfield updates the pieces individually and
+	// a dense one marks the piece list dirty. Both must end up with the same
+	// availability
+	int const num_pieces = 5000;
+	auto p = std::make_shared<piece_picker>(
+		std::int64_t(num_pieces) * default_piece_size, default_piece_size);
+
+	typed_bitfield<piece_index_t> sparse(num_pieces, false);
+	for (int i = 0; i < num_pieces; i += 499) sparse.set_bit(piece_index_t(i));
+	typed_bitfield<piece_index_t> dense(num_pieces, false);
+	for (int i = 0; i < num_pieces; i += 3) dense.set_bit(piece_index_t(i));
+
+	p->inc_refcount(sparse, &tmp1);
+	pick_pieces(p, std::string(num_pieces, '*').c_str(), 1, 0, nullptr);
+	p->inc_refcount(dense, &tmp2);
+
+	aux::vector<int, piece_index_t> avail;
+	p->get_availability(avail);
+	for (piece_index_t i(0); i < piece_index_t(num_pieces); ++i)
+		TEST_EQUAL(avail[i], int(sparse[i]) + int(dense[i]));
+
+	p->dec_refcount(dense, &tmp2);
+	pick_pieces(p, std::string(num_pieces, '*').c_str(), 1, 0, nullptr);
+	p->dec_refcount(sparse, &tmp1);
+
+	p->get_availability(avail);
+	for (piece_index_t i(0); i < piece_index_t(num_pieces); ++i)
+		TEST_EQUAL(avail[i], 0);
+}
+
 TORRENT_TEST(reversed_peers)
 {
 	// test reversed peers
@@ -1913,6 +1945,82 @@ TORRENT_TEST(get_download_queue)
 		, [](piece_picker::downloading_piece const& p) { return p.index == 3_piece; }), 1);
 }
 
+TORRENT_TEST(pick_pieces_batch)
+{
+	// piece 3 is the rarest, followed by the partial piece 1, which only has
+	// two free blocks left. We already have piece 6
+	auto p = setup_picker("4341444", "      *", "", " 3     ");
+
+	auto const all = string2vec("*******");
+	auto const some = string2vec("****** ");
+	auto const useless = string2vec("      *");
+
+	std::vector<piece_picker::batch_pick> batch;
+	batch.push_back({&all, &tmp1, 3, {}});
+	batch.push_back({&some, &tmp2, 4, {}});
+	batch.push_back({&useless, &tmp3, 4, {}});
+	p->pick_pieces_batch(batch, pc);
+
+	// the first peer gets the first three blocks of the rarest piece, the
+	// second peer gets the last one, then the free blocks of the partial piece
+	TEST_EQUAL(batch[0].num_blocks, 0);
+	TEST_CHECK((batch[0].picked == std::vector<piece_block>{
+		{3_piece, 0}, {3_piece, 1}, {3_piece, 2}}));
+
+	TEST_EQUAL(batch[1].num_blocks, 0);
+	TEST_EQUAL(batch[1].picked.size(), 4);
+	TEST_CHECK(batch[1].picked[0] == piece_block(3_piece, 3));
+	TEST_CHECK(batch[1].picked[1] == piece_block(1_piece, 2));
+	TEST_CHECK(batch[1].picked[2] == piece_block(1_piece, 3));
+	piece_block const last = batch[1].picked[3];
+	TEST_CHECK(some[last.piece_index]);
+	TEST_CHECK(last.piece_index != 1_piece && last.piece_index != 3_piece);
+	TEST_EQUAL(last.block_index, 0);
+
+	// the third peer doesn't have anything we want
+	TEST_EQUAL(batch[2].num_blocks, 4);
+	TEST_CHECK(batch[2].picked.empty());
+
+	// no block was handed to more than one peer
+	std::vector<piece_block> picked = batch[0].picked;
+	picked.insert(picked.end(), batch[1].picked.begin(), batch[1].picked.end());
+	TEST_CHECK(verify_pick(p, picked));
+}
+
+TORRENT_TEST(download_queue_add_remove)
+{
+	// add and remove downloading pieces out of order, and make sure every
+	// remaining piece can still be found
+	auto p = setup_picker("11111111", "        ", "", "");
+
+	for (piece_index_t const i : {5_piece, 1_piece, 7_piece, 3_piece, 0_piece, 6_piece})
+		TEST_CHECK(p->mark_as_downloading({i, 0}, tmp_peer));
+
+	p->abort_download({1_piece, 0}, tmp_peer);
+	p->abort_download({5_piece, 0}, tmp_peer);
+	TEST_CHECK(p->mark_as_downloading({2_piece, 0}, tmp_peer));
+	p->abort_download({6_piece, 0}, tmp_peer);
+
+	auto const dl = p->get_download_queue();
+	TEST_EQUAL(dl.size(), 4);
+	TEST_CHECK(std::is_sorted(dl.begin(), dl.end()));
+
+	for (piece_index_t const i : {0_piece, 2_piece, 3_piece, 7_piece})
+	{
+		piece_picker::downloading_piece st;
+		p->piece_info(i, st);
+		TEST_EQUAL(st.index, i);
+		TEST_EQUAL(st.requested, 1);
+		TEST_CHECK(p->is_requested({i, 0}));
+	}
+
+	for (piece_index_t const i : {1_piece, 4_piece, 5_piece, 6_piece})
+	{
+		TEST_CHECK(!p->is_requested({i, 0}));
+		TEST_EQUAL(p->piece_stats(i).downloading, 0);
+	}
+}
+
 TORRENT_TEST(get_download_queue_size)
 {
 	auto p = setup_picker("1111111", "       ", "1111111", "0327ff0");
@@ -0,0 +1,376 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "test.hpp"
+#include "libtorrent/aux_/slab_allocator.hpp"
+#include "libtorrent/aux_/buffer_arena.hpp"
+#include "libtorrent/aux_/buffer.hpp"
+#include "libtorrent/aux_/disk_buffer_pool.hpp"
+#include "libtorrent/aux_/session_settings.hpp"
+#include "libtorrent/disk_observer.hpp"
+#include "libtorrent/disk_interface.hpp"
+#include "libtorrent/io_context.hpp"
+
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+
+using namespace lt;
+
+TORRENT_TEST(slab_allocate_free)
+{
+	aux::slab_allocator a;
+
+	std::vector<char*> blocks;
+	for (int i = 0; i < 1000; ++i)
+	{
+		char* b = a.allocate();
+		TEST_CHECK(b != nullptr);
+		if (b == nullptr) break;
+		std::memset(b, i & 0xff, std::size_t(a.block_size()));
+		blocks.push_back(b);
+	}
+
+	// the blocks don't overlap
+	std::set<char*> unique(blocks.begin(), blocks.end());
+	TEST_EQUAL(unique.size(), blocks.size());
+	for (std::size_t i = 1; i < blocks.size(); ++i)
+	{
+		TEST_CHECK(std::abs(blocks[i] - blocks[i - 1]) >= a.block_size());
+	}
+	for (std::size_t i = 0; i < blocks.size(); ++i)
+	{
+		TEST_EQUAL(blocks[i][0], char(i & 0xff));
+		TEST_EQUAL(blocks[i][a.block_size() - 1], char(i & 0xff));
+	}
+
+	int const slabs = a.stats().slabs;
+	TEST_EQUAL(slabs, (1000 + a.blocks_per_slab() - 1)
+		/ a.blocks_per_slab());
+
+	for (char* b : blocks) a.free(b);
+
+	// most of the slabs are returned to the system. Only the blocks kept in
+	// the thread cache and depot hold on to slabs
+	TEST_CHECK(a.stats().slabs < slabs);
+
+	// allocating again is served from the cache
+	auto const before = a.stats();
+	char* b = a.allocate();
+	TEST_CHECK(b != nullptr);
+	TEST_EQUAL(a.stats().magazine_hits, before.magazine_hits + 1);
+	a.free(b);
+}
+
+TORRENT_TEST(slab_magazine_hits)
+{
+	aux::slab_allocator a;
+
+	// alternating allocations and frees never leave the thread's cache
+	char* b = a.allocate();
+	a.free(b);
+	auto const before = a.stats();
+	for (int i = 0; i < 1000; ++i)
+	{
+		b = a.allocate();
+		a.free(b);
+	}
+	auto const after = a.stats();
+	TEST_EQUAL(after.magazine_hits - before.magazine_hits, 2000);
+	TEST_EQUAL(after.magazine_misses, before.magazine_misses);
+}
+
+TORRENT_TEST(slab_threads)
+{
+	aux::slab_allocator a;
+
+	// blocks are allocated by one thread and freed by another, like disk
+	// buffers received by the network thread and freed by a disk thread
+	std::vector<std::vector<char*>> handoff(4);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&a, &handoff, t]
+		{
+			for (int i = 0; i < 500; ++i)
+			{
+				char* b = a.allocate();
+				if (b == nullptr) continue;
+				std::memset(b, t, std::size_t(a.block_size()));
+				handoff[std::size_t(t)].push_back(b);
+			}
+		});
+	}
+	for (auto& t : threads) t.join();
+	threads.clear();
+
+	std::set<char*> unique;
+	for (int t = 0; t < 4; ++t)
+	{
+		TEST_EQUAL(handoff[std::size_t(t)].size(), 500);
+		for (char* b : handoff[std::size_t(t)])
+		{
+			TEST_EQUAL(b[100], char(t));
+			unique.insert(b);
+		}
+	}
+	TEST_EQUAL(unique.size(), 2000);
+
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&a, &handoff, t]
+		{
+			for (char* b : handoff[std::size_t((t + 1) % 4)]) a.free(b);
+		});
+	}
+	for (auto& t : threads) t.join();
+}
+
+TORRENT_TEST(slab_block_sizes)
+{
+	for (int bs = aux::slab_allocator::min_block_size; bs <= aux::slab_allocator::slab_size; bs *= 4)
+	{
+		aux::slab_allocator a(bs);
+		TEST_EQUAL(a.blocks_per_slab(), aux::slab_allocator::slab_size / bs);
+
+		// fill two slabs
+		std::vector<char*> blocks;
+		for (int i = 0; i < a.blocks_per_slab() * 2; ++i)
+		{
+			char* b = a.allocate();
+			TEST_CHECK(b != nullptr);
+			if (b == nullptr) break;
+			b[0] = 'a';
+			b[bs - 1] = 'b';
+			blocks.push_back(b);
+		}
+		std::set<char*> unique(blocks.begin(), blocks.end());
+		TEST_EQUAL(unique.size(), blocks.size());
+		TEST_EQUAL(a.stats().slabs, 2);
+		for (char* b : blocks) a.free(b);
+	}
+}
+
+TORRENT_TEST(slab_hugepages)
+{
+	aux::slab_allocator a;
+	a.set_hugepages(true);
+	a.set_numa_local(true);
+
+	std::vector<char*> blocks;
+	for (int i = 0; i < a.blocks_per_slab() * 3; ++i)
+	{
+		char* b = a.allocate();
+		TEST_CHECK(b != nullptr);
+		if (b == nullptr) break;
+		std::memset(b, 0x55, std::size_t(a.block_size()));
+		blocks.push_back(b);
+	}
+
+	// whether the system has huge pages reserved or not, every slab is
+	// accounted for, either as a huge page or as a fallback
+	auto const st = a.stats();
+	TEST_EQUAL(st.slabs, 3);
+	TEST_EQUAL(st.hugepage_slabs + st.hugepage_fallbacks, 3);
+	for (char* b : blocks) a.free(b);
+}
+
+namespace {
+int g_node = 0;
+int mock_node() { return g_node; }
+}
+
+TORRENT_TEST(slab_numa_foreign_free)
+{
+	aux::slab_allocator a;
+	a.set_numa_local(true);
+	a.set_node_function(&mock_node);
+
+	// allocate a full slab on node 0
+	g_node = 0;
+	std::vector<char*> blocks;
+	for (int i = 0; i < a.blocks_per_slab(); ++i)
+		blocks.push_back(a.allocate());
+	TEST_EQUAL(a.stats().slabs, 1);
+	char* const lo = *std::min_element(blocks.begin(), blocks.end());
+
+	// free them all from a thread on node 1. Only the blocks still in the
+	// thread's cache (two magazines of 16) may be handed out again on node
+	// 1, the others must go back to their slab rather than to the depot
+	g_node = 1;
+	for (char* b : blocks) a.free(b);
+	blocks.clear();
+
+	int foreign = 0;
+	for (int i = 0; i < a.blocks_per_slab(); ++i)
+	{
+		char* const b = a.allocate();
+		if (b >= lo && b < lo + aux::slab_allocator::slab_size) ++foreign;
+		blocks.push_back(b);
+	}
+	TEST_CHECK(foreign <= 32);
+	TEST_EQUAL(a.stats().slabs, 2);
+	for (char* b : blocks) a.free(b);
+}
+
+TORRENT_TEST(slab_numa_consumer_node)
+{
+	aux::slab_allocator a;
+	a.set_numa_local(true);
+	a.set_node_function(&mock_node);
+
+	// a thread on node 1 allocating on behalf of a consumer on node 0 gets
+	// blocks from a node 0 slab
+	a.set_consumer_node(0);
+	g_node = 1;
+	std::vector<char*> blocks;
+	for (int i = 0; i < a.blocks_per_slab() / 2; ++i)
+		blocks.push_back(a.allocate());
+	TEST_EQUAL(a.stats().slabs, 1);
+
+	// a thread on node 0 takes the rest of that slab
+	a.set_consumer_node(-1);
+	g_node = 0;
+	for (int i = 0; i < a.blocks_per_slab() / 2; ++i)
+		blocks.push_back(a.allocate());
+	TEST_EQUAL(a.stats().slabs, 1);
+
+	// without a consumer node, the thread on node 1 needs a slab of its own
+	g_node = 1;
+	blocks.push_back(a.allocate());
+	TEST_EQUAL(a.stats().slabs, 2);
+	for (char* b : blocks) a.free(b);
+}
+
+TORRENT_TEST(buffer_arena_size_classes)
+{
+	aux::buffer_arena arena;
+
+	TEST_CHECK(!aux::buffer_arena::serves(100));
+	TEST_CHECK(!aux::buffer_arena::serves(aux::buffer_arena::min_size - 1));
+	TEST_CHECK(aux::buffer_arena::serves(aux::buffer_arena::min_size));
+	TEST_CHECK(aux::buffer_arena::serves(aux::buffer_arena::max_size));
+	TEST_CHECK(!aux::buffer_arena::serves(aux::buffer_arena::max_size + 1));
+
+	std::ptrdiff_t size = 16 * 1024 + 13;
+	char* b = arena.allocate(size);
+	TEST_CHECK(b != nullptr);
+	TEST_EQUAL(size, 32 * 1024);
+	std::memset(b, 0, std::size_t(size));
+	arena.free(b, size);
+
+	size = aux::buffer_arena::min_size;
+	b = arena.allocate(size);
+	TEST_EQUAL(size, aux::buffer_arena::min_size);
+	arena.free(b, size);
+
+	TEST_EQUAL(arena.stats().slabs, 2);
+}
+
+TORRENT_TEST(buffer_from_arena)
+{
+	aux::buffer_arena arena;
+	char const init[] = "foobar";
+
+	// small buffers are allocated on the heap
+	aux::buffer small(100, init, &arena);
+	TEST_CHECK(small.size() >= 100);
+	TEST_CHECK(std::memcmp(small.data(), init, sizeof(init)) == 0);
+	TEST_EQUAL(arena.stats().slabs, 0);
+
+	aux::buffer b(20000, init, &arena);
+	TEST_EQUAL(b.size(), 32 * 1024);
+	TEST_CHECK(std::memcmp(b.data(), init, sizeof(init)) == 0);
+	TEST_EQUAL(arena.stats().slabs, 1);
+
+	aux::buffer moved(std::move(b));
+	TEST_EQUAL(moved.size(), 32 * 1024);
+	TEST_CHECK(b.empty());
+
+	small = std::move(moved);
+	TEST_EQUAL(small.size(), 32 * 1024);
+	TEST_CHECK(std::memcmp(small.data(), init, sizeof(init)) == 0);
+
+	// too large for the arena
+	aux::buffer large(aux::buffer_arena::max_size + 1, init, &arena);
+	TEST_CHECK(large.size() > aux::buffer_arena::max_size);
+}
+
+namespace {
+
+struct test_observer : disk_observer
+{
+	void on_disk() override { ++called; }
+	int called = 0;
+};
+
+}
+
+TORRENT_TEST(disk_buffer_pool_watermark)
+{
+	io_context ios;
+	aux::disk_buffer_pool pool(ios);
+	aux::session_settings sett;
+	sett.set_int(settings_pack::max_queued_disk_bytes, 8 * default_block_size);
+	pool.set_settings(sett);
+
+	auto o = std::make_shared<test_observer>();
+
+	// the pool is considered full half way between the low watermark (4) and
+	// the max size (8)
+	std::vector<char*> blocks;
+	bool exceeded = false;
+	while (!exceeded && blocks.size() < 10)
+		blocks.push_back(pool.allocate_buffer(exceeded, o, "test"));
+	TEST_CHECK(exceeded);
+	TEST_EQUAL(blocks.size(), 6);
+	TEST_EQUAL(pool.in_use(), 6);
+
+	// the observer is notified once we drop to the low watermark
+	pool.free_buffer(blocks.back());
+	blocks.pop_back();
+	ios.poll();
+	TEST_EQUAL(o->called, 0);
+
+	pool.free_multiple_buffers(span<char*>(blocks).first(2));
+	ios.restart();
+	ios.poll();
+	TEST_EQUAL(o->called, 1);
+	TEST_EQUAL(pool.in_use(), 3);
+
+	for (char* b : span<char*>(blocks).subspan(2)) pool.free_buffer(b);
+	TEST_EQUAL(pool.in_use(), 0);
+}
@@ -0,0 +1,142 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/config.hpp"
+
+#if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
+
+#include "libtorrent/aux_/stats_export.hpp"
+#include "libtorrent/session_stats.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "test.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+using namespace lt;
+
+namespace {
+
+// reads the file into 8 byte aligned storage
+std::vector<std::int64_t> read_file(std::string const& name)
+{
+	std::ifstream f(name, std::ios::binary);
+	std::vector<char> const buf{std::istreambuf_iterator<char>(f)
+		, std::istreambuf_iterator<char>()};
+	std::vector<std::int64_t> ret((buf.size() + 7) / 8);
+	std::memcpy(ret.data(), buf.data(), buf.size());
+	return ret;
+}
+
+span<char const> bytes(std::vector<std::int64_t> const& v)
+{
+	return { reinterpret_cast<char const*>(v.data())
+		, static_cast<std::ptrdiff_t>(v.size() * 8) };
+}
+
+}
+
+TORRENT_TEST(stats_export_values)
+{
+	counters c;
+	c.inc_stats_counter(counters::recv_bytes, 1337);
+	c.set_value(counters::num_peers_connected, 42);
+
+	{
+		aux::stats_export ex("stats_export_test");
+		ex.update(c);
+	}
+
+	auto const file = read_file("stats_export_test");
+	std::vector<std::int64_t> values(counters::num_counters);
+	TEST_EQUAL(aux::read_stats_export(bytes(file), values), counters::num_counters);
+
+	for (int i = 0; i < counters::num_counters; ++i)
+		TEST_EQUAL(values[std::size_t(i)], c[i]);
+
+	int const idx = find_metric_idx("net.recv_bytes");
+	TEST_CHECK(idx >= 0);
+	TEST_EQUAL(values[std::size_t(idx)], 1337);
+}
+
+TORRENT_TEST(stats_export_metrics)
+{
+	{
+		aux::stats_export ex("stats_export_test");
+	}
+
+	auto const file = read_file("stats_export_test");
+	auto const& hdr = *reinterpret_cast<aux::stats_export_header const*>(file.data());
+	TEST_EQUAL(std::string(hdr.magic), "LTSTATS");
+	TEST_EQUAL(hdr.version, aux::stats_export::version);
+	TEST_EQUAL(int(hdr.num_values), counters::num_counters);
+	TEST_EQUAL(hdr.sequence.load(), 0);
+
+	auto const metrics = session_stats_metrics();
+	TEST_EQUAL(hdr.num_metrics, metrics.size());
+	TEST_CHECK(hdr.values_offset >= hdr.metrics_offset
+		+ hdr.num_metrics * sizeof(aux::stats_export_metric));
+
+	auto const* m = reinterpret_cast<aux::stats_export_metric const*>(
+		bytes(file).data() + hdr.metrics_offset);
+	for (auto const& metric : metrics)
+	{
+		TEST_EQUAL(std::string(m->name), metric.name);
+		TEST_EQUAL(int(m->value_index), metric.value_index);
+		TEST_EQUAL(m->type, metric.type == metric_type_t::gauge ? 1u : 0u);
+		++m;
+	}
+}
+
+TORRENT_TEST(stats_export_invalid)
+{
+	std::vector<std::int64_t> values(counters::num_counters);
+	std::vector<std::int64_t> garbage(100, 0x4141414141414141);
+	TEST_EQUAL(aux::read_stats_export(bytes(garbage), values), -1);
+	TEST_EQUAL(aux::read_stats_export({}, values), -1);
+
+	{
+		aux::stats_export ex("stats_export_test");
+		ex.update(counters());
+	}
+
+	// a truncated file is rejected
+	auto file = read_file("stats_export_test");
+	file.resize(file.size() / 2);
+	TEST_EQUAL(aux::read_stats_export(bytes(file), values), -1);
+}
+
+#else
+TORRENT_TEST(dummy) {}
+#endif
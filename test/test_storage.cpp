@@ -57,12 +57,15 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/random.hpp"
 #include "libtorrent/mmap_disk_io.hpp"
 #include "libtorrent/posix_disk_io.hpp"
+#include "libtorrent/io_uring_disk_io.hpp"
 #include "libtorrent/flags.hpp"
 
 #include <memory>
 #include <functional> // for bind
+#include <thread>
 
 #include <iostream>
+#include <array>
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <boost/variant/get.hpp>
@@ -736,6 +739,23 @@ TORRENT_TEST(check_files_allocate_posix)
 	test_check_files(zero_prio, lt::posix_disk_io_constructor);
 }
 
+#if TORRENT_HAVE_IO_URING
+TORRENT_TEST(check_files_sparse_io_uring)
+{
+	test_check_files(sparse | zero_prio, lt::io_uring_disk_io_constructor);
+}
+
+TORRENT_TEST(check_files_oversized_io_uring)
+{
+	test_check_files(sparse | test_oversized, lt::io_uring_disk_io_constructor);
+}
+
+TORRENT_TEST(check_files_allocate_io_uring)
+{
+	test_check_files(zero_prio, lt::io_uring_disk_io_constructor);
+}
+#endif
+
 #if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
 TORRENT_TEST(rename_mmap_disk_io)
 {
@@ -1727,6 +1747,235 @@ TORRENT_TEST(mmap_unaligned_read_both_store_buffer)
 	test_unaligned_read(lt::mmap_disk_io_constructor, second_side_from_store_buffer);
 	test_unaligned_read(lt::mmap_disk_io_constructor, none_from_store_buffer);
 }
+
+// a zero-copy read of a block in a memory mapped file hands out a pointer into
+// the mapping rather than a copy
+TORRENT_TEST(mmap_zero_copy_read)
+{
+	lt::io_context ioc;
+	lt::counters cnt;
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::aio_threads, 1);
+	std::unique_ptr<lt::disk_interface> disk_io
+		= lt::mmap_disk_io_constructor(ioc, pack, cnt);
+
+	// files smaller than this are not mapped
+	int const piece_size = int(lt::aux::mapped_file_cutoff);
+	lt::file_storage fs;
+	fs.add_file("test", piece_size * 2);
+	fs.set_num_pieces(2);
+	fs.set_piece_length(piece_size);
+
+	std::string const save_path = complete("save_path");
+	delete_dirs(combine_path(save_path, "test"));
+
+	lt::aux::vector<lt::download_priority_t, lt::file_index_t> prios;
+	lt::storage_params params(fs, nullptr, save_path, lt::storage_mode_sparse
+		, prios, lt::sha1_hash("01234567890123456789"));
+	lt::storage_holder t = disk_io->new_torrent(params, {});
+
+	std::vector<char> write_buffer(lt::default_block_size);
+	aux::random_bytes(write_buffer);
+	lt::peer_request const req{1_piece, lt::default_block_size, lt::default_block_size};
+
+	int outstanding = 1;
+	disk_io->async_write(t, req, write_buffer.data(), {}, write_handler(outstanding));
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	std::vector<lt::disk_buffer_holder> blocks;
+	for (int i = 0; i < 2; ++i)
+	{
+		++outstanding;
+		disk_io->async_read(t, req, [&](lt::disk_buffer_holder h, lt::storage_error const& ec)
+		{
+			--outstanding;
+			TEST_CHECK(!ec);
+			TEST_CHECK(lt::span<char const>(write_buffer) == lt::span<char const>(h.data(), h.size()));
+			blocks.push_back(std::move(h));
+		}, lt::disk_interface::zero_copy);
+		disk_io->submit_jobs();
+		sync(ioc, outstanding);
+	}
+
+	// both blocks point at the same place in the file mapping
+	TEST_EQUAL(blocks.size(), 2);
+	if (blocks.size() == 2) TEST_CHECK(blocks[0].data() == blocks[1].data());
+
+	// the mapping must outlive the storage and the file pool
+	t.reset();
+	disk_io->abort(true);
+	if (!blocks.empty())
+		TEST_CHECK(lt::span<char const>(write_buffer) == lt::span<char const>(blocks[0].data(), blocks[0].size()));
+}
+
+namespace {
+
+void test_write_vectored(int const write_mode)
+{
+	std::string const test_path = complete("temp_storage");
+	delete_dirs(test_path);
+
+	aux::session_settings set;
+	set.set_int(settings_pack::disk_write_mode, write_mode);
+	file_storage fs;
+	std::vector<char> buf;
+	aux::file_view_pool fp;
+	auto s = setup_torrent<mmap_storage>(fs, fp, buf, test_path, set);
+
+	// the buffers don't line up with the file boundary (at 0x4000 into the
+	// write) nor with each other
+	std::vector<char> data(0x10000);
+	fill_pattern(data);
+	span<char> const bufs[] = {
+		{data.data(), 0x3000},
+		{data.data() + 0x3000, 0x5000},
+		{data.data() + 0x8000, 0x1},
+		{data.data() + 0x8001, 0x7fff}
+	};
+
+	storage_error se;
+	int const ret = s->write(set, span<span<char> const>(bufs), 1_piece, 0
+		, aux::open_mode::write, disk_job_flags_t{}, se);
+	if (se) print_error("write", ret, se);
+	TEST_EQUAL(ret, 0x10000);
+	TEST_CHECK(!se);
+
+	std::vector<char> check(0x10000);
+	int const ret2 = read(s, set, check, 1_piece, 0, aux::open_mode::read_only, se);
+	if (se) print_error("read", ret2, se);
+	TEST_EQUAL(ret2, 0x10000);
+	TEST_CHECK(check == data);
+}
+}
+
+TORRENT_TEST(mmap_storage_write_vectored)
+{
+	test_write_vectored(settings_pack::always_mmap_write);
+}
+
+TORRENT_TEST(mmap_storage_write_vectored_pwrite)
+{
+	test_write_vectored(settings_pack::always_pwrite);
+}
+
+// write jobs for adjacent blocks that are queued up together are written
+// with a single operation
+TORRENT_TEST(mmap_disk_io_coalesce_writes)
+{
+	lt::io_context ioc;
+	lt::counters cnt;
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::aio_threads, 1);
+	std::unique_ptr<lt::disk_interface> disk_io
+		= lt::mmap_disk_io_constructor(ioc, pack, cnt);
+
+	int const block_size = lt::default_block_size;
+	lt::file_storage fs;
+	fs.add_file(combine_path("test", "a"), block_size * 5);
+	fs.add_file(combine_path("test", "b"), block_size * 11);
+	fs.set_num_pieces(4);
+	fs.set_piece_length(block_size * 4);
+
+	std::string const save_path = complete("save_path");
+	delete_dirs(combine_path(save_path, "test"));
+
+	lt::aux::vector<lt::download_priority_t, lt::file_index_t> prios;
+	lt::storage_params params(fs, nullptr, save_path, lt::storage_mode_sparse
+		, prios, lt::sha1_hash("01234567890123456789"));
+	lt::storage_holder t = disk_io->new_torrent(params, {});
+
+	std::vector<char> write_buffer(std::size_t(fs.total_size()));
+	aux::random_bytes(write_buffer);
+
+	// queue the blocks out of order, the run spans pieces and files
+	int const order[] = {5, 6, 7, 4, 8, 9, 0, 1, 2, 3, 12, 13, 10, 11, 14, 15};
+	int outstanding = 0;
+	for (int const b : order)
+	{
+		lt::peer_request const req{lt::piece_index_t(b / 4), (b % 4) * block_size, block_size};
+		++outstanding;
+		disk_io->async_write(t, req, write_buffer.data() + b * block_size, {}
+			, write_handler(outstanding));
+	}
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	TEST_EQUAL(cnt[counters::num_blocks_written], 16);
+	TEST_CHECK(cnt[counters::num_write_ops] < 16);
+
+	for (int b = 0; b < 16; ++b)
+	{
+		lt::peer_request const req{lt::piece_index_t(b / 4), (b % 4) * block_size, block_size};
+		++outstanding;
+		disk_io->async_read(t, req, [&, b](lt::disk_buffer_holder h, lt::storage_error const& ec)
+		{
+			--outstanding;
+			TEST_CHECK(!ec);
+			TEST_CHECK(lt::span<char const>(write_buffer).subspan(b * block_size, block_size)
+				== lt::span<char const>(h.data(), h.size()));
+		});
+	}
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	t.reset();
+	disk_io->abort(true);
+}
+
+// stop and remove a storage, and abort the disk I/O object, while writes that
+// could be coalesced are still queued. Every write must complete exactly
+// once, either successfully or with operation_aborted
+TORRENT_TEST(mmap_disk_io_coalesce_writes_abort)
+{
+	lt::io_context ioc;
+	lt::counters cnt;
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::aio_threads, 1);
+	std::unique_ptr<lt::disk_interface> disk_io
+		= lt::mmap_disk_io_constructor(ioc, pack, cnt);
+
+	int const block_size = lt::default_block_size;
+	lt::file_storage fs;
+	fs.add_file(combine_path("test", "a"), block_size * 16);
+	fs.set_num_pieces(4);
+	fs.set_piece_length(block_size * 4);
+
+	std::string const save_path = complete("save_path");
+	delete_dirs(combine_path(save_path, "test"));
+
+	lt::aux::vector<lt::download_priority_t, lt::file_index_t> prios;
+	lt::storage_params params(fs, nullptr, save_path, lt::storage_mode_sparse
+		, prios, lt::sha1_hash("01234567890123456789"));
+	lt::storage_holder t = disk_io->new_torrent(params, {});
+
+	std::vector<char> write_buffer(std::size_t(fs.total_size()));
+	aux::random_bytes(write_buffer);
+
+	int outstanding = 0;
+	std::vector<int> completions(16, 0);
+	for (int b = 0; b < 16; ++b)
+	{
+		lt::peer_request const req{lt::piece_index_t(b / 4), (b % 4) * block_size, block_size};
+		++outstanding;
+		disk_io->async_write(t, req, write_buffer.data() + b * block_size, {}
+			, [&, b](lt::storage_error const& ec)
+			{
+				--outstanding;
+				++completions[std::size_t(b)];
+				TEST_CHECK(!ec || ec.ec == boost::asio::error::operation_aborted);
+			});
+	}
+	++outstanding;
+	disk_io->async_stop_torrent(t, [&] { --outstanding; });
+	t.reset();
+	disk_io->submit_jobs();
+	disk_io->abort(true);
+	sync(ioc, outstanding);
+
+	for (int const c : completions)
+		TEST_EQUAL(c, 1);
+}
 #endif
 
 TORRENT_TEST(posix_unaligned_read_both_store_buffer)
@@ -1736,3 +1985,118 @@ TORRENT_TEST(posix_unaligned_read_both_store_buffer)
 	test_unaligned_read(lt::posix_disk_io_constructor, second_side_from_store_buffer);
 	test_unaligned_read(lt::posix_disk_io_constructor, none_from_store_buffer);
 }
+
+#if TORRENT_HAVE_IO_URING
+TORRENT_TEST(io_uring_unaligned_read_both_store_buffer)
+{
+	test_unaligned_read(lt::io_uring_disk_io_constructor, both_sides_from_store_buffer);
+	test_unaligned_read(lt::io_uring_disk_io_constructor, first_side_from_store_buffer);
+	test_unaligned_read(lt::io_uring_disk_io_constructor, second_side_from_store_buffer);
+	test_unaligned_read(lt::io_uring_disk_io_constructor, none_from_store_buffer);
+}
+
+namespace {
+
+// with hashing_threads = 0 the ring thread computes the hashes itself,
+// otherwise they are handed off to the hash thread pool
+void test_io_uring_hash(int const hashing_threads)
+{
+	int const piece_size = lt::default_block_size * 2;
+	int const num_pieces = 4;
+
+	lt::io_context ioc;
+	lt::counters cnt;
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::hashing_threads, hashing_threads);
+
+	std::unique_ptr<lt::disk_interface> disk_io
+		= lt::io_uring_disk_io_constructor(ioc, pack, cnt);
+
+	lt::file_storage fs;
+	fs.add_file("test", piece_size * num_pieces);
+	fs.set_num_pieces(num_pieces);
+	fs.set_piece_length(piece_size);
+
+	std::string const save_path = complete("save_path");
+	delete_dirs(combine_path(save_path, "test"));
+
+	lt::aux::vector<lt::download_priority_t, lt::file_index_t> prios;
+	lt::storage_params params(fs, nullptr
+		, save_path
+		, lt::storage_mode_sparse
+		, prios
+		, lt::sha1_hash("01234567890123456789"));
+
+	lt::storage_holder t = disk_io->new_torrent(params, {});
+
+	int outstanding = 0;
+	lt::add_torrent_params atp;
+	disk_io->async_check_files(t, &atp, lt::aux::vector<std::string, lt::file_index_t>{}
+		, [&](lt::status_t, lt::storage_error const&) { --outstanding; });
+	++outstanding;
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	std::vector<char> buffer(std::size_t(piece_size * num_pieces));
+	aux::random_bytes(buffer);
+
+	for (int i = 0; i < num_pieces * 2; ++i)
+	{
+		lt::peer_request const req{lt::piece_index_t(i / 2)
+			, (i % 2) * lt::default_block_size, lt::default_block_size};
+		++outstanding;
+		disk_io->async_write(t, req, buffer.data() + i * lt::default_block_size
+			, {}, write_handler(outstanding));
+	}
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	std::vector<std::array<lt::sha256_hash, 2>> block_hashes(num_pieces);
+	for (lt::piece_index_t p : fs.piece_range())
+	{
+		char const* piece = buffer.data() + static_cast<int>(p) * piece_size;
+		++outstanding;
+		disk_io->async_hash(t, p, block_hashes[std::size_t(static_cast<int>(p))]
+			, lt::disk_interface::v1_hash
+			, [&, piece](lt::piece_index_t, lt::sha1_hash const& h, lt::storage_error const& ec)
+			{
+				--outstanding;
+				TEST_CHECK(!ec);
+				TEST_EQUAL(h, lt::hasher(piece, piece_size).final());
+			});
+		++outstanding;
+		disk_io->async_hash2(t, p, lt::default_block_size, {}
+			, [&, piece](lt::piece_index_t, lt::sha256_hash const& h, lt::storage_error const& ec)
+			{
+				--outstanding;
+				TEST_CHECK(!ec);
+				TEST_EQUAL(h, lt::hasher256(piece + lt::default_block_size
+					, lt::default_block_size).final());
+			});
+	}
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	for (int i = 0; i < num_pieces * 2; ++i)
+	{
+		TEST_EQUAL(block_hashes[std::size_t(i / 2)][std::size_t(i % 2)]
+			, lt::hasher256(buffer.data() + i * lt::default_block_size
+				, lt::default_block_size).final());
+	}
+
+	t.reset();
+	disk_io->abort(true);
+}
+
+}
+
+TORRENT_TEST(io_uring_hash_disk_thread)
+{
+	test_io_uring_hash(0);
+}
+
+TORRENT_TEST(io_uring_hash_threads)
+{
+	test_io_uring_hash(2);
+}
+#endif
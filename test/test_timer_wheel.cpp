@@ -0,0 +1,160 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "test.hpp"
+#include "libtorrent/aux_/timer_wheel.hpp"
+#include "libtorrent/random.hpp"
+#include "libtorrent/time.hpp"
+
+#include <vector>
+#include <algorithm>
+
+using namespace lt;
+
+namespace {
+
+time_point const start = clock_type::now();
+
+}
+
+TORRENT_TEST(timer_wheel_expiry)
+{
+	aux::timer_wheel<int> w(milliseconds(100), start);
+	TEST_CHECK(w.empty());
+
+	w.schedule(start + milliseconds(250), 1);
+	w.schedule(start + milliseconds(300), 2);
+	w.schedule(start + seconds(10), 3);
+	TEST_EQUAL(w.size(), 3);
+
+	std::vector<int> fired;
+	auto const collect = [&](int v) { fired.push_back(v); };
+
+	w.advance(start + milliseconds(200), collect);
+	TEST_CHECK(fired.empty());
+
+	// timers are rounded up to the resolution
+	w.advance(start + milliseconds(299), collect);
+	TEST_CHECK(fired.empty());
+
+	w.advance(start + milliseconds(300), collect);
+	TEST_CHECK((fired == std::vector<int>{1, 2}));
+	fired.clear();
+
+	w.advance(start + milliseconds(9999), collect);
+	TEST_CHECK(fired.empty());
+	w.advance(start + seconds(11), collect);
+	TEST_CHECK((fired == std::vector<int>{3}));
+	TEST_CHECK(w.empty());
+}
+
+TORRENT_TEST(timer_wheel_past_due)
+{
+	aux::timer_wheel<int> w(milliseconds(100), start);
+	w.advance(start + seconds(1), [](int) {});
+
+	// a timer that's already due fires on the next tick
+	w.schedule(start, 1);
+	int fired = 0;
+	w.advance(start + seconds(1), [&](int) { ++fired; });
+	TEST_EQUAL(fired, 0);
+	w.advance(start + milliseconds(1100), [&](int) { ++fired; });
+	TEST_EQUAL(fired, 1);
+}
+
+TORRENT_TEST(timer_wheel_reschedule)
+{
+	aux::timer_wheel<int> w(milliseconds(100), start);
+	w.schedule(start + seconds(1), 0);
+
+	// a periodic timer, rescheduled from the handler
+	int count = 0;
+	for (int i = 1; i <= 100; ++i)
+	{
+		time_point const now = start + milliseconds(500 * i);
+		w.advance(now, [&](int v)
+		{
+			TEST_EQUAL(v, count);
+			++count;
+			w.schedule(now + seconds(1), v + 1);
+		});
+	}
+	// the wheel is advanced every 500 ms, so the timer fires at 1, 2, ... 50
+	// seconds
+	TEST_EQUAL(count, 50);
+	TEST_EQUAL(w.size(), 1);
+}
+
+TORRENT_TEST(timer_wheel_random)
+{
+	// with a resolution of 1 ms, the top level wheel wraps around after about
+	// 4.6 hours. Make sure timers spanning all levels, and beyond, fire at the
+	// right time
+	aux::timer_wheel<int> w(milliseconds(1), start);
+
+	std::vector<time_point> expiry;
+	for (int i = 0; i < 2000; ++i)
+	{
+		std::int64_t ms = 0;
+		switch (i % 5)
+		{
+			case 0: ms = lt::random(64); break;
+			case 1: ms = lt::random(4096); break;
+			case 2: ms = lt::random(262144); break;
+			case 3: ms = lt::random(16777216); break;
+			case 4: ms = 16777216 + lt::random(30000000); break;
+		}
+		expiry.push_back(start + milliseconds(ms));
+		w.schedule(expiry.back(), i);
+	}
+	TEST_EQUAL(w.size(), 2000);
+
+	std::vector<bool> fired(expiry.size(), false);
+	time_point now = start;
+	time_point prev = start;
+	while (!w.empty() && now < start + hours(14))
+	{
+		now += milliseconds(1 + lt::random(100000));
+		w.advance(now, [&](int const i)
+		{
+			TEST_CHECK(!fired[std::size_t(i)]);
+			fired[std::size_t(i)] = true;
+			// never early, and no later than the advance() it was due in
+			TEST_CHECK(expiry[std::size_t(i)] <= now);
+			TEST_CHECK(expiry[std::size_t(i)] > prev - milliseconds(1));
+		});
+		prev = now;
+	}
+	TEST_CHECK(w.empty());
+	TEST_CHECK(std::all_of(fired.begin(), fired.end(), [](bool b) { return b; }));
+}
@@ -0,0 +1,283 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "test.hpp"
+#include "libtorrent/udp_socket.hpp"
+#include "libtorrent/io_context.hpp"
+#include "libtorrent/error.hpp"
+#include "libtorrent/aux_/array.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace lt;
+
+namespace {
+
+struct socket_pair
+{
+	socket_pair()
+		: sender(ios, aux::listen_socket_handle())
+		, receiver(ios, aux::listen_socket_handle())
+	{
+		error_code ec;
+		sender.bind(udp::endpoint(make_address_v4("127.0.0.1"), 0), ec);
+		TEST_CHECK(!ec);
+		receiver.bind(udp::endpoint(make_address_v4("127.0.0.1"), 0), ec);
+		TEST_CHECK(!ec);
+		target = udp::endpoint(make_address_v4("127.0.0.1")
+			, std::uint16_t(receiver.local_port()));
+	}
+
+	void send(std::string const& msg, udp_send_flags_t const flags = {})
+	{
+		error_code ec;
+		sender.send(target, msg, ec, flags);
+		TEST_CHECK(!ec);
+	}
+
+	// drains the receiving socket and returns the payloads, in order
+	std::vector<std::string> receive_all()
+	{
+		std::vector<std::string> ret;
+		for (;;)
+		{
+			aux::array<udp_socket::packet, 50> p;
+			error_code ec;
+			int const num = receiver.read(p, ec);
+			for (auto const& pkt : span<udp_socket::packet>(p).first(num))
+			{
+				TEST_CHECK(!pkt.error);
+				TEST_EQUAL(pkt.from.port(), sender.local_port());
+				ret.emplace_back(pkt.data.data(), std::size_t(pkt.data.size()));
+			}
+			if (ec == error::would_block || ec == error::try_again) break;
+			TEST_CHECK(!ec);
+			if (ec) break;
+		}
+		return ret;
+	}
+
+	io_context ios;
+	udp_socket sender;
+	udp_socket receiver;
+	udp::endpoint target;
+};
+
+std::vector<std::string> make_messages(int const num)
+{
+	std::vector<std::string> ret;
+	for (int i = 0; i < num; ++i)
+		ret.push_back("message " + std::to_string(i));
+	return ret;
+}
+
+// a train of equally sized datagrams to the same endpoint is sent as a
+// single GSO buffer (where supported), which must arrive as individual
+// datagrams
+std::vector<std::string> make_train(int const num, int const size)
+{
+	std::vector<std::string> ret;
+	for (int i = 0; i < num; ++i)
+		ret.emplace_back(std::size_t(size), char('a' + i % 26));
+	// the last segment may be shorter
+	ret.emplace_back(std::size_t(size / 2), 'z');
+	return ret;
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(read_batch)
+{
+	socket_pair s;
+	auto const msgs = make_messages(udp_socket::max_batch_size + 10);
+	for (auto const& m : msgs) s.send(m);
+
+	TEST_CHECK(s.receive_all() == msgs);
+}
+
+TORRENT_TEST(read_none)
+{
+	socket_pair s;
+	aux::array<udp_socket::packet, 10> p;
+	error_code ec;
+	TEST_EQUAL(s.receiver.read(p, ec), 0);
+	TEST_CHECK(ec == error::would_block || ec == error::try_again);
+}
+
+TORRENT_TEST(cork)
+{
+	socket_pair s;
+	auto const msgs = make_messages(udp_socket::max_batch_size * 2 + 3);
+
+	s.sender.cork();
+	for (auto const& m : msgs) s.send(m);
+
+	error_code ec;
+	s.sender.uncork(ec);
+	TEST_CHECK(!ec);
+
+	TEST_CHECK(s.receive_all() == msgs);
+
+	// once uncorked, datagrams are sent immediately
+	s.send("foobar");
+	TEST_CHECK(s.receive_all() == std::vector<std::string>{"foobar"});
+}
+
+TORRENT_TEST(cork_preserve_order)
+{
+	socket_pair s;
+
+	s.sender.cork();
+	s.send("a");
+	s.send("b");
+	// DF datagrams bypass the queue, but not before the queued ones are sent
+	s.send("c", udp_socket::dont_fragment);
+	s.send("d");
+
+	error_code ec;
+	s.sender.uncork(ec);
+	TEST_CHECK(!ec);
+
+	TEST_CHECK((s.receive_all() == std::vector<std::string>{"a", "b", "c", "d"}));
+}
+
+TORRENT_TEST(cork_segments)
+{
+	socket_pair s;
+	auto const msgs = make_train(20, 1200);
+
+	s.sender.cork();
+	for (auto const& m : msgs) s.send(m);
+	error_code ec;
+	s.sender.uncork(ec);
+	TEST_CHECK(!ec);
+
+	TEST_CHECK(s.receive_all() == msgs);
+}
+
+TORRENT_TEST(nested_cork)
+{
+	socket_pair s;
+
+	s.sender.cork();
+	s.send("a");
+	s.sender.cork();
+	s.send("b");
+
+	error_code ec;
+	s.sender.uncork(ec);
+	TEST_CHECK(!ec);
+#if TORRENT_HAS_MMSG
+	// still corked by the outer call
+	TEST_CHECK(s.receive_all().empty());
+#endif
+	s.sender.uncork(ec);
+	TEST_CHECK(!ec);
+
+	TEST_CHECK((s.receive_all() == std::vector<std::string>{"a", "b"}));
+}
+
+TORRENT_TEST(gro)
+{
+	socket_pair s;
+	error_code ec;
+	s.receiver.set_gro(true, ec);
+	// GRO may not be supported on this system
+	if (ec) return;
+
+	auto const msgs = make_train(40, 1000);
+	s.sender.cork();
+	for (auto const& m : msgs) s.send(m);
+	s.sender.uncork(ec);
+	TEST_CHECK(!ec);
+
+	TEST_CHECK(s.receive_all() == msgs);
+
+	// GRO can be turned off again
+	s.receiver.set_gro(false, ec);
+	TEST_CHECK(!ec);
+	s.send("foobar");
+	TEST_CHECK(s.receive_all() == std::vector<std::string>{"foobar"});
+}
+
+#if TORRENT_HAS_MMSG
+TORRENT_TEST(cork_send_error)
+{
+	socket_pair s;
+	std::vector<std::pair<udp::endpoint, int>> failed;
+	s.sender.set_send_error_handler([&](udp::endpoint const& ep, int const size
+		, error_code const& e)
+	{
+		TEST_CHECK(e);
+		failed.emplace_back(ep, size);
+	});
+
+	// datagrams to the broadcast address are rejected, since SO_BROADCAST
+	// isn't set. They form a GSO run, which has to be split up to report
+	// each of them. The datagrams around them must still be delivered
+	udp::endpoint const bcast(make_address_v4("255.255.255.255"), 6881);
+	s.sender.cork();
+	s.send("a");
+	error_code ec;
+	for (int i = 0; i < 3; ++i)
+	{
+		s.sender.send(bcast, std::string(100, 'x'), ec);
+		TEST_CHECK(!ec);
+	}
+	s.send("b");
+	s.sender.uncork(ec);
+	TEST_CHECK(!ec);
+
+	TEST_EQUAL(int(failed.size()), 3);
+	for (auto const& f : failed)
+	{
+		TEST_CHECK(f.first == bcast);
+		TEST_EQUAL(f.second, 100);
+	}
+	TEST_CHECK((s.receive_all() == std::vector<std::string>{"a", "b"}));
+}
+
+TORRENT_TEST(close_corked)
+{
+	socket_pair s;
+
+	s.sender.cork();
+	s.send("a");
+	s.sender.close();
+
+	error_code ec;
+	s.sender.uncork(ec);
+	TEST_CHECK(!ec);
+	TEST_CHECK(s.receive_all().empty());
+}
+#endif
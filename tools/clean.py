@@ -45,6 +45,7 @@ def clean():
         'CMakeFiles',
         'CMakeCache.txt',
         'checking_benchmark',
+        'crypto_benchmark',
         'cpu_benchmark',
     ]
 
@@ -0,0 +1,163 @@
+/*
+
+Copyright (c) 2026, The libtorrent contributors
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+// measures the CPU cost of the peer protocol encryption (RC4), on a single
+// core, compared to plaintext connections. Plaintext payload is not touched
+// in user space, apart from the copy into the socket, which is what the
+// plaintext figure represents.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <cstring>
+#include <functional>
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/pe_crypto.hpp"
+#include "libtorrent/hasher.hpp"
+#include "libtorrent/random.hpp"
+#include "libtorrent/span.hpp"
+
+#if !defined TORRENT_DISABLE_ENCRYPTION
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// a piece message header followed by a 16 kiB block, repeated to fill 1 MiB.
+// This is what a send buffer full of uploads looks like
+struct send_buffer
+{
+	send_buffer()
+	{
+		int const num_blocks = 64;
+		headers.resize(num_blocks * 13);
+		blocks.resize(num_blocks * 0x4000);
+		lt::aux::random_bytes(headers);
+		lt::aux::random_bytes(blocks);
+		for (int i = 0; i < num_blocks; ++i)
+		{
+			iovec.emplace_back(headers.data() + i * 13, 13);
+			iovec.emplace_back(blocks.data() + i * 0x4000, 0x4000);
+		}
+	}
+
+	std::int64_t size() const
+	{ return std::int64_t(headers.size() + blocks.size()); }
+
+	std::vector<char> headers;
+	std::vector<char> blocks;
+	std::vector<lt::span<char>> iovec;
+};
+
+// runs fun repeatedly for about two seconds, and prints the throughput
+double run(char const* name, std::int64_t const bytes_per_round
+	, std::function<void()> const& fun)
+{
+	std::int64_t total = 0;
+	auto const start = clock_type::now();
+	auto end = start;
+	do
+	{
+		for (int i = 0; i < 16; ++i) fun();
+		total += bytes_per_round * 16;
+		end = clock_type::now();
+	} while (end - start < std::chrono::seconds(2));
+
+	double const seconds = std::chrono::duration<double>(end - start).count();
+	double const mbps = double(total) / seconds / 1000000.;
+	std::cout << std::left << std::setw(28) << name
+		<< std::right << std::fixed << std::setprecision(1)
+		<< std::setw(10) << mbps << " MB/s  "
+		<< std::setw(8) << std::setprecision(3)
+		<< (seconds * 1e9 / double(total)) << " ns/byte\n";
+	return mbps;
+}
+
+}
+
+int main()
+{
+	lt::sha1_hash const key = lt::hasher("benchmark_key", 13).final();
+
+	send_buffer buf;
+	std::vector<char> copy_target(std::size_t(buf.size()));
+
+	double const plain = run("plaintext (copy)", buf.size(), [&]
+	{
+		char* dst = copy_target.data();
+		for (auto const& b : buf.iovec)
+		{
+			std::memcpy(dst, b.data(), std::size_t(b.size()));
+			dst += b.size();
+		}
+	});
+
+	lt::rc4_handler rc4;
+	rc4.set_outgoing_key(key);
+	rc4.set_incoming_key(key);
+
+	double const send = run("rc4 send (iovec)", buf.size(), [&]
+	{
+		rc4.encrypt(buf.iovec);
+	});
+
+	// the receive side decrypts the receive buffer in place, in whatever
+	// chunks the socket returns
+	std::vector<char> recv_buf(std::size_t(buf.size()));
+	lt::aux::random_bytes(recv_buf);
+	double const recv = run("rc4 receive (64 kiB reads)", buf.size(), [&]
+	{
+		for (std::size_t i = 0; i < recv_buf.size(); i += 0x10000)
+		{
+			lt::span<char> chunk(recv_buf.data() + i
+				, int(std::min(std::size_t(0x10000), recv_buf.size() - i)));
+			rc4.decrypt(chunk);
+		}
+	});
+
+	std::cout << "\nencrypted connections are " << std::setprecision(1)
+		<< (plain / send) << "x (send) and " << (plain / recv)
+		<< "x (receive) as expensive per byte as plaintext\n";
+}
+
+#else
+
+int main()
+{
+	std::cerr << "encryption is disabled in this build\n";
+	return 1;
+}
+
+#endif